@@ -14,6 +14,7 @@ if [[ $# -eq 1 && -n $1 ]]; then
       "pbr.vert"
       "pbr.frag"
       "post_process.comp"
+      "cull_meshlets.comp"
       ) 
   fi
 
@@ -4,7 +4,9 @@
 #include "grass.h"
 
 #include "common/compute_pipeline_builder.h"
+#include "common/engine.h"
 #include "common/gltf_loader.h"
+#include "common/gpu_memory.h"
 #include "common/loaded_image.h"
 #include "common/logger.h"
 #include "common/pipeline_builder.h"
@@ -67,20 +69,15 @@ GrassProgram::~GrassProgram()
   RELEASE_IF(grass_pipeline_, SDL_ReleaseGPUGraphicsPipeline);
   RELEASE_IF(generate_grass_pipeline_, SDL_ReleaseGPUComputePipeline);
   RELEASE_IF(cull_chunks_pipeline_, SDL_ReleaseGPUComputePipeline);
-  RELEASE_IF(grassblade_indices_, SDL_ReleaseGPUBuffer);
-  RELEASE_IF(grassblade_vertices_, SDL_ReleaseGPUBuffer);
-  RELEASE_IF(grassblade_instances_, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(grassblade_indices_, GpuMemory::Release);
+  RELEASE_IF(grassblade_vertices_, GpuMemory::Release);
 
   RELEASE_IF(terrain_pipeline_, SDL_ReleaseGPUGraphicsPipeline);
-  RELEASE_IF(chunk_indices_, SDL_ReleaseGPUBuffer);
-  RELEASE_IF(chunk_instances_, SDL_ReleaseGPUBuffer);
-  RELEASE_IF(visible_chunks_, SDL_ReleaseGPUBuffer);
-  RELEASE_IF(visible_grassblades_, SDL_ReleaseGPUBuffer);
-  RELEASE_IF(draw_calls_, SDL_ReleaseGPUBuffer);
-
-  RELEASE_IF(depth_target_, SDL_ReleaseGPUTexture);
-  RELEASE_IF(scene_target_, SDL_ReleaseGPUTexture);
-  RELEASE_IF(noise_texture_, SDL_ReleaseGPUTexture);
+  RELEASE_IF(chunk_indices_, GpuMemory::Release);
+
+  RELEASE_IF(depth_target_, GpuMemory::Release);
+  RELEASE_IF(scene_target_, GpuMemory::Release);
+  RELEASE_IF(noise_texture_, GpuMemory::Release);
   SDL_WaitForGPUIdle(Device);
   ImGui_ImplSDL3_Shutdown();
   ImGui_ImplSDLGPU3_Shutdown();
@@ -127,7 +124,8 @@ GrassProgram::Init()
       info.layer_count_or_depth = 1;
       info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
     }
-    noise_texture_ = SDL_CreateGPUTexture(Device, &info);
+    noise_texture_ = GpuMemory::CreateTexture(
+      Device, info, GpuMemoryCategory::MaterialTexture, "Grass");
     if (!noise_texture_) {
       LOG_CRITICAL("Couldn't create noise texture");
       return false;
@@ -172,26 +170,16 @@ GrassProgram::Init()
       .first_instance = 0,
     },
   };
-  SDL_GPUBufferCreateInfo buf_info{};
-  {
-    buf_info.size = sizeof(draw_cmds);
-    buf_info.usage = SDL_GPU_BUFFERUSAGE_INDIRECT;
-  }
-  draw_calls_ = SDL_CreateGPUBuffer(Device, &buf_info);
-  if (!draw_calls_) {
-    LOG_ERROR("Couldn't create indirect buffer: {}", GETERR);
+  UploadBatch batch = EnginePtr->BeginUpload();
+  if (!draw_calls_.Assign(draw_cmds.data(), draw_cmds.size()) ||
+      !draw_calls_.Flush(batch) || !batch.Submit().Ok()) {
+    LOG_ERROR("Couldn't upload indirect draw calls");
     return false;
   }
 
-  EnginePtr->UploadToBuffer(draw_calls_, draw_cmds.data(), 2);
-
   return true;
 }
 
-static u64 prev_grassblades_size = 0;
-static u64 prev_chunks_size = 0;
-static u64 prev_visible_chunks_size = 0;
-static u64 prev_visible_grassblades_size = 0;
 bool
 GrassProgram::GenerateGrassblades()
 {
@@ -202,59 +190,20 @@ GrassProgram::GenerateGrassblades()
   auto blades_per_chunk = p.grass_per_chunk * p.grass_per_chunk;
   auto total_chunks = p.terrain_width * p.terrain_width;
 
-  { // resize storage buffers if needed
-
-    u32 new_grassblades_size =
-      blades_per_chunk * total_chunks * GRASS_INSTANCE_SZ;
-    u32 new_chunks_size = total_chunks * CHUNK_INSTANCE_SZ;
-    u32 new_visible_chunks_size = total_chunks * sizeof(u32);
-    u32 new_visible_grassblades_size =
-      total_chunks * blades_per_chunk * sizeof(u32);
-
-    const auto resize_buffer =
-      [&](SDL_GPUBuffer** buf, u64 new_size, u64& prev_size) -> bool {
-      if (new_size != prev_size) {
-        LOG_DEBUG(
-          "Resizing storage buffer from {} to {} bytes", prev_size, new_size);
-        SDL_GPUBufferCreateInfo buf_info{};
-        {
-          buf_info.size = new_size;
-          buf_info.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE |
-                           SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
-        }
-        auto* ret = SDL_CreateGPUBuffer(Device, &buf_info);
-        if (!ret) {
-          LOG_ERROR("Couldn't create storage buffer: {}", GETERR);
-          return false;
-        }
-        SDL_ReleaseGPUBuffer(Device, *buf);
-        *buf = ret;
-        prev_size = new_size;
-      } else {
-        LOG_DEBUG("Skipped storage buffer re-creation");
-      }
-      return true;
-    };
-
-    if (!resize_buffer(&grassblade_instances_,
-                       new_grassblades_size,
-                       prev_grassblades_size)) {
+  { // resize storage buffers if needed, contents are regenerated below
+    if (!grassblade_instances_.Resize(blades_per_chunk * total_chunks)) {
       LOG_ERROR("Couldn't resize grassblades buffer");
       return false;
     }
-    if (!resize_buffer(&chunk_instances_, new_chunks_size, prev_chunks_size)) {
+    if (!chunk_instances_.Resize(total_chunks)) {
       LOG_ERROR("Couldn't resize chunks buffer");
       return false;
     }
-    if (!resize_buffer(&visible_chunks_,
-                       new_visible_chunks_size,
-                       prev_visible_chunks_size)) {
+    if (!visible_chunks_.Resize(total_chunks)) {
       LOG_ERROR("Couldn't resize visible chunks buffers");
       return false;
     }
-    if (!resize_buffer(&visible_grassblades_,
-                       new_visible_grassblades_size,
-                       prev_visible_grassblades_size)) {
+    if (!visible_grassblades_.Resize(total_chunks * blades_per_chunk)) {
       LOG_ERROR("Couldn't resize visible grassblades buffers");
       return false;
     }
@@ -263,9 +212,9 @@ GrassProgram::GenerateGrassblades()
   { // Dispatch compute
     SDL_GPUStorageBufferReadWriteBinding bindings[2];
     {
-      bindings[0].buffer = grassblade_instances_;
+      bindings[0].buffer = grassblade_instances_.Get();
       bindings[0].cycle = false;
-      bindings[1].buffer = chunk_instances_;
+      bindings[1].buffer = chunk_instances_.Get();
       bindings[1].cycle = false;
     }
 
@@ -296,11 +245,11 @@ GrassProgram::CullChunks(CameraBinding& camera)
 {
   SDL_GPUStorageBufferReadWriteBinding bindings[3];
   {
-    bindings[0].buffer = visible_chunks_;
+    bindings[0].buffer = visible_chunks_.Get();
     bindings[0].cycle = false;
-    bindings[1].buffer = visible_grassblades_;
+    bindings[1].buffer = visible_grassblades_.Get();
     bindings[1].cycle = false;
-    bindings[2].buffer = draw_calls_;
+    bindings[2].buffer = draw_calls_.Get();
     bindings[2].cycle = false;
   }
 
@@ -319,7 +268,8 @@ GrassProgram::CullChunks(CameraBinding& camera)
   auto* pass = SDL_BeginGPUComputePass(cmd_buf, nullptr, 0, bindings, 3);
   SDL_BindGPUComputePipeline(pass, cull_chunks_pipeline_);
 
-  SDL_BindGPUComputeStorageBuffers(pass, 0, &chunk_instances_, 1);
+  SDL_GPUBuffer* chunks = chunk_instances_.Get();
+  SDL_BindGPUComputeStorageBuffers(pass, 0, &chunks, 1);
   SDL_PushGPUComputeUniformData(cmd_buf, 0, &params, sizeof(params));
   SDL_PushGPUComputeUniformData(cmd_buf, 1, &camera, sizeof(camera));
 
@@ -350,6 +300,17 @@ GrassProgram::Poll()
       }
     }
   }
+
+  if (draw_calls_readback_.Ready()) {
+    std::array<SDL_GPUIndexedIndirectDrawCommand, 2> cmds{};
+    if (draw_calls_readback_.Read(cmds.data(), 2)) {
+      visible_chunks_count_ = cmds[0].num_instances;
+      visible_blades_count_ = cmds[1].num_instances;
+    }
+    draw_calls_readback_ = {};
+  } else if (draw_calls_readback_.Valid() && draw_calls_readback_.Failed()) {
+    draw_calls_readback_ = {};
+  }
   camera_.Update(DeltaTime);
   if (regenerate_grass_) {
     if (!GenerateGrassblades()) {
@@ -427,19 +388,12 @@ GrassProgram::Draw()
   }
 
   SDL_SubmitGPUCommandBuffer(cmdbuf);
-  // auto fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdbuf);
-  // if (!fence) {
-  //   LOG_ERROR("couldn't acquire submit fence: {}", GETERR);
-  //   return false;
-  // }
-  // SDL_WaitForGPUFences(Device, true, &fence, 1);
-  // SDL_GPUIndirectDrawCommand draw_cmd{};
-  // std::memset(&draw_cmd, 0, sizeof(draw_cmd));
-  // draw_cmd.num_vertices = 6;
-  // if (!EnginePtr->UploadToBuffer(draw_calls_, &draw_cmd, 1)) {
-  //   LOG_ERROR("couldn't reset draw buffer: {}", GETERR);
-  //   return false;
-  // }
+
+  // Read the culling results back, one request in flight at a time
+  if (!draw_calls_readback_.Valid()) {
+    draw_calls_readback_ = EnginePtr->ReadbackAsync(
+      draw_calls_.Get(), 0, 2 * sizeof(SDL_GPUIndexedIndirectDrawCommand));
+  }
   return true;
 }
 
@@ -452,9 +406,9 @@ GrassProgram::DrawGrass(SDL_GPURenderPass* pass,
   static const SDL_GPUBufferBinding grass_idx_bind{ grassblade_indices_, 0 };
 
   SDL_GPUBuffer* buffers[4]{ grassblade_vertices_,
-                             grassblade_instances_,
-                             chunk_instances_,
-                             visible_grassblades_ };
+                             grassblade_instances_.Get(),
+                             chunk_instances_.Get(),
+                             visible_grassblades_.Get() };
   SDL_BindGPUGraphicsPipeline(pass, grass_pipeline_);
 
   SDL_BindGPUVertexSamplers(pass, 0, &b, 1);
@@ -478,7 +432,7 @@ GrassProgram::DrawGrass(SDL_GPURenderPass* pass,
   //   pass, grassblade_index_count_, total_chunks * blades_per_chunk, 0, 0, 0);
 
   SDL_DrawGPUIndexedPrimitivesIndirect(
-    pass, draw_calls_, sizeof(SDL_GPUIndexedIndirectDrawCommand), 1);
+    pass, draw_calls_.Get(), sizeof(SDL_GPUIndexedIndirectDrawCommand), 1);
 }
 
 void
@@ -492,8 +446,8 @@ GrassProgram::DrawTerrain(SDL_GPURenderPass* pass,
   SDL_BindGPUGraphicsPipeline(pass, terrain_pipeline_);
 
   SDL_BindGPUVertexSamplers(pass, 0, &b, 1);
-  SDL_BindGPUVertexStorageBuffers(pass, 0, &chunk_instances_, 1);
-  SDL_BindGPUVertexStorageBuffers(pass, 1, &visible_chunks_, 1);
+  SDL_GPUBuffer* buffers[2]{ chunk_instances_.Get(), visible_chunks_.Get() };
+  SDL_BindGPUVertexStorageBuffers(pass, 0, buffers, 2);
   SDL_PushGPUVertexUniformData(cmdbuf, 0, &camera, sizeof(camera));
   SDL_PushGPUVertexUniformData(
     cmdbuf, 1, &terrain_params_, sizeof(terrain_params_));
@@ -502,7 +456,7 @@ GrassProgram::DrawTerrain(SDL_GPURenderPass* pass,
 
   SDL_BindGPUIndexBuffer(pass, &chunk_idx_bind, SDL_GPU_INDEXELEMENTSIZE_32BIT);
 
-  SDL_DrawGPUIndexedPrimitivesIndirect(pass, draw_calls_, 0, 1);
+  SDL_DrawGPUIndexedPrimitivesIndirect(pass, draw_calls_.Get(), 0, 1);
 }
 
 bool
@@ -566,7 +520,8 @@ GrassProgram::CreateRenderTargets()
     info.sample_count = SDL_GPU_SAMPLECOUNT_1;
     info.usage =
       SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
-    scene_target_ = SDL_CreateGPUTexture(Device, &info);
+    scene_target_ =
+      GpuMemory::CreateTexture(Device, info, GpuMemoryCategory::RenderTarget);
     if (!scene_target_) {
       LOG_ERROR("Couldn't create scene rendertarget: {}", GETERR);
       return false;
@@ -577,7 +532,8 @@ GrassProgram::CreateRenderTargets()
     info.format = DEPTH_FORMAT;
     info.usage =
       SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET;
-    depth_target_ = SDL_CreateGPUTexture(Device, &info);
+    depth_target_ =
+      GpuMemory::CreateTexture(Device, info, GpuMemoryCategory::RenderTarget);
     if (!depth_target_) {
       LOG_ERROR("Couldn't create depth rendertarget: {}", GETERR);
       return false;
@@ -714,14 +670,16 @@ GrassProgram::UploadVertexData()
       idxInfo.usage = SDL_GPU_BUFFERUSAGE_INDEX;
       idxInfo.size = static_cast<u32>(sizeof(u32) * grassblade_index_count_);
     }
-    grassblade_indices_ = SDL_CreateGPUBuffer(Device, &idxInfo);
+    grassblade_indices_ =
+      GpuMemory::CreateBuffer(Device, idxInfo, GRASS_MEMORY, "Grass");
     if (!grassblade_indices_) {
       LOG_ERROR("couldn't create grassblades index buffer");
       return false;
     }
 
     idxInfo.size = 6 * sizeof(u32);
-    chunk_indices_ = SDL_CreateGPUBuffer(Device, &idxInfo);
+    chunk_indices_ =
+      GpuMemory::CreateBuffer(Device, idxInfo, GRASS_MEMORY, "Grass");
     if (!chunk_indices_) {
       LOG_ERROR("couldn't create chunks index buffer");
       return false;
@@ -734,26 +692,35 @@ GrassProgram::UploadVertexData()
       ssbo_info.size =
         static_cast<u32>(sizeof(PosNormalVertex_Aligned) * vert_count);
     }
-    grassblade_vertices_ = SDL_CreateGPUBuffer(Device, &ssbo_info);
+    grassblade_vertices_ =
+      GpuMemory::CreateBuffer(Device, ssbo_info, GRASS_MEMORY, "Grass");
     if (!grassblade_vertices_) {
       LOG_ERROR("couldn't create vertices ssbo");
       return false;
     }
   }
-  if (!EnginePtr->UploadToBuffer(
-        grassblade_indices_, indices.data(), grassblade_index_count_)) {
+  auto batch = EnginePtr->BeginUpload();
+  if (!batch.UploadToBuffer(grassblade_indices_,
+                            indices.data(),
+                            sizeof(u32) * grassblade_index_count_)) {
     LOG_ERROR("Couldn't upload index buffer data");
     return false;
   }
-  if (!EnginePtr->UploadToBuffer(
-        grassblade_vertices_, vertices.data(), vert_count)) {
+  if (!batch.UploadToBuffer(grassblade_vertices_,
+                            vertices.data(),
+                            sizeof(PosNormalVertex_Aligned) * vert_count)) {
     LOG_ERROR("Couldn't upload vertices ssbo data");
     return false;
   }
-  if (!EnginePtr->UploadToBuffer(chunk_indices_, chunk_idx.data(), 6)) {
+  if (!batch.UploadToBuffer(
+        chunk_indices_, chunk_idx.data(), sizeof(chunk_idx))) {
     LOG_ERROR("Couldn't upload index buffer data");
     return false;
   }
+  if (!batch.Submit().Ok()) {
+    LOG_ERROR("Couldn't submit vertex data uploads");
+    return false;
+  }
   return true;
 }
 
@@ -786,13 +753,27 @@ GrassProgram::DrawGui()
                 p.grass_per_chunk * p.grass_per_chunk * p.terrain_width *
                   p.terrain_width);
     ImGui::Text("Total chunks: %d", p.terrain_width * p.terrain_width);
+    ImGui::Text("Visible chunks: %u", visible_chunks_count_);
+    ImGui::Text("Visible grassblades: %u", visible_blades_count_);
     ImGui::Text(
       "Cull workgroup size: %ux%u", cull_dispatch_sz, cull_dispatch_sz);
-    ImGui::Text("Grassblades buffer size: %lu", prev_grassblades_size);
-    ImGui::Text("Chunks buffer size: %lu", prev_chunks_size);
-    ImGui::Text("Visible chunks buffer size: %lu", prev_visible_chunks_size);
+    ImGui::Text("Grassblades buffer size: %lu / %lu",
+                grassblade_instances_.SizeBytes(),
+                grassblade_instances_.CapacityBytes());
+    ImGui::Text("Chunks buffer size: %lu / %lu",
+                chunk_instances_.SizeBytes(),
+                chunk_instances_.CapacityBytes());
+    ImGui::Text("Visible chunks buffer size: %lu / %lu",
+                visible_chunks_.SizeBytes(),
+                visible_chunks_.CapacityBytes());
+    ImGui::Text("Storage reallocations: %u",
+                grassblade_instances_.Reallocations() +
+                  chunk_instances_.Reallocations() +
+                  visible_chunks_.Reallocations() +
+                  visible_grassblades_.Reallocations());
     ImGui::End();
   }
+  GpuMemory::RenderGui();
   if (ImGui::Begin("Settings")) {
     ImGui::Checkbox("Freeze culling camera", &freeze_cull_camera);
     if (ImGui::TreeNode("Viewport")) {
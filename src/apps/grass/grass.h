@@ -1,6 +1,8 @@
 #pragma once
 
+#include "common/gpu_buffer.h"
 #include "common/grid.h"
+#include "common/readback.h"
 #include "common/program.h"
 #include "common/skybox.h"
 #include "common/types.h"
@@ -24,6 +26,19 @@ struct TerrainBinding
   glm::vec4 terrain_color;
 };
 
+// Mirrors of 'shaders/grass_instance.glsl' & 'terrain_chunk_instance.glsl'
+struct GrassInstance
+{
+  u32 chunk_index;
+  f32 rotation;
+  glm::vec2 relative_translation;
+};
+
+struct ChunkInstance
+{
+  glm::ivec2 world_translation;
+};
+
 class GrassProgram : public Program
 {
   using path = std::filesystem::path;
@@ -49,6 +64,11 @@ class GrassProgram : public Program
 
   static constexpr u64 CHUNK_INSTANCE_SZ = 8;
   static constexpr u64 GRASS_INSTANCE_SZ = 16;
+  static_assert(sizeof(ChunkInstance) == CHUNK_INSTANCE_SZ);
+  static_assert(sizeof(GrassInstance) == GRASS_INSTANCE_SZ);
+  static constexpr SDL_GPUBufferUsageFlags STORAGE_USAGE =
+    SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE |
+    SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ;
 
 public:
   GrassProgram(SDL_GPUDevice* device,
@@ -114,6 +134,10 @@ private:
     .fog_start = 25.f,
   };
   bool regenerate_grass_{ false };
+  // Culling results, a few frames late
+  ReadbackHandle draw_calls_readback_{};
+  u32 visible_chunks_count_{ 0 };
+  u32 visible_blades_count_{ 0 };
 
   // GPU Resources:
   SDL_GPUTexture* depth_target_{ nullptr };
@@ -129,13 +153,29 @@ private:
   SDL_GPUColorTargetInfo swapchain_target_info_{};
   SDL_GPUBuffer* grassblade_vertices_{ nullptr };
   SDL_GPUBuffer* grassblade_indices_{ nullptr };
-  SDL_GPUBuffer* grassblade_instances_{ nullptr };
   SDL_GPUBuffer* chunk_indices_{ nullptr };
-  SDL_GPUBuffer* chunk_instances_{ nullptr };
-  SDL_GPUBuffer* visible_chunks_{ nullptr };
-  SDL_GPUBuffer* visible_grassblades_{ nullptr };
+  // Written by the generation & culling compute passes
+  static constexpr auto GRASS_MEMORY = GpuMemoryCategory::GrassStorage;
+  GpuBuffer<GrassInstance> grassblade_instances_{
+    EnginePtr, STORAGE_USAGE, "Grassblade instances", false, GRASS_MEMORY
+  };
+  GpuBuffer<ChunkInstance> chunk_instances_{
+    EnginePtr, STORAGE_USAGE, "Chunk instances", false, GRASS_MEMORY
+  };
+  GpuBuffer<u32> visible_chunks_{
+    EnginePtr, STORAGE_USAGE, "Visible chunks", false, GRASS_MEMORY
+  };
+  GpuBuffer<u32> visible_grassblades_{
+    EnginePtr, STORAGE_USAGE, "Visible grassblades", false, GRASS_MEMORY
+  };
 
-  SDL_GPUBuffer* draw_calls_{ nullptr };
+  GpuBuffer<SDL_GPUIndexedIndirectDrawCommand> draw_calls_{
+    EnginePtr,
+    SDL_GPU_BUFFERUSAGE_INDIRECT,
+    "Grass draw calls",
+    false,
+    GRASS_MEMORY
+  };
 };
 
 } // namespace grass
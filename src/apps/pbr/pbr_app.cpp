@@ -6,6 +6,7 @@
 #include "common/compute_pipeline_builder.h"
 #include "common/cubemap.h"
 #include "common/engine.h"
+#include "common/gpu_memory.h"
 #include "common/logger.h"
 #include "common/types.h"
 #include "common/util.h"
@@ -17,6 +18,27 @@
 #include <imgui/backends/imgui_impl_sdlgpu3.h>
 #include <imgui/imgui.h>
 
+namespace {
+// World space frustum planes of a zero to one depth projection, pointing in
+std::array<glm::vec4, 6>
+frustum_planes(const glm::mat4& viewproj)
+{
+  auto row = [&viewproj](i32 i) {
+    return glm::vec4{
+      viewproj[0][i], viewproj[1][i], viewproj[2][i], viewproj[3][i]
+    };
+  };
+  std::array<glm::vec4, 6> ret{
+    row(3) + row(0), row(3) - row(0), row(3) + row(1),
+    row(3) - row(1), row(2),          row(3) - row(2),
+  };
+  for (auto& plane : ret) {
+    plane /= glm::length(glm::vec3{ plane });
+  }
+  return ret;
+}
+}
+
 CubeProgram::CubeProgram(SDL_GPUDevice* device,
                          SDL_Window* window,
                          Engine* engine,
@@ -78,16 +100,24 @@ CubeProgram::CubeProgram(SDL_GPUDevice* device,
 CubeProgram::~CubeProgram()
 {
   LOG_TRACE("Destroying app");
+  // Loads still running use the loader, their scenes are dropped right away
+  for (auto& [path, load] : scene_loads_) {
+    EnginePtr->Workers().Wait(load);
+  }
+  scene_loads_.clear();
+  pending_scene_ = nullptr;
+  scene_cache_.Clear();
   for (auto it = scenes_.begin(); it != scenes_.end(); it++) {
     it->get()->Release();
   }
 
-  RELEASE_IF(depth_target_, SDL_ReleaseGPUTexture);
-  RELEASE_IF(hdr_color_target_, SDL_ReleaseGPUTexture);
-  RELEASE_IF(post_processed_target_, SDL_ReleaseGPUTexture);
-  RELEASE_IF(brdf_lut_, SDL_ReleaseGPUTexture);
+  RELEASE_IF(depth_target_, GpuMemory::Release);
+  RELEASE_IF(hdr_color_target_, GpuMemory::Release);
+  RELEASE_IF(post_processed_target_, GpuMemory::Release);
+  RELEASE_IF(brdf_lut_, GpuMemory::Release);
 
   RELEASE_IF(post_process_pipeline, SDL_ReleaseGPUComputePipeline);
+  RELEASE_IF(cull_meshlets_pipeline_, SDL_ReleaseGPUComputePipeline);
 
   // for (u8 i = 0; i<3; ++i) {
   RELEASE_IF(pbr_samplers_[0], SDL_ReleaseGPUSampler);
@@ -124,6 +154,7 @@ CubeProgram::Init()
     return false;
   }
   assert(!scenes_[0]->Meshes().empty());
+  // Streams in like the ones picked later, drawn as its meshes land
   LOG_INFO("Loaded {} meshes", scenes_[0]->Meshes().size());
 
   if (!CreateSceneRenderTargets()) {
@@ -142,6 +173,10 @@ CubeProgram::Init()
     LOG_CRITICAL("Couldn't create post-process pipeline");
     return false;
   }
+
+  if (!CreateCullMeshletsPipeline()) {
+    LOG_WARN("Meshlet culling is unavailable, meshes are drawn whole");
+  }
   LOG_DEBUG("Created post-process pipeline");
 
   global_transform_.translation_ = { 0.f, 0.f, 0.0f };
@@ -171,29 +206,85 @@ CubeProgram::Poll()
     } else if (evt.type == SDL_EVENT_KEY_DOWN) {
       if (evt.key.key == SDLK_ESCAPE) {
         quit = true;
+      } else if (evt.key.key == SDLK_F12) {
+        screenshot_requested_ = true;
+      }
+    }
+  }
+
+  if (screenshot_.Ready()) {
+    SaveScreenshot();
+    screenshot_ = {};
+  } else if (screenshot_.Valid() && screenshot_.Failed()) {
+    LOG_ERROR("Screenshot readback failed");
+    screenshot_ = {};
+  }
+
+  if (meshlet_draws_readback_.Ready()) {
+    std::vector<SDL_GPUIndexedIndirectDrawCommand> cmds(meshlet_draws_read_);
+    if (meshlet_draws_readback_.Read(cmds.data(), meshlet_draws_read_)) {
+      visible_meshlets_ = 0;
+      visible_meshlet_triangles_ = 0;
+      for (const auto& c : cmds) {
+        visible_meshlets_ += c.num_instances > 0 ? 1 : 0;
+        visible_meshlet_triangles_ += u64(c.num_indices / 3) * c.num_instances;
       }
     }
+    meshlet_draws_readback_ = {};
+  } else if (meshlet_draws_readback_.Valid() &&
+             meshlet_draws_readback_.Failed()) {
+    meshlet_draws_readback_ = {};
   }
 
   static auto last_asset = scenes_[0]->Path;
-  if (scene_picker_.CurrentAsset != last_asset && !is_loading_scene) {
+  if (scene_picker_.CurrentAsset != requested_scene_) {
     ChangeScene();
   }
 
-  // Poll future:
-  if (scene_future_.valid() && scene_future_.wait_for(std::chrono::nanoseconds(
-                                 0)) == std::future_status::ready) {
-    is_loading_scene = false;
-    auto ret = scene_future_.get();
-    if (ret == nullptr) {
-      LOG_ERROR("Failed loading scene `{}`",
-                scene_picker_.CurrentAsset.c_str());
+  // Loads run concurrently, only the one of the last picked scene is kept
+  for (auto it = scene_loads_.begin(); it != scene_loads_.end();) {
+    auto& [path, load] = *it;
+    if (load.wait_for(std::chrono::nanoseconds(0)) !=
+        std::future_status::ready) {
+      ++it;
+      continue;
+    }
+    auto ret = load.get();
+    if (path != requested_scene_) {
+      LOG_DEBUG("Caching scene `{}`, another one was picked", path.c_str());
+      CacheScene(std::move(ret));
+    } else if (ret == nullptr) {
+      LOG_ERROR("Failed loading scene `{}`", path.c_str());
       scene_picker_.CurrentAsset = last_asset; // restore former scene
-      return true;
+      requested_scene_ = last_asset;
+    } else {
+      // Uploads are drained by the engine over the next frames, the former
+      // scene keeps being drawn meanwhile
+      pending_scene_ = std::move(ret);
     }
-    last_asset = scene_picker_.CurrentAsset;
+    it = scene_loads_.erase(it);
+  }
+
+  // Scenes stream in: they replace the former one as soon as they can be
+  // drawn, meshes and textures show up over the next frames
+  for (auto& scene : scenes_) {
+    scene->Update();
+  }
+  if (pending_scene_) {
+    pending_scene_->Update();
+  }
+  if (pending_scene_ && pending_scene_->Path != requested_scene_) {
+    CacheScene(std::move(pending_scene_));
+  } else if (pending_scene_ && pending_scene_->UploadFailed()) {
+    LOG_ERROR("Failed uploading scene `{}`", pending_scene_->Path.c_str());
+    scene_picker_.CurrentAsset = last_asset;
+    requested_scene_ = last_asset;
+    pending_scene_ = nullptr;
+  } else if (pending_scene_ && pending_scene_->Drawable()) {
+    last_asset = pending_scene_->Path;
     // scenes_.push_back(std::move(ret));
-    scenes_[0] = std::move(ret);
+    CacheScene(std::move(scenes_[0]));
+    scenes_[0] = std::move(pending_scene_);
   }
 
   return true;
@@ -251,16 +342,12 @@ CubeProgram::Draw()
   UpdateScene(); // TODO: move out
   auto vp = camera_.Projection() * camera_.View();
   auto draw_data = DrawGui();
-  auto d = instance_cfg.dimension;
-  auto total_instances = d * d * d;
   SceneDataBinding scene_data{
     vp,
     camera_.Model(),
     glm::vec4{ camera_.Position, 0.f },
     glm::vec4{ light_pos_, 0.f },
     glm::vec4{ .9f, .9f, .9f, .1f },
-    instance_cfg.spread,
-    instance_cfg.dimension,
     pbr_debug_flags_,
   };
   CameraBinding camera_bind{
@@ -272,6 +359,52 @@ CubeProgram::Draw()
   ImGui_ImplSDLGPU3_PrepareDrawData(draw_data, cmdbuf);
 
   stats_.Reset(); // Reset stats after GUI has drawn
+  // Per-draw data, uploaded ahead of the frame's command buffer
+  {
+    auto& lod = render_context_.Lod;
+    lod.CameraPosition = camera_.Position;
+    lod.PixelsPerUnit =
+      lod_cfg_.enabled
+        ? LodSelection::PixelsPerUnitFor(camera_.Fov(), f32(vp_height_))
+        : 0.f;
+    lod.MaxPixelError = lod_cfg_.max_pixel_error;
+    for (const auto& scene : scenes_) {
+      scene->Draw(glm::mat4{ 1.0f }, render_context_);
+    }
+    draw_data_host_.clear();
+    auto push_draw_data = [this](const RenderItem& draw) {
+      draw_data_host_.push_back(DrawDataBinding{ draw.matrix,
+                                                 draw.Quantization.Offset,
+                                                 draw.Quantization.Scale,
+                                                 draw.FirstInstance });
+    };
+    for (const auto& draw : render_context_.OpaqueItems) {
+      push_draw_data(draw);
+    }
+    for (const auto& draw : render_context_.TransparentItems) {
+      push_draw_data(draw);
+    }
+    PrepareMeshletJobs(vp);
+    if (!draw_data_.Assign(draw_data_host_) ||
+        !instance_transforms_.Assign(render_context_.InstanceTransforms) ||
+        !meshlet_jobs_.Assign(meshlet_jobs_host_)) {
+      LOG_ERROR("Couldn't resize draw data buffers");
+      SDL_SubmitGPUCommandBuffer(cmdbuf);
+      return false;
+    }
+    if (draw_data_.IsDirty() || instance_transforms_.IsDirty() ||
+        meshlet_jobs_.IsDirty()) {
+      UploadBatch batch = EnginePtr->BeginUpload();
+      if (!draw_data_.Flush(batch) || !instance_transforms_.Flush(batch) ||
+          !meshlet_jobs_.Flush(batch) || !batch.Submit().Ok()) {
+        LOG_ERROR("Couldn't upload draw data");
+      }
+    }
+  }
+
+  // Meshlet culling, fills the indirect draws of the scene pass
+  CullMeshlets(cmdbuf);
+
   // Scene Pass
   {
     SDL_PushGPUVertexUniformData(cmdbuf, 0, &scene_data, sizeof(scene_data));
@@ -282,42 +415,67 @@ CubeProgram::Draw()
 
     SDL_SetGPUViewport(scenePass, &scene_vp);
 
-    auto DrawCall = [&](const RenderItem& draw) {
+    // Meshes share the MeshPool buffers, only rebind when the page changes.
+    // Pools never mix index sizes, so the index buffer implies it
+    SDL_GPUBuffer* bound_vertices = nullptr;
+    SDL_GPUBuffer* bound_indices = nullptr;
+    SDL_GPUBuffer* draw_buffers[] = { draw_data_.Get(),
+                                      instance_transforms_.Get() };
+    auto DrawCall = [&](const RenderItem& draw, u32 draw_index) {
       assert(draw.VertexBuffer != nullptr);
       assert(draw.IndexBuffer != nullptr);
-      const SDL_GPUBufferBinding vBinding{ draw.VertexBuffer, 0 };
-      const SDL_GPUBufferBinding iBinding{ draw.IndexBuffer, 0 };
 
       // Geometry
-      SDL_BindGPUVertexBuffers(scenePass, 0, &vBinding, 1);
-      SDL_BindGPUIndexBuffer(
-        scenePass, &iBinding, SDL_GPU_INDEXELEMENTSIZE_32BIT);
-      DrawDataBinding b{ draw.matrix };
+      if (draw.VertexBuffer != bound_vertices ||
+          draw.IndexBuffer != bound_indices) {
+        const SDL_GPUBufferBinding vBinding{ draw.VertexBuffer, 0 };
+        const SDL_GPUBufferBinding iBinding{ draw.IndexBuffer, 0 };
+        SDL_BindGPUVertexBuffers(scenePass, 0, &vBinding, 1);
+        SDL_BindGPUIndexBuffer(scenePass, &iBinding, draw.IndexSize);
+        bound_vertices = draw.VertexBuffer;
+        bound_indices = draw.IndexBuffer;
+      }
+      DrawIndexBinding b{ draw_index };
       SDL_PushGPUVertexUniformData(cmdbuf, 1, &b, sizeof(b));
 
       // Material
       auto material = draw.Material;
       SDL_BindGPUGraphicsPipeline(scenePass, material->Pipeline);
+      SDL_BindGPUVertexStorageBuffers(scenePass, 0, draw_buffers, 2);
 
       material->ubo.Bind(cmdbuf);
 
       material->BindSamplers(scenePass);
       SDL_BindGPUFragmentSamplers(
         scenePass, material->TextureCount, pbr_sampler_binds, 3);
-      SDL_DrawGPUIndexedPrimitives(
-        scenePass, draw.VertexCount, total_instances, draw.FirstIndex, 0, 0);
+      const u32 first_command = draw_first_command_[draw_index];
+      if (first_command != ~0u) {
+        // Culled meshlets are empty draws
+        SDL_DrawGPUIndexedPrimitivesIndirect(
+          scenePass,
+          meshlet_draws_.Get(),
+          first_command * sizeof(SDL_GPUIndexedIndirectDrawCommand),
+          draw.MeshletCount);
+        stats_.meshlets += draw.MeshletCount;
+      } else {
+        SDL_DrawGPUIndexedPrimitives(scenePass,
+                                     draw.VertexCount,
+                                     draw.InstanceCount,
+                                     draw.FirstIndex,
+                                     draw.VertexOffset,
+                                     0);
+        stats_.triangles += u64(draw.VertexCount / 3) * draw.InstanceCount;
+      }
     };
 
-    for (const auto& scene : scenes_) {
-      scene->Draw(glm::mat4{ 1.0f }, render_context_);
-    }
+    u32 draw_index = 0;
     for (const auto& draw : render_context_.OpaqueItems) {
-      DrawCall(draw);
+      DrawCall(draw, draw_index++);
       stats_.opaque_draws++;
       stats_.total_draws++;
     }
     for (const auto& draw : render_context_.TransparentItems) {
-      DrawCall(draw);
+      DrawCall(draw, draw_index++);
       stats_.transparent_draws++;
       stats_.total_draws++;
     }
@@ -359,24 +517,190 @@ CubeProgram::Draw()
   }
 
   SDL_SubmitGPUCommandBuffer(cmdbuf);
+
+  if (screenshot_requested_ && !screenshot_.Valid()) {
+    screenshot_requested_ = false;
+    SDL_GPUTextureRegion region{};
+    {
+      region.texture = post_processed_target_;
+      region.w = static_cast<Uint32>(vp_width_);
+      region.h = static_cast<Uint32>(vp_height_);
+      region.d = 1;
+    }
+    screenshot_ =
+      EnginePtr->ReadbackAsync(region, SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM);
+  }
+  if (!meshlet_draws_readback_.Valid() && meshlet_draws_.Size() > 0) {
+    meshlet_draws_read_ = meshlet_draws_.Size();
+    meshlet_draws_readback_ = EnginePtr->ReadbackAsync(
+      meshlet_draws_.Get(), 0, u32(meshlet_draws_.SizeBytes()));
+  }
   return true;
 }
 
+// One job per RenderItem split into meshlets, in draw order. Items of a scene
+// are contiguous, so are jobs reading the same meshlet buffer
+void
+CubeProgram::PrepareMeshletJobs(const glm::mat4& viewproj)
+{
+  const u32 draw_count = draw_data_host_.size();
+  draw_first_command_.assign(draw_count, ~0u);
+  meshlet_jobs_host_.clear();
+  meshlet_job_sources_.clear();
+  if (!meshlet_cfg_.enabled || cull_meshlets_pipeline_ == nullptr) {
+    return;
+  }
+  if (!meshlet_cfg_.freeze) {
+    const auto planes = frustum_planes(viewproj);
+    std::copy(planes.begin(), planes.end(), meshlet_cull_.frustum);
+    meshlet_cull_.camera_world = glm::vec4{ camera_.Position, 1.f };
+  }
+  meshlet_cull_.flags = (meshlet_cfg_.frustum ? MESHLET_CULL_FRUSTUM : 0) |
+                        (meshlet_cfg_.cone ? MESHLET_CULL_CONE : 0);
+
+  u32 commands{ 0 };
+  u32 draw_index{ 0 };
+  auto add_job = [&](const RenderItem& draw) {
+    if (draw.Meshlets != nullptr && draw.MeshletCount > 0) {
+      MeshletCullJob job{};
+      {
+        job.draw_index = draw_index;
+        job.first_meshlet = draw.FirstMeshlet;
+        job.meshlet_count = draw.MeshletCount;
+        job.first_command = commands;
+        job.instance_count = draw.InstanceCount;
+      }
+      meshlet_jobs_host_.push_back(job);
+      meshlet_job_sources_.push_back(draw.Meshlets);
+      draw_first_command_[draw_index] = commands;
+      commands += draw.MeshletCount;
+    }
+    ++draw_index;
+  };
+  for (const auto& draw : render_context_.OpaqueItems) {
+    add_job(draw);
+  }
+  for (const auto& draw : render_context_.TransparentItems) {
+    add_job(draw);
+  }
+  if (!meshlet_draws_.Resize(commands)) {
+    LOG_ERROR("Couldn't resize meshlet draws");
+    draw_first_command_.assign(draw_count, ~0u);
+    meshlet_jobs_host_.clear();
+    meshlet_job_sources_.clear();
+  }
+}
+
+void
+CubeProgram::CullMeshlets(SDL_GPUCommandBuffer* cmdbuf)
+{
+  if (meshlet_jobs_host_.empty()) {
+    return;
+  }
+  SDL_GPUStorageBufferReadWriteBinding binding{};
+  {
+    binding.buffer = meshlet_draws_.Get();
+    binding.cycle = true; // every command is rewritten
+  }
+  auto* pass = SDL_BeginGPUComputePass(cmdbuf, nullptr, 0, &binding, 1);
+  SDL_BindGPUComputePipeline(pass, cull_meshlets_pipeline_);
+
+  // One dispatch per meshlet buffer
+  const u32 job_count = meshlet_jobs_host_.size();
+  for (u32 first = 0; first < job_count;) {
+    SDL_GPUBuffer* meshlets = meshlet_job_sources_[first];
+    u32 end = first;
+    u32 max_meshlets{ 0 };
+    while (end < job_count && meshlet_job_sources_[end] == meshlets) {
+      max_meshlets =
+        std::max(max_meshlets, meshlet_jobs_host_[end].meshlet_count);
+      ++end;
+    }
+    SDL_GPUBuffer* buffers[] = { meshlets,
+                                 meshlet_jobs_.Get(),
+                                 draw_data_.Get(),
+                                 instance_transforms_.Get() };
+    SDL_BindGPUComputeStorageBuffers(pass, 0, buffers, 4);
+    meshlet_cull_.first_job = first;
+    meshlet_cull_.job_count = end - first;
+    SDL_PushGPUComputeUniformData(
+      cmdbuf, 0, &meshlet_cull_, sizeof(meshlet_cull_));
+    SDL_DispatchGPUCompute(pass,
+                           (max_meshlets + CULL_MESHLETS_GROUP_SIZE - 1) /
+                             CULL_MESHLETS_GROUP_SIZE,
+                           end - first,
+                           1);
+    first = end;
+  }
+  SDL_EndGPUComputePass(pass);
+}
+
+void
+CubeProgram::SaveScreenshot()
+{
+  static u32 count = 0;
+  const auto& pixels = screenshot_.Data();
+  auto* surface =
+    SDL_CreateSurfaceFrom(vp_width_,
+                          vp_height_,
+                          SDL_PIXELFORMAT_RGBA32,
+                          const_cast<u8*>(pixels.data()),
+                          vp_width_ * 4);
+  if (!surface) {
+    LOG_ERROR("Couldn't create screenshot surface: {}", GETERR);
+    return;
+  }
+  auto path = "screenshot_" + std::to_string(count++) + ".bmp";
+  if (SDL_SaveBMP(surface, path.c_str())) {
+    LOG_INFO("Saved screenshot to `{}`", path);
+  } else {
+    LOG_ERROR("Couldn't save screenshot: {}", GETERR);
+  }
+  SDL_DestroySurface(surface);
+}
+
 void
 CubeProgram::ChangeScene()
 {
-  if (is_loading_scene) {
-    LOG_WARN("a scene is already loading, ignoring request");
+  requested_scene_ = scene_picker_.CurrentAsset;
+  if (scenes_[0]->Path == requested_scene_) {
+    return; // picked back the drawn scene, running loads get dropped
+  }
+  const bool in_flight =
+    std::any_of(scene_loads_.begin(), scene_loads_.end(), [&](auto& load) {
+      return load.first == requested_scene_;
+    });
+  if (in_flight ||
+      (pending_scene_ && pending_scene_->Path == requested_scene_)) {
+    return;
+  }
+  // Still resident from an earlier visit, swapped in by the next Poll()
+  if (auto cached = scene_cache_.Take(requested_scene_)) {
+    LOG_INFO("scene {} is cached", requested_scene_.c_str());
+    CacheScene(std::move(pending_scene_));
+    pending_scene_ = std::move(cached);
     return;
   }
-  is_loading_scene = true;
-  LOG_INFO("loading scene {}", scene_picker_.CurrentAsset.c_str());
-  scene_future_ = std::async([this]() {
-    // std::this_thread::sleep_for(std::chrono::seconds(3));
-    return loader_.Load(scene_picker_.CurrentAsset);
-    // return ret;
-    // return std::unique_ptr<GLTFScene>(nullptr);
-  });
+  LOG_INFO("loading scene {}", requested_scene_.c_str());
+  scene_loads_.emplace_back(requested_scene_,
+                            loader_.LoadAsync(requested_scene_));
+}
+
+void
+CubeProgram::CacheScene(UniquePtr<GLTFScene> scene)
+{
+  if (!scene) {
+    return;
+  }
+  // A scene still streaming would keep creating textures the cache never
+  // measured, it's released instead (its streaming cancelled) and loaded
+  // again if picked back
+  if (!scene->Resident()) {
+    LOG_DEBUG("not caching `{}`, still streaming", scene->Path.string());
+    return;
+  }
+  const u64 bytes = scene->GpuBytes();
+  scene_cache_.Insert(std::move(scene), bytes);
 }
 
 bool
@@ -395,7 +719,8 @@ CubeProgram::CreateSceneRenderTargets()
     info.sample_count = SDL_GPU_SAMPLECOUNT_1;
     info.usage = SDL_GPU_TEXTUREUSAGE_COLOR_TARGET |
                  SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_READ;
-    hdr_color_target_ = SDL_CreateGPUTexture(Device, &info);
+    hdr_color_target_ =
+      GpuMemory::CreateTexture(Device, info, GpuMemoryCategory::RenderTarget);
   }
 
   { // Post processing pass target (HDR -> SDR compute shader)
@@ -403,14 +728,16 @@ CubeProgram::CreateSceneRenderTargets()
     info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER |
                  SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_READ |
                  SDL_GPU_TEXTUREUSAGE_COMPUTE_STORAGE_WRITE;
-    post_processed_target_ = SDL_CreateGPUTexture(Device, &info);
+    post_processed_target_ =
+      GpuMemory::CreateTexture(Device, info, GpuMemoryCategory::RenderTarget);
   }
 
   { // Depth target
     info.format = SDL_GPU_TEXTUREFORMAT_D16_UNORM;
     info.usage =
       SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_DEPTH_STENCIL_TARGET;
-    depth_target_ = SDL_CreateGPUTexture(Device, &info);
+    depth_target_ =
+      GpuMemory::CreateTexture(Device, info, GpuMemoryCategory::RenderTarget);
   }
 
   post_process_target_info_.texture = post_processed_target_;
@@ -457,7 +784,8 @@ CubeProgram::LoadPbrTextures()
       tex_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
       tex_info.sample_count = SDL_GPU_SAMPLECOUNT_1;
     }
-    brdf_lut_ = SDL_CreateGPUTexture(Device, &tex_info);
+    brdf_lut_ = GpuMemory::CreateTexture(
+      Device, tex_info, GpuMemoryCategory::IBL, "BRDF LUT");
     if (!brdf_lut_) {
       LOG_ERROR("Couldn't create texture: {}", GETERR);
       return false;
@@ -514,6 +842,27 @@ CubeProgram::CreatePostProcessPipeline()
   return true;
 }
 
+bool
+CubeProgram::CreateCullMeshletsPipeline()
+{
+  LOG_TRACE("CubeProgram::CreateCullMeshletsPipeline");
+
+  ComputePipelineBuilder builder{};
+  cull_meshlets_pipeline_ = builder //
+                              .SetReadOnlyStorageBufferCount(4)
+                              .SetReadWriteStorageBufferCount(1)
+                              .SetUBOCount(1)
+                              .SetThreadCount(CULL_MESHLETS_GROUP_SIZE, 1, 1)
+                              .SetShader(CULL_MESHLETS_PATH)
+                              .Build(Device);
+
+  if (cull_meshlets_pipeline_ == nullptr) {
+    LOG_ERROR("Couldn't create cull_meshlets pipeline: {}", GETERR);
+    return false;
+  }
+  return true;
+}
+
 bool
 CubeProgram::InitGui()
 {
@@ -590,10 +939,22 @@ CubeProgram::DrawGui()
     }
     if (ImGui::Begin("Stats")) {
       ImGui::Text("Total draws: %u", stats_.total_draws);
+      auto& uploads = EnginePtr->Uploads();
+      ImGui::Text("Pending uploads: %lu KiB (%lu KiB last frame)",
+                  uploads.PendingBytes() / 1024,
+                  uploads.LastTickBytes() / 1024);
       ImGui::Text("Opaque draws: %u", stats_.opaque_draws);
       ImGui::Text("Transparent draws: %u", stats_.transparent_draws);
+      // Meshlet triangles survived culling, as of the last readback
+      ImGui::Text("Triangles: %lu",
+                  stats_.triangles +
+                    (stats_.meshlets > 0 ? visible_meshlet_triangles_ : 0));
+      ImGui::Text("Meshlets: %u (%u visible)",
+                  stats_.meshlets,
+                  visible_meshlets_);
       ImGui::End();
     }
+    GpuMemory::RenderGui();
 
     ImGui::ShowMetricsWindow();
 
@@ -704,9 +1065,28 @@ CubeProgram::DrawGui()
         }
         ImGui::TreePop();
       }
-      if (ImGui::TreeNode("Instancing")) {
-        ImGui::InputFloat("Spread", &instance_cfg.spread);
-        ImGui::InputInt("Dimensions", (int*)&instance_cfg.dimension);
+      if (ImGui::TreeNode("LOD")) {
+        ImGui::Checkbox("Enabled", &lod_cfg_.enabled);
+        ImGui::SliderFloat(
+          "Max pixel error", &lod_cfg_.max_pixel_error, .1f, 16.f);
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Scene cache")) {
+        constexpr u64 mib = 1024 * 1024;
+        i32 budget = static_cast<i32>(scene_cache_.Budget() / mib);
+        if (ImGui::InputInt("Budget (MiB)", &budget) && budget >= 0) {
+          scene_cache_.SetBudget(u64(budget) * mib);
+        }
+        ImGui::Text("%zu scenes, %.1f MiB",
+                    scene_cache_.Size(),
+                    scene_cache_.Used() / f32(mib));
+        ImGui::TreePop();
+      }
+      if (ImGui::TreeNode("Meshlets")) {
+        ImGui::Checkbox("GPU culling", &meshlet_cfg_.enabled);
+        ImGui::Checkbox("Frustum", &meshlet_cfg_.frustum);
+        ImGui::Checkbox("Backface cones", &meshlet_cfg_.cone);
+        ImGui::Checkbox("Freeze", &meshlet_cfg_.freeze);
         ImGui::TreePop();
       }
 
@@ -716,7 +1096,8 @@ CubeProgram::DrawGui()
       ImGui::End();
     }
 
-    scene_picker_.Render(is_loading_scene);
+    scene_picker_.Render(!scene_loads_.empty() || pending_scene_ ||
+                         !scenes_[0]->Resident());
   }
 
   ImGui::Render();
@@ -7,14 +7,18 @@
 
 #include "common/camera.h"
 #include "common/gltf_loader.h"
+#include "common/gpu_buffer.h"
+#include "common/readback.h"
 #include "common/gltf_scene.h"
 #include "common/program.h"
 #include "common/rendersystem.h"
+#include "common/scene_cache.h"
 #include "common/scene_picker.h"
 #include "common/skybox.h"
 #include "common/transform.h"
 #include "common/types.h"
 
+#include "shaders/meshlet_cull.h"
 #include "shaders/post_process_flags.h"
 
 struct Rotation
@@ -31,10 +35,8 @@ struct SceneDataBinding
   glm::vec4 camera_world;
   glm::vec4 sun_dir;
   glm::vec4 sun_color;
-  f32 spread;
-  u32 dimension;
   u32 pbr_flags; // View 'shaders/pbr_flags.h'
-  f32 _pad[1] = { 0.f };
+  f32 _pad[3] = { 0.f };
 };
 
 struct PostProcessDataBinding
@@ -43,16 +45,35 @@ struct PostProcessDataBinding
   f32 _pad[3] = { 0.f };
 };
 
+// Per-draw storage buffer element, indexed with DrawIndexBinding
 struct DrawDataBinding
 {
   glm::mat4 model;
+  glm::vec4 position_offset; // dequantizes packed positions
+  glm::vec4 position_scale;
+  u32 first_instance; // into the instance transforms
+  u32 _pad[3] = { 0 };
   // u32 material_index;
 };
 
-struct InstancingCfg
+struct DrawIndexBinding
+{
+  u32 index;
+  u32 _pad[3] = { 0 };
+};
+
+struct LodCfg
+{
+  bool enabled = true;
+  float max_pixel_error = 1.f; // screen space error of the picked LODs
+};
+
+struct MeshletCullCfg
 {
-  float spread = 5.f;   // gap between each mesh instance
-  Uint32 dimension = 1; // instance count per side
+  bool enabled = true; // draw meshes as GPU culled meshlets
+  bool frustum = true;
+  bool cone = true;    // backface culling of whole meshlets
+  bool freeze = false; // keep culling from the current camera
 };
 
 const std::filesystem::path MODELS_DIR("resources/models");
@@ -64,11 +85,15 @@ class CubeProgram : public Program
     u32 total_draws;
     u32 opaque_draws;
     u32 transparent_draws;
+    u64 triangles;
+    u32 meshlets;
     void Reset()
     {
       total_draws = 0;
       opaque_draws = 0;
       transparent_draws = 0;
+      triangles = 0;
+      meshlets = 0;
     };
   };
 
@@ -80,6 +105,9 @@ class CubeProgram : public Program
 
   static constexpr const char* POST_PROCESS_PATH =
     "resources/shaders/compiled/post_process.comp.spv";
+  static constexpr const char* CULL_MESHLETS_PATH =
+    "resources/shaders/compiled/cull_meshlets.comp.spv";
+  static constexpr u32 CULL_MESHLETS_GROUP_SIZE = 64; // match in shader
 
   static constexpr auto HDR_TARGET_FORMAT =
     SDL_GPU_TEXTUREFORMAT_R16G16B16A16_FLOAT;
@@ -103,8 +131,13 @@ private:
   ImDrawData* DrawGui();
   void UpdateScene();
   void ChangeScene();
+  void CacheScene(UniquePtr<GLTFScene> scene);
+  void SaveScreenshot();
   bool LoadPbrTextures();
   bool CreatePostProcessPipeline();
+  bool CreateCullMeshletsPipeline();
+  void PrepareMeshletJobs(const glm::mat4& viewproj);
+  void CullMeshlets(SDL_GPUCommandBuffer* cmdbuf);
 
 private:
   // Internals:
@@ -123,15 +156,32 @@ private:
     // MODELS_DIR / "AlphaBlendModeTest.glb"
   };
   RenderContext render_context_{};
+  std::vector<DrawDataBinding> draw_data_host_{}; // rebuilt every frame
+  // Per draw index, into meshlet_draws_ or ~0u when drawn whole
+  std::vector<u32> draw_first_command_{};
+  std::vector<MeshletCullJob> meshlet_jobs_host_{};
+  std::vector<SDL_GPUBuffer*> meshlet_job_sources_{}; // meshlets of each job
+  MeshletCullSettings meshlet_cull_{};
   std::vector<UniquePtr<GLTFScene>> scenes_{};
   ScenePicker scene_picker_{ MODELS_DIR, default_scene_path_ };
-  bool is_loading_scene{ false };
-  std::future<UniquePtr<GLTFScene>> scene_future_;
+  path requested_scene_{ default_scene_path_ }; // last picked
+  // Loads in flight, by scene path
+  std::vector<std::pair<path, std::future<UniquePtr<GLTFScene>>>>
+    scene_loads_{};
+  UniquePtr<GLTFScene> pending_scene_{ nullptr }; // loaded, uploads in flight
+  SceneCache scene_cache_{}; // scenes switched away from
   Stats stats_;
+  bool screenshot_requested_{ false }; // F12
+  ReadbackHandle screenshot_{};        // tone-mapped target, RGBA8
+  ReadbackHandle meshlet_draws_readback_{};
+  u32 meshlet_draws_read_{ 0 }; // commands in the pending readback
+  u32 visible_meshlets_{ 0 };
+  u64 visible_meshlet_triangles_{ 0 };
 
   // User controls:
   Rotation rotations_[3]; // spin cube
-  InstancingCfg instance_cfg{};
+  LodCfg lod_cfg_{};
+  MeshletCullCfg meshlet_cfg_{};
   bool wireframe_{ false };
   bool skybox_toggle_{ true };
   i32 tex_idx{ 0 };
@@ -154,6 +204,32 @@ private:
   SDL_GPUDepthStencilTargetInfo scene_depth_target_info_{};
   SDL_GPUColorTargetInfo swapchain_target_info_{};
   SDL_GPUComputePipeline* post_process_pipeline{};
+  SDL_GPUComputePipeline* cull_meshlets_pipeline_{};
+  GpuBuffer<DrawDataBinding> draw_data_{
+    EnginePtr,
+    SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+      SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+    "PBR draw data",
+    true // cycled, rewritten every frame
+  };
+  GpuBuffer<InstanceTransform> instance_transforms_{
+    EnginePtr,
+    SDL_GPU_BUFFERUSAGE_GRAPHICS_STORAGE_READ |
+      SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+    "PBR instances",
+    true // cycled, rewritten every frame
+  };
+  GpuBuffer<MeshletCullJob> meshlet_jobs_{
+    EnginePtr,
+    SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ,
+    "PBR meshlet jobs",
+    true // cycled, rewritten every frame
+  };
+  GpuBuffer<SDL_GPUIndexedIndirectDrawCommand> meshlet_draws_{
+    EnginePtr,
+    SDL_GPU_BUFFERUSAGE_INDIRECT | SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_WRITE,
+    "PBR meshlet draws"
+  }; // written by cull_meshlets.comp
 
 #define RED 1.0, 0.0, 0.0
 #define GREEN 0.0, 1.0, 0.0
@@ -0,0 +1,23 @@
+#include "accessor_decode.h"
+
+#include <pch.h>
+
+std::span<const std::byte>
+buffer_bytes(const fastgltf::Buffer& buffer)
+{
+  using Bytes = std::span<const std::byte>;
+  return std::visit(
+    fastgltf::visitor{
+      [](const fastgltf::sources::Array& src) {
+        return Bytes{ src.bytes.data(), src.bytes.size() };
+      },
+      [](const fastgltf::sources::Vector& src) {
+        return Bytes{ src.bytes.data(), src.bytes.size() };
+      },
+      [](const fastgltf::sources::ByteView& src) {
+        return Bytes{ src.bytes.data(), src.bytes.size() };
+      },
+      []([[maybe_unused]] const auto& src) { return Bytes{}; },
+    },
+    buffer.data);
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "common/types.h"
+
+#include <algorithm>
+#include <cstring>
+#include <span>
+#include <type_traits>
+
+#include <fastgltf/tools.hpp>
+#include <fastgltf/types.hpp>
+
+// glTF accessors decoded straight from their buffers into the loader's
+// vertex and index arrays, quantized (KHR_mesh_quantization) and sparse ones
+// included. The elements are still expanded to the CPU side float vertex,
+// packed again afterwards, see VertexPacker
+
+// Bytes of a buffer, wherever they live
+std::span<const std::byte>
+buffer_bytes(const fastgltf::Buffer& buffer);
+
+// Unaligned read of a T
+template<typename T>
+T
+load_unaligned(const std::byte* src)
+{
+  T ret{};
+  std::memcpy(&ret, src, sizeof(T));
+  return ret;
+}
+
+// One component of an accessor element, converted to `To`. Normalized
+// integers (KHR_mesh_quantization) map to [0, 1] or [-1, 1] the way the glTF
+// spec dequantizes them, the others keep their value
+template<typename To>
+To
+read_component(const std::byte* src, fastgltf::ComponentType type, bool norm)
+{
+  auto convert = [norm](auto value, f32 max) {
+    if constexpr (std::is_floating_point_v<To>) {
+      return norm ? std::max(static_cast<To>(value) / max, To(-1))
+                  : static_cast<To>(value);
+    } else {
+      return static_cast<To>(value);
+    }
+  };
+  switch (type) {
+    case fastgltf::ComponentType::Byte:
+      return convert(load_unaligned<i8>(src), 127.f);
+    case fastgltf::ComponentType::UnsignedByte:
+      return convert(load_unaligned<u8>(src), 255.f);
+    case fastgltf::ComponentType::Short:
+      return convert(load_unaligned<i16>(src), 32767.f);
+    case fastgltf::ComponentType::UnsignedShort:
+      return convert(load_unaligned<u16>(src), 65535.f);
+    case fastgltf::ComponentType::UnsignedInt:
+      return static_cast<To>(load_unaligned<u32>(src));
+    case fastgltf::ComponentType::Float:
+      return static_cast<To>(load_unaligned<f32>(src));
+    default:
+      return To{};
+  }
+}
+
+// Decodes `count` elements `src_stride` bytes apart into elements `Stride`
+// bytes apart. Components already of the element's type are moved with
+// fixed size copies the compiler vectorizes, others are converted one by one
+template<typename T, size_t Stride>
+void
+decode_elements(const std::byte* src,
+                size_t src_stride,
+                const fastgltf::Accessor& accessor,
+                size_t count,
+                std::byte* dst)
+{
+  using Traits = fastgltf::ElementTraits<T>;
+  using Component = typename Traits::component_type;
+  constexpr size_t components = sizeof(T) / sizeof(Component);
+  if (accessor.componentType == Traits::enum_component_type &&
+      !accessor.normalized) {
+    for (size_t i = 0; i < count; ++i) {
+      std::memcpy(dst + i * Stride, src + i * src_stride, sizeof(T));
+    }
+    return;
+  }
+  const size_t size = fastgltf::getComponentByteSize(accessor.componentType);
+  for (size_t i = 0; i < count; ++i) {
+    Component element[components];
+    for (size_t c = 0; c < components; ++c) {
+      element[c] = read_component<Component>(src + i * src_stride + c * size,
+                                             accessor.componentType,
+                                             accessor.normalized);
+    }
+    std::memcpy(dst + i * Stride, element, sizeof(T));
+  }
+}
+
+// Decodes an accessor into elements `Stride` bytes apart, e.g. one field of
+// interleaved vertices. Quantized data (KHR_mesh_quantization) is converted
+// straight from the buffer, sparse accessors get their values written over
+// the decoded base. Other cases (mismatching element types, out of range
+// views) go through fastgltf's conversion
+template<typename T, size_t Stride = sizeof(T)>
+void
+copy_accessor(const fastgltf::Asset& asset,
+              const fastgltf::Accessor& accessor,
+              void* dest)
+{
+  using Traits = fastgltf::ElementTraits<T>;
+  auto fallback = [&] {
+    fastgltf::copyFromAccessor<T, Stride>(asset, accessor, dest);
+  };
+  // `size` bytes within a view, nullptr when they're out of its buffer
+  auto view_data = [&](size_t view_index, size_t offset, size_t size) {
+    const auto& view = asset.bufferViews[view_index];
+    const auto bytes = buffer_bytes(asset.buffers[view.bufferIndex]);
+    const size_t begin = view.byteOffset + offset;
+    return begin + size <= bytes.size() && offset + size <= view.byteLength
+             ? bytes.data() + begin
+             : nullptr;
+  };
+  const auto component_type = accessor.componentType;
+  if (accessor.type != Traits::type ||
+      component_type == fastgltf::ComponentType::Int ||
+      component_type == fastgltf::ComponentType::Double) {
+    return fallback();
+  }
+  const size_t element_size =
+    fastgltf::getElementByteSize(accessor.type, component_type);
+  auto* dst = static_cast<std::byte*>(dest);
+
+  // Dense base, zeroes without a view
+  if (accessor.bufferViewIndex.has_value()) {
+    const auto view_index = accessor.bufferViewIndex.value();
+    const size_t stride =
+      asset.bufferViews[view_index].byteStride.value_or(element_size);
+    const size_t size =
+      accessor.count == 0 ? 0 : (accessor.count - 1) * stride + element_size;
+    const auto* src = view_data(view_index, accessor.byteOffset, size);
+    if (!src) {
+      return fallback();
+    }
+    decode_elements<T, Stride>(src, stride, accessor, accessor.count, dst);
+  } else {
+    const T zero{};
+    for (size_t i = 0; i < accessor.count; ++i) {
+      std::memcpy(dst + i * Stride, &zero, sizeof(T));
+    }
+  }
+  if (!accessor.sparse.has_value()) {
+    return;
+  }
+
+  // Sparse values are tightly packed, each overwrites the element of its index
+  const auto& sparse = accessor.sparse.value();
+  const size_t index_size =
+    fastgltf::getComponentByteSize(sparse.indexComponentType);
+  const auto* indices = view_data(sparse.indicesBufferView,
+                                  sparse.indicesByteOffset,
+                                  sparse.count * index_size);
+  const auto* values = view_data(sparse.valuesBufferView,
+                                 sparse.valuesByteOffset,
+                                 sparse.count * element_size);
+  if (!indices || !values) {
+    return fallback();
+  }
+  for (size_t i = 0; i < sparse.count; ++i) {
+    const auto index = read_component<u32>(
+      indices + i * index_size, sparse.indexComponentType, false);
+    if (index < accessor.count) {
+      decode_elements<T, Stride>(values + i * element_size,
+                                 element_size,
+                                 accessor,
+                                 1,
+                                 dst + index * Stride);
+    }
+  }
+}
@@ -18,6 +18,7 @@ public:
   const glm::mat4& View() const { return view_; }
   const glm::mat4& Model() const { return model_; }
   const glm::mat4& Rotation() const { return rotation_; }
+  f32 Fov() const { return fov_; } // vertical, radians
 
 public:
   glm::vec3 Position{ 0.f, 0.f, 4.f };
@@ -0,0 +1,151 @@
+#include "compressed_texture_cache.h"
+
+#include "common/logger.h"
+#include "common/util.h"
+
+#include <charconv>
+
+#include <ktx.h>
+#include <pch.h>
+
+namespace {
+// Formats TextureEncoder produces, see TextureTranscoder for the reverse
+u32
+to_vk_format(SDL_GPUTextureFormat format)
+{
+  switch (format) {
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+      return 133; // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+      return 134; // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+      return 137; // VK_FORMAT_BC3_UNORM_BLOCK
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB:
+      return 138; // VK_FORMAT_BC3_SRGB_BLOCK
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM:
+      return 141; // VK_FORMAT_BC5_UNORM_BLOCK
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+      return 145; // VK_FORMAT_BC7_UNORM_BLOCK
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB:
+      return 146; // VK_FORMAT_BC7_SRGB_BLOCK
+    default:
+      return 0; // VK_FORMAT_UNDEFINED
+  }
+}
+}
+
+CompressedTextureCache::CompressedTextureCache(std::filesystem::path cache_dir)
+  : cache_dir_{ std::move(cache_dir) }
+{
+}
+
+u64
+CompressedTextureCache::Key(std::span<const u8> source,
+                            TextureRole role,
+                            bool srgb,
+                            const TextureTranscoder::Support& support)
+{
+  const u8 settings[] = {
+    static_cast<u8>(Version), static_cast<u8>(role), srgb,      support.BC1,
+    support.BC3,              support.BC5,           support.BC7,
+  };
+  const u64 hash = Fnv1a(source.data(), source.size());
+  return Fnv1a(settings, sizeof(settings), hash);
+}
+
+std::filesystem::path
+CompressedTextureCache::EntryPath(u64 key) const
+{
+  char name[17]{};
+  std::to_chars(name, name + 16, key, 16);
+  return cache_dir_ / (std::string{ name } + ".ktx2");
+}
+
+bool
+CompressedTextureCache::Load(u64 key, TranscodedTexture* out) const
+{
+  const auto path = EntryPath(key);
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) {
+    return false;
+  }
+  size_t size{ 0 };
+  void* data = SDL_LoadFile(path.string().c_str(), &size);
+  if (!data) {
+    LOG_WARN("CompressedTextureCache: couldn't read {}: {}",
+             path.string(),
+             GETERR);
+    return false;
+  }
+  // The key already covers what the device samples
+  const TextureTranscoder::Support any{ true, true, true, true };
+  const std::span<const u8> bytes{ static_cast<const u8*>(data), size };
+  const bool ret =
+    TextureTranscoder::Transcode(bytes, TextureRole::Color, false, any, out);
+  SDL_free(data);
+  if (!ret) {
+    LOG_WARN("CompressedTextureCache: {} is corrupted", path.string());
+  }
+  return ret;
+}
+
+bool
+CompressedTextureCache::Write(u64 key, const TranscodedTexture& texture) const
+{
+#define ERR ktxErrorString(result)
+  ktxTextureCreateInfo info{};
+  {
+    info.vkFormat = to_vk_format(texture.Format);
+    info.baseWidth = texture.Width;
+    info.baseHeight = texture.Height;
+    info.baseDepth = 1;
+    info.numDimensions = 2;
+    info.numLevels = static_cast<u32>(texture.Levels.size());
+    info.numLayers = 1;
+    info.numFaces = 1;
+    info.isArray = false;
+    info.generateMipmaps = false;
+  }
+  if (info.vkFormat == 0) {
+    LOG_WARN("CompressedTextureCache: can't store format {}",
+             (u32)texture.Format);
+    return false;
+  }
+
+  ktxTexture2* ktx{ nullptr };
+  auto result =
+    ktxTexture2_Create(&info, KTX_TEXTURE_CREATE_ALLOC_STORAGE, &ktx);
+  if (result != KTX_SUCCESS) {
+    LOG_WARN("CompressedTextureCache: couldn't create KTX2 texture: {}", ERR);
+    return false;
+  }
+  for (u32 level = 0; level < info.numLevels; ++level) {
+    const auto& bytes = texture.Levels[level];
+    result = ktxTexture_SetImageFromMemory(
+      ktxTexture(ktx), level, 0, 0, bytes.data(), bytes.size());
+    if (result != KTX_SUCCESS) {
+      LOG_WARN("CompressedTextureCache: couldn't set level {}: {}", level, ERR);
+      ktxTexture2_Destroy(ktx);
+      return false;
+    }
+  }
+
+  const auto path = EntryPath(key);
+  auto save = [&](const std::filesystem::path& tmp) {
+    result = ktxTexture_WriteToNamedFile(ktxTexture(ktx), tmp.string().c_str());
+    if (result != KTX_SUCCESS) {
+      LOG_WARN(
+        "CompressedTextureCache: couldn't write {}: {}", tmp.string(), ERR);
+      return false;
+    }
+    return true;
+  };
+  const bool written = WriteFileAtomically(path, save);
+  ktxTexture2_Destroy(ktx);
+  if (!written) {
+    return false;
+  }
+  LOG_DEBUG("CompressedTextureCache: wrote {}", path.string());
+  return true;
+#undef ERR
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "common/texture_transcoder.h"
+#include "common/types.h"
+#include <filesystem>
+#include <span>
+
+// On-disk cache of material textures compressed by TextureEncoder, one KTX2
+// file per entry. Entries are content addressed: the key hashes the source
+// image bytes with everything that changes the encoding, so they never go
+// stale and identical images are shared across scenes
+class CompressedTextureCache
+{
+public:
+  // Bump whenever the encoders' output changes
+  static constexpr u32 Version = 1;
+
+  explicit CompressedTextureCache(
+    std::filesystem::path cache_dir = "cache/textures");
+
+  // Key of the encoded image `source` (PNG, JPEG...) compressed for `role`
+  static u64 Key(std::span<const u8> source,
+                 TextureRole role,
+                 bool srgb,
+                 const TextureTranscoder::Support& support);
+
+  bool Load(u64 key, TranscodedTexture* out) const;
+  bool Write(u64 key, const TranscodedTexture& texture) const;
+
+  std::filesystem::path EntryPath(u64 key) const;
+
+private:
+  std::filesystem::path cache_dir_;
+};
@@ -1,9 +1,12 @@
 #include "cubemap.h"
+#include "common/deletion_queue.h"
+#include "common/gpu_memory.h"
 #include "common/loaded_image.h"
 #include "common/logger.h"
 #include "common/pipeline_builder.h"
 #include "common/types.h"
 #include "common/unit_cube.h"
+#include "common/upload_batch.h"
 
 #include <SDL3/SDL_gpu.h>
 #include <pch.h>
@@ -14,13 +17,19 @@
 Cubemap::~Cubemap()
 {
   LOG_TRACE("Destroying cubemap");
-  if (Texture != nullptr) {
-    SDL_ReleaseGPUTexture(device_, Texture);
+  if (deletion_queue_) {
+    deletion_queue_->Release(Texture);
+  } else if (Texture != nullptr) {
+    GpuMemory::Release(device_, Texture);
   }
 }
 
-MultifileCubemapLoader::MultifileCubemapLoader(SDL_GPUDevice* device)
+MultifileCubemapLoader::MultifileCubemapLoader(SDL_GPUDevice* device,
+                                               StagingRing* staging,
+                                               DeletionQueue* deletion_queue)
   : device_{ device }
+  , staging_{ staging }
+  , deletion_queue_{ deletion_queue }
 {
 }
 
@@ -30,11 +39,23 @@ MultifileCubemapLoader::Load(std::filesystem::path dir,
 {
   LOG_TRACE("MultifileCubeMapLoader::Load");
   std::array<LoadedImage, 6> imgs;
+  std::array<StagingRing::Allocation, 6> staged{};
+  UploadBatch batch{ device_, staging_ };
+  auto discard_staged = [&]() {
+    for (auto& s : staged) {
+      batch.Discard(s);
+    }
+  };
 
-  { // Load all faces in memory
+  { // Decode all faces straight into staging memory
     for (u8 i = 0; i < 6; ++i) {
-      if (!ImageLoader::Load(imgs[i], dir / paths_[i])) {
-        LOG_ERROR("couldn't load cubemap texture #{}: {}", i, GETERR);
+      staged[i] = batch.StageImage(imgs[i],
+                                   dir / paths_[i],
+                                   ImageType::DIMENSIONS_2D,
+                                   ImagePixelFormat::PIXELFORMAT_UINT);
+      if (!staged[i].Valid()) {
+        LOG_ERROR("couldn't load cubemap texture #{}", i);
+        discard_staged();
         return nullptr;
       }
       // assert(img.nrChannels == 4);
@@ -48,37 +69,10 @@ MultifileCubemapLoader::Load(std::filesystem::path dir,
     ret->Usage = usage;
     ret->Format = format;
     ret->device_ = device_;
+    ret->deletion_queue_ = deletion_queue_;
   }
   u32 width = imgs[0].w;
   u32 height = imgs[0].h;
-  u32 imgSz = 4 * width * height;
-
-  SDL_GPUTransferBufferCreateInfo info{};
-  {
-    info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-    info.size = imgSz * 6;
-  };
-
-  SDL_GPUTransferBuffer* trBuf = SDL_CreateGPUTransferBuffer(device_, &info);
-  if (!trBuf) {
-    LOG_ERROR("couldn't create GPU transfer buffer: {}", GETERR);
-    return nullptr;
-  }
-
-  { // Map transfer buffer and memcpy data
-    u8* textureTransferPtr =
-      (u8*)SDL_MapGPUTransferBuffer(device_, trBuf, false);
-    if (!textureTransferPtr) {
-      SDL_ReleaseGPUTransferBuffer(device_, trBuf);
-      LOG_ERROR("couldn't get transfer buffer mapping: {}", GETERR);
-      return nullptr;
-    }
-    for (int i = 0; i < 6; ++i) {
-      const auto& img = imgs[i];
-      SDL_memcpy(textureTransferPtr + (imgSz * i), img.data, imgSz);
-    }
-    SDL_UnmapGPUTransferBuffer(device_, trBuf);
-  }
 
   { // Create cubemap with right dimensions now that we got image size
     SDL_GPUTextureCreateInfo cubeMapInfo{};
@@ -92,30 +86,19 @@ MultifileCubemapLoader::Load(std::filesystem::path dir,
       // TODO: future usages may require different flags:
       cubeMapInfo.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
     };
-    ret->Texture = SDL_CreateGPUTexture(device_, &cubeMapInfo);
+    ret->Texture = GpuMemory::CreateTexture(device_,
+                                            cubeMapInfo,
+                                            GpuMemoryCategory::IBL,
+                                            ret->Path.filename().string());
     if (!ret->Texture) {
       LOG_ERROR("couldn't create cubemap texture: {}", GETERR);
-      SDL_ReleaseGPUTransferBuffer(device_, trBuf);
+      discard_staged();
       return nullptr;
     }
   }
 
-  { // Copy pass transfer buffer to GPU
-    SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
-    if (!cmdbuf) {
-      LOG_ERROR("couldn't get command buffer for copy pass: {}", GETERR);
-      SDL_ReleaseGPUTransferBuffer(device_, trBuf);
-      return nullptr;
-    }
-
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
-
+  { // Upload all faces in a single batch
     for (u32 i = 0; i < 6; i += 1) {
-      SDL_GPUTextureTransferInfo trInfo{};
-      {
-        trInfo.transfer_buffer = trBuf;
-        trInfo.offset = imgSz * i;
-      }
       SDL_GPUTextureRegion texReg{};
       {
         texReg.texture = ret->Texture;
@@ -124,20 +107,31 @@ MultifileCubemapLoader::Load(std::filesystem::path dir,
         texReg.h = height;
         texReg.d = 1;
       };
-      SDL_UploadToGPUTexture(copyPass, &trInfo, &texReg, false);
+      auto face = staged[i];
+      staged[i] = {}; // handed over, even on failure
+      if (!batch.UploadToTexture(texReg, face)) {
+        LOG_ERROR("couldn't upload cubemap face #{}", i);
+        discard_staged();
+        return nullptr;
+      }
+    }
+    if (!batch.Submit().Ok()) {
+      LOG_ERROR("couldn't submit cubemap upload: {}", GETERR);
+      return nullptr;
     }
-    SDL_EndGPUCopyPass(copyPass);
-    SDL_SubmitGPUCommandBuffer(cmdbuf);
   }
 
-  SDL_ReleaseGPUTransferBuffer(device_, trBuf);
   LOG_DEBUG("Loaded cubemap `{}` textures", dir.c_str());
 
   return ret;
 }
 
-KtxCubemapLoader::KtxCubemapLoader(SDL_GPUDevice* device)
+KtxCubemapLoader::KtxCubemapLoader(SDL_GPUDevice* device,
+                                   StagingRing* staging,
+                                   DeletionQueue* deletion_queue)
   : device_{ device }
+  , staging_{ staging }
+  , deletion_queue_{ deletion_queue }
 {
 }
 
@@ -199,34 +193,7 @@ KtxCubemapLoader::Load(std::filesystem::path path, CubeMapUsage usage) const
     ret->Usage = usage;
     ret->Format = format;
     ret->device_ = device_;
-  }
-
-  SDL_GPUTransferBufferCreateInfo info{};
-  {
-    info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-    info.size = texture->dataSize;
-  };
-
-  SDL_GPUTransferBuffer* trBuf = SDL_CreateGPUTransferBuffer(device_, &info);
-  if (!trBuf) {
-    ktxTexture_Destroy(texture);
-    LOG_ERROR("couldn't create GPU transfer buffer: {}", GETERR);
-    return nullptr;
-  }
-
-  { // Map transfer buffer and memcpy data
-    u8* textureTransferPtr =
-      (u8*)SDL_MapGPUTransferBuffer(device_, trBuf, false);
-    if (!textureTransferPtr) {
-      ktxTexture_Destroy(texture);
-      SDL_ReleaseGPUTransferBuffer(device_, trBuf);
-      LOG_ERROR("couldn't get transfer buffer mapping: {}", GETERR);
-      return nullptr;
-    }
-    for (int i = 0; i < 6; ++i) {
-      SDL_memcpy(textureTransferPtr + (face_sz * i), imgs[i], face_sz);
-    }
-    SDL_UnmapGPUTransferBuffer(device_, trBuf);
+    ret->deletion_queue_ = deletion_queue_;
   }
 
   { // Create cubemap
@@ -241,30 +208,20 @@ KtxCubemapLoader::Load(std::filesystem::path path, CubeMapUsage usage) const
       // TODO: future usages may require different flags:
       cubeMapInfo.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
     };
-    ret->Texture = SDL_CreateGPUTexture(device_, &cubeMapInfo);
+    ret->Texture = GpuMemory::CreateTexture(device_,
+                                            cubeMapInfo,
+                                            GpuMemoryCategory::IBL,
+                                            ret->Path.filename().string());
     if (!ret->Texture) {
       LOG_ERROR("couldn't create cubemap texture: {}", GETERR);
-      SDL_ReleaseGPUTransferBuffer(device_, trBuf);
+      ktxTexture_Destroy(texture);
       return nullptr;
     }
   }
 
-  { // Copy pass transfer buffer to GPU
-    SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
-    if (!cmdbuf) {
-      LOG_ERROR("couldn't get command buffer for copy pass: {}", GETERR);
-      SDL_ReleaseGPUTransferBuffer(device_, trBuf);
-      return nullptr;
-    }
-
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
-
+  { // Upload all faces in a single batch
+    UploadBatch batch{ device_, staging_ };
     for (u32 i = 0; i < 6; i++) {
-      SDL_GPUTextureTransferInfo trInfo{};
-      {
-        trInfo.transfer_buffer = trBuf;
-        trInfo.offset = face_sz * i;
-      }
       SDL_GPUTextureRegion texReg{};
       {
         texReg.texture = ret->Texture;
@@ -273,21 +230,31 @@ KtxCubemapLoader::Load(std::filesystem::path path, CubeMapUsage usage) const
         texReg.h = height;
         texReg.d = 1;
       };
-      SDL_UploadToGPUTexture(copyPass, &trInfo, &texReg, false);
+      if (!batch.UploadToTexture(texReg, imgs[i], face_sz)) {
+        LOG_ERROR("couldn't upload cubemap face #{}", i);
+        ktxTexture_Destroy(texture);
+        return nullptr;
+      }
+    }
+    if (!batch.Submit().Ok()) {
+      LOG_ERROR("couldn't submit cubemap upload: {}", GETERR);
+      ktxTexture_Destroy(texture);
+      return nullptr;
     }
-    SDL_EndGPUCopyPass(copyPass);
-    SDL_SubmitGPUCommandBuffer(cmdbuf);
   }
 
   ktxTexture_Destroy(texture);
-  SDL_ReleaseGPUTransferBuffer(device_, trBuf);
   LOG_DEBUG("Loaded cubemap `{}` KTX texture", path.c_str());
 
   return ret;
 }
 
-ProjectionCubemapLoader::ProjectionCubemapLoader(SDL_GPUDevice* device)
+ProjectionCubemapLoader::ProjectionCubemapLoader(SDL_GPUDevice* device,
+                                                 StagingRing* staging,
+                                                 DeletionQueue* deletion_queue)
   : device_{ device }
+  , staging_{ staging }
+  , deletion_queue_{ deletion_queue }
 {
   if (!CreatePipeline()) {
     LOG_ERROR("Couldn't create pipeline");
@@ -305,8 +272,8 @@ ProjectionCubemapLoader::ProjectionCubemapLoader(SDL_GPUDevice* device)
 ProjectionCubemapLoader::~ProjectionCubemapLoader()
 {
   auto* Device = this->device_;
-  RELEASE_IF(VertexBuffer, SDL_ReleaseGPUBuffer);
-  RELEASE_IF(IndexBuffer, SDL_ReleaseGPUBuffer);
+  RELEASE_IF(VertexBuffer, GpuMemory::Release);
+  RELEASE_IF(IndexBuffer, GpuMemory::Release);
   RELEASE_IF(Pipeline, SDL_ReleaseGPUGraphicsPipeline);
 }
 
@@ -326,13 +293,17 @@ ProjectionCubemapLoader::Load(std::filesystem::path path,
     return nullptr;
   }
 
+  // The HDR upload and the face renders share one command buffer
+  UploadBatch batch{ device_, staging_ };
   LoadedImage img{};
+  StagingRing::Allocation staged{};
   constexpr auto tex_format = SDL_GPU_TEXTUREFORMAT_R32G32B32A32_FLOAT;
   SDL_GPUTexture* tex{ nullptr };
-  { // Load texture data to cpu and create texture
+  { // Decode straight into staging memory and create texture
     auto type = ImageType::DIMENSIONS_2D;
     auto f = ImagePixelFormat::PIXELFORMAT_FLOAT;
-    if (!ImageLoader::Load(img, path, type, f)) {
+    staged = batch.StageImage(img, path, type, f);
+    if (!staged.Valid()) {
       LOG_ERROR("couldn't load cubemap image {}", path.c_str());
       return nullptr;
     }
@@ -345,9 +316,11 @@ ProjectionCubemapLoader::Load(std::filesystem::path path,
       tex_info.num_levels = 1;
       tex_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
     }
-    tex = SDL_CreateGPUTexture(device_, &tex_info);
+    tex = GpuMemory::CreateTexture(
+      device_, tex_info, GpuMemoryCategory::IBL, path.filename().string());
     if (!tex) {
       LOG_ERROR("Couldn't create texture: {}", GETERR);
+      batch.Discard(staged);
       return nullptr;
     }
   }
@@ -365,60 +338,30 @@ ProjectionCubemapLoader::Load(std::filesystem::path path,
     tex_sampler = SDL_CreateGPUSampler(device_, &samplerInfo);
     if (!tex_sampler) {
       LOG_ERROR("Couldn't create sampler, {}", GETERR);
+      batch.Discard(staged);
+      GpuMemory::Release(device_, tex);
       return nullptr;
     }
   }
 
-  SDL_GPUTransferBuffer* trBuf;
-  { // Memcpy data from cpu -> transfer buffer
-    SDL_GPUTransferBufferCreateInfo info{};
-    {
-      info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-      info.size = img.DataSize();
-    };
-    trBuf = SDL_CreateGPUTransferBuffer(device_, &info);
-    if (!trBuf) {
-      SDL_ReleaseGPUTexture(device_, tex);
-      LOG_ERROR("couldn't create GPU transfer buffer: {}", GETERR);
-      return nullptr;
-    }
-    u8* mapped = (u8*)SDL_MapGPUTransferBuffer(device_, trBuf, false);
-    if (!mapped) {
-      SDL_ReleaseGPUTexture(device_, tex);
-      SDL_ReleaseGPUTransferBuffer(device_, trBuf);
-      LOG_ERROR("couldn't get transfer buffer mapping: {}", GETERR);
-      return nullptr;
-    }
-    SDL_memcpy(mapped, img.data, img.DataSize());
-    SDL_UnmapGPUTransferBuffer(device_, trBuf);
+  SDL_GPUTextureRegion tex_reg{};
+  {
+    tex_reg.texture = tex;
+    tex_reg.w = static_cast<u32>(img.w);
+    tex_reg.h = static_cast<u32>(img.h);
+    tex_reg.d = 1;
+  }
+  if (!batch.UploadToTexture(tex_reg, staged)) {
+    GpuMemory::Release(device_, tex);
+    SDL_ReleaseGPUSampler(device_, tex_sampler);
+    return nullptr;
   }
-
-  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
+  SDL_GPUCommandBuffer* cmdbuf = batch.CommandBuffer();
   if (cmdbuf == NULL) {
     LOG_ERROR("Couldn't acquire command buffer: {}", GETERR);
     return nullptr;
   }
 
-  { // Copy pass transfer buffer -> GPU texture
-    SDL_GPUTextureTransferInfo tex_transfer_info{};
-    {
-      tex_transfer_info.transfer_buffer = trBuf;
-      tex_transfer_info.offset = 0;
-    }
-    SDL_GPUTextureRegion tex_reg{};
-    {
-      tex_reg.texture = tex;
-      tex_reg.w = img.w;
-      tex_reg.h = img.h;
-      tex_reg.d = 1;
-    }
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
-    SDL_UploadToGPUTexture(copyPass, &tex_transfer_info, &tex_reg, false);
-
-    SDL_EndGPUCopyPass(copyPass);
-  }
-  SDL_ReleaseGPUTransferBuffer(device_, trBuf);
-
   constexpr u32 width = 512, height = 512;
   auto ret = MakeUnique<Cubemap>();
   {
@@ -426,6 +369,7 @@ ProjectionCubemapLoader::Load(std::filesystem::path path,
     ret->Usage = usage;
     ret->Format = tex_format;
     ret->device_ = device_;
+    ret->deletion_queue_ = deletion_queue_;
   }
 
   { // Create cubemap
@@ -440,7 +384,10 @@ ProjectionCubemapLoader::Load(std::filesystem::path path,
       cubeMapInfo.usage =
         SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
     };
-    ret->Texture = SDL_CreateGPUTexture(device_, &cubeMapInfo);
+    ret->Texture = GpuMemory::CreateTexture(device_,
+                                            cubeMapInfo,
+                                            GpuMemoryCategory::IBL,
+                                            ret->Path.filename().string());
     if (!ret->Texture) {
       LOG_ERROR("Couldn't create cubemap texture: {}", GETERR);
       return nullptr;
@@ -492,15 +439,14 @@ ProjectionCubemapLoader::Load(std::filesystem::path path,
     }
   }
 
-  auto b = SDL_SubmitGPUCommandBuffer(cmdbuf);
-  if (!b) {
+  if (!batch.Submit().Ok()) {
     LOG_ERROR("Couldn't submit command buffer: {}", GETERR);
   } else {
     LOG_DEBUG("Loaded HDR texture `{}` as cubemap", path.c_str());
   }
 
   SDL_ReleaseGPUSampler(device_, tex_sampler);
-  SDL_ReleaseGPUTexture(device_, tex);
+  GpuMemory::Release(device_, tex);
   return ret;
 }
 
@@ -547,13 +493,13 @@ ProjectionCubemapLoader::UploadVertexData()
 
   const u32 vbuf_sz = sizeof(PosVertex) * UnitCube::VertCount;
   const u32 ibuf_sz = sizeof(u16) * UnitCube::IndexCount;
-  const u32 trbuf_sz = vbuf_sz + ibuf_sz;
   SDL_GPUBufferCreateInfo bufInfo{};
   {
     bufInfo.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
     bufInfo.size = vbuf_sz;
   }
-  VertexBuffer = SDL_CreateGPUBuffer(device_, &bufInfo);
+  VertexBuffer =
+    GpuMemory::CreateBuffer(device_, bufInfo, GpuMemoryCategory::Mesh);
   if (!VertexBuffer) {
     LOG_ERROR("Couldn't create vertex buffer: {}", GETERR);
     return false;
@@ -563,50 +509,21 @@ ProjectionCubemapLoader::UploadVertexData()
     bufInfo.usage = SDL_GPU_BUFFERUSAGE_INDEX;
     bufInfo.size = ibuf_sz;
   }
-  IndexBuffer = SDL_CreateGPUBuffer(device_, &bufInfo);
-  if (!VertexBuffer) {
+  IndexBuffer =
+    GpuMemory::CreateBuffer(device_, bufInfo, GpuMemoryCategory::Mesh);
+  if (!IndexBuffer) {
     LOG_ERROR("Couldn't create index buffer: {}", GETERR);
     return false;
   }
 
-  SDL_GPUTransferBufferCreateInfo trInfo{};
-  {
-    trInfo.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
-    trInfo.size = trbuf_sz;
-  }
-  SDL_GPUTransferBuffer* trBuf = SDL_CreateGPUTransferBuffer(device_, &trInfo);
-  if (!trBuf) {
-    LOG_ERROR("Couldn't create transfer buffer: {}", GETERR);
+  UploadBatch batch{ device_, staging_ };
+  if (!batch.UploadToBuffer(VertexBuffer, UnitCube::Verts, vbuf_sz) ||
+      !batch.UploadToBuffer(IndexBuffer, UnitCube::Indices, ibuf_sz)) {
+    LOG_ERROR("Couldn't record cubemap vertex upload");
     return false;
   }
 
-  { // Transfer buffer
-    PosVertex* transferData =
-      (PosVertex*)SDL_MapGPUTransferBuffer(device_, trBuf, false);
-    u16* indexData = (u16*)&transferData[24];
-
-    SDL_memcpy(transferData, UnitCube::Verts, sizeof(UnitCube::Verts));
-    SDL_memcpy(indexData, UnitCube::Indices, sizeof(UnitCube::Indices));
-    SDL_UnmapGPUTransferBuffer(device_, trBuf);
-  }
-
-  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
-
-  { // Copy pass
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdbuf);
-
-    SDL_GPUTransferBufferLocation trLoc{ trBuf, 0 };
-    SDL_GPUBufferRegion vBufReg{ VertexBuffer, 0, vbuf_sz };
-    SDL_GPUBufferRegion iBufReg{ IndexBuffer, 0, ibuf_sz };
-
-    SDL_UploadToGPUBuffer(copyPass, &trLoc, &vBufReg, false);
-    trLoc.offset = vBufReg.size;
-    SDL_UploadToGPUBuffer(copyPass, &trLoc, &iBufReg, false);
-    SDL_EndGPUCopyPass(copyPass);
-  }
-
-  SDL_ReleaseGPUTransferBuffer(device_, trBuf);
-  auto ret = SDL_SubmitGPUCommandBuffer(cmdbuf);
+  auto ret = batch.Submit().Ok();
   if (ret) {
     LOG_DEBUG("Sent cubemap vertex data to GPU");
   } else {
@@ -4,6 +4,9 @@
 #include <SDL3/SDL_gpu.h>
 #include <filesystem>
 
+class DeletionQueue;
+class StagingRing;
+
 enum class CubeMapUsage : u8
 {
   Skybox,
@@ -25,6 +28,7 @@ struct Cubemap
 
 private: // TODO: remove this in favor of RAII texture wrapper
   SDL_GPUDevice* device_{};
+  DeletionQueue* deletion_queue_{}; // released right away if null
 };
 
 class ICubemapLoader
@@ -38,13 +42,17 @@ public:
 class MultifileCubemapLoader final : public ICubemapLoader
 {
 public:
-  explicit MultifileCubemapLoader(SDL_GPUDevice* device);
+  explicit MultifileCubemapLoader(SDL_GPUDevice* device,
+                                  StagingRing* staging,
+                                  DeletionQueue* deletion_queue);
   UniquePtr<Cubemap> Load(std::filesystem::path dir,
                           CubeMapUsage usage) const override;
   ~MultifileCubemapLoader() override = default;
 
 private:
   SDL_GPUDevice* device_{};
+  StagingRing* staging_{};
+  DeletionQueue* deletion_queue_{};
   const char* paths_[6]{ "left.jpg",   "right.jpg", "top.jpg",
                          "bottom.jpg", "back.jpg",  "front.jpg" };
 };
@@ -53,20 +61,26 @@ private:
 class KtxCubemapLoader final : public ICubemapLoader
 {
 public:
-  explicit KtxCubemapLoader(SDL_GPUDevice* device);
+  explicit KtxCubemapLoader(SDL_GPUDevice* device,
+                            StagingRing* staging,
+                            DeletionQueue* deletion_queue);
   UniquePtr<Cubemap> Load(std::filesystem::path path,
                           CubeMapUsage usage) const override;
   ~KtxCubemapLoader() override = default;
 
 private:
   SDL_GPUDevice* device_{};
+  StagingRing* staging_{};
+  DeletionQueue* deletion_queue_{};
 };
 
 // HDR flat equirectangular projection. Reconstructs faces
 class ProjectionCubemapLoader final : public ICubemapLoader
 {
 public:
-  explicit ProjectionCubemapLoader(SDL_GPUDevice* device);
+  explicit ProjectionCubemapLoader(SDL_GPUDevice* device,
+                                   StagingRing* staging,
+                                   DeletionQueue* deletion_queue);
   UniquePtr<Cubemap> Load(std::filesystem::path path,
                           CubeMapUsage usage) const override;
   ~ProjectionCubemapLoader() override;
@@ -86,4 +100,6 @@ private:
   static constexpr const char* FragPath =
     "resources/shaders/compiled/cubemap_projection.frag.spv";
   SDL_GPUDevice* device_{};
+  StagingRing* staging_{};
+  DeletionQueue* deletion_queue_{};
 };
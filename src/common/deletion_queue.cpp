@@ -0,0 +1,129 @@
+#include "deletion_queue.h"
+
+#include "common/gpu_memory.h"
+#include "common/logger.h"
+#include "common/types.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <pch.h>
+
+DeletionQueue::DeletionQueue(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+DeletionQueue::~DeletionQueue()
+{
+  Flush();
+}
+
+void
+DeletionQueue::Push(std::function<void()>&& fn)
+{
+  std::lock_guard lock{ mutex_ };
+  entries_.push_back(Entry{ frame_, std::move(fn) });
+}
+
+void
+DeletionQueue::Release(SDL_GPUBuffer* buffer)
+{
+  if (buffer != nullptr) {
+    Push([device = device_, buffer] { GpuMemory::Release(device, buffer); });
+  }
+}
+
+void
+DeletionQueue::Release(SDL_GPUTexture* texture)
+{
+  if (texture != nullptr) {
+    Push([device = device_, texture] { GpuMemory::Release(device, texture); });
+  }
+}
+
+void
+DeletionQueue::Release(SDL_GPUSampler* sampler)
+{
+  if (sampler != nullptr) {
+    Push(
+      [device = device_, sampler] { SDL_ReleaseGPUSampler(device, sampler); });
+  }
+}
+
+void
+DeletionQueue::Release(SDL_GPUTransferBuffer* buffer)
+{
+  if (buffer != nullptr) {
+    Push([device = device_, buffer] {
+      SDL_ReleaseGPUTransferBuffer(device, buffer);
+    });
+  }
+}
+
+void
+DeletionQueue::Release(SDL_GPUGraphicsPipeline* pipeline)
+{
+  if (pipeline != nullptr) {
+    Push([device = device_, pipeline] {
+      SDL_ReleaseGPUGraphicsPipeline(device, pipeline);
+    });
+  }
+}
+
+void
+DeletionQueue::Release(SDL_GPUComputePipeline* pipeline)
+{
+  if (pipeline != nullptr) {
+    Push([device = device_, pipeline] {
+      SDL_ReleaseGPUComputePipeline(device, pipeline);
+    });
+  }
+}
+
+void
+DeletionQueue::NextFrame()
+{
+  std::deque<Entry> expired;
+  {
+    std::lock_guard lock{ mutex_ };
+    ++frame_;
+    while (!entries_.empty() &&
+           entries_.front().Frame + FramesInFlight <= frame_) {
+      expired.push_back(std::move(entries_.front()));
+      entries_.pop_front();
+    }
+  }
+  // Run outside the lock, entries may push new releases
+  for (auto& entry : expired) {
+    entry.Fn();
+  }
+}
+
+void
+DeletionQueue::Flush()
+{
+  std::deque<Entry> expired;
+  {
+    std::lock_guard lock{ mutex_ };
+    expired.swap(entries_);
+  }
+  if (!expired.empty()) {
+    LOG_DEBUG("DeletionQueue: flushing {} releases", expired.size());
+  }
+  for (auto& entry : expired) {
+    entry.Fn();
+  }
+}
+
+u64
+DeletionQueue::Frame() const
+{
+  std::lock_guard lock{ mutex_ };
+  return frame_;
+}
+
+size_t
+DeletionQueue::Pending() const
+{
+  std::lock_guard lock{ mutex_ };
+  return entries_.size();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "common/types.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+// Defers GPU resource destruction until every frame that could still
+// reference the resource has completed, so resources can be dropped
+// mid-frame (scene switches, buffer resizes) without waiting for the GPU.
+// Entries pushed during frame N run in NextFrame() once N + FramesInFlight
+// has been reached.
+class DeletionQueue
+{
+public:
+  // SDL allows at most 3 frames in flight
+  static constexpr u64 FramesInFlight = 3;
+
+public:
+  DISABLE_COPY_AND_MOVE(DeletionQueue);
+  explicit DeletionQueue(SDL_GPUDevice* device);
+  ~DeletionQueue(); // flushes
+
+  void Push(std::function<void()>&& fn);
+
+  // Null-safe shorthands for Push()
+  void Release(SDL_GPUBuffer* buffer);
+  void Release(SDL_GPUTexture* texture);
+  void Release(SDL_GPUSampler* sampler);
+  void Release(SDL_GPUTransferBuffer* buffer);
+  void Release(SDL_GPUGraphicsPipeline* pipeline);
+  void Release(SDL_GPUComputePipeline* pipeline);
+
+  // Called once per frame, after the frame's command buffers are submitted
+  void NextFrame();
+  // Runs every pending entry now. The GPU must be idle
+  void Flush();
+
+  u64 Frame() const;
+  size_t Pending() const;
+
+private:
+  struct Entry
+  {
+    u64 Frame;
+    std::function<void()> Fn;
+  };
+
+private:
+  SDL_GPUDevice* device_;
+  u64 frame_{ 0 };
+  std::deque<Entry> entries_;
+  mutable std::mutex mutex_;
+};
@@ -8,16 +8,24 @@
 
 Engine::Engine(SDL_GPUDevice* device, SDL_Window* window)
   : Device{ device }
-  , MultifileCubemapLoader{ device }
-  , KtxCubemapLoader{ device }
-  , ProjectionCubemapLoader{ device }
+  , deletion_queue_{ device }
+  , staging_{ device }
+  , uploads_{ device, &staging_ }
+  , readback_{ device }
+  , MultifileCubemapLoader{ device, &staging_, &deletion_queue_ }
+  , KtxCubemapLoader{ device, &staging_, &deletion_queue_ }
+  , ProjectionCubemapLoader{ device, &staging_, &deletion_queue_ }
   , window_{ window }
 {
 }
 
 Engine::~Engine()
 {
-  RELEASE_IF(default_texture_, SDL_ReleaseGPUTexture)
+  // Apps are destroyed first, whatever they deferred can go now
+  SDL_WaitForGPUIdle(Device);
+  deletion_queue_.Flush();
+
+  RELEASE_IF(default_texture_, GpuMemory::Release)
   RELEASE_IF(linear_clamp_sampler_, SDL_ReleaseGPUSampler);
   RELEASE_IF(linear_repeat_sampler_, SDL_ReleaseGPUSampler);
 }
@@ -39,6 +47,28 @@ Engine::Init()
   return true;
 }
 
+void
+Engine::NextFrame()
+{
+  uploads_.Tick();
+  deletion_queue_.NextFrame();
+  staging_.Reclaim();
+  readback_.Update();
+}
+
+ReadbackHandle
+Engine::ReadbackAsync(SDL_GPUBuffer* buf, u32 offset, u32 size)
+{
+  return readback_.Download(buf, offset, size);
+}
+
+ReadbackHandle
+Engine::ReadbackAsync(const SDL_GPUTextureRegion& region,
+                      SDL_GPUTextureFormat format)
+{
+  return readback_.Download(region, format);
+}
+
 bool
 Engine::UploadTo2DTexture(SDL_GPUTexture* tex, LoadedImage& img)
 {
@@ -48,47 +78,12 @@ Engine::UploadTo2DTexture(SDL_GPUTexture* tex, LoadedImage& img)
     return false;
   }
 
-  TransferBufferWrapper tr_wrapped{ Device, static_cast<u32>(img.DataSize()) };
-  auto* tr_buf = tr_wrapped.Get();
-  if (!tr_buf) {
-    LOG_ERROR("Couldn't create transfer buffer: {}", SDL_GetError);
+  UploadBatch batch{ Device, &staging_ };
+  if (!batch.UploadTo2DTexture(tex, img)) {
     return false;
   }
-
-  { // Setup transfer buffer
-    void* memory = SDL_MapGPUTransferBuffer(Device, tr_buf, false);
-    if (!memory) {
-      LOG_ERROR("Couldn't map texture memory: {}", SDL_GetError());
-      return false;
-    }
-    SDL_memcpy(memory, img.data, img.DataSize());
-    SDL_UnmapGPUTransferBuffer(Device, tr_buf);
-  }
-
-  { // Copy pass
-    SDL_GPUTextureTransferInfo tex_transfer_info{};
-    tex_transfer_info.transfer_buffer = tr_buf;
-    tex_transfer_info.offset = 0;
-
-    SDL_GPUTextureRegion tex_reg{};
-    {
-      tex_reg.texture = tex;
-      tex_reg.w = (Uint32)img.w;
-      tex_reg.h = (Uint32)img.h;
-      tex_reg.d = 1;
-    }
-    SDL_GPUCommandBuffer* cmdBuf = SDL_AcquireGPUCommandBuffer(Device);
-    if (!cmdBuf) {
-      LOG_ERROR("Couldn't acquire command buffer: {}", SDL_GetError());
-      return false;
-    }
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(cmdBuf);
-    SDL_UploadToGPUTexture(copyPass, &tex_transfer_info, &tex_reg, false);
-
-    SDL_EndGPUCopyPass(copyPass);
-    if (!SDL_SubmitGPUCommandBuffer(cmdBuf)) {
-      LOG_ERROR("Couldn't sumbit command buffer: {}", SDL_GetError());
-    }
+  if (!batch.Submit().Ok()) {
+    LOG_ERROR("Couldn't sumbit command buffer: {}", SDL_GetError());
   }
   return true;
 }
@@ -105,6 +100,7 @@ Engine::CreateDefaultSamplers()
     info.address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
     info.address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
     info.address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
+    info.max_lod = 1000.f; // whole mip chain
   }
   linear_repeat_sampler_ = SDL_CreateGPUSampler(Device, &info);
   if (!linear_repeat_sampler_) {
@@ -141,7 +137,8 @@ Engine::CreateDefaultTexture()
       tex_info.usage =
         SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
     }
-    default_texture_ = SDL_CreateGPUTexture(Device, &tex_info);
+    default_texture_ = GpuMemory::CreateTexture(
+      Device, tex_info, GpuMemoryCategory::MaterialTexture, "Engine");
 
     if (!default_texture_) {
       LOG_ERROR("Default texture creation failed: {}", SDL_GetError());
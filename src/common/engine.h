@@ -1,8 +1,15 @@
 #pragma once
 
 #include "common/cubemap.h"
+#include "common/deletion_queue.h"
+#include "common/gpu_memory.h"
+#include "common/readback.h"
 #include "common/rendersystem.h"
+#include "common/staging_ring.h"
+#include "common/thread_pool.h"
 #include "common/types.h"
+#include "common/upload_batch.h"
+#include "common/upload_scheduler.h"
 #include <SDL3/SDL_gpu.h>
 
 class GLTFLoader;
@@ -21,8 +28,22 @@ public:
   SDL_GPUTexture* DefaultTexture() const { return default_texture_; }
   SDL_GPUSampler* LinearRepeatSampler() const { return linear_repeat_sampler_; }
   SDL_GPUSampler* LinearClampSampler() const { return linear_clamp_sampler_; }
+  StagingRing& Staging() { return staging_; }
+  // Releases that must wait for in-flight frames, see DeletionQueue
+  DeletionQueue& Deletions() { return deletion_queue_; }
+
+  // Called by the main loop once the frame has been submitted
+  void NextFrame();
 
   // GPU Uploads:
+  // Records many uploads into one command buffer, see UploadBatch
+  UploadBatch BeginUpload() { return UploadBatch{ Device, &staging_ }; }
+  // Queues uploads drained under a per-frame budget, see UploadScheduler
+  UploadScheduler& Uploads() { return uploads_; }
+  // Shared CPU workers for asset processing
+  ThreadPool& Workers() { return workers_; }
+
+  // Single-shot helpers, each one is its own batch
   template<typename T>
   bool UploadToBuffer(SDL_GPUBuffer* buf, const T* data, const u32 size);
   template<typename V, typename I>
@@ -31,15 +52,39 @@ public:
                                   u32 vert_count,
                                   const I* indices,
                                   u32 idx_count);
+  template<typename V, typename I>
+  bool CreateAndUploadMeshBuffers(UploadBatch& batch,
+                                  MeshBuffers* buffers,
+                                  const V* vertices,
+                                  u32 vert_count,
+                                  const I* indices,
+                                  u32 idx_count);
 
   bool UploadTo2DTexture(SDL_GPUTexture* tex, LoadedImage& img);
 
+  // GPU Readbacks:
+  // Non-blocking downloads, the handle becomes Ready() a few frames later.
+  // Must be called after the command buffer writing the data was submitted
+  ReadbackHandle ReadbackAsync(SDL_GPUBuffer* buf, u32 offset, u32 size);
+  ReadbackHandle ReadbackAsync(const SDL_GPUTextureRegion& region,
+                               SDL_GPUTextureFormat format);
+
 private:
   bool CreateDefaultSamplers();
   bool CreateDefaultTexture();
 
 public:
   SDL_GPUDevice* Device;
+
+private:
+  // Declared before the cubemap loaders, which use them
+  DeletionQueue deletion_queue_;
+  StagingRing staging_;
+  UploadScheduler uploads_;
+  ReadbackPool readback_;
+  ThreadPool workers_{};
+
+public:
   MultifileCubemapLoader MultifileCubemapLoader;
   KtxCubemapLoader KtxCubemapLoader;
   ProjectionCubemapLoader ProjectionCubemapLoader;
@@ -56,168 +101,92 @@ bool
 Engine::UploadToBuffer(SDL_GPUBuffer* buf, const T* data, const u32 count)
 {
   LOG_TRACE("Engine::UploadBuffers");
-  if (buf == nullptr) {
-    LOG_ERROR("Couldn't upload to buffer: invalid buffer");
+  UploadBatch batch{ Device, &staging_ };
+  if (!batch.UploadToBuffer(buf, data, sizeof(T) * count)) {
+    LOG_ERROR("Couldn't upload to buffer");
     return false;
   }
+  return batch.Submit().Ok();
+}
 
-  const u32 transfer_size = sizeof(T) * count;
-
-  TransferBufferWrapper tr_wrapped{ Device, transfer_size };
-  auto* tr_buf = tr_wrapped.Get();
-  if (!tr_buf) {
-    LOG_ERROR("Couldn't create transfer buffer: {}", SDL_GetError);
+template<typename V, typename I>
+bool
+Engine::CreateAndUploadMeshBuffers(MeshBuffers* buffers,
+                                   const V* vertices,
+                                   u32 vert_count,
+                                   const I* indices,
+                                   u32 idx_count)
+{
+  UploadBatch batch{ Device, &staging_ };
+  if (!CreateAndUploadMeshBuffers(
+        batch, buffers, vertices, vert_count, indices, idx_count)) {
     return false;
   }
-
-  { // setup transfer buffer
-    T* transferData = (T*)SDL_MapGPUTransferBuffer(Device, tr_buf, false);
-    if (!transferData) {
-      LOG_ERROR("couldn't get mapping for transfer buffer");
-      return false;
-    }
-
-    for (u32 i = 0; i < count; ++i) {
-      transferData[i] = data[i];
-    }
-    SDL_UnmapGPUTransferBuffer(Device, tr_buf);
-  }
-
-  auto ret{ false };
-  { // copy pass
-    SDL_GPUCommandBuffer* uploadCmdBuf = SDL_AcquireGPUCommandBuffer(Device);
-    if (!uploadCmdBuf) {
-      LOG_ERROR("couldn't acquire command buffer");
-      return false;
-    }
-    SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(uploadCmdBuf);
-
-    SDL_GPUTransferBufferLocation trLoc;
-    {
-      trLoc.transfer_buffer = tr_buf;
-      trLoc.offset = 0;
-    }
-    SDL_GPUBufferRegion reg;
-    {
-      reg.buffer = buf;
-      reg.offset = 0;
-      reg.size = transfer_size;
-    };
-    SDL_UploadToGPUBuffer(copyPass, &trLoc, &reg, false);
-
-    SDL_EndGPUCopyPass(copyPass);
-    ret = SDL_SubmitGPUCommandBuffer(uploadCmdBuf);
+  if (!batch.Submit().Ok()) {
+    LOG_ERROR("couldn't submit copy pass command buffer");
+    GpuMemory::Release(Device, buffers->VertexBuffer);
+    GpuMemory::Release(Device, buffers->IndexBuffer);
+    return false;
   }
-
-  return ret;
+  LOG_DEBUG("Uploaded vertex data to GPU");
+  return true;
 }
 
 template<typename V, typename I>
 bool
-Engine::CreateAndUploadMeshBuffers(MeshBuffers* buffers,
+Engine::CreateAndUploadMeshBuffers(UploadBatch& batch,
+                                   MeshBuffers* buffers,
                                    const V* vertices,
                                    u32 vert_count,
                                    const I* indices,
                                    u32 idx_count)
 {
   LOG_TRACE("Engine::CreateAndUploadMeshBuffers");
-  u32 transfer_size = sizeof(V) * vert_count + sizeof(I) * idx_count;
+  const u32 vert_size = static_cast<u32>(sizeof(V) * vert_count);
+  const u32 idx_size = static_cast<u32>(sizeof(I) * idx_count);
   LOG_DEBUG("Mesh has {} vertices and {} indices", vert_count, idx_count);
 
   SDL_GPUBufferCreateInfo vertInfo{};
   {
     vertInfo.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
-    vertInfo.size = static_cast<u32>(sizeof(V) * vert_count);
+    vertInfo.size = vert_size;
   }
 
   SDL_GPUBufferCreateInfo idxInfo{};
   {
     idxInfo.usage = SDL_GPU_BUFFERUSAGE_INDEX;
-    idxInfo.size = static_cast<u32>(sizeof(I) * idx_count);
+    idxInfo.size = idx_size;
   }
 
-  buffers->VertexBuffer = SDL_CreateGPUBuffer(Device, &vertInfo);
+  buffers->VertexBuffer =
+    GpuMemory::CreateBuffer(Device, vertInfo, GpuMemoryCategory::Mesh);
   auto vbuf = buffers->VertexBuffer;
   if (!vbuf) {
     LOG_ERROR("couldn't create vertex buffer");
     return false;
   }
 
-  buffers->IndexBuffer = SDL_CreateGPUBuffer(Device, &idxInfo);
+  buffers->IndexBuffer =
+    GpuMemory::CreateBuffer(Device, idxInfo, GpuMemoryCategory::Mesh);
   auto ibuf = buffers->IndexBuffer;
   if (!ibuf) {
     LOG_ERROR("couldn't create index buffer");
-    SDL_ReleaseGPUBuffer(Device, vbuf);
-    return false;
-  }
-
-#define RELEASE_BUFFERS                                                        \
-  SDL_ReleaseGPUBuffer(Device, vbuf);                                          \
-  SDL_ReleaseGPUBuffer(Device, ibuf);
-
-  TransferBufferWrapper tr_wrapped{ Device, transfer_size };
-  auto* trBuf = tr_wrapped.Get();
-  if (!trBuf) {
-    LOG_ERROR("Couldn't create transfer buffer: {}", SDL_GetError);
-    RELEASE_BUFFERS
-    return false;
-  }
-
-  // Transfer Buffer to send vertex data to GPU
-  V* transferData = (V*)SDL_MapGPUTransferBuffer(Device, trBuf, false);
-  if (!transferData) {
-    LOG_ERROR("couldn't get mapping for transfer buffer");
-    RELEASE_BUFFERS
+    GpuMemory::Release(Device, vbuf);
     return false;
   }
 
-  for (u32 i = 0; i < vert_count; ++i) {
-    transferData[i] = vertices[i];
-  }
-
-  I* indexData = (I*)&transferData[vert_count];
-  for (u32 i = 0; i < idx_count; ++i) {
-    indexData[i] = indices[i];
-  }
-
-  SDL_UnmapGPUTransferBuffer(Device, trBuf);
-
-  // Upload the transfer data to the GPU resources
-  SDL_GPUCommandBuffer* uploadCmdBuf = SDL_AcquireGPUCommandBuffer(Device);
-  if (!uploadCmdBuf) {
-    LOG_ERROR("couldn't acquire command buffer");
-    RELEASE_BUFFERS
+  if (!batch.UploadToBuffer(vbuf, vertices, vert_size) ||
+      !batch.UploadToBuffer(ibuf, indices, idx_size)) {
+    LOG_ERROR("couldn't record mesh upload");
+    GpuMemory::Release(Device, vbuf);
+    GpuMemory::Release(Device, ibuf);
+    buffers->VertexBuffer = nullptr;
+    buffers->IndexBuffer = nullptr;
     return false;
   }
-  SDL_GPUCopyPass* copyPass = SDL_BeginGPUCopyPass(uploadCmdBuf);
-
-  SDL_GPUTransferBufferLocation trLoc;
-  {
-    trLoc.transfer_buffer = trBuf;
-    trLoc.offset = 0;
-  }
-  SDL_GPUBufferRegion reg;
-  {
-    reg.buffer = vbuf;
-    reg.offset = 0;
-    reg.size = static_cast<u32>(sizeof(V) * vert_count);
-  };
-  SDL_UploadToGPUBuffer(copyPass, &trLoc, &reg, false);
-
-  trLoc.offset = sizeof(V) * vert_count;
-  reg.buffer = ibuf;
-  reg.size = sizeof(I) * idx_count;
-
-  SDL_UploadToGPUBuffer(copyPass, &trLoc, &reg, false);
-
-  SDL_EndGPUCopyPass(copyPass);
-  bool ret = SDL_SubmitGPUCommandBuffer(uploadCmdBuf);
-  if (!ret) {
-    LOG_ERROR("couldn't submit copy pass command buffer");
-    RELEASE_BUFFERS
-  } else {
-    LOG_DEBUG("Uploaded vertex data to GPU");
-  }
-  return ret;
-#undef RELEASE_BUFFERS
+  buffers->VertexOffset = 0;
+  buffers->VertexCount = vert_count;
+  buffers->FirstIndex = 0;
+  buffers->IndexCount = idx_count;
+  return true;
 }
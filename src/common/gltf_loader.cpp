@@ -2,17 +2,23 @@
 
 #include "common/gltf_loader.h"
 
+#include "common/accessor_decode.h"
 #include "common/engine.h"
+#include "common/gpu_memory.h"
 #include "common/loaded_image.h"
 #include "common/logger.h"
 #include "common/material.h"
+#include "common/mip_chain.h"
 #include "common/pipeline_builder.h"
 #include "common/rendersystem.h"
 #include "common/tangent_loader.h"
+#include "common/texture_encoder.h"
 #include "common/types.h"
 #include "common/util.h"
 #include "shaders/material_features.h"
+#include "shaders/meshlet_cull.h"
 
+#include <cstring>
 #include <limits>
 #include <variant>
 
@@ -25,6 +31,16 @@
 #include <glm/gtx/quaternion.hpp>
 
 namespace {
+// Decodes images into a heap vector the upload scheduler takes over
+ImageLoader::Destination
+pixels_destination(std::vector<u8>& pixels)
+{
+  return [&pixels](const LoadedImage& info) -> void* {
+    pixels.resize(info.DataSize());
+    return pixels.data();
+  };
+}
+
 SDL_GPUFilter
 extract_filter(fastgltf::Filter filter)
 {
@@ -59,6 +75,166 @@ extract_mipmap_mode(fastgltf::Filter filter)
   }
 }
 
+#if FASTGLTF_HAS_MEMORY_MAPPED_FILE
+using SourceFile = fastgltf::MappedGltfFile;
+#else
+using SourceFile = fastgltf::GltfDataBuffer;
+#endif
+
+// Whole content of a mapped or loaded file
+std::span<const std::byte>
+file_bytes(fastgltf::GltfDataGetter& file)
+{
+  file.reset();
+  auto bytes = file.read(file.totalSize(), 0);
+  file.reset();
+  return bytes;
+}
+
+// Offset of the BIN chunk data in a GLB, 0 if there's none
+u64
+glb_bin_offset(std::span<const std::byte> glb)
+{
+  constexpr u32 glb_magic = 0x46546C67; // "glTF"
+  constexpr u32 header_size = 12, chunk_header_size = 8;
+  auto read_u32 = [&](u64 offset) {
+    u32 v{ 0 };
+    std::memcpy(&v, glb.data() + offset, sizeof(u32));
+    return v;
+  };
+  if (glb.size() < header_size + chunk_header_size ||
+      read_u32(0) != glb_magic) {
+    return 0;
+  }
+  const u64 json_length = read_u32(header_size);
+  const u64 bin_header = header_size + chunk_header_size + json_length;
+  if (glb.size() < bin_header + chunk_header_size) {
+    return 0;
+  }
+  return bin_header + chunk_header_size;
+}
+
+// Parses with every buffer read straight from memory mapped files when the
+// platform allows it, or from files read whole into memory otherwise: the GLB
+// BIN chunk and external buffers become ByteViews into `files`, which must
+// outlive `out`. `buffer_paths` gets the external buffer files, in order
+bool
+parse_gltf(const std::filesystem::path& path,
+           fastgltf::Asset* out,
+           GLTFLoader::MappedFiles* files,
+           std::vector<std::filesystem::path>* buffer_paths)
+{
+  // Quantized attributes are decoded like the others, see copy_accessor
+  fastgltf::Parser parser{ fastgltf::Extensions::KHR_texture_basisu |
+                           fastgltf::Extensions::KHR_mesh_quantization |
+                           fastgltf::Extensions::EXT_mesh_gpu_instancing };
+  auto open = [&](const std::filesystem::path& file_path) -> SourceFile* {
+    auto file = SourceFile::FromPath(file_path);
+    if (file.error() != fastgltf::Error::None) {
+      LOG_ERROR("couldn't open {}", file_path.string());
+      return nullptr;
+    }
+    auto& ret = files->emplace_back(
+      std::make_unique<SourceFile>(std::move(file.get())));
+    return ret.get();
+  };
+
+  auto* file = open(path);
+  if (!file) {
+    return false;
+  }
+  // External buffers are opened below instead of being read by fastgltf
+  auto asset = parser.loadGltf(*file, path.parent_path());
+  if (auto error = asset.error(); error != fastgltf::Error::None) {
+    LOG_ERROR("couldn't parse gltf: {}", fastgltf::getErrorMessage(error));
+    return false;
+  }
+  *out = std::move(asset.get());
+
+  const auto glb = file_bytes(*file);
+  const u64 bin_offset = glb_bin_offset(glb);
+  buffer_paths->clear();
+  for (auto& buffer : out->buffers) {
+    if (auto* uri = std::get_if<fastgltf::sources::URI>(&buffer.data)) {
+      if (!uri->uri.isLocalPath()) {
+        continue;
+      }
+      const auto& ext_path =
+        buffer_paths->emplace_back(path.parent_path() / uri->uri.fspath());
+      auto* ext = open(ext_path);
+      if (!ext) {
+        return false;
+      }
+      auto bytes = file_bytes(*ext);
+      if (uri->fileByteOffset + buffer.byteLength > bytes.size()) {
+        LOG_ERROR("buffer {} is truncated", ext_path.string());
+        return false;
+      }
+      buffer.data = fastgltf::sources::ByteView{
+        bytes.subspan(uri->fileByteOffset, buffer.byteLength), uri->mimeType
+      };
+    } else if (auto* array =
+                 std::get_if<fastgltf::sources::Array>(&buffer.data);
+               array && bin_offset > 0 && &buffer == &out->buffers[0] &&
+               bin_offset + buffer.byteLength <= glb.size()) {
+      // GLB BIN chunk, drop fastgltf's copy for the file's
+      buffer.data = fastgltf::sources::ByteView{
+        glb.subspan(bin_offset, buffer.byteLength), array->mimeType
+      };
+    }
+  }
+
+  if (auto error = fastgltf::validate(*out); error != fastgltf::Error::None) {
+    LOG_ERROR("couldn't validate gltf");
+    return false;
+  }
+  return true;
+}
+
+// EXT_mesh_gpu_instancing transforms of a node, composed like node TRS.
+// Missing attributes are the identity. False when their counts don't match
+bool
+read_instances(const fastgltf::Asset& asset,
+               const fastgltf::Node& node,
+               std::vector<glm::mat4>* out)
+{
+  const fastgltf::Accessor* accessors[3]{};
+  const char* names[] = { "TRANSLATION", "ROTATION", "SCALE" };
+  size_t count{ 0 };
+  for (size_t i = 0; i < std::size(names); ++i) {
+    auto attr = node.findInstancingAttribute(names[i]);
+    if (attr == node.instancingAttributes.end()) {
+      continue;
+    }
+    accessors[i] = &asset.accessors[attr->accessorIndex];
+    if (count != 0 && accessors[i]->count != count) {
+      return false;
+    }
+    count = accessors[i]->count;
+  }
+
+  std::vector<glm::vec3> translations(count, glm::vec3{ 0.f });
+  std::vector<glm::vec4> rotations(count, glm::vec4{ 0.f, 0.f, 0.f, 1.f });
+  std::vector<glm::vec3> scales(count, glm::vec3{ 1.f });
+  if (accessors[0]) {
+    copy_accessor<glm::vec3>(asset, *accessors[0], translations.data());
+  }
+  if (accessors[1]) {
+    copy_accessor<glm::vec4>(asset, *accessors[1], rotations.data());
+  }
+  if (accessors[2]) {
+    copy_accessor<glm::vec3>(asset, *accessors[2], scales.data());
+  }
+  out->reserve(out->size() + count);
+  for (size_t i = 0; i < count; ++i) {
+    const auto& r = rotations[i];
+    out->push_back(glm::translate(glm::mat4(1.f), translations[i]) *
+                   glm::toMat4(glm::quat(r.w, r.x, r.y, r.z)) *
+                   glm::scale(glm::mat4(1.f), scales[i]));
+  }
+  return true;
+}
+
 }
 
 GLTFLoader::GLTFLoader(Engine* engine)
@@ -66,6 +242,15 @@ GLTFLoader::GLTFLoader(Engine* engine)
 {
 
   tangent_loader_ = std::make_unique<OGLDevTangentLoader>();
+  texture_support_ = TextureTranscoder::Support::Query(engine_->Device);
+  for (size_t i = 0; i < mesh_pools_.size(); ++i) {
+    const auto format = static_cast<VertexFormat>(i / 2);
+    mesh_pools_[i] = std::make_unique<MeshPool>(
+      engine_->Device,
+      VertexFormatStride(format),
+      i % 2 ? SDL_GPU_INDEXELEMENTSIZE_32BIT : SDL_GPU_INDEXELEMENTSIZE_16BIT);
+  }
+  meshlet_pool_ = std::make_unique<MeshletPool>(engine_->Device);
 
   if (!CreatePipelines()) {
     LOG_ERROR("Couldn't create default sampler");
@@ -90,14 +275,19 @@ GLTFLoader::GLTFLoader(Engine* engine, SDL_GPUTextureFormat framebuffer_format)
 }
 
 bool
-GLTFLoader::IsInitialized()
+GLTFLoader::IsInitialized() const
 {
+  for (const auto& pipelines : pipelines_) {
+    if (!pipelines.Opaque || !pipelines.Transparent) {
+      return false;
+    }
+  }
   // clang-format off
   return (
     engine_ != nullptr &&
     tangent_loader_ != nullptr &&
-    opaque_pipeline_ != nullptr &&
-    transparent_pipeline_ != nullptr &&
+    mesh_pools_[0] != nullptr &&
+    meshlet_pool_ != nullptr &&
     default_sampler_ != nullptr &&
     default_texture_ != nullptr &&
     default_material_ != nullptr
@@ -115,16 +305,36 @@ GLTFLoader::Release()
 {
   LOG_TRACE("GLTFLoader::Release");
 
+  // Released scenes' mesh and texture tasks use the loader until they return
+  {
+    std::lock_guard lock{ detached_mutex_ };
+    for (auto& task : detached_tasks_) {
+      engine_->Workers().Wait(task);
+    }
+    detached_tasks_.clear();
+  }
+
   auto Device = engine_->Device;
-  RELEASE_IF(transparent_pipeline_, SDL_ReleaseGPUGraphicsPipeline);
-  RELEASE_IF(opaque_pipeline_, SDL_ReleaseGPUGraphicsPipeline);
+  for (auto& pipelines : pipelines_) {
+    RELEASE_IF(pipelines.Transparent, SDL_ReleaseGPUGraphicsPipeline);
+    RELEASE_IF(pipelines.Opaque, SDL_ReleaseGPUGraphicsPipeline);
+  }
   RELEASE_IF(default_sampler_, SDL_ReleaseGPUSampler)
+  if (mesh_pools_[0]) {
+    // Released scenes still have mesh ranges queued for freeing in the pools
+    SDL_WaitForGPUIdle(Device);
+    engine_->Deletions().Flush();
+    for (auto& pool : mesh_pools_) {
+      pool->Release();
+    }
+    meshlet_pool_->Release();
+  }
 
   LOG_DEBUG("Released GLTFLoader resources");
 }
 
 UniquePtr<GLTFScene>
-GLTFLoader::Load(const std::filesystem::path& path)
+GLTFLoader::Load(const std::filesystem::path& path) const
 {
   LOG_TRACE("GLTFLoader::Load");
   if (!std::filesystem::exists(path)) {
@@ -137,21 +347,28 @@ GLTFLoader::Load(const std::filesystem::path& path)
     return nullptr;
   }
 
-  if (!Parse(path)) {
+  auto ctx = MakeShared<LoadContext>(); // texture tasks may outlive the load
+  if (!parse_gltf(path, &ctx->Asset, &ctx->Files, &ctx->BufferPaths)) {
     LOG_ERROR("Coudln't parse asset `{}`", path.c_str())
     return nullptr;
   }
 
   UniquePtr<GLTFScene> ret = MakeUnique<GLTFScene>(path, this);
 
-  if (!LoadResources(ret.get())) {
+  if (!LoadResources(*ctx, ret.get())) {
     return nullptr;
   }
   return ret;
 }
 
+std::future<UniquePtr<GLTFScene>>
+GLTFLoader::LoadAsync(const std::filesystem::path& path) const
+{
+  return engine_->Workers().Submit([this, path]() { return Load(path); });
+}
+
 bool
-GLTFLoader::Load(GLTFScene* scene, std::filesystem::path& path)
+GLTFLoader::Load(GLTFScene* scene, std::filesystem::path& path) const
 {
   LOG_TRACE("GLTFLoader::Load");
   if (!std::filesystem::exists(path)) {
@@ -159,87 +376,97 @@ GLTFLoader::Load(GLTFScene* scene, std::filesystem::path& path)
     return false;
   }
 
-  if (!transparent_pipeline_ || !opaque_pipeline_) {
-    LOG_ERROR("Default pipelines aren't initalized");
-    return false;
-  }
-
-  if (!CreateDefaultSampler()) {
-    LOG_ERROR("Couldn't create default sampler");
-    return false;
-  }
-  if (!CreateDefaultTexture()) {
-    LOG_ERROR("Couldn't create default texture");
+  // Defaults are shared by every load, created once by the constructor
+  if (!IsInitialized()) {
+    LOG_ERROR("Loader isn't initalized");
     return false;
   }
 
-  if (!Parse(path)) {
+  auto ctx = MakeShared<LoadContext>();
+  if (!parse_gltf(path, &ctx->Asset, &ctx->Files, &ctx->BufferPaths)) {
     LOG_ERROR("Coudln't parse asset `{}`", path.c_str())
     return false;
   }
 
   scene->Path = path;
   scene->loader_ = this;
-  return LoadResources(scene);
+  return LoadResources(*ctx, scene);
 }
 
 bool
-GLTFLoader::Parse(const std::filesystem::path& path)
+GLTFLoader::LoadResources(LoadContext& ctx, GLTFScene* ret) const
 {
-  auto data = fastgltf::GltfDataBuffer::FromPath(path);
-  if (data.error() != fastgltf::Error::None) {
-    LOG_ERROR("couldn't load gltf from path");
-    return false;
-  }
-
-  constexpr auto gltfOptions = fastgltf::Options::LoadExternalBuffers;
-
-  fastgltf::Parser parser{};
-
-  auto asset = parser.loadGltf(data.get(), path.parent_path(), gltfOptions);
-  if (auto error = asset.error(); error != fastgltf::Error::None) {
-    LOG_ERROR("couldn't parse binary gltf");
-    return false;
+  // Meshes and textures are baked or decoded on the workers and queued, the
+  // engine drains them a bit every frame. GLTFScene::Update() publishes them
+  // and the scene becomes Resident() once everything landed
+  auto& uploads = engine_->Uploads();
+  ctx.Ticket = uploads.CreateTicket();
+  ctx.MemoryScope = ret->Path.filename().string();
+  bool loaded = LoadResourcesImpl(ctx, ret);
+  uploads.Seal(ctx.Ticket);
+  if (loaded && !streaming_) {
+    for (auto& task : ret->mesh_tasks_) {
+      engine_->Workers().Wait(task);
+    }
+    ret->mesh_tasks_.clear();
+    for (auto& task : ret->texture_tasks_) {
+      engine_->Workers().Wait(task);
+    }
+    ret->texture_tasks_.clear();
   }
+  LOG_DEBUG("GLTFLoader: Queued {} bytes of uploads",
+            ctx.Ticket.PendingBytes());
 
-  if (auto error = fastgltf::validate(asset.get());
-      error != fastgltf::Error::None) {
-    LOG_ERROR("couldn't validate gltf");
-    return false;
+  ret->uploads_ = std::move(ctx.Ticket);
+  ret->loaded_ = true;
+  if (!loaded) {
+    ret->Release(); // including what's already queued or decoding
   }
-
-  asset_ = std::move(asset.get());
-  return true;
+  return loaded;
 }
 
 bool
-GLTFLoader::LoadResources(GLTFScene* ret)
+GLTFLoader::LoadResourcesImpl(LoadContext& ctx, GLTFScene* ret) const
 {
-  if (!LoadSamplers(ret)) {
+  if (!LoadSamplers(ctx, ret)) {
     LOG_ERROR("Couldn't load samplers from GLTF");
     return false;
   }
   LOG_DEBUG("GLTFLoader: Loaded {} Samplers", ret->samplers_.size());
 
-  // if (!LoadImageData(ret)) {
-  //   LOG_ERROR("Couldn't load images from GLTF");
-  //   return false;
-  // }
-  ret->textures_ = std::vector<SDL_GPUTexture*>{ asset_.textures.size() };
-
-  if (!LoadMaterials(ret)) {
+  if (!LoadMaterials(ctx, ret)) {
     LOG_ERROR("Couldn't load materials from GLTF");
     return false;
   }
   LOG_DEBUG("GLTFLoader: Loaded {} Materials", ret->materials_.size());
 
-  if (!LoadVertexData(ret)) {
-    LOG_ERROR("Couldn't load vertex data from GLTF");
-    return false;
+  // Cached geometry skips the accessor reads and tangent generation, it's
+  // uploaded in place and the cache entry lives until the uploads are
+  // recorded. Otherwise each mesh is baked by its own task and shows up once
+  // it landed, the hierarchy only needs the mesh indices
+  MeshCache::View geometry{};
+  SharedPtr<MeshCache::Data> nodes{ nullptr }; // holds `geometry` when baking
+  const u32 bake_key = mesh_optimization_.Key();
+  if (use_mesh_cache_ &&
+      ctx.Cache->Open(ret->Path, bake_key, ctx.BufferPaths)) {
+    LOG_INFO("GLTFLoader: Using cached meshes for {}", ctx.MemoryScope);
+    geometry = ctx.Cache->Get();
+    if (!LoadVertexData(ret, geometry, ctx.Cache)) {
+      LOG_ERROR("Couldn't load vertex data from GLTF");
+      return false;
+    }
+    LOG_DEBUG("GLTFLoader: Loaded {} Meshes", ret->meshes_.size());
+  } else {
+    nodes = MakeShared<MeshCache::Data>();
+    if (!BakeNodes(ctx, nodes.get()) || !StreamMeshes(ctx, ret, nodes)) {
+      LOG_ERROR("Couldn't process meshes from GLTF");
+      return false;
+    }
+    geometry = nodes->Get();
+    LOG_DEBUG("GLTFLoader: Baking {} Meshes", ret->meshes_.size());
   }
-  LOG_DEBUG("GLTFLoader: Loaded {} Meshes", ret->meshes_.size());
 
-  if (!LoadNodes(ret)) {
+  if (!LoadNodes(ret, geometry)) {
     LOG_ERROR("Couldn't load nodes from GLTF");
     return false;
   }
@@ -247,156 +474,463 @@ GLTFLoader::LoadResources(GLTFScene* ret)
             ret->parent_nodes_.size(),
             ret->all_nodes_.size());
 
-  ret->loaded_ = true;
   return true;
 }
 
 bool
-GLTFLoader::LoadVertexData(GLTFScene* ret)
+GLTFLoader::BakeMesh(const LoadContext& ctx,
+                     size_t mesh_index,
+                     MeshCache::Data* out) const
 {
-  LOG_TRACE("GLTFLoader::LoadVertexData");
-  if (asset_.meshes.empty()) {
-    LOG_WARN("LoadVertexData: GLTF has no meshes");
-    return false;
-  }
-  // construct our Mesh vector at the same time we fill vertices and indices
-  // buffers
-  ret->meshes_ = std::vector<MeshAsset>{};
-  ret->meshes_.reserve(asset_.meshes.size());
+  LOG_TRACE("GLTFLoader::BakeMesh");
+  const auto& mesh = ctx.Asset.meshes[mesh_index];
   std::vector<PosNormalTangentColorUvVertex> vertices;
   std::vector<u32> indices;
 
-  for (auto& mesh : asset_.meshes) {
-    MeshAsset newMesh;
-    newMesh.Name = mesh.name.c_str();
-    vertices.clear();
-    indices.clear();
-    bool need_tangents{ false };
-
-    for (auto&& p : mesh.primitives) {
-      Geometry newGeometry{
-        .FirstIndex = indices.size(),
-        .VertexCount = (u32)asset_.accessors[p.indicesAccessor.value()].count
-      };
-
-      size_t initial_vtx = vertices.size();
+  BakedMesh newMesh{};
+  newMesh.FirstSubmesh = out->Submeshes.size();
+  newMesh.NameOffset = out->Names.size();
+  newMesh.NameLength = mesh.name.size();
+  out->Names.append(mesh.name.c_str(), mesh.name.size());
+  bool need_tangents{ false };
 
-      { // load indexes
-        fastgltf::Accessor& indexaccessor =
-          asset_.accessors[p.indicesAccessor.value()];
-        indices.reserve(indices.size() + indexaccessor.count);
+  for (auto&& p : mesh.primitives) {
+    BakedSubmesh newGeometry{};
+    {
+      newGeometry.FirstIndex = indices.size();
+      newGeometry.IndexCount =
+        (u32)ctx.Asset.accessors[p.indicesAccessor.value()].count;
+      newGeometry.MaterialIndex = -1;
+    }
 
-        fastgltf::iterateAccessor<std::uint32_t>(
-          asset_, indexaccessor, [&](std::uint32_t idx) {
-            indices.push_back(idx + initial_vtx);
-          });
+    // Every attribute is decoded once, straight into its interleaved field
+    using Vertex = PosNormalTangentColorUvVertex;
+    const size_t initial_vtx = vertices.size();
+    const auto& positions =
+      ctx.Asset.accessors[p.findAttribute("POSITION")->accessorIndex];
+    vertices.resize(initial_vtx + positions.count);
+    Vertex* first = vertices.data() + initial_vtx;
+    copy_accessor<glm::vec3, sizeof(Vertex)>(
+      ctx.Asset, positions, &first->pos);
+
+    // Attributes not matching the positions are broken, they're skipped
+    auto find = [&](const char* name) -> const fastgltf::Accessor* {
+      auto attr = p.findAttribute(name);
+      if (attr == p.attributes.end()) {
+        return nullptr;
       }
-
-      { // load positions
-        fastgltf::Accessor& posAccessor =
-          asset_.accessors[p.findAttribute("POSITION")->accessorIndex];
-        vertices.resize(vertices.size() + posAccessor.count);
-
-        fastgltf::iterateAccessorWithIndex<glm::vec3>(
-          asset_, posAccessor, [&](glm::vec3 v, size_t index) {
-            vertices[initial_vtx + index].pos = v;
-          });
+      const auto& accessor = ctx.Asset.accessors[attr->accessorIndex];
+      if (accessor.count != positions.count) {
+        LOG_WARN("Mesh {}: {} doesn't match POSITION", mesh.name, name);
+        return nullptr;
       }
+      return &accessor;
+    };
+    if (const auto* normals = find("NORMAL")) {
+      copy_accessor<glm::vec3, sizeof(Vertex)>(
+        ctx.Asset, *normals, &first->normal);
+    }
+    if (const auto* colors = find("COLOR_0")) {
+      copy_accessor<glm::vec4, sizeof(Vertex)>(
+        ctx.Asset, *colors, &first->color);
+    }
+    if (const auto* uvs = find("TEXCOORD_0")) {
+      copy_accessor<glm::vec2, sizeof(Vertex)>(ctx.Asset, *uvs, &first->uv);
+    }
 
-      { // load normals:
-        auto attr = p.findAttribute("NORMAL");
-        if (attr != p.attributes.end()) {
-          fastgltf::iterateAccessorWithIndex<glm::vec3>(
-            asset_,
-            asset_.accessors[attr->accessorIndex],
-            [&](glm::vec3 v, size_t index) {
-              vertices[initial_vtx + index].normal = v;
-            });
+    { // indices, relative to the mesh's vertices like its meshlets and LODs
+      const auto& accessor = ctx.Asset.accessors[p.indicesAccessor.value()];
+      const size_t first_index = indices.size();
+      indices.resize(first_index + accessor.count);
+      copy_accessor<u32>(ctx.Asset, accessor, &indices[first_index]);
+      if (initial_vtx != 0) {
+        for (size_t i = first_index; i < indices.size(); ++i) {
+          indices[i] += static_cast<u32>(initial_vtx);
         }
       }
+    }
 
-      { // load color:
-        auto attr = p.findAttribute("COLOR_0");
-        if (attr != p.attributes.end()) {
-          fastgltf::iterateAccessorWithIndex<glm::vec4>(
-            asset_,
-            asset_.accessors[attr->accessorIndex],
-            [&](glm::vec4 v, size_t index) {
-              vertices[initial_vtx + index].color = v;
-            });
+    { // material, only normal mapped ones need tangents
+      if (p.materialIndex.has_value() &&
+          p.materialIndex.value() < ctx.Asset.materials.size()) {
+        newGeometry.MaterialIndex = (i32)p.materialIndex.value();
+        const auto& mat = ctx.Asset.materials[p.materialIndex.value()];
+        if (!need_tangents) {
+          need_tangents = mat.normalTexture.has_value();
         }
       }
+    }
 
-      { // load UVs
-        auto attr = p.findAttribute("TEXCOORD_0");
-        if (attr != p.attributes.end()) {
-          fastgltf::iterateAccessorWithIndex<glm::vec2>(
-            asset_,
-            asset_.accessors[attr->accessorIndex],
-            [&](glm::vec2 v, size_t index) {
-              vertices[initial_vtx + index].uv = v;
-            });
-        }
+    if (const auto* tangents = find("TANGENT")) {
+      copy_accessor<glm::vec4, sizeof(Vertex)>(
+        ctx.Asset, *tangents, &first->tangent);
+      LOG_INFO("Found tangents attribute for mesh {}", mesh.name.c_str());
+      need_tangents = false;
+    }
+
+    out->Submeshes.push_back(newGeometry);
+    LOG_DEBUG("New geometry. Total Verts: {}, Total Indices: {}",
+              vertices.size(),
+              indices.size());
+  }
+
+  // Lazy pre-compute tangents only if necessary:
+  // Iterate all vertices after they're all loaded
+  if (need_tangents) {
+    LOG_INFO("Computing tangents for mesh {}", mesh.name.c_str());
+    CPUMeshBuffers buffers{};
+    {
+      buffers.IndexBuffer = &indices;
+      buffers.VertexBuffer = &vertices;
+    }
+    tangent_loader_->Load(&buffers);
+  }
+
+  { // after tangents, so that welding compares them too
+    std::vector<MeshOptimizer::IndexRange> ranges{};
+    for (u32 i = newMesh.FirstSubmesh; i < out->Submeshes.size(); ++i) {
+      ranges.push_back(
+        { out->Submeshes[i].FirstIndex, out->Submeshes[i].IndexCount });
+    }
+    const auto stats = MeshOptimizer::Optimize(
+      mesh_optimization_, &vertices, &indices, ranges);
+    for (size_t i = 1; i < stats.size(); ++i) {
+      LOG_DEBUG("Optimizing mesh {}, {}: ACMR {:.3f} -> {:.3f}, {} -> {} "
+                "vertices",
+                mesh.name.c_str(),
+                stats[i].Step,
+                stats[i - 1].Acmr,
+                stats[i].Acmr,
+                stats[i - 1].VertexCount,
+                stats[i].VertexCount);
+    }
+
+    // Meshlets reorder triangles within their submesh
+    const size_t first_meshlet = out->Meshlets.size();
+    for (u32 i = newMesh.FirstSubmesh; i < out->Submeshes.size(); ++i) {
+      auto& sub = out->Submeshes[i];
+      auto meshlets =
+        MeshOptimizer::BuildMeshlets(mesh_optimization_,
+                                     vertices,
+                                     &indices,
+                                     ranges[i - newMesh.FirstSubmesh]);
+      sub.FirstMeshlet = out->Meshlets.size();
+      sub.MeshletCount = meshlets.size();
+      for (const auto& m : meshlets) {
+        out->Meshlets.push_back({ m.Center,
+                                  m.Radius,
+                                  m.ConeAxis,
+                                  m.ConeCutoff,
+                                  m.First,
+                                  m.Count,
+                                  { 0, 0 } });
       }
+    }
+    LOG_DEBUG("Mesh {}: {} meshlets",
+              mesh.name.c_str(),
+              out->Meshlets.size() - first_meshlet);
+
+    // LODs are appended to the mesh's indices, after every submesh
+    for (u32 i = newMesh.FirstSubmesh; i < out->Submeshes.size(); ++i) {
+      auto& sub = out->Submeshes[i];
+      auto lods = MeshOptimizer::BuildLods(mesh_optimization_,
+                                           vertices,
+                                           &indices,
+                                           ranges[i - newMesh.FirstSubmesh]);
+      sub.FirstLod = out->Lods.size();
+      sub.LodCount = lods.size();
+      for (const auto& lod : lods) {
+        out->Lods.push_back({ lod.First, lod.Count, lod.Error, 0 });
+        LOG_DEBUG("Mesh {} LOD {}: {} triangles, error {}",
+                  mesh.name.c_str(),
+                  out->Lods.size() - sub.FirstLod,
+                  lod.Count / 3,
+                  lod.Error);
+      }
+    }
+  }
 
-      { // material:
-        if (p.materialIndex.has_value()) {
-          auto& mat = ret->materials_[p.materialIndex.value()];
-          newGeometry.material = mat->Build();
-          if (!need_tangents) {
-            need_tangents = (mat->FeatureFlags & HAS_NORMAL_TEX);
-          }
-        } else {
-          // TODO: pre-build default material once
-          newGeometry.material = ret->materials_[0]->Build();
-        }
-        if (newGeometry.material->Opacity == MaterialOpacity::Opaque) {
-          newGeometry.material->Pipeline = opaque_pipeline_;
-        } else {
-          newGeometry.material->Pipeline = transparent_pipeline_;
+  if (!vertices.empty()) {
+    newMesh.BoundsMin = newMesh.BoundsMax = vertices[0].pos;
+  }
+  for (const auto& v : vertices) {
+    newMesh.BoundsMin = glm::min(newMesh.BoundsMin, v.pos);
+    newMesh.BoundsMax = glm::max(newMesh.BoundsMax, v.pos);
+  }
+
+  // Smallest vertex format and index size that hold the mesh
+  const auto format = VertexPacker::Choose(vertices);
+  const bool short_indices = vertices.size() < MaxVerticesForU16Indices;
+  newMesh.Format = static_cast<u32>(format);
+  newMesh.IndexSize = short_indices ? sizeof(u16) : sizeof(u32);
+  newMesh.VertexOffset = out->Vertices.size();
+  newMesh.VertexCount = vertices.size();
+  newMesh.IndexOffset = out->Indices.size();
+  newMesh.IndexCount = indices.size();
+  newMesh.SubmeshCount = out->Submeshes.size() - newMesh.FirstSubmesh;
+  VertexPacker::Pack(
+    vertices,
+    format,
+    VertexQuantization::FromBounds(newMesh.BoundsMin, newMesh.BoundsMax),
+    &out->Vertices);
+  if (short_indices) {
+    const size_t begin = out->Indices.size();
+    out->Indices.resize(begin + indices.size() * sizeof(u16));
+    for (size_t i = 0; i < indices.size(); ++i) {
+      const u16 idx = static_cast<u16>(indices[i]);
+      std::memcpy(&out->Indices[begin + i * sizeof(u16)], &idx, sizeof(u16));
+    }
+  } else {
+    const auto* bytes = reinterpret_cast<const u8*>(indices.data());
+    out->Indices.insert(
+      out->Indices.end(), bytes, bytes + indices.size() * sizeof(u32));
+  }
+  out->Meshes.push_back(newMesh);
+  return true;
+}
+
+bool
+GLTFLoader::StreamMeshes(const LoadContext& ctx,
+                         GLTFScene* ret,
+                         SharedPtr<const MeshCache::Data> nodes) const
+{
+  LOG_TRACE("GLTFLoader::StreamMeshes");
+  const size_t count = ctx.Asset.meshes.size();
+  if (count == 0) {
+    LOG_WARN("StreamMeshes: GLTF has no meshes");
+    return false;
+  }
+  // Placeholders the nodes point to, filled by GLTFScene::Update
+  ret->meshes_ = std::vector<MeshAsset>(count);
+  auto& uploads = engine_->Uploads();
+  ret->mesh_uploads_.reserve(count);
+  for (auto& mesh : ret->meshes_) {
+    mesh.Visible = false;
+    ret->mesh_uploads_.push_back(uploads.CreateTicket());
+  }
+
+  // Every mesh is kept until the last task writes them to the mesh cache
+  struct Bake
+  {
+    std::mutex Mutex;
+    std::vector<SharedPtr<const MeshCache::Data>> Meshes;
+    size_t Pending{ 0 };
+  };
+  auto bake = MakeShared<Bake>();
+  bake->Meshes.resize(count);
+  bake->Pending = count;
+
+  // The tasks keep the parsed asset alive, baking reads its buffers
+  auto& workers = engine_->Workers();
+  auto keep = ctx.shared_from_this();
+  auto stream = ret->mesh_stream_;
+  const auto path = ret->Path;
+  const u32 bake_key = mesh_optimization_.Key();
+  ret->mesh_tasks_.reserve(count);
+  for (u32 i = 0; i < count; ++i) {
+    const auto ticket = ret->mesh_uploads_[i];
+    auto task = [this, keep, stream, bake, nodes, path, bake_key, ticket, i]() {
+      GLTFScene::StreamedMesh streamed{ .Index = i };
+      auto baked = MakeShared<MeshCache::Data>();
+      bool created{ false };
+      if (!stream->Cancelled && BakeMesh(*keep, i, baked.get())) {
+        created = CreateMesh(
+          baked->Get(), baked->Meshes[0], ticket, baked, &streamed.Mesh);
+      }
+      if (!created && !stream->Cancelled) {
+        LOG_ERROR("Couldn't bake mesh {}, it's left out", i);
+      }
+      bool published{ false };
+      {
+        std::lock_guard lock{ stream->Mutex };
+        if (!stream->Cancelled) {
+          stream->Arrived.push_back(std::move(streamed));
+          published = true;
         }
       }
+      if (published) {
+        // Only now, Update() shows the mesh once its ticket is ready
+        engine_->Uploads().Seal(ticket);
+      } else {
+        // The scene was released while this ran, nothing will draw it
+        ticket.Cancel();
+        DropMesh(streamed.Mesh);
+      }
 
-      { // tangents:
-        auto attr = p.findAttribute("TANGENT");
-        if (attr != p.attributes.end()) {
-          fastgltf::iterateAccessorWithIndex<glm::vec4>(
-            asset_,
-            asset_.accessors[attr->accessorIndex],
-            [&](glm::vec4 v, size_t index) {
-              vertices[initial_vtx + index].tangent = v;
-            });
-          LOG_INFO("Found tangents attribute for mesh {}", mesh.name.c_str());
-          need_tangents = false;
+      if (!use_mesh_cache_) {
+        return;
+      }
+      std::lock_guard lock{ bake->Mutex };
+      bake->Meshes[i] = created ? baked : nullptr;
+      if (--bake->Pending > 0) {
+        return;
+      }
+      MeshCache::Data data{};
+      for (const auto& mesh : bake->Meshes) {
+        if (!mesh) {
+          return; // some were skipped or failed, the next load bakes again
         }
+        data.Append(*mesh);
+      }
+      data.Nodes = nodes->Nodes;
+      data.Children = nodes->Children;
+      data.Instances = nodes->Instances;
+      if (!keep->Cache->Write(path, data, bake_key, keep->BufferPaths)) {
+        LOG_WARN("GLTFLoader: Couldn't cache meshes of {}", keep->MemoryScope);
       }
+    };
+    ret->mesh_tasks_.push_back(workers.Submit(std::move(task)));
+  }
+  ret->meshes_pending_ = count;
+  LOG_DEBUG("Baking {} meshes on {} workers", count, workers.Size());
+  return true;
+}
 
-      newMesh.Submeshes.push_back(newGeometry);
-      LOG_DEBUG("New geometry. Total Verts: {}, Total Indices: {}",
-                vertices.size(),
-                indices.size());
+bool
+GLTFLoader::CreateMesh(const MeshCache::View& baked,
+                       const BakedMesh& mesh,
+                       const UploadTicket& ticket,
+                       const SharedPtr<const void>& owner,
+                       MeshAsset* out) const
+{
+  MeshAsset& newMesh = *out;
+  newMesh.Name = std::string{ baked.Name(mesh) };
+  newMesh.BoundsMin = mesh.BoundsMin;
+  newMesh.BoundsMax = mesh.BoundsMax;
+  newMesh.Format = mesh.Layout();
+  newMesh.Quantization =
+    VertexQuantization::FromBounds(mesh.BoundsMin, mesh.BoundsMax);
+  newMesh.Visible = false; // see GLTFScene::Update
+
+  std::vector<MeshletBinding> meshlets{};
+  for (const auto& sub :
+       baked.Submeshes.subspan(mesh.FirstSubmesh, mesh.SubmeshCount)) {
+    Geometry newGeometry{ .FirstIndex = sub.FirstIndex,
+                          .VertexCount = sub.IndexCount };
+    for (const auto& lod : baked.Lods.subspan(sub.FirstLod, sub.LodCount)) {
+      newGeometry.Lods.push_back(
+        GeometryLod{ lod.FirstIndex, lod.IndexCount, lod.Error });
     }
-
-    // Lazy pre-compute tangents only if necessary:
-    // Iterate all vertices after they're all loaded
-    if (need_tangents) {
-      LOG_INFO("Computing tangents for mesh {}", mesh.name.c_str());
-      CPUMeshBuffers buffers{};
+    // Checked against the scene's materials by BuildMaterials()
+    newGeometry.MaterialIndex =
+      sub.MaterialIndex >= 0 ? static_cast<u32>(sub.MaterialIndex) : 0;
+    newGeometry.FirstMeshlet = meshlets.size();
+    newGeometry.MeshletCount = sub.MeshletCount;
+    for (const auto& m :
+         baked.Meshlets.subspan(sub.FirstMeshlet, sub.MeshletCount)) {
+      MeshletBinding binding{};
       {
-        buffers.IndexBuffer = &indices;
-        buffers.VertexBuffer = &vertices;
+        binding.sphere = glm::vec4{ m.Center, m.Radius };
+        binding.cone = glm::vec4{ m.ConeAxis, m.ConeCutoff };
+        binding.first_index = m.FirstIndex; // rebased once allocated
+        binding.index_count = m.IndexCount;
       }
-      tangent_loader_->Load(&buffers);
-    }
-    if (!engine_->CreateAndUploadMeshBuffers(&newMesh.Buffers,
-                                             vertices.data(),
-                                             vertices.size(),
-                                             indices.data(),
-                                             indices.size())) {
-      LOG_ERROR("Couldn't upload mesh data");
+      meshlets.push_back(binding);
+    }
+    newMesh.Submeshes.push_back(newGeometry);
+  }
+
+  auto* pool = MeshPoolFor(newMesh.Format,
+                           mesh.IndexSize == sizeof(u16)
+                             ? SDL_GPU_INDEXELEMENTSIZE_16BIT
+                             : SDL_GPU_INDEXELEMENTSIZE_32BIT);
+  if (!pool->Allocate(mesh.VertexCount, mesh.IndexCount, &newMesh.Buffers)) {
+    LOG_ERROR("Couldn't allocate mesh data");
+    return false;
+  }
+
+  // Meshlet indices are absolute, like the pool's own ranges
+  for (auto& binding : meshlets) {
+    binding.first_index += newMesh.Buffers.FirstIndex;
+    binding.vertex_offset = newMesh.Buffers.VertexOffset;
+  }
+  auto& uploads = engine_->Uploads();
+  if (!meshlet_pool_->Upload(uploads, ticket, meshlets, &newMesh.Meshlets)) {
+    // Without meshlets, the mesh is drawn whole
+    LOG_WARN("Couldn't upload meshlets of mesh {}", newMesh.Name);
+    for (auto& geometry : newMesh.Submeshes) {
+      geometry.MeshletCount = 0;
+    }
+  }
+  for (auto& geometry : newMesh.Submeshes) {
+    geometry.FirstMeshlet += newMesh.Meshlets.First;
+  }
+
+  if (!pool->Enqueue(uploads,
+                     ticket,
+                     newMesh.Buffers,
+                     baked.MeshVertices(mesh),
+                     baked.MeshIndices(mesh),
+                     owner)) {
+    LOG_ERROR("Couldn't upload mesh data");
+    ticket.Cancel(); // the meshlets may be queued already
+    DropMesh(newMesh);
+    *out = MeshAsset{};
+    out->Visible = false;
+    return false;
+  }
+  return true;
+}
+
+void
+GLTFLoader::BuildMaterials(const GLTFScene& scene, MeshAsset* mesh) const
+{
+  const auto& pipelines = pipelines_[size_t(mesh->Format)];
+  for (auto& geometry : mesh->Submeshes) {
+    if (geometry.MaterialIndex >= scene.materials_.size()) {
+      // TODO: pre-build default material once
+      geometry.MaterialIndex = 0;
+    }
+    geometry.material = scene.materials_[geometry.MaterialIndex]->Build();
+    if (geometry.material->Opacity == MaterialOpacity::Opaque) {
+      geometry.material->Pipeline = pipelines.Opaque;
+    } else {
+      geometry.material->Pipeline = pipelines.Transparent;
+    }
+  }
+}
+
+void
+GLTFLoader::DropMesh(const MeshAsset& mesh) const
+{
+  if (mesh.Buffers.VertexBuffer == nullptr) {
+    return; // never created
+  }
+  // Earlier frames may still draw it, the ranges are freed once they're done
+  MeshPool* pool = MeshPoolFor(mesh.Format, mesh.Buffers.IndexSize);
+  MeshletPool* meshlet_pool = meshlet_pool_.get();
+  engine_->Deletions().Push(
+    [pool, meshlet_pool, buffers = mesh.Buffers, meshlets = mesh.Meshlets] {
+      pool->Free(buffers);
+      meshlet_pool->Free(meshlets);
+    });
+}
+
+bool
+GLTFLoader::LoadVertexData(GLTFScene* ret,
+                           const MeshCache::View& baked,
+                           const SharedPtr<const void>& owner) const
+{
+  LOG_TRACE("GLTFLoader::LoadVertexData");
+  if (baked.Meshes.empty()) {
+    LOG_WARN("LoadVertexData: GLTF has no meshes");
+    return false;
+  }
+  // One ticket per mesh, each is drawn as soon as its own data landed
+  auto& uploads = engine_->Uploads();
+  ret->meshes_ = std::vector<MeshAsset>(baked.Meshes.size());
+  ret->mesh_uploads_.reserve(baked.Meshes.size());
+  for (size_t i = 0; i < baked.Meshes.size(); ++i) {
+    auto& newMesh = ret->meshes_[i];
+    auto ticket = uploads.CreateTicket();
+    ret->mesh_uploads_.push_back(ticket);
+    const bool created =
+      CreateMesh(baked, baked.Meshes[i], ticket, owner, &newMesh);
+    uploads.Seal(ticket);
+    if (!created) {
       return false;
     }
-    ret->meshes_.emplace_back(newMesh);
+    BuildMaterials(*ret, &newMesh);
   }
   return true;
 }
@@ -409,29 +943,13 @@ GLTFLoader::LoadPositions(const std::filesystem::path& path,
 {
   LOG_TRACE("GLTFLoader::LoadPositions");
 
-  auto data = fastgltf::GltfDataBuffer::FromPath(path);
-  if (data.error() != fastgltf::Error::None) {
-    LOG_ERROR("couldn't load gltf from path");
-    return false;
-  }
-
-  constexpr auto gltfOptions = fastgltf::Options::LoadExternalBuffers;
-  fastgltf::Parser parser{};
-
-  auto expected_asset =
-    parser.loadGltf(data.get(), path.parent_path(), gltfOptions);
-  if (auto error = expected_asset.error(); error != fastgltf::Error::None) {
-    LOG_ERROR("couldn't parse binary gltf");
+  MappedFiles files; // must outlive asset
+  std::vector<std::filesystem::path> buffer_paths;
+  fastgltf::Asset asset;
+  if (!parse_gltf(path, &asset, &files, &buffer_paths)) {
     return false;
   }
 
-  if (auto error = fastgltf::validate(expected_asset.get());
-      error != fastgltf::Error::None) {
-    LOG_ERROR("couldn't validate gltf");
-    return false;
-  }
-  auto& asset = expected_asset.get();
-
   if (asset.meshes.empty()) {
     LOG_WARN("LoadVertexData: GLTF has no meshes");
     return false;
@@ -475,127 +993,354 @@ GLTFLoader::LoadPositions(const std::filesystem::path& path,
   return true;
 }
 
+std::vector<u8>
+GLTFLoader::ReadImage(const LoadContext& ctx,
+                      const std::filesystem::path& parent_path,
+                      const fastgltf::Image& img) const
+{
+  std::vector<u8> ret{};
+  // clang-format off
+  std::visit(fastgltf::visitor{
+      []([[maybe_unused]] const auto& arg) { LOG_WARN("No URI source"); },
+      [&](const fastgltf::sources::URI& file_path) {
+        assert(file_path.fileByteOffset == 0);
+        assert(file_path.uri.isLocalPath());
+        const auto path = parent_path / file_path.uri.fspath();
+        size_t size{ 0 };
+        void* data = SDL_LoadFile(path.string().c_str(), &size);
+        if (!data) {
+          LOG_WARN("Couldn't load image {}: {}", path.string(), GETERR);
+          return;
+        }
+        ret.assign((const u8*)data, (const u8*)data + size);
+        SDL_free(data);
+      },
+      [&](const fastgltf::sources::Vector& vec) {
+        ret.assign((const u8*)vec.bytes.data(),
+                   (const u8*)vec.bytes.data() + vec.bytes.size());
+      },
+      [&](const fastgltf::sources::BufferView& view) {
+        const auto& buffer_view = ctx.Asset.bufferViews[view.bufferViewIndex];
+        auto bytes = buffer_bytes(ctx.Asset.buffers[buffer_view.bufferIndex]);
+        if (buffer_view.byteOffset + buffer_view.byteLength > bytes.size()) {
+          LOG_ERROR("Couldn't load image from BufferView: buffer isn't loaded");
+          return;
+        }
+        const auto* data = (const u8*)(bytes.data() + buffer_view.byteOffset);
+        ret.assign(data, data + buffer_view.byteLength);
+      }
+    }, img.data);
+  // clang-format on
+  return ret;
+}
+
+std::vector<u8>
+GLTFLoader::ReadTexture(const LoadContext& ctx,
+                        const std::filesystem::path& parent_path,
+                        u64 texture_index,
+                        bool fallback) const
+{
+  if (texture_index >= ctx.Asset.textures.size()) {
+    return {};
+  }
+  auto& tex = ctx.Asset.textures[texture_index];
+  // KHR_texture_basisu images win, imageIndex is then a fallback for viewers
+  // without the extension
+  if (fallback && !tex.basisuImageIndex.has_value()) {
+    return {};
+  }
+  const decltype(tex.imageIndex) indices[] = { tex.basisuImageIndex,
+                                               tex.imageIndex };
+  for (size_t i = fallback ? 1 : 0; i < std::size(indices); ++i) {
+    const auto& index = indices[i];
+    if (!index.has_value() || *index >= ctx.Asset.images.size()) {
+      continue;
+    }
+    auto bytes = ReadImage(ctx, parent_path, ctx.Asset.images[*index]);
+    if (!bytes.empty()) {
+      return bytes;
+    }
+  }
+  return {};
+}
+
 bool
-GLTFLoader::LoadTexture(GLTFScene* ret, u64 texture_index, bool srgb)
+GLTFLoader::DecodeTexture(std::span<const u8> bytes,
+                          TextureRole role,
+                          bool srgb,
+                          DecodedTexture* out) const
 {
-  LOG_TRACE("GLTFLoader::LoadTexture");
+  LOG_TRACE("GLTFLoader::DecodeTexture");
 
-  if (texture_index >= asset_.textures.size()) {
+  if (!TextureTranscoder::IsKtx2(bytes)) {
+    return DecodeImage(bytes, role, srgb, out);
+  }
+  auto& compressed = out->Compressed;
+  if (!TextureTranscoder::Transcode(
+        bytes, role, srgb, texture_support_, &compressed)) {
     return false;
   }
-  auto& tex = asset_.textures[texture_index];
-  u64 img_idx = tex.imageIndex.value_or(std::numeric_limits<u64>::max());
-  if (img_idx >= asset_.images.size()) {
+  // A single RGBA8 level takes the regular path to get its mips
+  const bool rgba8 =
+    compressed.Format == SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM ||
+    compressed.Format == SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB;
+  if (rgba8 && compressed.Levels.size() == 1) {
+    out->Image.w = static_cast<i32>(compressed.Width);
+    out->Image.h = static_cast<i32>(compressed.Height);
+    out->Image.nrChannels = 4;
+    out->Image.image_type = ImageType::DIMENSIONS_2D;
+    out->Image.pixel_format = ImagePixelFormat::PIXELFORMAT_UINT;
+    out->Pixels = std::move(compressed.Levels[0]);
+    compressed = {};
+  }
+  return true;
+}
+
+bool
+GLTFLoader::DecodeImage(std::span<const u8> bytes,
+                        TextureRole role,
+                        bool srgb,
+                        DecodedTexture* out) const
+{
+  // Compressed before, the image isn't even decoded
+  const u64 cache_key =
+    compress_textures_
+      ? CompressedTextureCache::Key(bytes, role, srgb, texture_support_)
+      : 0;
+  if (compress_textures_ && texture_cache_.Load(cache_key, &out->Compressed)) {
+    return true;
+  }
+
+  auto& pixels = out->Pixels;
+  bool loaded = ImageLoader::LoadInto(out->Image,
+                                      bytes.data(),
+                                      static_cast<i32>(bytes.size()),
+                                      pixels_destination(pixels),
+                                      ImageType::DIMENSIONS_2D,
+                                      ImagePixelFormat::PIXELFORMAT_UINT);
+  if (!loaded || pixels.empty()) {
+    LOG_WARN("Couldn't decode image");
     return false;
   }
-  auto& img = asset_.images[img_idx];
-  LoadedImage imgData{};
-  { // load image data to CPU
-    std::visit(fastgltf::visitor{
-                 // clang-format off
-        []([[maybe_unused]] auto& arg) {LOG_WARN("No URI source");},
-        [&](fastgltf::sources::URI& filePath) {
-          LOG_DEBUG("Loading image from URI");
-          LoadImageFromURI(imgData, ret->Path.parent_path(), filePath);
-        },
-        [&](fastgltf::sources::Vector& vec) {
-          LOG_DEBUG("Loading image from Vector");
-          LoadImageFromVector(imgData,vec);
-        },
-        [&](fastgltf::sources::BufferView& view) {
-          const auto& bufferView = asset_.bufferViews[view.bufferViewIndex];
-          const auto& buffer = asset_.buffers[bufferView.bufferIndex];
-
-          LoadImageFromBufferView(imgData, bufferView, buffer);
-        }
-      }, img.data);
-    // clang-format on
+  if (!compress_textures_) {
+    return true;
   }
 
-  { // create GPU texture
-    SDL_GPUTexture* tex{ nullptr };
-    if (imgData.data) {
-      LOG_DEBUG("Creating texture");
-      tex = CreateAndUploadTexture(imgData, srgb);
-    }
-    if (!tex) {
-      LOG_WARN("Falling back to default textue");
-      tex = default_texture_;
-    }
-    ret->textures_[texture_index] = tex;
+  const u32 w = static_cast<u32>(out->Image.w);
+  const u32 h = static_cast<u32>(out->Image.h);
+  const auto format = TextureEncoder::FormatFor(
+    role, srgb, TextureEncoder::HasAlpha(pixels), w, h, texture_support_);
+  if (format == SDL_GPU_TEXTUREFORMAT_INVALID) {
+    return true; // stays RGBA8
+  }
+  // The whole chain is stored, uploads take the levels the sampler reads
+  auto& compressed = out->Compressed;
+  if (!TextureEncoder::EncodeChain(format,
+                                   std::move(pixels),
+                                   w,
+                                   h,
+                                   MipChain::LevelCount(w, h),
+                                   srgb,
+                                   &compressed)) {
+    return false;
   }
+  pixels.clear();
+  texture_cache_.Write(cache_key, compressed);
   return true;
 }
 
-void
-GLTFLoader::LoadImageFromURI(LoadedImage& img,
-                             std::filesystem::path parent_path,
-                             const fastgltf::sources::URI& URI)
+bool
+GLTFLoader::LoadTextures(const LoadContext& ctx,
+                         GLTFScene* ret,
+                         TextureMap* out) const
 {
-  LOG_TRACE("GLTFLoader::LoadImageFromURI");
-  assert(URI.fileByteOffset == 0);
-  assert(URI.uri.isLocalPath());
-
-  const auto p = URI.uri.fspath();
+  LOG_TRACE("GLTFLoader::LoadTextures");
+
+  // Unique (texture, srgb) pairs: a texture shared by several materials or
+  // slots is only decoded and uploaded once. KTX2 images are transcoded for
+  // their role, one bound in several roles keeps every channel
+  std::vector<TextureKey> keys;
+  std::vector<TextureRole> roles;
+  auto collect = [&](const auto& opt_tex_info, bool srgb, TextureRole role) {
+    if (opt_tex_info.has_value()) {
+      TextureKey key{ opt_tex_info.value().textureIndex, srgb };
+      if (out->emplace(key, static_cast<u32>(keys.size())).second) {
+        keys.push_back(key);
+        roles.push_back(role);
+        return;
+      }
+      auto i = std::find(keys.begin(), keys.end(), key) - keys.begin();
+      if (roles[i] != role) {
+        roles[i] = TextureRole::Color;
+      }
+    }
+  };
+  for (auto& mat : ctx.Asset.materials) {
+    collect(mat.pbrData.baseColorTexture, true, TextureRole::Color);
+    collect(mat.pbrData.metallicRoughnessTexture, false, TextureRole::Data);
+    collect(mat.normalTexture, false, TextureRole::Normal);
+    collect(mat.occlusionTexture, false, TextureRole::Data);
+    collect(mat.emissiveTexture, false, TextureRole::Data);
+  }
 
-  bool loaded = ImageLoader::Load(img,
-                                  parent_path / p,
-                                  ImageType::DIMENSIONS_2D,
-                                  ImagePixelFormat::PIXELFORMAT_UINT);
-  if (!loaded) {
-    LOG_WARN("Couldn't load image {}", p.c_str())
+  // Textures are decoded, created and queued on the workers, the scene binds
+  // them as they land (GLTFScene::Update). The tasks keep the parsed asset
+  // alive, the images may point into its buffers
+  auto& workers = engine_->Workers();
+  auto keep = ctx.shared_from_this();
+  auto stream = ret->texture_stream_;
+  const auto parent_path = ret->Path.parent_path();
+  ret->texture_tasks_.reserve(keys.size());
+  for (u32 i = 0; i < keys.size(); ++i) {
+    const auto key = keys[i];
+    const auto role = roles[i];
+    auto task = [this, keep, stream, parent_path, key, role, i]() {
+      GLTFScene::StreamedTexture streamed{ .Index = i };
+      SharedTextures::Entry entry{};
+      if (!stream->Cancelled &&
+          StreamTexture(*keep, parent_path, key, role, &entry)) {
+        streamed.Texture = entry.Texture;
+        streamed.Upload = std::move(entry.Upload);
+      } else if (!stream->Cancelled) {
+        LOG_WARN("Falling back to default texture for texture {}", key.first);
+      }
+      {
+        std::lock_guard lock{ stream->Mutex };
+        if (!stream->Cancelled) {
+          stream->Arrived.push_back(std::move(streamed));
+          return;
+        }
+      }
+      // The scene was released while this ran, nothing will bind it
+      if (streamed.Texture) {
+        DropTexture(streamed.Texture, streamed.Upload);
+      }
+    };
+    ret->texture_tasks_.push_back(workers.Submit(std::move(task)));
   }
+  ret->textures_pending_ = keys.size();
+  LOG_DEBUG("Streaming {} textures on {} workers", keys.size(), workers.Size());
+  return true;
 }
 
-void
-GLTFLoader::LoadImageFromVector(LoadedImage& img,
-                                const fastgltf::sources::Vector& vector)
+bool
+GLTFLoader::StreamTexture(const LoadContext& ctx,
+                          const std::filesystem::path& parent_path,
+                          TextureKey key,
+                          TextureRole role,
+                          SharedTextures::Entry* out) const
 {
-  LOG_TRACE("GLTFLoader::LoadImageFromVector");
+  const auto& [texture_index, srgb] = key;
+  const auto bytes = ReadTexture(ctx, parent_path, texture_index, false);
+  if (bytes.empty()) {
+    return false;
+  }
+  // Same bytes decoded the same way, whichever scene they come from. Mips
+  // and compression are settings of the loader, not of the image
+  const u64 settings = u64{ Mipmapped(ctx, texture_index) } |
+                       u64{ compress_textures_ } << 1;
+  const u64 shared_key =
+    Fnv1a(&settings,
+          sizeof(settings),
+          CompressedTextureCache::Key(bytes, role, srgb, texture_support_));
+  if (shared_textures_.Acquire(shared_key, out)) {
+    LOG_DEBUG("Reusing texture {} from another scene", texture_index);
+    return true;
+  }
 
-  bool loaded = ImageLoader::Load(img,
-                                  (u8*)vector.bytes.data(),
-                                  vector.bytes.size(),
-                                  ImageType::DIMENSIONS_2D,
-                                  ImagePixelFormat::PIXELFORMAT_UINT);
-  if (!loaded) {
-    LOG_WARN("Couldn't load image from vector")
+  DecodedTexture img{};
+  if (!DecodeTexture(bytes, role, srgb, &img)) {
+    const auto fallback = ReadTexture(ctx, parent_path, texture_index, true);
+    if (fallback.empty() || !DecodeTexture(fallback, role, srgb, &img)) {
+      return false;
+    }
   }
+  auto& uploads = engine_->Uploads();
+  out->Upload = uploads.CreateTicket();
+  out->Texture = CreateTexture(ctx, out->Upload, key, &img);
+  uploads.Seal(out->Upload);
+  if (!out->Texture) {
+    out->Upload.Cancel(); // levels queued before a failure
+    return false;
+  }
+  // Another load created it meanwhile, its texture is kept
+  const auto created = *out;
+  if (!shared_textures_.Insert(shared_key, out)) {
+    created.Upload.Cancel();
+    engine_->Deletions().Release(created.Texture);
+  }
+  return true;
 }
 
 void
-GLTFLoader::LoadImageFromBufferView(LoadedImage& img,
-                                    const fastgltf::BufferView& view,
-                                    const fastgltf::Buffer& buffer)
+GLTFLoader::DropTexture(SDL_GPUTexture* texture,
+                        const UploadTicket& upload) const
 {
-  LOG_TRACE("GLTFLoader::LoadImageFromBufferView");
-
-  if (!std::holds_alternative<fastgltf::sources::Array>(buffer.data)) {
-    LOG_ERROR("Couldn't load image from BufferView: buffer isn't a Vector");
+  if (texture == default_texture_ || !shared_textures_.Release(texture)) {
     return;
   }
+  upload.Cancel();
+  engine_->Deletions().Release(texture);
+}
 
-  auto& vector = std::get<fastgltf::sources::Array>(buffer.data);
-  u8* data = (u8*)(vector.bytes.data() + view.byteOffset);
+void
+GLTFLoader::Detach(std::vector<std::future<void>>&& tasks) const
+{
+  using namespace std::chrono_literals;
+  std::lock_guard lock{ detached_mutex_ };
+  std::erase_if(detached_tasks_, [](const std::future<void>& task) {
+    return task.wait_for(0s) == std::future_status::ready;
+  });
+  for (auto& task : tasks) {
+    detached_tasks_.push_back(std::move(task));
+  }
+}
 
-  bool loaded = ImageLoader::Load(img,
-                                  data,
-                                  view.byteLength,
-                                  ImageType::DIMENSIONS_2D,
-                                  ImagePixelFormat::PIXELFORMAT_UINT);
-  if (!loaded) {
-    LOG_WARN("Couldn't load image from array")
+SDL_GPUTexture*
+GLTFLoader::CreateTexture(const LoadContext& ctx,
+                          const UploadTicket& ticket,
+                          TextureKey key,
+                          DecodedTexture* img) const
+{
+  const auto& [texture_index, srgb] = key;
+  if (!img->Compressed.Levels.empty()) {
+    LOG_DEBUG("Creating compressed texture");
+    auto& compressed = img->Compressed;
+    u32 levels =
+      MipLevelCount(ctx, texture_index, compressed.Width, compressed.Height);
+    return CreateAndUploadCompressedTexture(
+      ctx, ticket, std::move(compressed), levels);
   }
+  LOG_DEBUG("Creating texture");
+  u32 levels = MipLevelCount(ctx, texture_index, img->Image.w, img->Image.h);
+  return CreateAndUploadTexture(
+    ctx, ticket, img->Image, std::move(img->Pixels), srgb, levels);
 }
 
 // NOTE: 4 channels hardcoded here to match R8G8B8A8_UNORM format
 SDL_GPUTexture*
-GLTFLoader::CreateAndUploadTexture(LoadedImage& img, bool srgb)
+GLTFLoader::CreateAndUploadTexture(const LoadContext& ctx,
+                                   const UploadTicket& ticket,
+                                   const LoadedImage& img,
+                                   std::vector<u8>&& pixels,
+                                   bool srgb,
+                                   u32 levels) const
 {
   LOG_TRACE("GLTFLoader::CreateAndUploadTexture");
   auto format = srgb ? SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB
                      : SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
 
+  // Blitting mips needs the texture to be a color target
+  constexpr auto blit_usage =
+    SDL_GPU_TEXTUREUSAGE_SAMPLER | SDL_GPU_TEXTUREUSAGE_COLOR_TARGET;
+  bool gpu_mips = levels > 1 && mip_generation_ == MipGeneration::Gpu;
+  if (gpu_mips &&
+      !SDL_GPUTextureSupportsFormat(
+        engine_->Device, format, SDL_GPU_TEXTURETYPE_2D, blit_usage)) {
+    LOG_DEBUG("Format can't be blitted, generating mips on the CPU");
+    gpu_mips = false;
+  }
+
   SDL_GPUTextureCreateInfo tex_info{};
   {
     tex_info.type = SDL_GPU_TEXTURETYPE_2D;
@@ -603,32 +1348,146 @@ GLTFLoader::CreateAndUploadTexture(LoadedImage& img, bool srgb)
     tex_info.width = static_cast<Uint32>(img.w);
     tex_info.height = static_cast<Uint32>(img.h);
     tex_info.layer_count_or_depth = 1;
-    tex_info.num_levels = 1;
+    tex_info.num_levels = levels;
+    tex_info.usage = gpu_mips ? blit_usage : SDL_GPU_TEXTUREUSAGE_SAMPLER;
+  }
+  auto* tex = GpuMemory::CreateTexture(engine_->Device,
+                                       tex_info,
+                                       GpuMemoryCategory::MaterialTexture,
+                                       ctx.MemoryScope);
+  if (!tex) {
+    LOG_ERROR("Couldn't create texture: {}", SDL_GetError());
+    return tex;
+  }
+
+  auto& uploads = engine_->Uploads();
+  u32 w = tex_info.width;
+  u32 h = tex_info.height;
+  // Base level only when blitting, the whole chain otherwise
+  const u32 uploaded_levels = gpu_mips ? 1 : levels;
+  for (u32 level = 0; level < uploaded_levels; ++level) {
+    std::vector<u8> next{};
+    if (level + 1 < uploaded_levels) {
+      next = MipChain::Downsample(pixels, w, h, srgb);
+    }
+
+    SDL_GPUTextureRegion region{};
+    {
+      region.texture = tex;
+      region.mip_level = level;
+      region.w = w;
+      region.h = h;
+      region.d = 1;
+    }
+    if (!uploads.EnqueueTexture(ticket,
+                                UploadScheduler::PriorityTexture + level,
+                                region,
+                                std::move(pixels),
+                                gpu_mips)) {
+      LOG_ERROR("Couldn't create texture: upload failed");
+      engine_->Deletions().Release(tex); // earlier levels may be queued
+      return nullptr;
+    }
+    pixels = std::move(next);
+    w = MipChain::LevelSize(w, 1);
+    h = MipChain::LevelSize(h, 1);
+  }
+
+  return tex;
+}
+
+SDL_GPUTexture*
+GLTFLoader::CreateAndUploadCompressedTexture(const LoadContext& ctx,
+                                             const UploadTicket& ticket,
+                                             TranscodedTexture&& texture,
+                                             u32 levels) const
+{
+  LOG_TRACE("GLTFLoader::CreateAndUploadCompressedTexture");
+  // The file brings its own chain, a missing one isn't generated
+  levels = std::min(levels, static_cast<u32>(texture.Levels.size()));
+
+  SDL_GPUTextureCreateInfo tex_info{};
+  {
+    tex_info.type = SDL_GPU_TEXTURETYPE_2D;
+    tex_info.format = texture.Format;
+    tex_info.width = texture.Width;
+    tex_info.height = texture.Height;
+    tex_info.layer_count_or_depth = 1;
+    tex_info.num_levels = levels;
     tex_info.usage = SDL_GPU_TEXTUREUSAGE_SAMPLER;
   }
-  auto* tex = SDL_CreateGPUTexture(engine_->Device, &tex_info);
+  auto* tex = GpuMemory::CreateTexture(engine_->Device,
+                                       tex_info,
+                                       GpuMemoryCategory::MaterialTexture,
+                                       ctx.MemoryScope);
   if (!tex) {
     LOG_ERROR("Couldn't create texture: {}", SDL_GetError());
     return tex;
   }
 
-  if (!engine_->UploadTo2DTexture(tex, img)) {
-    LOG_ERROR("Couldn't create texture: upload failed");
-    return nullptr;
+  auto& uploads = engine_->Uploads();
+  for (u32 level = 0; level < levels; ++level) {
+    SDL_GPUTextureRegion region{};
+    {
+      region.texture = tex;
+      region.mip_level = level;
+      region.w = MipChain::LevelSize(texture.Width, level);
+      region.h = MipChain::LevelSize(texture.Height, level);
+      region.d = 1;
+    }
+    if (!uploads.EnqueueTexture(ticket,
+                                UploadScheduler::PriorityTexture + level,
+                                region,
+                                std::move(texture.Levels[level]),
+                                false)) {
+      LOG_ERROR("Couldn't create texture: upload failed");
+      engine_->Deletions().Release(tex); // earlier levels may be queued
+      return nullptr;
+    }
   }
 
   return tex;
 }
 
 bool
-GLTFLoader::LoadSamplers(GLTFScene* ret)
+GLTFLoader::Mipmapped(const LoadContext& ctx, u64 texture_index) const
+{
+  if (mip_generation_ == MipGeneration::None) {
+    return false;
+  }
+  // Follow the sampler: plain nearest/linear minification never reads mips
+  const auto& tex = ctx.Asset.textures[texture_index];
+  if (tex.samplerIndex.has_value() &&
+      tex.samplerIndex.value() < ctx.Asset.samplers.size()) {
+    auto min_filter = ctx.Asset.samplers[tex.samplerIndex.value()].minFilter;
+    if (min_filter.has_value() &&
+        (min_filter.value() == fastgltf::Filter::Nearest ||
+         min_filter.value() == fastgltf::Filter::Linear)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+u32
+GLTFLoader::MipLevelCount(const LoadContext& ctx,
+                          u64 texture_index,
+                          u32 width,
+                          u32 height) const
+{
+  return Mipmapped(ctx, texture_index) ? MipChain::LevelCount(width, height)
+                                       : 1;
+}
+
+bool
+GLTFLoader::LoadSamplers(const LoadContext& ctx, GLTFScene* ret) const
 {
   LOG_TRACE("GLTFLoader::LoadSamplers");
 
   ret->samplers_ = std::vector<SDL_GPUSampler*>{};
-  ret->samplers_.reserve(asset_.samplers.size());
+  ret->samplers_.reserve(ctx.Asset.samplers.size());
 
-  if (asset_.samplers.empty()) {
+  if (ctx.Asset.samplers.empty()) {
     LOG_WARN("GLTF asset has no samplers. falling back to default");
     ret->samplers_.push_back(default_sampler_);
     return true;
@@ -636,7 +1495,7 @@ GLTFLoader::LoadSamplers(GLTFScene* ret)
 
   // auto near = fastgltf::Filter::Nearest;
   auto linear = fastgltf::Filter::Linear;
-  for (auto& sampler : asset_.samplers) {
+  for (auto& sampler : ctx.Asset.samplers) {
     SDL_GPUSamplerCreateInfo info{};
     {
       info.min_filter = extract_filter(sampler.minFilter.value_or(linear));
@@ -646,6 +1505,7 @@ GLTFLoader::LoadSamplers(GLTFScene* ret)
       info.address_mode_u = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
       info.address_mode_v = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
       info.address_mode_w = SDL_GPU_SAMPLERADDRESSMODE_REPEAT;
+      info.max_lod = 1000.f; // whole mip chain
     }
     auto* s = SDL_CreateGPUSampler(engine_->Device, &info);
     if (!s) {
@@ -654,7 +1514,7 @@ GLTFLoader::LoadSamplers(GLTFScene* ret)
     }
     ret->samplers_.push_back(s);
   }
-  assert(ret->samplers_.size() == asset_.samplers.size());
+  assert(ret->samplers_.size() == ctx.Asset.samplers.size());
   return true;
 }
 
@@ -685,18 +1545,24 @@ GLTFLoader::CreateDefaultTexture()
 }
 
 bool
-GLTFLoader::LoadMaterials(GLTFScene* ret)
+GLTFLoader::LoadMaterials(const LoadContext& ctx, GLTFScene* ret) const
 {
   LOG_TRACE("GLTFLoader::LoadMaterials");
-  if (asset_.materials.size() == 0) {
+  if (ctx.Asset.materials.size() == 0) {
     LOG_WARN("No materials found in GLTF");
     ret->materials_.push_back(default_material_);
     return true;
   }
+
+  TextureMap textures;
+  if (!LoadTextures(ctx, ret, &textures)) {
+    LOG_ERROR("Couldn't load textures from GLTF");
+    return false;
+  }
   ret->materials_ = std::vector<SharedPtr<GLTFPbrMaterial>>{};
-  ret->materials_.reserve(asset_.materials.size());
+  ret->materials_.reserve(ctx.Asset.materials.size());
 
-  for (auto& mat : asset_.materials) {
+  for (auto& mat : ctx.Asset.materials) {
     auto newMat = std::make_shared<GLTFPbrMaterial>();
 
     { // factors
@@ -727,23 +1593,25 @@ GLTFLoader::LoadMaterials(GLTFScene* ret)
     }
 
     // template optional because fastgltf::NormalTextureInfo type is derived
-    // from fastgltf::TextureInfo
+    // from fastgltf::TextureInfo. Textures stream in, the material starts
+    // with the default one and without the texture's feature
     auto bindTexture = [&](const auto& opt_tex_info,
                            SDL_GPUTexture** texture,
                            SDL_GPUSampler** sampler,
                            int flag,
-                           [[maybe_unused]] bool srgb = false) {
+                           bool srgb = false) {
       // using TexInfoType = std::decay_t<decltype(*opt_tex_info)>;
       if (opt_tex_info.has_value()) {
         auto tex_idx = opt_tex_info.value().textureIndex;
-        // assert(tex_idx < ret->textures_.size());
-        assert(LoadTexture(ret, tex_idx, srgb) == true);
-
-        auto sampler_idx = asset_.textures[tex_idx].samplerIndex.value_or(0);
+        auto sampler_idx = ctx.Asset.textures[tex_idx].samplerIndex.value_or(0);
         assert(sampler_idx < ret->samplers_.size());
-        *texture = ret->textures_[tex_idx];
+        *texture = default_texture_;
         *sampler = ret->samplers_[sampler_idx];
-        newMat->FeatureFlags |= flag;
+        ret->texture_slots_.push_back(
+          { textures.at({ tex_idx, srgb }),
+            static_cast<u32>(ret->materials_.size()),
+            texture,
+            static_cast<u32>(flag) });
       } else {
         *texture = default_texture_;
         *sampler = default_sampler_;
@@ -781,32 +1649,35 @@ GLTFLoader::LoadMaterials(GLTFScene* ret)
 }
 
 bool
-GLTFLoader::LoadNodes(GLTFScene* ret)
+GLTFLoader::BakeNodes(const LoadContext& ctx, MeshCache::Data* out) const
 {
-  LOG_TRACE("GLTFLoader::LoadNodes");
-  if (asset_.nodes.size() == 0) {
+  LOG_TRACE("GLTFLoader::BakeNodes");
+  if (ctx.Asset.nodes.size() == 0) {
     LOG_ERROR("GLTF has no nodes (TODO: handle it as it's valid)")
     return false;
   }
-  ret->parent_nodes_ = std::vector<SharedPtr<SceneNode>>{};
-  ret->all_nodes_ = std::vector<SharedPtr<SceneNode>>{};
-  ret->all_nodes_.reserve(asset_.nodes.size());
-
-  // Create node for every node in scene
-  for (const fastgltf::Node& node : asset_.nodes) {
-    std::shared_ptr<SceneNode> NewNode;
-
-    if (node.meshIndex.has_value()) {
-      NewNode = std::make_shared<MeshNode>();
-      auto idx = node.meshIndex.value();
-      static_cast<MeshNode*>(NewNode.get())->Mesh = &ret->meshes_[idx];
-    } else {
-      NewNode = std::make_shared<SceneNode>();
+  out->Nodes.reserve(ctx.Asset.nodes.size());
+
+  for (const fastgltf::Node& node : ctx.Asset.nodes) {
+    BakedNode NewNode{};
+    NewNode.MeshIndex =
+      node.meshIndex.has_value() ? (i32)node.meshIndex.value() : -1;
+    NewNode.FirstChild = out->Children.size();
+    NewNode.ChildCount = node.children.size();
+    for (const u64 childIdx : node.children) {
+      out->Children.push_back(childIdx);
+    }
+    NewNode.FirstInstance = out->Instances.size();
+    if (NewNode.MeshIndex >= 0 && !node.instancingAttributes.empty() &&
+        !read_instances(ctx.Asset, node, &out->Instances)) {
+      LOG_WARN("Node {}: instancing attributes don't match, drawn once",
+               node.name.c_str());
     }
+    NewNode.InstanceCount = out->Instances.size() - NewNode.FirstInstance;
 
     std::visit(fastgltf::visitor{
                  [&](fastgltf::math::fmat4x4 matrix) {
-                   memcpy(&NewNode->LocalMatrix, matrix.data(), sizeof(matrix));
+                   memcpy(&NewNode.LocalMatrix, matrix.data(), sizeof(matrix));
                  },
                  [&](fastgltf::TRS transform) {
                    glm::vec3 tl(transform.translation[0],
@@ -824,18 +1695,54 @@ GLTFLoader::LoadNodes(GLTFScene* ret)
                    glm::mat4 rm = glm::toMat4(rot);
                    glm::mat4 sm = glm::scale(glm::mat4(1.f), sc);
 
-                   NewNode->LocalMatrix = tm * rm * sm;
+                   NewNode.LocalMatrix = tm * rm * sm;
                  } },
                node.transform);
+    out->Nodes.push_back(NewNode);
+  }
+  return true;
+}
+
+bool
+GLTFLoader::LoadNodes(GLTFScene* ret, const MeshCache::View& baked) const
+{
+  LOG_TRACE("GLTFLoader::LoadNodes");
+  if (baked.Nodes.empty()) {
+    LOG_ERROR("GLTF has no nodes (TODO: handle it as it's valid)")
+    return false;
+  }
+  ret->parent_nodes_ = std::vector<SharedPtr<SceneNode>>{};
+  ret->all_nodes_ = std::vector<SharedPtr<SceneNode>>{};
+  ret->all_nodes_.reserve(baked.Nodes.size());
+
+  // Create node for every node in scene
+  for (const BakedNode& node : baked.Nodes) {
+    std::shared_ptr<SceneNode> NewNode;
+
+    if (node.MeshIndex >= 0) {
+      auto mesh_node = std::make_shared<MeshNode>();
+      mesh_node->Mesh = &ret->meshes_[node.MeshIndex];
+      const auto instances =
+        baked.Instances.subspan(node.FirstInstance, node.InstanceCount);
+      mesh_node->Instances.reserve(instances.size());
+      for (const auto& instance : instances) {
+        mesh_node->Instances.push_back(ToInstanceTransform(instance));
+      }
+      NewNode = std::move(mesh_node);
+    } else {
+      NewNode = std::make_shared<SceneNode>();
+    }
+    NewNode->LocalMatrix = node.LocalMatrix;
     ret->all_nodes_.push_back(NewNode);
   }
 
   // Iterate again to build hierarchy
-  for (u64 i = 0; i < asset_.nodes.size(); ++i) {
-    const fastgltf::Node& gltfnode = asset_.nodes[i];
+  for (u64 i = 0; i < baked.Nodes.size(); ++i) {
+    const BakedNode& bakednode = baked.Nodes[i];
     const SharedPtr<SceneNode>& node = ret->all_nodes_[i];
 
-    for (const u64 childIdx : gltfnode.children) {
+    for (const u32 childIdx :
+         baked.Children.subspan(bakednode.FirstChild, bakednode.ChildCount)) {
       node->Children.push_back(ret->all_nodes_[childIdx]);
       ret->all_nodes_[childIdx]->Parent = node;
     }
@@ -862,6 +1769,14 @@ GLTFLoader::CreateDefaultMaterial()
   default_material_ = std::make_shared<GLTFPbrMaterial>();
 }
 
+MeshPool*
+GLTFLoader::MeshPoolFor(VertexFormat format,
+                        SDL_GPUIndexElementSize index_size) const
+{
+  const size_t wide = index_size == SDL_GPU_INDEXELEMENTSIZE_32BIT ? 1 : 0;
+  return mesh_pools_[size_t(format) * 2 + wide].get();
+}
+
 bool
 GLTFLoader::CreatePipelines()
 {
@@ -880,7 +1795,9 @@ GLTFLoader::CreatePipelines()
       GLTFPbrMaterial::TextureCount + 3; // brdf lut, irradiance & specular maps
     auto vertUbos = GLTFPbrMaterial::VertexUBOCount;
     auto fragUbos = GLTFPbrMaterial::FragmentUBOCount;
-    vs = LoadShader(VertexShaderPath, Device, 0, vertUbos, 0, 0);
+    auto vertStorageBuffers = GLTFPbrMaterial::VertexStorageBufferCount;
+    vs = LoadShader(
+      VertexShaderPath, Device, 0, vertUbos, vertStorageBuffers, 0);
     if (vs == nullptr) {
       LOG_ERROR("Couldn't load vertex shader at path {}", VertexShaderPath);
       return false;
@@ -892,30 +1809,35 @@ GLTFLoader::CreatePipelines()
     }
   }
 
-  PipelineBuilder builder{};
-  builder //
-    .AddColorTarget(framebuffer_format_, false)
-    .SetVertexShader(vs)
-    .SetFragmentShader(fs)
-    .SetPrimitiveType(SDL_GPU_PRIMITIVETYPE_TRIANGLELIST)
-    .AddVertexAttributes(PosNormalTangentColorUvAttrs)
-    .EnableDepthTest()
-    .SetCompareOp(SDL_GPU_COMPAREOP_LESS)
-    .EnableDepthWrite(SDL_GPU_TEXTUREFORMAT_D16_UNORM);
-
-  opaque_pipeline_ = builder.Build(Device);
-  if (opaque_pipeline_ == nullptr) {
-    LOG_ERROR("Couldn't create pipeline!");
-    return false;
-  }
+  for (size_t i = 0; i < pipelines_.size(); ++i) {
+    const auto format = static_cast<VertexFormat>(i);
+    auto& pipelines = pipelines_[i];
+
+    PipelineBuilder builder{};
+    builder //
+      .AddColorTarget(framebuffer_format_, false)
+      .SetVertexShader(vs)
+      .SetFragmentShader(fs)
+      .SetPrimitiveType(SDL_GPU_PRIMITIVETYPE_TRIANGLELIST)
+      .AddVertexAttributes(VertexFormatElements(format))
+      .EnableDepthTest()
+      .SetCompareOp(SDL_GPU_COMPAREOP_LESS)
+      .EnableDepthWrite(SDL_GPU_TEXTUREFORMAT_D16_UNORM);
+
+    pipelines.Opaque = builder.Build(Device);
+    if (pipelines.Opaque == nullptr) {
+      LOG_ERROR("Couldn't create pipeline!");
+      return false;
+    }
 
-  enable_blending(builder.color_descs[0]);
-  builder.pipeline_info.depth_stencil_state.enable_depth_write = false;
+    enable_blending(builder.color_descs[0]);
+    builder.pipeline_info.depth_stencil_state.enable_depth_write = false;
 
-  transparent_pipeline_ = builder.Build(Device);
-  if (transparent_pipeline_ == nullptr) {
-    LOG_ERROR("Couldn't create pipeline!");
-    return false;
+    pipelines.Transparent = builder.Build(Device);
+    if (pipelines.Transparent == nullptr) {
+      LOG_ERROR("Couldn't create pipeline!");
+      return false;
+    }
   }
   SDL_ReleaseGPUShader(Device, fs);
   SDL_ReleaseGPUShader(Device, vs);
@@ -1,13 +1,27 @@
 #pragma once
 
+#include <array>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
 
+#include "common/compressed_texture_cache.h"
 #include "common/gltf_material.h"
 #include "common/gltf_scene.h"
 #include "common/loaded_image.h"
+#include "common/mesh_cache.h"
+#include "common/mesh_optimizer.h"
+#include "common/mesh_pool.h"
+#include "common/meshlet_pool.h"
 #include "common/rendersystem.h"
+#include "common/shared_textures.h"
 #include "common/tangent_loader.h"
+#include "common/texture_transcoder.h"
 #include "common/types.h"
+#include "common/upload_scheduler.h"
 
 #include <SDL3/SDL_gpu.h>
 #include <fastgltf/core.hpp>
@@ -16,6 +30,11 @@
 
 class Engine;
 
+// Loads glTF scenes. The loader only holds what every load shares (pipelines,
+// mesh and meshlet pools, default texture, sampler and material, settings),
+// each load keeps its parse state in its own LoadContext: loads can run
+// concurrently, from any thread. Settings must not change while loads are
+// running
 class GLTFLoader
 {
   friend class GLTFScene;
@@ -25,14 +44,49 @@ public:
   GLTFLoader(Engine* engine, SDL_GPUTextureFormat framebuffer_format);
   ~GLTFLoader();
 
-  bool Load(GLTFScene* scene, std::filesystem::path& path);
-  UniquePtr<GLTFScene> Load(const std::filesystem::path& path);
+  bool Load(GLTFScene* scene, std::filesystem::path& path) const;
+  UniquePtr<GLTFScene> Load(const std::filesystem::path& path) const;
+  // Loads on the engine's workers
+  std::future<UniquePtr<GLTFScene>> LoadAsync(
+    const std::filesystem::path& path) const;
   static bool LoadPositions(const std::filesystem::path& path,
                             std::vector<PosNormalVertex_Aligned>& vertices,
                             std::vector<u32>& indices,
                             u32 mesh_idx);
   void Release(); // Callable dtor, must be destroyed before app
 
+  // Files the parsed asset's buffers point into, memory mapped or read whole
+  // where fastgltf can't map files
+#if FASTGLTF_HAS_MEMORY_MAPPED_FILE
+  using MappedFiles = std::vector<UniquePtr<fastgltf::MappedGltfFile>>;
+#else
+  using MappedFiles = std::vector<UniquePtr<fastgltf::GltfDataBuffer>>;
+#endif
+
+  // How material textures get their mip chain. Gpu blits it after the upload,
+  // Cpu box filters it while loading (slower, but what cached builds store)
+  enum class MipGeneration : u8
+  {
+    None,
+    Gpu,
+    Cpu,
+  };
+  void SetMipGeneration(MipGeneration mode) { mip_generation_ = mode; }
+  // Baked geometry is reused across launches while the source is unchanged
+  void SetMeshCacheEnabled(bool enabled) { use_mesh_cache_ = enabled; }
+  // PNG/JPEG material textures are block compressed once, then loaded from
+  // the compressed texture cache
+  void SetTextureCompression(bool enabled) { compress_textures_ = enabled; }
+  // Scenes are handed out once their geometry is queued, textures are
+  // decoded afterwards and show up as they land. Otherwise Load() returns
+  // once every texture is queued too
+  void SetStreaming(bool enabled) { streaming_ = enabled; }
+  // Steps run on each mesh before it's baked
+  void SetMeshOptimization(const MeshOptimizer::Options& options)
+  {
+    mesh_optimization_ = options;
+  }
+
 public:
   static constexpr const char* VertexShaderPath =
     "resources/shaders/compiled/pbr.vert.spv";
@@ -40,36 +94,133 @@ public:
     "resources/shaders/compiled/pbr.frag.spv";
 
 private:
-  bool LoadVertexData(GLTFScene* ret);
-  bool LoadSamplers(GLTFScene* ret);
-  bool LoadImageData(GLTFScene* ret);
-  bool LoadTexture(GLTFScene* ret, u64 texture_index, bool srgb);
-  bool LoadMaterials(GLTFScene* ret);
-  bool LoadNodes(GLTFScene* ret);
-
-  bool Parse(const std::filesystem::path& path);
-  bool LoadResources(GLTFScene* ret);
-
-  // TODO: some of these utils should be moved somewhere else
-  template<typename V, typename I>
-  bool UploadBuffers(MeshBuffers* buffers,
-                     std::vector<V> vertices,
-                     std::vector<I> indices);
-
-  void LoadImageFromURI(LoadedImage& img,
-                        std::filesystem::path parent_path,
-                        const fastgltf::sources::URI& URI);
-  void LoadImageFromVector(LoadedImage& img,
-                           const fastgltf::sources::Vector& vector);
-  void LoadImageFromBufferView(LoadedImage& img,
-                               const fastgltf::BufferView& view,
-                               const fastgltf::Buffer& buffer);
-  SDL_GPUTexture* CreateAndUploadTexture(LoadedImage& img, bool srgb);
+  // Per load state, shared with the mesh and texture tasks that outlive the
+  // load
+  struct LoadContext : std::enable_shared_from_this<LoadContext>
+  {
+    DISABLE_COPY_AND_MOVE(LoadContext);
+    LoadContext() = default;
+
+    MappedFiles Files{}; // declared first, outlives Asset
+    fastgltf::Asset Asset{};
+    // External buffers, what cached geometry is validated against
+    std::vector<std::filesystem::path> BufferPaths{};
+    // Holds the mapped entry, shared with its uploads
+    SharedPtr<MeshCache> Cache{ MakeShared<MeshCache>() };
+    UploadTicket Ticket{}; // uploads of the scene being loaded
+    std::string MemoryScope{}; // GpuMemory scope of the scene being loaded
+  };
+
+  // Geometry and hierarchy post-processed the way the mesh cache stores them.
+  // BakeMesh() appends one glTF mesh
+  bool BakeMesh(const LoadContext& ctx,
+                size_t mesh_index,
+                MeshCache::Data* out) const;
+  bool BakeNodes(const LoadContext& ctx, MeshCache::Data* out) const;
+  // Starts a bake task per mesh, see GLTFScene::Update. The last one to
+  // finish writes the mesh cache, along with the baked `nodes`
+  bool StreamMeshes(const LoadContext& ctx,
+                    GLTFScene* ret,
+                    SharedPtr<const MeshCache::Data> nodes) const;
+  // Allocates a baked mesh and its meshlets in the pools and queues them on
+  // `ticket`, its materials aren't built. `owner` keeps `baked` alive until
+  // the uploads are recorded
+  bool CreateMesh(const MeshCache::View& baked,
+                  const BakedMesh& mesh,
+                  const UploadTicket& ticket,
+                  const SharedPtr<const void>& owner,
+                  MeshAsset* out) const;
+  // Material instances of a created mesh, main thread
+  void BuildMaterials(const GLTFScene& scene, MeshAsset* mesh) const;
+  // Frees the ranges of a mesh its scene won't draw anymore
+  void DropMesh(const MeshAsset& mesh) const;
+  // Creates every mesh of cached geometry, `owner` as in CreateMesh()
+  bool LoadVertexData(GLTFScene* ret,
+                      const MeshCache::View& baked,
+                      const SharedPtr<const void>& owner) const;
+  bool LoadSamplers(const LoadContext& ctx, GLTFScene* ret) const;
+  // Streamed texture index per (texture index, srgb), a glTF texture can be
+  // bound as color and as data
+  using TextureKey = std::pair<u64, bool>;
+  using TextureMap = std::map<TextureKey, u32>;
+  struct DecodedTexture
+  {
+    LoadedImage Image{}; // description only, see ImageLoader::LoadInto
+    std::vector<u8> Pixels{};
+    TranscodedTexture Compressed{}; // block compressed, Pixels stays empty
+  };
+  // Starts the texture tasks, see GLTFScene::Update
+  bool LoadTextures(const LoadContext& ctx,
+                    GLTFScene* ret,
+                    TextureMap* out) const;
+  // Texture task: reuses the texture another scene created from the same
+  // image, or decodes, creates and queues it
+  bool StreamTexture(const LoadContext& ctx,
+                     const std::filesystem::path& parent_path,
+                     TextureKey key,
+                     TextureRole role,
+                     SharedTextures::Entry* out) const;
+  SDL_GPUTexture* CreateTexture(const LoadContext& ctx,
+                                const UploadTicket& ticket,
+                                TextureKey key,
+                                DecodedTexture* img) const;
+  // Releases a texture its scene won't bind anymore, unless another scene
+  // still shares it. `upload` is cancelled along with it
+  void DropTexture(SDL_GPUTexture* texture, const UploadTicket& upload) const;
+  // Mesh and texture tasks of released scenes, left to finish on the
+  // workers. They are only waited for by Release()
+  void Detach(std::vector<std::future<void>>&& tasks) const;
+  // Encoded bytes of a texture's KHR_texture_basisu image, or of its regular
+  // one. `fallback` reads the regular one of a texture having both, for when
+  // the basisu one can't be transcoded
+  std::vector<u8> ReadTexture(const LoadContext& ctx,
+                              const std::filesystem::path& parent_path,
+                              u64 texture_index,
+                              bool fallback) const;
+  bool DecodeTexture(std::span<const u8> bytes,
+                     TextureRole role,
+                     bool srgb,
+                     DecodedTexture* out) const;
+  // Encoded bytes of an image, whatever its source
+  std::vector<u8> ReadImage(const LoadContext& ctx,
+                            const std::filesystem::path& parent_path,
+                            const fastgltf::Image& img) const;
+  // PNG/JPEG images, block compressed through the texture cache when enabled
+  bool DecodeImage(std::span<const u8> bytes,
+                   TextureRole role,
+                   bool srgb,
+                   DecodedTexture* out) const;
+  bool LoadMaterials(const LoadContext& ctx, GLTFScene* ret) const;
+  bool LoadNodes(GLTFScene* ret, const MeshCache::View& baked) const;
+
+  bool LoadResources(LoadContext& ctx, GLTFScene* ret) const;
+  bool LoadResourcesImpl(LoadContext& ctx, GLTFScene* ret) const;
+
+  SDL_GPUTexture* CreateAndUploadTexture(const LoadContext& ctx,
+                                         const UploadTicket& ticket,
+                                         const LoadedImage& img,
+                                         std::vector<u8>&& pixels,
+                                         bool srgb,
+                                         u32 levels) const;
+  // Uploads the first `levels` levels of an already encoded chain
+  SDL_GPUTexture* CreateAndUploadCompressedTexture(const LoadContext& ctx,
+                                                   const UploadTicket& ticket,
+                                                   TranscodedTexture&& texture,
+                                                   u32 levels) const;
+  // Whether the texture's sampler minifies with mipmaps
+  bool Mipmapped(const LoadContext& ctx, u64 texture_index) const;
+  // 1 unless Mipmapped()
+  u32 MipLevelCount(const LoadContext& ctx,
+                    u64 texture_index,
+                    u32 width,
+                    u32 height) const;
   bool CreateDefaultTexture();
   bool CreateDefaultSampler();
   void CreateDefaultMaterial();
   bool CreatePipelines();
-  bool IsInitialized();
+  bool IsInitialized() const;
+  MeshPool* MeshPoolFor(VertexFormat format,
+                        SDL_GPUIndexElementSize index_size) const;
 
 private:
   Engine* engine_;
@@ -77,13 +228,31 @@ private:
   // Used for material pipeline creation, default assumes HDR framebuffer
   SDL_GPUTextureFormat framebuffer_format_ =
     SDL_GPU_TEXTUREFORMAT_R16G16B16A16_FLOAT;
-  fastgltf::Asset asset_;
+  MipGeneration mip_generation_{ MipGeneration::Gpu };
+  TextureTranscoder::Support texture_support_{};
+  CompressedTextureCache texture_cache_{};
+  mutable SharedTextures shared_textures_{}; // of every scene
+  mutable std::mutex detached_mutex_;
+  mutable std::vector<std::future<void>> detached_tasks_{};
+  bool compress_textures_{ true };
+  bool streaming_{ true };
+  bool use_mesh_cache_{ true };
+  MeshOptimizer::Options mesh_optimization_{};
+  // Vertex data of every scene, per vertex format and index size
+  std::array<UniquePtr<MeshPool>, 2 * size_t(VertexFormat::Count)>
+    mesh_pools_{};
+  UniquePtr<MeshletPool> meshlet_pool_{ nullptr }; // of every scene
   UniquePtr<TangentLoader> tangent_loader_{ nullptr };
 
   SDL_GPUSampler* default_sampler_{ nullptr };
   SDL_GPUTexture* default_texture_{ nullptr };
   SharedPtr<GLTFPbrMaterial> default_material_{ nullptr };
 
-  SDL_GPUGraphicsPipeline* opaque_pipeline_{ nullptr };
-  SDL_GPUGraphicsPipeline* transparent_pipeline_{ nullptr };
+  struct MaterialPipelines
+  {
+    SDL_GPUGraphicsPipeline* Opaque{ nullptr };
+    SDL_GPUGraphicsPipeline* Transparent{ nullptr };
+  };
+  // Per vertex format, they only differ by their vertex input
+  std::array<MaterialPipelines, size_t(VertexFormat::Count)> pipelines_{};
 };
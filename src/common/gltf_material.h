@@ -10,6 +10,8 @@ struct GLTFPbrMaterial final : public IMaterialBuilder
 {
   static constexpr u8 TextureCount = CAST_FLAG(PbrTextureFlag::COUNT);
   static constexpr u8 VertexUBOCount = 2;
+  // Per-draw data and instance offsets
+  static constexpr u8 VertexStorageBufferCount = 2;
   static constexpr u8 FragmentUBOCount = 2;
   // Color factors:
   glm::vec4 BaseColorFactor{ 1.f };
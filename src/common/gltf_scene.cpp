@@ -4,6 +4,8 @@
 
 #include "common/engine.h"
 #include "common/gltf_loader.h"
+#include "common/gpu_memory.h"
+#include "shaders/meshlet_cull.h"
 
 GLTFScene::GLTFScene(std::filesystem::path path, const GLTFLoader* loader)
   : Path{ path }
@@ -23,26 +25,173 @@ GLTFScene::Release()
 {
   LOG_TRACE("Destroying GLTFScene");
   {
-    auto Device = loader_->engine_->Device;
+    // Mesh and texture tasks aren't waited for, that could run other queued
+    // work (a whole scene load) on this thread. Those not started skip,
+    // running ones drop what they created themselves once they see the flag
+    {
+      std::lock_guard lock{ mesh_stream_->Mutex };
+      mesh_stream_->Cancelled = true;
+      for (auto& arrived : mesh_stream_->Arrived) {
+        meshes_[arrived.Index] = std::move(arrived.Mesh);
+      }
+      mesh_stream_->Arrived.clear();
+    }
+    loader_->Detach(std::move(mesh_tasks_));
+    mesh_tasks_.clear();
+    meshes_pending_ = 0;
+    {
+      std::lock_guard lock{ texture_stream_->Mutex };
+      texture_stream_->Cancelled = true;
+      for (auto& arrived : texture_stream_->Arrived) {
+        if (arrived.Texture) {
+          textures_.push_back(arrived.Texture);
+          texture_uploads_.push_back(std::move(arrived));
+        }
+      }
+      texture_stream_->Arrived.clear();
+    }
+    loader_->Detach(std::move(texture_tasks_));
+    texture_tasks_.clear();
+    textures_pending_ = 0;
+
+    // Queued uploads would target the released resources
+    uploads_.Cancel();
+    for (auto& ticket : mesh_uploads_) {
+      ticket.Cancel();
+    }
+    // Earlier frames may still draw the scene, nothing is destroyed right away
+    auto& deletions = loader_->engine_->Deletions();
+    // Shared textures are released along with the last scene showing them
     for (auto* tex : textures_) {
-      if (tex != loader_->default_texture_) {
-        RELEASE_IF(tex, SDL_ReleaseGPUTexture);
+      UploadTicket upload{};
+      for (const auto& streamed : texture_uploads_) {
+        if (streamed.Texture == tex) {
+          upload = streamed.Upload;
+        }
       }
+      loader_->DropTexture(tex, upload);
     }
+    texture_uploads_.clear();
     for (auto* sampler : samplers_) {
       if (sampler != loader_->default_sampler_) {
-        RELEASE_IF(sampler, SDL_ReleaseGPUSampler);
+        deletions.Release(sampler);
       }
     }
-    for (auto& mesh : meshes_) {
-      RELEASE_IF(mesh.IndexBuffer(), SDL_ReleaseGPUBuffer);
-      RELEASE_IF(mesh.VertexBuffer(), SDL_ReleaseGPUBuffer);
+    for (const auto& mesh : meshes_) {
+      loader_->DropMesh(mesh);
     }
-    LOG_DEBUG("Released GLTF resources");
+    LOG_DEBUG("Queued GLTF resources for release");
   }
   loaded_ = false;
 }
 
+void
+GLTFScene::Update()
+{
+  if (!loaded_) {
+    return;
+  }
+  if (meshes_pending_ > 0) {
+    std::lock_guard lock{ mesh_stream_->Mutex };
+    for (auto& arrived : mesh_stream_->Arrived) {
+      auto& mesh = meshes_[arrived.Index];
+      mesh = std::move(arrived.Mesh);
+      loader_->BuildMaterials(*this, &mesh);
+      --meshes_pending_;
+    }
+    mesh_stream_->Arrived.clear();
+  }
+  // Each mesh is drawn once its own data landed. The tasks seal a ticket
+  // after publishing its mesh, placeholders never get ready
+  for (size_t i = 0; i < meshes_.size(); ++i) {
+    if (!meshes_[i].Visible && mesh_uploads_[i].Ready()) {
+      meshes_[i].Visible = true;
+    }
+  }
+
+  if (textures_pending_ == 0) {
+    return;
+  }
+  {
+    std::lock_guard lock{ texture_stream_->Mutex };
+    for (auto& arrived : texture_stream_->Arrived) {
+      if (arrived.Texture) {
+        textures_.push_back(arrived.Texture);
+      }
+      texture_uploads_.push_back(std::move(arrived));
+    }
+    texture_stream_->Arrived.clear();
+  }
+  std::vector<bool> changed(materials_.size(), false);
+  for (auto it = texture_uploads_.begin(); it != texture_uploads_.end();) {
+    const bool failed = !it->Texture || it->Upload.Failed();
+    if (!failed && !it->Upload.Ready()) {
+      ++it;
+      continue;
+    }
+    // Failed ones keep the default texture
+    for (const auto& slot : texture_slots_) {
+      if (!failed && slot.Texture == it->Index) {
+        *slot.Target = it->Texture;
+        materials_[slot.Material]->FeatureFlags |= slot.Flag;
+        changed[slot.Material] = true;
+      }
+    }
+    --textures_pending_;
+    it = texture_uploads_.erase(it);
+  }
+  // Draws use built instances, those of the changed materials are rebuilt
+  for (auto& mesh : meshes_) {
+    for (auto& geometry : mesh.Submeshes) {
+      if (geometry.MaterialIndex < changed.size() &&
+          changed[geometry.MaterialIndex]) {
+        auto* pipeline = geometry.material->Pipeline;
+        geometry.material = materials_[geometry.MaterialIndex]->Build();
+        geometry.material->Pipeline = pipeline;
+      }
+    }
+  }
+}
+
+bool
+GLTFScene::Resident() const
+{
+  if (!uploads_.Ready() || meshes_pending_ > 0 || textures_pending_ > 0) {
+    return false;
+  }
+  return std::all_of(meshes_.begin(), meshes_.end(), [](const auto& mesh) {
+    return mesh.Visible;
+  });
+}
+
+bool
+GLTFScene::UploadFailed() const
+{
+  return uploads_.Failed() ||
+         std::any_of(mesh_uploads_.begin(),
+                     mesh_uploads_.end(),
+                     [](const auto& ticket) { return ticket.Failed(); });
+}
+
+u64
+GLTFScene::GpuBytes() const
+{
+  u64 ret = 0;
+  for (const auto& mesh : meshes_) {
+    const MeshPool* pool =
+      loader_->MeshPoolFor(mesh.Format, mesh.Buffers.IndexSize);
+    ret += u64{ mesh.Buffers.VertexCount } * pool->VertexStride() +
+           u64{ mesh.Buffers.IndexCount } * pool->IndexStride() +
+           u64{ mesh.Meshlets.Count } * sizeof(MeshletBinding);
+  }
+  for (auto* tex : textures_) {
+    if (tex != loader_->default_texture_) {
+      ret += GpuMemory::SizeOf(tex);
+    }
+  }
+  return ret;
+}
+
 void
 GLTFScene::Draw(glm::mat4 matrix, RenderContext& context)
 {
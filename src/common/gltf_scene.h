@@ -1,9 +1,14 @@
 #pragma once
 
+#include <atomic>
 #include <filesystem>
+#include <future>
+#include <mutex>
+#include <vector>
 
 #include "common/gltf_material.h"
 #include "common/rendersystem.h"
+#include "common/upload_scheduler.h"
 
 #include <SDL3/SDL_gpu.h>
 
@@ -21,6 +26,19 @@ public:
 
   void Draw(glm::mat4 matrix, RenderContext& context) override;
   void Release();
+  // Publishes what landed since the last call: meshes show up once baked
+  // and on the GPU, textures get bound to their materials, which draw with
+  // the default texture meanwhile. Main thread, once per frame
+  void Update();
+  // The scene-wide uploads landed, meshes and textures may still stream in
+  bool Drawable() const { return uploads_.Ready(); }
+  // Everything landed and was published by Update()
+  bool Resident() const;
+  bool UploadFailed() const;
+  // GPU memory of its baked meshes, their meshlets and landed textures.
+  // Textures shared with other scenes (see SharedTextures) are counted by
+  // each of them
+  u64 GpuBytes() const;
 
   const std::vector<MeshAsset>& Meshes() const;
   const std::vector<SDL_GPUTexture*>& Textures() const;
@@ -32,10 +50,54 @@ public:
 public:
   std::filesystem::path Path;
 
+private:
+  // A material texture decoded on the workers, created and queued
+  struct StreamedTexture
+  {
+    u32 Index{ 0 }; // of the texture, see TextureSlot
+    SDL_GPUTexture* Texture{ nullptr }; // nullptr when it couldn't be loaded
+    UploadTicket Upload{};
+  };
+  // A mesh baked on the workers, created and queued on its mesh_uploads_
+  // ticket
+  struct StreamedMesh
+  {
+    u32 Index{ 0 }; // into meshes_
+    MeshAsset Mesh{}; // no materials yet, left empty when the bake failed
+  };
+  // Filled by the workers, drained by Update()
+  template<typename T>
+  struct Stream
+  {
+    std::mutex Mutex;
+    std::vector<T> Arrived;
+    std::atomic<bool> Cancelled{ false }; // tasks not started yet skip
+  };
+  using TextureStream = Stream<StreamedTexture>;
+  using MeshStream = Stream<StreamedMesh>;
+  // Where a streamed texture is bound once resident
+  struct TextureSlot
+  {
+    u32 Texture;
+    u32 Material;
+    SDL_GPUTexture** Target; // into the material
+    u32 Flag; // feature enabled along with the texture
+  };
+
 private:
   bool loaded_{ false };
-  const GLTFLoader* loader_;
+  const GLTFLoader* loader_{ nullptr };
+  UploadTicket uploads_{};
   std::vector<MeshAsset> meshes_;
+  std::vector<UploadTicket> mesh_uploads_; // per mesh, see MeshAsset::Visible
+  SharedPtr<MeshStream> mesh_stream_{ MakeShared<MeshStream>() };
+  std::vector<std::future<void>> mesh_tasks_;
+  size_t meshes_pending_{ 0 }; // not baked yet, placeholders in meshes_
+  SharedPtr<TextureStream> texture_stream_{ MakeShared<TextureStream>() };
+  std::vector<std::future<void>> texture_tasks_;
+  std::vector<TextureSlot> texture_slots_;
+  std::vector<StreamedTexture> texture_uploads_; // arrived, not bound yet
+  size_t textures_pending_{ 0 }; // not bound yet, whether arrived or not
   std::vector<SDL_GPUTexture*> textures_;
   std::vector<SDL_GPUSampler*> samplers_;
   std::vector<SharedPtr<GLTFPbrMaterial>> materials_;
@@ -0,0 +1,162 @@
+#include "gpu_buffer.h"
+
+#include "common/engine.h"
+#include "common/logger.h"
+#include "common/types.h"
+#include "common/upload_batch.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <pch.h>
+
+namespace {
+u32
+next_pow2(u32 v)
+{
+  u32 ret = 1;
+  while (ret < v) {
+    ret <<= 1;
+  }
+  return ret;
+}
+}
+
+GpuBufferBase::GpuBufferBase(Engine* engine,
+                             SDL_GPUBufferUsageFlags usage,
+                             u32 stride,
+                             bool cycle,
+                             const char* name,
+                             GpuMemoryCategory category)
+  : engine_{ engine }
+  , usage_{ usage }
+  , stride_{ stride }
+  , cycle_{ cycle }
+  , name_{ name }
+  , category_{ category }
+{
+}
+
+GpuBufferBase::~GpuBufferBase()
+{
+  engine_->Deletions().Release(buffer_);
+}
+
+bool
+GpuBufferBase::Reserve(u32 count)
+{
+  recreated_ = false;
+
+  u32 new_capacity = capacity_;
+  if (count > capacity_) {
+    new_capacity = std::max(MinCapacity, next_pow2(count));
+  } else if (count < capacity_ / 4 && capacity_ > MinCapacity) {
+    // Shrink hysteresis: only give memory back well under the capacity
+    new_capacity = std::max(MinCapacity, next_pow2(count) * 2);
+  }
+  if (new_capacity == capacity_ && buffer_ != nullptr) {
+    return true;
+  }
+
+  SDL_GPUBufferCreateInfo info{};
+  {
+    info.usage = usage_;
+    info.size = new_capacity * stride_;
+  }
+  auto* buffer =
+    GpuMemory::CreateBuffer(engine_->Device, info, category_, name_);
+  if (!buffer) {
+    LOG_ERROR("{}: couldn't create buffer of {} bytes: {}",
+              name_,
+              info.size,
+              GETERR);
+    return false;
+  }
+  SDL_SetGPUBufferName(engine_->Device, buffer, name_);
+  LOG_DEBUG("{}: capacity {} -> {} elements ({} bytes)",
+            name_,
+            capacity_,
+            new_capacity,
+            info.size);
+
+  // Previous frames may still read the old buffer
+  engine_->Deletions().Release(buffer_);
+  buffer_ = buffer;
+  capacity_ = new_capacity;
+  recreated_ = true;
+  ++reallocations_;
+  dirty_.clear();
+  return true;
+}
+
+void
+GpuBufferBase::MarkDirtyRange(u32 first, u32 count)
+{
+  if (count == 0) {
+    return;
+  }
+  u32 begin = first;
+  u32 end = first + count;
+
+  // Merge with every overlapping or adjacent range
+  for (auto it = dirty_.begin(); it != dirty_.end();) {
+    if (it->first <= end && begin <= it->second) {
+      begin = std::min(begin, it->first);
+      end = std::max(end, it->second);
+      it = dirty_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  dirty_.emplace_back(begin, end);
+
+  if (dirty_.size() > MaxDirtyRanges) {
+    u32 lo = UINT32_MAX;
+    u32 hi = 0;
+    for (const auto& [b, e] : dirty_) {
+      lo = std::min(lo, b);
+      hi = std::max(hi, e);
+    }
+    dirty_.assign(1, { lo, hi });
+  }
+}
+
+void
+GpuBufferBase::MarkAllDirty()
+{
+  dirty_.clear();
+  if (size_ > 0) {
+    dirty_.emplace_back(0, size_);
+  }
+}
+
+bool
+GpuBufferBase::FlushRanges(UploadBatch& batch, const u8* host_data)
+{
+  if (dirty_.empty() || size_ == 0) {
+    dirty_.clear();
+    return true;
+  }
+  if (host_data == nullptr) {
+    LOG_ERROR("{}: flushing a buffer without host data", name_);
+    return false;
+  }
+
+  if (cycle_) {
+    dirty_.assign(1, { 0, size_ });
+  }
+  for (auto [begin, end] : dirty_) {
+    end = std::min(end, size_);
+    if (begin >= end) {
+      continue;
+    }
+    if (!batch.UploadToBuffer(buffer_,
+                              host_data + static_cast<u64>(begin) * stride_,
+                              (end - begin) * stride_,
+                              begin * stride_,
+                              cycle_)) {
+      LOG_ERROR("{}: couldn't upload range [{}, {})", name_, begin, end);
+      return false;
+    }
+  }
+  dirty_.clear();
+  return true;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "common/gpu_memory.h"
+#include "common/types.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+class Engine;
+class UploadBatch;
+
+// Untyped part of GpuBuffer<T>: owns the SDL buffer and its growth policy.
+// Capacity doubles when the buffer is too small and halves only once the
+// size drops under a quarter of it, so sizes oscillating around a power of
+// two don't recreate the buffer every time.
+// Recreating the buffer doesn't preserve its GPU contents: host-backed
+// buffers are re-uploaded on the next Flush(), GPU-written ones must be
+// regenerated by their owner (see Recreated()).
+class GpuBufferBase
+{
+public:
+  static constexpr u32 MinCapacity = 16;   // elements
+  static constexpr u32 MaxDirtyRanges = 8; // merged into one past that
+
+public:
+  DISABLE_COPY_AND_MOVE(GpuBufferBase);
+  ~GpuBufferBase(); // release is deferred until in-flight frames are done
+
+  SDL_GPUBuffer* Get() const { return buffer_; }
+  // Element count, and allocated element count
+  u32 Size() const { return size_; }
+  u32 Capacity() const { return capacity_; }
+  u32 Stride() const { return stride_; }
+  u64 SizeBytes() const { return static_cast<u64>(size_) * stride_; }
+  u64 CapacityBytes() const { return static_cast<u64>(capacity_) * stride_; }
+
+  // Cycled buffers are meant for data rewritten every frame: uploads let SDL
+  // swap in a fresh backing buffer instead of waiting on the previous frame.
+  // The whole [0, Size()) range is uploaded since cycling discards contents
+  bool Cycle() const { return cycle_; }
+  // True if the last Resize() created a new SDL buffer
+  bool Recreated() const { return recreated_; }
+  bool IsDirty() const { return !dirty_.empty(); }
+  u32 Reallocations() const { return reallocations_; }
+
+protected:
+  GpuBufferBase(Engine* engine,
+                SDL_GPUBufferUsageFlags usage,
+                u32 stride,
+                bool cycle,
+                const char* name,
+                GpuMemoryCategory category);
+
+  bool Reserve(u32 count);
+  void MarkDirtyRange(u32 first, u32 count);
+  void MarkAllDirty();
+  bool FlushRanges(UploadBatch& batch, const u8* host_data);
+
+protected:
+  u32 size_{ 0 };
+
+private:
+  Engine* engine_;
+  SDL_GPUBuffer* buffer_{ nullptr };
+  SDL_GPUBufferUsageFlags usage_;
+  u32 stride_;
+  u32 capacity_{ 0 };
+  u32 reallocations_{ 0 };
+  bool cycle_;
+  bool recreated_{ false };
+  const char* name_;
+  GpuMemoryCategory category_;
+  std::vector<std::pair<u32, u32>> dirty_; // [begin, end) in elements
+};
+
+// Typed, growable GPU buffer. Host-backed buffers keep a CPU copy of their
+// elements and only upload the ranges modified since the last Flush().
+// GPU-only buffers (written by compute) just use Resize().
+template<typename T>
+class GpuBuffer final : public GpuBufferBase
+{
+public:
+  explicit GpuBuffer(Engine* engine,
+                     SDL_GPUBufferUsageFlags usage,
+                     const char* name = "GpuBuffer",
+                     bool cycle = false,
+                     GpuMemoryCategory category = GpuMemoryCategory::Other)
+    : GpuBufferBase{ engine, usage, sizeof(T), cycle, name, category }
+  {
+  }
+
+  // Doesn't preserve GPU contents when the buffer has to be recreated
+  bool Resize(u32 count)
+  {
+    if (!Reserve(count)) {
+      return false;
+    }
+    if (!host_.empty() || count == 0) {
+      host_.resize(count);
+    }
+    size_ = count;
+    if (Recreated() && !host_.empty()) {
+      MarkAllDirty();
+    }
+    return true;
+  }
+
+  // Replaces the whole contents, only the span between the first and the last
+  // element that differ is uploaded
+  bool Assign(const T* data, u32 count)
+  {
+    const u32 old_size = static_cast<u32>(host_.size());
+    host_.resize(count);
+    if (!Resize(count)) {
+      return false;
+    }
+    const auto same = [&](u32 i) {
+      return i < old_size && std::memcmp(&host_[i], &data[i], sizeof(T)) == 0;
+    };
+    u32 first = 0;
+    while (first < count && same(first)) {
+      ++first;
+    }
+    u32 last = count;
+    while (last > first && same(last - 1)) {
+      --last;
+    }
+    if (first < last) {
+      std::memcpy(
+        host_.data() + first, data + first, (last - first) * sizeof(T));
+      MarkDirtyRange(first, last - first);
+    }
+    return true;
+  }
+  bool Assign(const std::vector<T>& data)
+  {
+    return Assign(data.data(), static_cast<u32>(data.size()));
+  }
+
+  void Set(u32 index, const T& value)
+  {
+    host_[index] = value;
+    MarkDirtyRange(index, 1);
+  }
+  const T& operator[](u32 index) const { return host_[index]; }
+
+  // Writes through Data() must be followed by MarkDirty()
+  T* Data() { return host_.data(); }
+  void MarkDirty(u32 first, u32 count) { MarkDirtyRange(first, count); }
+
+  // Records the upload of the dirty ranges into the batch
+  bool Flush(UploadBatch& batch)
+  {
+    return FlushRanges(batch, reinterpret_cast<const u8*>(host_.data()));
+  }
+
+private:
+  std::vector<T> host_{};
+};
@@ -0,0 +1,278 @@
+#include "gpu_memory.h"
+
+#include "common/logger.h"
+#include "common/types.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <pch.h>
+
+#include <imgui.h>
+
+namespace {
+constexpr f32 MiB = 1024.f * 1024.f;
+
+constexpr size_t
+index_of(GpuMemoryCategory category)
+{
+  return static_cast<size_t>(category);
+}
+}
+
+GpuMemory::State&
+GpuMemory::Get()
+{
+  static State state{};
+  return state;
+}
+
+SDL_GPUBuffer*
+GpuMemory::CreateBuffer(SDL_GPUDevice* device,
+                        const SDL_GPUBufferCreateInfo& info,
+                        GpuMemoryCategory category,
+                        std::string_view scope)
+{
+  auto* buffer = SDL_CreateGPUBuffer(device, &info);
+  if (buffer) {
+    Track(buffer, info.size, category, scope);
+  }
+  return buffer;
+}
+
+SDL_GPUTexture*
+GpuMemory::CreateTexture(SDL_GPUDevice* device,
+                         const SDL_GPUTextureCreateInfo& info,
+                         GpuMemoryCategory category,
+                         std::string_view scope)
+{
+  auto* texture = SDL_CreateGPUTexture(device, &info);
+  if (texture) {
+    Track(texture, TextureSize(info), category, scope);
+  }
+  return texture;
+}
+
+void
+GpuMemory::Release(SDL_GPUDevice* device, SDL_GPUBuffer* buffer)
+{
+  if (buffer != nullptr) {
+    Untrack(buffer);
+    SDL_ReleaseGPUBuffer(device, buffer);
+  }
+}
+
+void
+GpuMemory::Release(SDL_GPUDevice* device, SDL_GPUTexture* texture)
+{
+  if (texture != nullptr) {
+    Untrack(texture);
+    SDL_ReleaseGPUTexture(device, texture);
+  }
+}
+
+u64
+GpuMemory::TextureSize(const SDL_GPUTextureCreateInfo& info)
+{
+  const bool is_3d = info.type == SDL_GPU_TEXTURETYPE_3D;
+  const u32 layers = is_3d ? 1 : std::max(info.layer_count_or_depth, 1u);
+  u64 ret = 0;
+  for (u32 level = 0; level < std::max(info.num_levels, 1u); ++level) {
+    const u32 w = std::max(info.width >> level, 1u);
+    const u32 h = std::max(info.height >> level, 1u);
+    const u32 d = is_3d ? std::max(info.layer_count_or_depth >> level, 1u) : 1;
+    ret += SDL_CalculateGPUTextureFormatSize(info.format, w, h, d);
+  }
+  // MSAA samples are stored separately
+  const u32 samples = 1u << static_cast<u32>(info.sample_count);
+  return ret * layers * samples;
+}
+
+void
+GpuMemory::Track(const void* resource,
+                 u64 size,
+                 GpuMemoryCategory category,
+                 std::string_view scope)
+{
+  Untrack(resource); // address reused after an untracked release
+
+  auto& state = Get();
+  std::lock_guard lock{ state.mutex };
+  state.allocations[resource] =
+    Allocation{ size, category, std::string{ scope } };
+
+  auto add = [size](Stats& stats) {
+    stats.Used += size;
+    stats.Peak = std::max(stats.Peak, stats.Used);
+    ++stats.Count;
+  };
+  add(state.total);
+  add(state.categories[index_of(category)]);
+  if (!scope.empty()) {
+    state.scopes[std::string{ scope }] += size;
+  }
+
+  if (state.budget > 0 && state.total.Used > state.budget && !state.warned) {
+    LOG_WARN("GPU memory over budget: {:.1f} / {:.1f} MiB ({} `{}`)",
+             state.total.Used / MiB,
+             state.budget / MiB,
+             CategoryName(category),
+             scope);
+    state.warned = true;
+  }
+}
+
+void
+GpuMemory::Untrack(const void* resource)
+{
+  auto& state = Get();
+  std::lock_guard lock{ state.mutex };
+  auto it = state.allocations.find(resource);
+  if (it == state.allocations.end()) {
+    return;
+  }
+
+  const auto& alloc = it->second;
+  auto remove = [&alloc](Stats& stats) {
+    stats.Used -= alloc.Size;
+    --stats.Count;
+  };
+  remove(state.total);
+  remove(state.categories[index_of(alloc.Category)]);
+  if (!alloc.Scope.empty()) {
+    auto scope = state.scopes.find(alloc.Scope);
+    scope->second -= alloc.Size;
+    if (scope->second == 0) {
+      state.scopes.erase(scope);
+    }
+  }
+  state.allocations.erase(it);
+
+  if (state.total.Used <= state.budget) {
+    state.warned = false;
+  }
+}
+
+u64
+GpuMemory::SizeOf(const void* resource)
+{
+  auto& state = Get();
+  std::lock_guard lock{ state.mutex };
+  auto it = state.allocations.find(resource);
+  return it == state.allocations.end() ? 0 : it->second.Size;
+}
+
+GpuMemory::Stats
+GpuMemory::Total()
+{
+  auto& state = Get();
+  std::lock_guard lock{ state.mutex };
+  return state.total;
+}
+
+GpuMemory::Stats
+GpuMemory::Category(GpuMemoryCategory category)
+{
+  auto& state = Get();
+  std::lock_guard lock{ state.mutex };
+  return state.categories[index_of(category)];
+}
+
+std::vector<std::pair<std::string, u64>>
+GpuMemory::Scopes()
+{
+  auto& state = Get();
+  std::vector<std::pair<std::string, u64>> ret;
+  {
+    std::lock_guard lock{ state.mutex };
+    ret.assign(state.scopes.begin(), state.scopes.end());
+  }
+  std::sort(ret.begin(), ret.end(), [](const auto& a, const auto& b) {
+    return a.second > b.second;
+  });
+  return ret;
+}
+
+void
+GpuMemory::SetBudget(u64 bytes)
+{
+  auto& state = Get();
+  std::lock_guard lock{ state.mutex };
+  state.budget = bytes;
+  state.warned = false;
+}
+
+u64
+GpuMemory::Budget()
+{
+  auto& state = Get();
+  std::lock_guard lock{ state.mutex };
+  return state.budget;
+}
+
+bool
+GpuMemory::OverBudget()
+{
+  auto& state = Get();
+  std::lock_guard lock{ state.mutex };
+  return state.budget > 0 && state.total.Used > state.budget;
+}
+
+const char*
+GpuMemory::CategoryName(GpuMemoryCategory category)
+{
+  switch (category) {
+    case GpuMemoryCategory::Mesh:
+      return "Mesh";
+    case GpuMemoryCategory::MaterialTexture:
+      return "Material textures";
+    case GpuMemoryCategory::IBL:
+      return "IBL";
+    case GpuMemoryCategory::RenderTarget:
+      return "Render targets";
+    case GpuMemoryCategory::GrassStorage:
+      return "Grass storage";
+    case GpuMemoryCategory::Other:
+    case GpuMemoryCategory::Count:
+    default:
+      return "Other";
+  }
+}
+
+void
+GpuMemory::RenderGui()
+{
+  if (ImGui::Begin("GPU memory")) {
+    auto total = Total();
+    ImGui::Text("Total: %.1f MiB (peak %.1f MiB), %u resources",
+                total.Used / MiB,
+                total.Peak / MiB,
+                total.Count);
+
+    i32 budget_mib = static_cast<i32>(Budget() / (1024 * 1024));
+    if (ImGui::InputInt("Budget (MiB)", &budget_mib)) {
+      SetBudget(static_cast<u64>(std::max(budget_mib, 0)) * 1024 * 1024);
+    }
+    if (budget_mib > 0) {
+      ImGui::ProgressBar(total.Used / (budget_mib * MiB));
+      if (OverBudget()) {
+        ImGui::TextColored(ImVec4{ 1.f, .3f, .3f, 1.f }, "Over budget!");
+      }
+    }
+
+    ImGui::SeparatorText("Categories");
+    for (size_t i = 0; i < index_of(GpuMemoryCategory::Count); ++i) {
+      auto category = static_cast<GpuMemoryCategory>(i);
+      auto stats = Category(category);
+      ImGui::Text("%-18s %8.1f MiB (peak %.1f), %u",
+                  CategoryName(category),
+                  stats.Used / MiB,
+                  stats.Peak / MiB,
+                  stats.Count);
+    }
+
+    ImGui::SeparatorText("Scopes");
+    for (const auto& [scope, bytes] : Scopes()) {
+      ImGui::Text("%8.1f MiB  %s", bytes / MiB, scope.c_str());
+    }
+    ImGui::End();
+  }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "common/types.h"
+#include <SDL3/SDL_gpu.h>
+#include <array>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+enum class GpuMemoryCategory : u8
+{
+  Mesh,
+  MaterialTexture,
+  IBL,
+  RenderTarget,
+  GrassStorage,
+  Other,
+  Count
+};
+
+// Process-wide accounting of GPU buffers and textures. Resources created
+// through it are tagged with a category and an optional scope (e.g. the scene
+// they belong to) and untracked when released through it, or through the
+// DeletionQueue. Sizes are estimates: drivers add alignment and metadata.
+class GpuMemory
+{
+public:
+  struct Stats
+  {
+    u64 Used{ 0 };
+    u64 Peak{ 0 };
+    u32 Count{ 0 };
+  };
+
+  static SDL_GPUBuffer* CreateBuffer(SDL_GPUDevice* device,
+                                     const SDL_GPUBufferCreateInfo& info,
+                                     GpuMemoryCategory category,
+                                     std::string_view scope = {});
+  static SDL_GPUTexture* CreateTexture(SDL_GPUDevice* device,
+                                       const SDL_GPUTextureCreateInfo& info,
+                                       GpuMemoryCategory category,
+                                       std::string_view scope = {});
+  // Untracks and releases, null safe. Same signature as the SDL functions so
+  // they work with RELEASE_IF
+  static void Release(SDL_GPUDevice* device, SDL_GPUBuffer* buffer);
+  static void Release(SDL_GPUDevice* device, SDL_GPUTexture* texture);
+  // For resources released elsewhere, no-op if it isn't tracked
+  static void Untrack(const void* resource);
+
+  static u64 TextureSize(const SDL_GPUTextureCreateInfo& info);
+  // Tracked size of a resource, 0 if it isn't tracked
+  static u64 SizeOf(const void* resource);
+
+  static Stats Total();
+  static Stats Category(GpuMemoryCategory category);
+  // Bytes in use per scope, largest first
+  static std::vector<std::pair<std::string, u64>> Scopes();
+
+  // Warns once every time usage crosses the budget, 0 disables it
+  static void SetBudget(u64 bytes);
+  static u64 Budget();
+  static bool OverBudget();
+
+  static const char* CategoryName(GpuMemoryCategory category);
+  // ImGui window with live totals, peaks, per scope usage and the budget
+  static void RenderGui();
+
+private:
+  struct Allocation
+  {
+    u64 Size;
+    GpuMemoryCategory Category;
+    std::string Scope;
+  };
+
+  struct State
+  {
+    std::unordered_map<const void*, Allocation> allocations;
+    std::array<Stats, static_cast<size_t>(GpuMemoryCategory::Count)>
+      categories{};
+    std::unordered_map<std::string, u64> scopes;
+    Stats total{};
+    u64 budget{ 0 };
+    bool warned{ false };
+    std::mutex mutex;
+  };
+
+  static State& Get();
+  static void Track(const void* resource,
+                    u64 size,
+                    GpuMemoryCategory category,
+                    std::string_view scope);
+};
@@ -1,5 +1,62 @@
 #include "loaded_image.h"
 
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+// Caller memory handed to stb in place of its output allocation, see
+// ImageLoader::LoadInto. stb allocates the final image with its exact size,
+// intermediate buffers have different sizes.
+struct DecodeTarget
+{
+  void* Ptr{ nullptr };
+  size_t Size{ 0 };
+  bool Used{ false };
+};
+thread_local DecodeTarget decode_target{};
+
+void*
+DecodeMalloc(size_t size)
+{
+  auto& target = decode_target;
+  if (target.Ptr && !target.Used && size == target.Size) {
+    target.Used = true;
+    return target.Ptr;
+  }
+  return std::malloc(size);
+}
+
+void*
+DecodeRealloc(void* ptr, size_t size)
+{
+  auto& target = decode_target;
+  if (ptr == nullptr || ptr != target.Ptr) {
+    return std::realloc(ptr, size);
+  }
+  // The target can't grow, move the data to the heap
+  void* moved = std::malloc(size);
+  if (moved) {
+    std::memcpy(moved, ptr, std::min(size, target.Size));
+    target.Used = false;
+  }
+  return moved;
+}
+
+void
+DecodeFree(void* ptr)
+{
+  if (ptr != nullptr && ptr == decode_target.Ptr) {
+    decode_target.Used = false; // owned by the caller
+    return;
+  }
+  std::free(ptr);
+}
+} // namespace
+
+#define STBI_MALLOC(sz) DecodeMalloc(sz)
+#define STBI_REALLOC(p, newsz) DecodeRealloc(p, newsz)
+#define STBI_FREE(p) DecodeFree(p)
+
 #ifndef STB_IMAGE_IMPLEMENTATION
 #define STB_IMAGE_IMPLEMENTATION
 #endif
@@ -13,7 +70,7 @@ LoadedImage::~LoadedImage()
 }
 
 u8
-LoadedImage::BytesPerPixel()
+LoadedImage::BytesPerPixel() const
 {
   // Always assume 4 channels
   if (pixel_format == ImagePixelFormat::PIXELFORMAT_UINT) {
@@ -25,7 +82,7 @@ LoadedImage::BytesPerPixel()
 }
 
 u64
-LoadedImage::DataSize()
+LoadedImage::DataSize() const
 {
   return BytesPerPixel() * w * h;
 }
@@ -72,3 +129,78 @@ ImageLoader::Load(LoadedImage& out,
 
   return out.data != nullptr;
 }
+
+bool
+ImageLoader::Decode(LoadedImage& out,
+                    const Destination& dst,
+                    const std::function<void*()>& decode)
+{
+  const u64 size = out.DataSize();
+  void* target = dst(out);
+  if (target == nullptr) {
+    return false;
+  }
+
+  decode_target = DecodeTarget{ target, size, false };
+  void* decoded = decode();
+  decode_target = DecodeTarget{};
+  if (decoded == nullptr) {
+    LOG_ERROR("Couldn't decode image: {}", stbi_failure_reason());
+    return false;
+  }
+  if (decoded != target) { // stb took another path, fall back to a copy
+    LOG_DEBUG("Image wasn't decoded in place, copying {} bytes", size);
+    std::memcpy(target, decoded, size);
+    stbi_image_free(decoded);
+  }
+  return true;
+}
+
+bool
+ImageLoader::LoadInto(LoadedImage& out,
+                      std::filesystem::path path,
+                      const Destination& dst,
+                      ImageType img_type,
+                      ImagePixelFormat pixel_fmt)
+{
+  out.pixel_format = pixel_fmt;
+  out.image_type = img_type;
+  if (!stbi_info(path.c_str(), &out.w, &out.h, &out.nrChannels)) {
+    LOG_ERROR("Couldn't read image header {}: {}",
+              path.c_str(),
+              stbi_failure_reason());
+    return false;
+  }
+
+  return Decode(out, dst, [&]() -> void* {
+    i32 w, h, n;
+    if (pixel_fmt == ImagePixelFormat::PIXELFORMAT_FLOAT) {
+      return stbi_loadf(path.c_str(), &w, &h, &n, 4);
+    }
+    return stbi_load(path.c_str(), &w, &h, &n, 4);
+  });
+}
+
+bool
+ImageLoader::LoadInto(LoadedImage& out,
+                      const u8* data,
+                      i32 sz,
+                      const Destination& dst,
+                      ImageType img_type,
+                      ImagePixelFormat pixel_fmt)
+{
+  out.pixel_format = pixel_fmt;
+  out.image_type = img_type;
+  if (!stbi_info_from_memory(data, sz, &out.w, &out.h, &out.nrChannels)) {
+    LOG_ERROR("Couldn't read image header: {}", stbi_failure_reason());
+    return false;
+  }
+
+  return Decode(out, dst, [&]() -> void* {
+    i32 w, h, n;
+    if (pixel_fmt == ImagePixelFormat::PIXELFORMAT_FLOAT) {
+      return stbi_loadf_from_memory(data, sz, &w, &h, &n, 4);
+    }
+    return stbi_load_from_memory(data, sz, &w, &h, &n, 4);
+  });
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <functional>
+
 // Wether image pixel data represents a 2D texture or a cubemap
 enum class ImageType : u8
 {
@@ -26,13 +28,17 @@ struct LoadedImage
 
   ~LoadedImage();
 
-  u64 DataSize();
-  u8 BytesPerPixel();
+  u64 DataSize() const;
+  u8 BytesPerPixel() const;
 };
 
 class ImageLoader
 {
 public:
+  // Returns where to decode `info`, which holds info.DataSize() bytes, or
+  // nullptr to abort
+  using Destination = std::function<void*(const LoadedImage& info)>;
+
   static bool Load(
     LoadedImage& out,
     std::filesystem::path path,
@@ -45,4 +51,27 @@ public:
     i32 sz,
     ImageType img_type = ImageType::DIMENSIONS_2D,
     ImagePixelFormat pixel_fmt = ImagePixelFormat::PIXELFORMAT_UINT);
+
+  // Reads the header first and decodes straight into the memory returned by
+  // `dst` (e.g. mapped staging memory), skipping the intermediate heap copy.
+  // `out` only receives the image description, out.data stays null
+  static bool LoadInto(
+    LoadedImage& out,
+    std::filesystem::path path,
+    const Destination& dst,
+    ImageType img_type = ImageType::DIMENSIONS_2D,
+    ImagePixelFormat pixel_fmt = ImagePixelFormat::PIXELFORMAT_UINT);
+
+  static bool LoadInto(
+    LoadedImage& out,
+    const u8* data,
+    i32 sz,
+    const Destination& dst,
+    ImageType img_type = ImageType::DIMENSIONS_2D,
+    ImagePixelFormat pixel_fmt = ImagePixelFormat::PIXELFORMAT_UINT);
+
+private:
+  static bool Decode(LoadedImage& out,
+                     const Destination& dst,
+                     const std::function<void*()>& decode);
 };
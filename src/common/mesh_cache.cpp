@@ -0,0 +1,399 @@
+#include "mesh_cache.h"
+
+#include "common/logger.h"
+#include "common/types.h"
+#include "common/util.h"
+
+#include <charconv>
+#include <cstring>
+
+#include <fastgltf/core.hpp>
+#include <pch.h>
+
+namespace {
+struct Section
+{
+  u64 Offset;
+  u64 Size; // bytes
+};
+
+// Identifies a version of a file the entry was baked from
+struct FileStamp
+{
+  u64 Size;
+  i64 Mtime;
+  u64 ContentHash;
+};
+
+struct FileHeader
+{
+  u32 Magic;
+  u32 Version;
+  u32 HeaderSize;
+  u32 BakeKey;
+  FileStamp Source;
+  Section Buffers; // FileStamp of each external buffer, in order
+  Section Meshes;
+  Section Submeshes;
+  Section Lods;
+  Section Meshlets;
+  Section Nodes;
+  Section Children;
+  Section Instances;
+  Section Vertices;
+  Section Indices;
+  Section Names;
+};
+
+bool
+source_stamp(const std::filesystem::path& source, u64* size, i64* mtime)
+{
+  std::error_code ec;
+  *size = std::filesystem::file_size(source, ec);
+  if (ec) {
+    return false;
+  }
+  *mtime = std::filesystem::last_write_time(source, ec)
+             .time_since_epoch()
+             .count();
+  return !ec;
+}
+
+bool
+stamp_file(const std::filesystem::path& path, FileStamp* out)
+{
+  if (!source_stamp(path, &out->Size, &out->Mtime)) {
+    LOG_WARN("MeshCache: couldn't stat {}", path.string());
+    return false;
+  }
+  out->ContentHash = MeshCache::HashFile(path);
+  return true;
+}
+
+// A touched but unchanged file still matches
+bool
+stamp_matches(const std::filesystem::path& path, const FileStamp& stamp)
+{
+  u64 size{ 0 };
+  i64 mtime{ 0 };
+  return source_stamp(path, &size, &mtime) && size == stamp.Size &&
+         (mtime == stamp.Mtime ||
+          MeshCache::HashFile(path) == stamp.ContentHash);
+}
+
+// Typed span over a section, empty if it doesn't fit the file
+template<typename T>
+std::span<const T>
+section_span(std::span<const u8> file, const Section& section, bool* ok)
+{
+  if (section.Offset % alignof(T) != 0 || section.Size % sizeof(T) != 0 ||
+      section.Offset > file.size() ||
+      section.Size > file.size() - section.Offset) {
+    *ok = false;
+    return {};
+  }
+  return { reinterpret_cast<const T*>(file.data() + section.Offset),
+           section.Size / sizeof(T) };
+}
+
+// Every range of the view stays within its sections
+bool
+validate(const MeshCache::View& view)
+{
+  for (const auto& mesh : view.Meshes) {
+    const u64 stride = VertexFormatStride(mesh.Layout());
+    if (stride == 0 || (mesh.IndexSize != 2 && mesh.IndexSize != 4)) {
+      return false;
+    }
+    const u64 vert_bytes = stride * mesh.VertexCount;
+    const u64 idx_bytes = u64(mesh.IndexSize) * mesh.IndexCount;
+    if (mesh.VertexOffset > view.Vertices.size() ||
+        vert_bytes > view.Vertices.size() - mesh.VertexOffset ||
+        mesh.IndexOffset > view.Indices.size() ||
+        idx_bytes > view.Indices.size() - mesh.IndexOffset ||
+        u64(mesh.FirstSubmesh) + mesh.SubmeshCount > view.Submeshes.size() ||
+        u64(mesh.NameOffset) + mesh.NameLength > view.Names.size()) {
+      return false;
+    }
+    for (u32 i = 0; i < mesh.SubmeshCount; ++i) {
+      const auto& sub = view.Submeshes[mesh.FirstSubmesh + i];
+      if (u64(sub.FirstIndex) + sub.IndexCount > mesh.IndexCount ||
+          u64(sub.FirstLod) + sub.LodCount > view.Lods.size() ||
+          u64(sub.FirstMeshlet) + sub.MeshletCount > view.Meshlets.size()) {
+        return false;
+      }
+      for (const auto& lod : view.Lods.subspan(sub.FirstLod, sub.LodCount)) {
+        if (u64(lod.FirstIndex) + lod.IndexCount > mesh.IndexCount) {
+          return false;
+        }
+      }
+      for (const auto& meshlet :
+           view.Meshlets.subspan(sub.FirstMeshlet, sub.MeshletCount)) {
+        if (u64(meshlet.FirstIndex) + meshlet.IndexCount > mesh.IndexCount) {
+          return false;
+        }
+      }
+    }
+  }
+  for (const auto& node : view.Nodes) {
+    if (node.MeshIndex >= i64(view.Meshes.size()) ||
+        u64(node.FirstChild) + node.ChildCount > view.Children.size() ||
+        u64(node.FirstInstance) + node.InstanceCount > view.Instances.size()) {
+      return false;
+    }
+  }
+  for (u32 child : view.Children) {
+    if (child >= view.Nodes.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+}
+
+MeshCache::View
+MeshCache::Data::Get() const
+{
+  View ret{};
+  {
+    ret.Meshes = Meshes;
+    ret.Submeshes = Submeshes;
+    ret.Lods = Lods;
+    ret.Meshlets = Meshlets;
+    ret.Nodes = Nodes;
+    ret.Children = Children;
+    ret.Instances = Instances;
+    ret.Vertices = Vertices;
+    ret.Indices = Indices;
+    ret.Names = Names;
+  }
+  return ret;
+}
+
+void
+MeshCache::Data::Append(const Data& meshes)
+{
+  for (BakedMesh mesh : meshes.Meshes) {
+    mesh.VertexOffset += Vertices.size();
+    mesh.IndexOffset += Indices.size();
+    mesh.FirstSubmesh += Submeshes.size();
+    mesh.NameOffset += Names.size();
+    Meshes.push_back(mesh);
+  }
+  for (BakedSubmesh sub : meshes.Submeshes) {
+    sub.FirstLod += Lods.size();
+    sub.FirstMeshlet += Meshlets.size();
+    Submeshes.push_back(sub);
+  }
+  Lods.insert(Lods.end(), meshes.Lods.begin(), meshes.Lods.end());
+  Meshlets.insert(
+    Meshlets.end(), meshes.Meshlets.begin(), meshes.Meshlets.end());
+  Vertices.insert(
+    Vertices.end(), meshes.Vertices.begin(), meshes.Vertices.end());
+  Indices.insert(Indices.end(), meshes.Indices.begin(), meshes.Indices.end());
+  Names += meshes.Names;
+}
+
+MeshCache::MeshCache(std::filesystem::path cache_dir)
+  : cache_dir_{ std::move(cache_dir) }
+{
+}
+
+MeshCache::~MeshCache()
+{
+  Close();
+}
+
+std::filesystem::path
+MeshCache::EntryPath(const std::filesystem::path& source) const
+{
+  std::error_code ec;
+  auto abs = std::filesystem::absolute(source, ec).lexically_normal();
+  const auto key = (ec ? source : abs).string();
+  const u64 hash = Fnv1a(key.data(), key.size());
+
+  char name[17]{};
+  std::to_chars(name, name + 16, hash, 16);
+  return cache_dir_ / (std::string{ name } + ".mesh");
+}
+
+u64
+MeshCache::HashFile(const std::filesystem::path& path)
+{
+  SDL_IOStream* io = SDL_IOFromFile(path.string().c_str(), "rb");
+  if (!io) {
+    LOG_WARN("Couldn't open {} for hashing: {}", path.string(), GETERR);
+    return 0;
+  }
+  std::vector<u8> chunk(1024 * 1024);
+  u64 hash = Fnv1aOffset;
+  size_t read{ 0 };
+  while ((read = SDL_ReadIO(io, chunk.data(), chunk.size())) > 0) {
+    hash = Fnv1a(chunk.data(), read, hash);
+  }
+  SDL_CloseIO(io);
+  return hash;
+}
+
+bool
+MeshCache::Map(const std::filesystem::path& path)
+{
+#if FASTGLTF_HAS_MEMORY_MAPPED_FILE
+  auto file = fastgltf::MappedGltfFile::FromPath(path);
+  if (file.error() != fastgltf::Error::None) {
+    return false;
+  }
+  mapped_ = std::make_unique<fastgltf::MappedGltfFile>(std::move(file.get()));
+  auto bytes = mapped_->read(mapped_->totalSize(), 0);
+  file_ = { reinterpret_cast<const u8*>(bytes.data()), bytes.size() };
+#else
+  size_t size{ 0 };
+  void* data = SDL_LoadFile(path.string().c_str(), &size);
+  if (!data) {
+    return false;
+  }
+  bytes_.assign(static_cast<u8*>(data), static_cast<u8*>(data) + size);
+  SDL_free(data);
+  file_ = bytes_;
+#endif
+  return true;
+}
+
+void
+MeshCache::Close()
+{
+  view_ = {};
+  file_ = {};
+  bytes_.clear();
+#if FASTGLTF_HAS_MEMORY_MAPPED_FILE
+  mapped_ = nullptr;
+#endif
+}
+
+bool
+MeshCache::Open(const std::filesystem::path& source,
+                u32 bake_key,
+                std::span<const std::filesystem::path> buffers)
+{
+  Close();
+  const auto path = EntryPath(source);
+  std::error_code ec;
+  if (!std::filesystem::exists(path, ec)) {
+    LOG_DEBUG("MeshCache: no entry for {}", source.string());
+    return false;
+  }
+  if (!Map(path)) {
+    LOG_WARN("MeshCache: couldn't map {}", path.string());
+    return false;
+  }
+
+  FileHeader header{};
+  if (file_.size() < sizeof(header)) {
+    LOG_WARN("MeshCache: {} is truncated", path.string());
+    Close();
+    return false;
+  }
+  std::memcpy(&header, file_.data(), sizeof(header));
+  if (header.Magic != Magic || header.Version != Version ||
+      header.HeaderSize != sizeof(header) || header.BakeKey != bake_key) {
+    LOG_DEBUG("MeshCache: {} was baked by another version or settings",
+              path.string());
+    Close();
+    return false;
+  }
+
+  bool ok{ true };
+  auto stamps = section_span<FileStamp>(file_, header.Buffers, &ok);
+  bool current = ok && stamp_matches(source, header.Source) &&
+                 stamps.size() == buffers.size();
+  for (size_t i = 0; current && i < buffers.size(); ++i) {
+    current = stamp_matches(buffers[i], stamps[i]);
+  }
+  if (!current) {
+    LOG_DEBUG("MeshCache: {} is stale", source.string());
+    Close();
+    return false;
+  }
+
+  view_.Meshes = section_span<BakedMesh>(file_, header.Meshes, &ok);
+  view_.Submeshes = section_span<BakedSubmesh>(file_, header.Submeshes, &ok);
+  view_.Lods = section_span<BakedLod>(file_, header.Lods, &ok);
+  view_.Meshlets = section_span<BakedMeshlet>(file_, header.Meshlets, &ok);
+  view_.Nodes = section_span<BakedNode>(file_, header.Nodes, &ok);
+  view_.Children = section_span<u32>(file_, header.Children, &ok);
+  view_.Instances = section_span<glm::mat4>(file_, header.Instances, &ok);
+  view_.Vertices = section_span<u8>(file_, header.Vertices, &ok);
+  view_.Indices = section_span<u8>(file_, header.Indices, &ok);
+  auto names = section_span<char>(file_, header.Names, &ok);
+  view_.Names = { names.data(), names.size() };
+  if (!ok || !validate(view_)) {
+    LOG_WARN("MeshCache: {} is corrupted", path.string());
+    Close();
+    return false;
+  }
+  LOG_DEBUG("MeshCache: mapped {} meshes from {}",
+            view_.Meshes.size(),
+            path.string());
+  return true;
+}
+
+bool
+MeshCache::Write(const std::filesystem::path& source,
+                 const Data& data,
+                 u32 bake_key,
+                 std::span<const std::filesystem::path> buffers) const
+{
+  FileHeader header{};
+  {
+    header.Magic = Magic;
+    header.Version = Version;
+    header.HeaderSize = sizeof(header);
+    header.BakeKey = bake_key;
+  }
+  std::vector<FileStamp> stamps(buffers.size());
+  if (!stamp_file(source, &header.Source)) {
+    return false;
+  }
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    if (!stamp_file(buffers[i], &stamps[i])) {
+      return false;
+    }
+  }
+
+  std::vector<u8> out(sizeof(header));
+  auto append = [&out](const auto& items) {
+    const auto* bytes = reinterpret_cast<const u8*>(items.data());
+    const u64 size = items.size() * sizeof(items[0]);
+    constexpr u64 mask = SectionAlignment - 1;
+    out.resize((out.size() + mask) & ~mask);
+    Section ret{ out.size(), size };
+    out.insert(out.end(), bytes, bytes + size);
+    return ret;
+  };
+  header.Buffers = append(stamps);
+  header.Meshes = append(data.Meshes);
+  header.Submeshes = append(data.Submeshes);
+  header.Lods = append(data.Lods);
+  header.Meshlets = append(data.Meshlets);
+  header.Nodes = append(data.Nodes);
+  header.Children = append(data.Children);
+  header.Instances = append(data.Instances);
+  header.Vertices = append(data.Vertices);
+  header.Indices = append(data.Indices);
+  header.Names = append(data.Names);
+  std::memcpy(out.data(), &header, sizeof(header));
+
+  const auto path = EntryPath(source);
+  auto save = [&out](const std::filesystem::path& tmp) {
+    if (!SDL_SaveFile(tmp.string().c_str(), out.data(), out.size())) {
+      LOG_WARN("MeshCache: couldn't write {}: {}", tmp.string(), GETERR);
+      return false;
+    }
+    return true;
+  };
+  if (!WriteFileAtomically(path, save)) {
+    return false;
+  }
+  LOG_DEBUG("MeshCache: wrote {} bytes to {}", out.size(), path.string());
+  return true;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include "common/types.h"
+#include "common/util.h"
+#include "common/vertex_formats.h"
+#include <fastgltf/core.hpp>
+#include <filesystem>
+#include <glm/ext/matrix_float4x4.hpp>
+#include <glm/ext/vector_float3.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Records of a baked scene, laid out exactly as stored on disk
+struct BakedMesh
+{
+  u64 VertexOffset; // bytes into the vertex section
+  u64 IndexOffset; // bytes into the index section
+  u32 VertexCount;
+  u32 IndexCount; // indices are relative to the mesh
+  u32 FirstSubmesh;
+  u32 SubmeshCount;
+  u32 NameOffset; // into the name section
+  u32 NameLength;
+  u32 Format; // VertexFormat
+  u32 IndexSize; // bytes per index, 2 or 4
+  glm::vec3 BoundsMin; // object space, also quantizes positions
+  f32 Pad0;
+  glm::vec3 BoundsMax;
+  f32 Pad1;
+
+  VertexFormat Layout() const { return static_cast<VertexFormat>(Format); }
+};
+
+struct BakedSubmesh
+{
+  u32 FirstIndex; // relative to the mesh
+  u32 IndexCount;
+  i32 MaterialIndex; // -1 for the default material
+  u32 FirstLod; // into the LOD section, the submesh itself is level 0
+  u32 LodCount;
+  u32 FirstMeshlet; // into the meshlet section, they split level 0
+  u32 MeshletCount;
+  u32 Pad;
+};
+
+// Simplified index range of a submesh, in the mesh's index range
+struct BakedLod
+{
+  u32 FirstIndex; // relative to the mesh
+  u32 IndexCount;
+  f32 Error; // object space distance to the full mesh
+  u32 Pad;
+};
+
+// Cluster of a submesh, see MeshOptimizer::Meshlet
+struct BakedMeshlet
+{
+  glm::vec3 Center; // object space bounding sphere
+  f32 Radius;
+  glm::vec3 ConeAxis; // normal cone, never culls with a cutoff of 1
+  f32 ConeCutoff;
+  u32 FirstIndex; // relative to the mesh
+  u32 IndexCount;
+  u32 Pad[2];
+};
+
+struct BakedNode
+{
+  glm::mat4 LocalMatrix;
+  i32 MeshIndex; // -1 for plain nodes
+  u32 FirstChild; // into the children section
+  u32 ChildCount;
+  // Into the instance section, EXT_mesh_gpu_instancing. None draws the mesh
+  // once, at the node
+  u32 FirstInstance;
+  u32 InstanceCount;
+  u32 Pad[3];
+};
+
+// On-disk cache of post-processed glTF geometry: packed vertices (with
+// generated tangents), 16 or 32 bit indices, submesh ranges with their
+// material index, LOD ranges and meshlets, the node hierarchy with its
+// instance transforms and mesh bounds. Entries are keyed by the source path
+// and validated against the mtime and size of the source and of its external
+// buffers, then against a content hash when a file was only touched. The file
+// is memory mapped and its sections are uploaded as is, nothing is rebuilt on
+// reload.
+class MeshCache
+{
+public:
+  static constexpr u32 Magic = 0x4853454D; // "MESH"
+  // Bump whenever the baking (vertex layout, tangents...) changes
+  static constexpr u32 Version = 7;
+  static constexpr u32 SectionAlignment = 16;
+
+  // Read-only view of baked data, either in memory or in a mapped cache file
+  struct View
+  {
+    std::span<const BakedMesh> Meshes{};
+    std::span<const BakedSubmesh> Submeshes{};
+    std::span<const BakedLod> Lods{};
+    std::span<const BakedMeshlet> Meshlets{};
+    std::span<const BakedNode> Nodes{};
+    std::span<const u32> Children{};
+    std::span<const glm::mat4> Instances{}; // node space
+    std::span<const u8> Vertices{};
+    std::span<const u8> Indices{};
+    std::string_view Names{};
+
+    std::string_view Name(const BakedMesh& mesh) const
+    {
+      return Names.substr(mesh.NameOffset, mesh.NameLength);
+    }
+    const u8* MeshVertices(const BakedMesh& mesh) const
+    {
+      return Vertices.data() + mesh.VertexOffset;
+    }
+    const u8* MeshIndices(const BakedMesh& mesh) const
+    {
+      return Indices.data() + mesh.IndexOffset;
+    }
+  };
+
+  // Baked data being built from a freshly loaded scene
+  struct Data
+  {
+    std::vector<BakedMesh> Meshes{};
+    std::vector<BakedSubmesh> Submeshes{};
+    std::vector<BakedLod> Lods{};
+    std::vector<BakedMeshlet> Meshlets{};
+    std::vector<BakedNode> Nodes{};
+    std::vector<u32> Children{};
+    std::vector<glm::mat4> Instances{};
+    std::vector<u8> Vertices{};
+    std::vector<u8> Indices{};
+    std::string Names{};
+
+    View Get() const;
+    // Appends meshes baked on their own, rebasing their offsets. Nodes of
+    // `meshes` are left out, they index the whole scene's meshes
+    void Append(const Data& meshes);
+  };
+
+public:
+  DISABLE_COPY_AND_MOVE(MeshCache);
+  explicit MeshCache(std::filesystem::path cache_dir = "cache/meshes");
+  ~MeshCache();
+
+  // Maps the entry of `source` if it's up to date and was baked with the same
+  // settings (`bake_key`). `buffers` are the files the source reads geometry
+  // from (.bin), the same list it was written with. The view stays valid
+  // until Close() or the next Open()
+  bool Open(const std::filesystem::path& source,
+            u32 bake_key = 0,
+            std::span<const std::filesystem::path> buffers = {});
+  void Close();
+  const View& Get() const { return view_; }
+
+  bool Write(const std::filesystem::path& source,
+             const Data& data,
+             u32 bake_key = 0,
+             std::span<const std::filesystem::path> buffers = {}) const;
+
+  std::filesystem::path EntryPath(const std::filesystem::path& source) const;
+  static u64 HashFile(const std::filesystem::path& path);
+
+private:
+  bool Map(const std::filesystem::path& path);
+
+private:
+  std::filesystem::path cache_dir_;
+#if FASTGLTF_HAS_MEMORY_MAPPED_FILE
+  UniquePtr<fastgltf::MappedGltfFile> mapped_{ nullptr };
+#endif
+  std::vector<u8> bytes_{}; // when files can't be mapped
+  std::span<const u8> file_{};
+  View view_{};
+};
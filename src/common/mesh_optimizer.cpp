@@ -0,0 +1,750 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_set>
+#include <unordered_map>
+
+#include <pch.h>
+
+namespace {
+// FIFO post-transform cache, vertices are in it while less than `size` misses
+// happened since their own
+class CacheSim
+{
+public:
+  CacheSim(size_t vertex_count, u32 size)
+    : stamps_(vertex_count, 0)
+    , time_{ size }
+    , size_{ size }
+  {
+  }
+
+  // True on a miss
+  bool Access(u32 v)
+  {
+    if (time_ - stamps_[v] < size_) {
+      return false;
+    }
+    stamps_[v] = time_++;
+    return true;
+  }
+  void Flush() { time_ += size_; }
+
+private:
+  std::vector<u32> stamps_;
+  u32 time_;
+  u32 size_;
+};
+
+// Triangles around each vertex, compressed
+struct Adjacency
+{
+  std::vector<u32> Offsets{};
+  std::vector<u32> Triangles{};
+
+  Adjacency(std::span<const u32> indices, size_t vertex_count)
+    : Offsets(vertex_count + 1, 0)
+    , Triangles(indices.size())
+  {
+    for (u32 v : indices) {
+      ++Offsets[v + 1];
+    }
+    std::partial_sum(Offsets.begin(), Offsets.end(), Offsets.begin());
+    std::vector<u32> fill{ Offsets.begin(), Offsets.end() - 1 };
+    for (size_t i = 0; i < indices.size(); ++i) {
+      Triangles[fill[indices[i]]++] = static_cast<u32>(i / 3);
+    }
+  }
+  std::span<const u32> Of(u32 v) const
+  {
+    return { Triangles.data() + Offsets[v], Offsets[v + 1] - Offsets[v] };
+  }
+};
+
+struct VertexKey
+{
+  const u8* Data;
+  size_t Size;
+
+  bool operator==(const VertexKey& o) const
+  {
+    return std::memcmp(Data, o.Data, Size) == 0;
+  }
+};
+
+struct VertexKeyHash
+{
+  size_t operator()(const VertexKey& k) const
+  {
+    return static_cast<size_t>(Fnv1a(k.Data, k.Size));
+  }
+};
+
+// Sum of squared distances to planes, weighted by the triangle areas
+struct Quadric
+{
+  f64 A00{ 0 }, A01{ 0 }, A02{ 0 }, A03{ 0 };
+  f64 A11{ 0 }, A12{ 0 }, A13{ 0 };
+  f64 A22{ 0 }, A23{ 0 };
+  f64 A33{ 0 };
+  f64 Weight{ 0 };
+
+  void AddPlane(glm::dvec3 n, f64 d, f64 weight)
+  {
+    A00 += weight * n.x * n.x;
+    A01 += weight * n.x * n.y;
+    A02 += weight * n.x * n.z;
+    A03 += weight * n.x * d;
+    A11 += weight * n.y * n.y;
+    A12 += weight * n.y * n.z;
+    A13 += weight * n.y * d;
+    A22 += weight * n.z * n.z;
+    A23 += weight * n.z * d;
+    A33 += weight * d * d;
+    Weight += weight;
+  }
+
+  Quadric& operator+=(const Quadric& o)
+  {
+    A00 += o.A00;
+    A01 += o.A01;
+    A02 += o.A02;
+    A03 += o.A03;
+    A11 += o.A11;
+    A12 += o.A12;
+    A13 += o.A13;
+    A22 += o.A22;
+    A23 += o.A23;
+    A33 += o.A33;
+    Weight += o.Weight;
+    return *this;
+  }
+
+  // Mean squared distance of `p` to the planes
+  f64 Error(glm::dvec3 p) const
+  {
+    if (!(Weight > 0)) {
+      return 0;
+    }
+    const f64 e = A00 * p.x * p.x + 2 * A01 * p.x * p.y +
+                  2 * A02 * p.x * p.z + 2 * A03 * p.x + A11 * p.y * p.y +
+                  2 * A12 * p.y * p.z + 2 * A13 * p.y + A22 * p.z * p.z +
+                  2 * A23 * p.z + A33;
+    return std::max(e / Weight, 0.0);
+  }
+};
+
+u64
+edge_key(u32 a, u32 b)
+{
+  return (u64(a) << 32) | b;
+}
+
+glm::vec3
+position(const void* positions, size_t stride, u32 v)
+{
+  glm::vec3 ret{};
+  std::memcpy(&ret, static_cast<const u8*>(positions) + v * stride, 12);
+  return ret;
+}
+}
+
+u32
+MeshOptimizer::Options::Key() const
+{
+  const f32 values[] = {
+    Weld ? 1.f : 0.f,
+    VertexCache ? 1.f : 0.f,
+    Overdraw ? OverdrawThreshold : 0.f,
+    VertexFetch ? 1.f : 0.f,
+    f32(CacheSize),
+    f32(MaxLods),
+    LodMaxError,
+    Meshlets ? f32(MeshletVertices) : 0.f,
+    Meshlets ? f32(MeshletTriangles) : 0.f,
+  };
+  u32 hash = 0x811c9dc5u; // FNV-1a
+  for (f32 v : values) {
+    hash = (hash ^ std::bit_cast<u32>(v)) * 0x01000193u;
+  }
+  return hash;
+}
+
+f32
+MeshOptimizer::Acmr(std::span<const u32> indices,
+                    size_t vertex_count,
+                    u32 cache_size)
+{
+  if (indices.size() < 3) {
+    return 0.f;
+  }
+  CacheSim cache{ vertex_count, cache_size };
+  u64 misses{ 0 };
+  for (u32 v : indices) {
+    misses += cache.Access(v) ? 1 : 0;
+  }
+  return static_cast<f32>(misses) / static_cast<f32>(indices.size() / 3);
+}
+
+size_t
+MeshOptimizer::WeldRemap(const void* vertices,
+                         size_t vertex_count,
+                         size_t stride,
+                         std::vector<u32>* remap)
+{
+  const auto* bytes = static_cast<const u8*>(vertices);
+  std::unordered_map<VertexKey, u32, VertexKeyHash> unique{};
+  unique.reserve(vertex_count);
+  remap->resize(vertex_count);
+  for (size_t i = 0; i < vertex_count; ++i) {
+    auto [it, inserted] = unique.try_emplace(
+      VertexKey{ bytes + i * stride, stride }, static_cast<u32>(unique.size()));
+    (*remap)[i] = it->second;
+  }
+  return unique.size();
+}
+
+size_t
+MeshOptimizer::FetchRemap(std::span<const u32> indices,
+                          size_t vertex_count,
+                          std::vector<u32>* remap)
+{
+  remap->assign(vertex_count, ~0u);
+  u32 next{ 0 };
+  for (u32 v : indices) {
+    if ((*remap)[v] == ~0u) {
+      (*remap)[v] = next++;
+    }
+  }
+  return next;
+}
+
+// Tipsify: fans around a vertex, then moves to the neighbour that is still in
+// the cache and has the fewest triangles left, or back along a dead end stack
+void
+MeshOptimizer::OptimizeVertexCache(std::span<u32> indices,
+                                   size_t vertex_count,
+                                   u32 cache_size)
+{
+  const size_t tri_count = indices.size() / 3;
+  if (tri_count == 0) {
+    return;
+  }
+  const Adjacency adjacency{ indices, vertex_count };
+  std::vector<u32> live(vertex_count, 0);
+  for (u32 v : indices) {
+    ++live[v];
+  }
+  std::vector<u32> stamps(vertex_count, 0);
+  std::vector<bool> emitted(tri_count, false);
+  std::vector<u32> dead_ends{};
+  std::vector<u32> candidates{};
+  std::vector<u32> out{};
+  out.reserve(indices.size());
+
+  u32 time{ cache_size + 1 };
+  size_t cursor{ 0 }; // into `indices`, for fresh starts
+  i64 fan = indices[0];
+  while (fan >= 0) {
+    candidates.clear();
+    for (u32 tri : adjacency.Of(static_cast<u32>(fan))) {
+      if (emitted[tri]) {
+        continue;
+      }
+      emitted[tri] = true;
+      for (u32 k = 0; k < 3; ++k) {
+        const u32 v = indices[tri * 3 + k];
+        out.push_back(v);
+        dead_ends.push_back(v);
+        candidates.push_back(v);
+        --live[v];
+        if (time - stamps[v] > cache_size) {
+          stamps[v] = time++;
+        }
+      }
+    }
+
+    // Neighbours still in the cache after their remaining fan was emitted
+    fan = -1;
+    i64 best_priority{ -1 };
+    for (u32 v : candidates) {
+      if (live[v] == 0) {
+        continue;
+      }
+      i64 priority{ 0 };
+      if (time - stamps[v] + 2 * live[v] <= cache_size) {
+        priority = time - stamps[v];
+      }
+      if (priority > best_priority) {
+        best_priority = priority;
+        fan = v;
+      }
+    }
+    while (fan < 0 && !dead_ends.empty()) {
+      const u32 v = dead_ends.back();
+      dead_ends.pop_back();
+      if (live[v] > 0) {
+        fan = v;
+      }
+    }
+    while (fan < 0 && cursor < indices.size()) {
+      const u32 v = indices[cursor++];
+      if (live[v] > 0) {
+        fan = v;
+      }
+    }
+  }
+  std::copy(out.begin(), out.end(), indices.begin());
+}
+
+void
+MeshOptimizer::OptimizeOverdraw(std::span<u32> indices,
+                                const void* positions,
+                                size_t vertex_count,
+                                size_t stride,
+                                f32 threshold,
+                                u32 cache_size)
+{
+  const size_t tri_count = indices.size() / 3;
+  if (tri_count < 2) {
+    return;
+  }
+
+  // Cluster boundaries where the cache is reset, cut as soon as the cluster's
+  // own ACMR is close enough to the whole range's
+  const f32 target = Acmr(indices, vertex_count, cache_size) * threshold;
+  std::vector<size_t> clusters{ 0 }; // first triangle of each
+  {
+    CacheSim cache{ vertex_count, cache_size };
+    u32 misses{ 0 };
+    size_t first{ 0 };
+    for (size_t t = 0; t < tri_count; ++t) {
+      for (u32 k = 0; k < 3; ++k) {
+        misses += cache.Access(indices[t * 3 + k]) ? 1 : 0;
+      }
+      const f32 acmr = static_cast<f32>(misses) / f32(t + 1 - first);
+      if (acmr <= target && t + 1 < tri_count) {
+        clusters.push_back(t + 1);
+        first = t + 1;
+        misses = 0;
+        cache.Flush();
+      }
+    }
+  }
+
+  // Outward facing clusters (relative to the range's centroid) occlude more
+  // of the mesh, they're drawn first
+  struct Cluster
+  {
+    size_t First;
+    size_t Count;
+    f32 Sort;
+  };
+  std::vector<Cluster> sorted{};
+  sorted.reserve(clusters.size());
+  glm::vec3 centroid{ 0.f };
+  f32 total_area{ 0.f };
+  std::vector<glm::vec3> centers(clusters.size(), glm::vec3{ 0.f });
+  std::vector<glm::vec3> normals(clusters.size(), glm::vec3{ 0.f });
+  std::vector<f32> areas(clusters.size(), 0.f);
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    const size_t end = c + 1 < clusters.size() ? clusters[c + 1] : tri_count;
+    for (size_t t = clusters[c]; t < end; ++t) {
+      const glm::vec3 a = position(positions, stride, indices[t * 3]);
+      const glm::vec3 b = position(positions, stride, indices[t * 3 + 1]);
+      const glm::vec3 d = position(positions, stride, indices[t * 3 + 2]);
+      const glm::vec3 n = glm::cross(b - a, d - a);
+      const f32 area = glm::length(n);
+      centers[c] += (a + b + d) * (area / 3.f);
+      normals[c] += n;
+      areas[c] += area;
+    }
+    centroid += centers[c];
+    total_area += areas[c];
+    sorted.push_back({ clusters[c], end - clusters[c], 0.f });
+  }
+  if (!(total_area > 0.f)) {
+    return;
+  }
+  centroid /= total_area;
+  for (size_t c = 0; c < sorted.size(); ++c) {
+    if (areas[c] > 0.f && glm::length(normals[c]) > 0.f) {
+      sorted[c].Sort = glm::dot(centers[c] / areas[c] - centroid,
+                                glm::normalize(normals[c]));
+    }
+  }
+  std::stable_sort(
+    sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+      return a.Sort > b.Sort;
+    });
+
+  std::vector<u32> out{};
+  out.reserve(indices.size());
+  for (const auto& c : sorted) {
+    out.insert(out.end(),
+               indices.begin() + c.First * 3,
+               indices.begin() + (c.First + c.Count) * 3);
+  }
+  std::copy(out.begin(), out.end(), indices.begin());
+}
+
+std::vector<u32>
+MeshOptimizer::Simplify(std::span<const u32> indices,
+                        const void* positions,
+                        size_t vertex_count,
+                        size_t stride,
+                        size_t target_index_count,
+                        f32 target_error,
+                        f32* out_error)
+{
+  std::vector<u32> ret{ indices.begin(), indices.end() };
+  f64 max_cost{ 0 };
+  *out_error = 0.f;
+  if (ret.size() < 3 || ret.size() <= target_index_count) {
+    return ret;
+  }
+  auto pos = [&](u32 v) { return position(positions, stride, v); };
+
+  // Vertices sharing a position are merged into the first one
+  std::vector<u32> canonical(vertex_count);
+  std::vector<u32> siblings(vertex_count, 0);
+  {
+    const auto* bytes = static_cast<const u8*>(positions);
+    std::unordered_map<VertexKey, u32, VertexKeyHash> unique{};
+    unique.reserve(vertex_count);
+    for (size_t v = 0; v < vertex_count; ++v) {
+      auto [it, inserted] = unique.try_emplace(
+        VertexKey{ bytes + v * stride, sizeof(glm::vec3) }, u32(v));
+      canonical[v] = it->second;
+    }
+  }
+  {
+    std::vector<bool> referenced(vertex_count, false);
+    for (u32 v : ret) {
+      if (!referenced[v]) {
+        referenced[v] = true;
+        ++siblings[canonical[v]];
+      }
+    }
+  }
+
+  // Seams, open and non manifold edges lock their vertices
+  std::vector<bool> locked(vertex_count, false);
+  {
+    std::unordered_set<u64> edges{};
+    std::unordered_set<u64> repeated{};
+    edges.reserve(ret.size());
+    for (size_t i = 0; i < ret.size(); ++i) {
+      const u32 a = canonical[ret[i]];
+      const u32 b = canonical[ret[i - i % 3 + (i + 1) % 3]];
+      if (!edges.insert(edge_key(a, b)).second) {
+        repeated.insert(edge_key(a, b));
+      }
+    }
+    for (u64 e : edges) {
+      const u32 a = u32(e >> 32);
+      const u32 b = u32(e);
+      if (!edges.contains(edge_key(b, a)) || repeated.contains(e)) {
+        locked[a] = true;
+        locked[b] = true;
+      }
+    }
+    for (size_t v = 0; v < vertex_count; ++v) {
+      if (siblings[v] > 1) {
+        locked[v] = true;
+      }
+    }
+  }
+
+  std::vector<Quadric> quadrics(vertex_count);
+  for (size_t t = 0; t + 2 < ret.size(); t += 3) {
+    const glm::dvec3 a{ pos(ret[t]) };
+    const glm::dvec3 b{ pos(ret[t + 1]) };
+    const glm::dvec3 c{ pos(ret[t + 2]) };
+    glm::dvec3 n = glm::cross(b - a, c - a);
+    const f64 area = glm::length(n);
+    if (!(area > 0)) {
+      continue;
+    }
+    n /= area;
+    for (u32 k = 0; k < 3; ++k) {
+      quadrics[canonical[ret[t + k]]].AddPlane(n, -glm::dot(n, a), area);
+    }
+  }
+
+  struct Collapse
+  {
+    f64 Cost;
+    u32 From;
+    u32 To;
+  };
+  std::vector<Collapse> collapses{};
+  std::vector<u32> remap(vertex_count);
+  std::vector<bool> touched(vertex_count);
+  const f64 max_error = f64(target_error) * target_error;
+  while (ret.size() > target_index_count) {
+    const Adjacency adjacency{ ret, vertex_count };
+
+    // Only unlocked vertices move. Planes live on the canonical vertex, which
+    // isn't `from` when only a duplicate of it is referenced
+    collapses.clear();
+    for (size_t i = 0; i < ret.size(); ++i) {
+      const u32 from = ret[i];
+      const u32 to = ret[i - i % 3 + (i + 1) % 3];
+      if (locked[canonical[from]] || from == to) {
+        continue;
+      }
+      Quadric q = quadrics[canonical[from]];
+      q += quadrics[canonical[to]];
+      collapses.push_back({ q.Error(glm::dvec3{ pos(to) }), from, to });
+    }
+    std::sort(collapses.begin(),
+              collapses.end(),
+              [](const Collapse& a, const Collapse& b) {
+                return a.Cost < b.Cost;
+              });
+
+    std::iota(remap.begin(), remap.end(), 0u);
+    std::fill(touched.begin(), touched.end(), false);
+    size_t removed{ 0 }; // triangles
+    const size_t wanted = (ret.size() - target_index_count + 2) / 3;
+    for (const auto& c : collapses) {
+      if (c.Cost > max_error || removed >= wanted) {
+        break;
+      }
+      if (touched[c.From] || touched[c.To]) {
+        continue;
+      }
+      // Triangles around `From` must not flip once it moves to `To`
+      bool flips{ false };
+      size_t degenerate{ 0 };
+      const glm::vec3 target = pos(c.To);
+      for (u32 tri : adjacency.Of(c.From)) {
+        const u32* t = &ret[tri * 3];
+        if (t[0] == c.To || t[1] == c.To || t[2] == c.To) {
+          ++degenerate;
+          continue;
+        }
+        glm::vec3 p[3] = { pos(t[0]), pos(t[1]), pos(t[2]) };
+        const glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        p[std::find(t, t + 3, c.From) - t] = target;
+        const glm::vec3 after = glm::cross(p[1] - p[0], p[2] - p[0]);
+        if (glm::dot(before, after) <= 0.f) {
+          flips = true;
+          break;
+        }
+      }
+      if (flips) {
+        continue;
+      }
+
+      remap[c.From] = c.To;
+      quadrics[canonical[c.To]] += quadrics[canonical[c.From]];
+      max_cost = std::max(max_cost, c.Cost);
+      removed += degenerate;
+      for (u32 tri : adjacency.Of(c.From)) {
+        for (u32 k = 0; k < 3; ++k) {
+          touched[ret[tri * 3 + k]] = true;
+        }
+      }
+    }
+    if (removed == 0) {
+      break; // nothing left under the error limit
+    }
+
+    size_t kept{ 0 };
+    for (size_t t = 0; t + 2 < ret.size(); t += 3) {
+      const u32 a = remap[ret[t]];
+      const u32 b = remap[ret[t + 1]];
+      const u32 c = remap[ret[t + 2]];
+      if (a != b && b != c && a != c) {
+        ret[kept++] = a;
+        ret[kept++] = b;
+        ret[kept++] = c;
+      }
+    }
+    ret.resize(kept);
+  }
+  *out_error = static_cast<f32>(std::sqrt(max_cost));
+  return ret;
+}
+
+std::vector<MeshOptimizer::Meshlet>
+MeshOptimizer::BuildMeshlets(std::span<u32> indices,
+                             const void* positions,
+                             size_t vertex_count,
+                             size_t stride,
+                             u32 max_vertices,
+                             u32 max_triangles,
+                             u32 cache_size)
+{
+  std::vector<Meshlet> ret{};
+  if (indices.size() < 3 || max_vertices < 3 || max_triangles == 0) {
+    return ret;
+  }
+
+  // Bounds of the triangles in [first, end)
+  auto add_meshlet = [&](u32 first, u32 end) {
+    Meshlet m{};
+    m.First = first;
+    m.Count = end - first;
+    glm::vec3 lo{ position(positions, stride, indices[first]) };
+    glm::vec3 hi{ lo };
+    glm::vec3 normals{ 0.f };
+    std::vector<glm::vec3> face_normals{};
+    face_normals.reserve(m.Count / 3);
+    for (u32 i = first; i < end; i += 3) {
+      const glm::vec3 a = position(positions, stride, indices[i]);
+      const glm::vec3 b = position(positions, stride, indices[i + 1]);
+      const glm::vec3 c = position(positions, stride, indices[i + 2]);
+      lo = glm::min(lo, glm::min(a, glm::min(b, c)));
+      hi = glm::max(hi, glm::max(a, glm::max(b, c)));
+      const glm::vec3 n = glm::cross(b - a, c - a);
+      const f32 length = glm::length(n);
+      if (length > 0.f) { // degenerate triangles can't be seen
+        face_normals.push_back(n / length);
+        normals += face_normals.back();
+      }
+    }
+    m.Center = (lo + hi) * .5f;
+    for (u32 i = first; i < end; ++i) {
+      const glm::vec3 p = position(positions, stride, indices[i]);
+      m.Radius = std::max(m.Radius, glm::length(p - m.Center));
+    }
+
+    m.ConeCutoff = 1.f;
+    const f32 length = glm::length(normals);
+    if (length > 0.f) {
+      m.ConeAxis = normals / length;
+      f32 min_dot{ 1.f };
+      for (const auto& n : face_normals) {
+        min_dot = std::min(min_dot, glm::dot(n, m.ConeAxis));
+      }
+      // Wider than a hemisphere, some triangle always faces the viewer
+      if (min_dot > 0.f) {
+        m.ConeCutoff = std::sqrt(1.f - min_dot * min_dot);
+      }
+    }
+    ret.push_back(m);
+  };
+
+  const u32 triangle_count = u32(indices.size() / 3);
+  const Adjacency adjacency{ indices.first(triangle_count * 3), vertex_count };
+  std::vector<glm::vec3> face_normals(triangle_count, glm::vec3{ 0.f });
+  for (u32 t = 0; t < triangle_count; ++t) {
+    const glm::vec3 a = position(positions, stride, indices[t * 3]);
+    const glm::vec3 n =
+      glm::cross(position(positions, stride, indices[t * 3 + 1]) - a,
+                 position(positions, stride, indices[t * 3 + 2]) - a);
+    const f32 length = glm::length(n);
+    face_normals[t] = length > 0.f ? n / length : n;
+  }
+
+  // stamp[v] == current while v is in the meshlet being grown
+  std::vector<u32> stamp(vertex_count, 0);
+  std::vector<u8> emitted(triangle_count, 0);
+  std::vector<u32> order{}; // triangles in meshlet order
+  order.reserve(triangle_count);
+  std::vector<u32> members{}; // vertices of the current meshlet
+  u32 current{ 0 };
+  u32 seed{ 0 }; // first triangle not emitted yet, in input order
+  auto missing = [&](u32 t) {
+    u32 count{ 0 };
+    for (u32 k = 0; k < 3; ++k) {
+      const u32 v = indices[t * 3 + k];
+      // a triangle may repeat one of its own vertices
+      count += stamp[v] != current && (k < 1 || v != indices[t * 3]) &&
+               (k < 2 || v != indices[t * 3 + 1]);
+    }
+    return count;
+  };
+
+  std::vector<u32> bounds{ 0 }; // meshlet boundaries in `order`
+  while (order.size() < triangle_count) {
+    ++current;
+    members.clear();
+    glm::vec3 normals{ 0.f };
+    u32 triangles{ 0 };
+    while (seed < triangle_count && emitted[seed]) {
+      ++seed;
+    }
+    u32 next = seed;
+    // Grow over shared vertices, favoring triangles that add few vertices
+    // and face the same way as the meshlet so far
+    while (next != ~0u) {
+      emitted[next] = 1;
+      order.push_back(next);
+      ++triangles;
+      normals += face_normals[next];
+      for (u32 k = 0; k < 3; ++k) {
+        const u32 v = indices[next * 3 + k];
+        if (stamp[v] != current) {
+          stamp[v] = current;
+          members.push_back(v);
+        }
+      }
+      if (triangles == max_triangles) {
+        break;
+      }
+
+      const f32 length = glm::length(normals);
+      const glm::vec3 axis = length > 0.f ? normals / length : normals;
+      next = ~0u;
+      f32 best{ std::numeric_limits<f32>::max() };
+      for (u32 v : members) {
+        for (u32 t : adjacency.Of(v)) {
+          if (emitted[t]) {
+            continue;
+          }
+          const u32 added = missing(t);
+          if (members.size() + added > max_vertices) {
+            continue;
+          }
+          // a new vertex weighs as much as a triangle facing backwards
+          const f32 score =
+            f32(added) + (1.f - glm::dot(face_normals[t], axis)) * .5f;
+          if (score < best) {
+            best = score;
+            next = t;
+          }
+        }
+      }
+    }
+    bounds.push_back(u32(order.size()));
+  }
+
+  // Meshlets become contiguous ranges, triangles keep their winding
+  const std::vector<u32> source{ indices.begin(),
+                                 indices.begin() + triangle_count * 3 };
+  for (u32 i = 0; i < triangle_count; ++i) {
+    std::copy_n(&source[order[i] * 3], 3, &indices[i * 3]);
+  }
+  std::vector<u32> local{};
+  for (size_t i = 1; i < bounds.size(); ++i) {
+    const u32 first = bounds[i - 1] * 3;
+    const u32 count = (bounds[i] - bounds[i - 1]) * 3;
+    if (cache_size > 0) {
+      // On meshlet local vertex ids, the full vertex count would make this
+      // quadratic
+      auto range = indices.subspan(first, count);
+      local.assign(range.begin(), range.end());
+      std::sort(local.begin(), local.end());
+      local.erase(std::unique(local.begin(), local.end()), local.end());
+      for (auto& idx : range) {
+        idx = u32(std::lower_bound(local.begin(), local.end(), idx) -
+                  local.begin());
+      }
+      OptimizeVertexCache(range, local.size(), cache_size);
+      for (auto& idx : range) {
+        idx = local[idx];
+      }
+    }
+    add_meshlet(first, first + count);
+  }
+  return ret;
+}
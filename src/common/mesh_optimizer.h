@@ -0,0 +1,315 @@
+#pragma once
+
+#include "common/types.h"
+#include <cstddef>
+#include <span>
+#include <vector>
+
+// Load time index/vertex buffer optimizations, run on meshes before they're
+// baked. Triangles are only reordered within their index range (submesh), so
+// ranges keep their material. Based on "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw" (Sander, Nehab, Barczak 2007)
+class MeshOptimizer
+{
+public:
+  struct Options
+  {
+    bool Weld{ true }; // merge bitwise identical vertices
+    bool VertexCache{ true }; // Tipsify triangle order
+    bool Overdraw{ false }; // sort triangle clusters front to back
+    bool VertexFetch{ true }; // vertices in first use order
+    // Overdraw may cost up to this factor of the ACMR
+    f32 OverdrawThreshold{ 1.05f };
+    u32 CacheSize{ 16 };
+    // Simplified levels built per range by BuildLods, each with about half
+    // the triangles of the previous one
+    u32 MaxLods{ 4 };
+    // Levels stop once their error reaches this fraction of the mesh size
+    f32 LodMaxError{ .05f };
+    // Meshlets built per range by BuildMeshlets, for GPU cluster culling
+    bool Meshlets{ true };
+    u32 MeshletVertices{ 64 };
+    u32 MeshletTriangles{ 124 };
+
+    // Identifies what the options do to baked data
+    u32 Key() const;
+  };
+
+  struct IndexRange
+  {
+    u32 First;
+    u32 Count;
+  };
+
+  // Index range of a simplified level, `Error` is an object space distance
+  struct Lod
+  {
+    u32 First;
+    u32 Count;
+    f32 Error;
+  };
+
+  // Contiguous index range culled as a whole. The bounding sphere and the
+  // normal cone are in object space: every triangle faces away from a viewer
+  // when dot(center - viewer, ConeAxis) >= ConeCutoff * distance + Radius.
+  // A cutoff of 1 never culls
+  struct Meshlet
+  {
+    u32 First;
+    u32 Count;
+    glm::vec3 Center;
+    f32 Radius;
+    glm::vec3 ConeAxis;
+    f32 ConeCutoff; // sine of the cone's half angle
+  };
+
+  // ACMR and vertex count after a step, "input" comes first
+  struct Stats
+  {
+    const char* Step;
+    f32 Acmr;
+    size_t VertexCount;
+  };
+
+  // Runs the enabled steps in order: weld, vertex cache, overdraw, fetch.
+  // Ranges must cover whole triangles
+  template<typename V>
+  static std::vector<Stats> Optimize(const Options& options,
+                                     std::vector<V>* vertices,
+                                     std::vector<u32>* indices,
+                                     std::span<const IndexRange> ranges);
+
+  // Appends the simplified levels of `range` to `indices`, they reference the
+  // same vertices
+  template<typename V>
+  static std::vector<Lod> BuildLods(const Options& options,
+                                    const std::vector<V>& vertices,
+                                    std::vector<u32>* indices,
+                                    IndexRange range);
+
+  // Splits `range` into meshlets, reordering its triangles so that each
+  // meshlet is a contiguous index range
+  template<typename V>
+  static std::vector<Meshlet> BuildMeshlets(const Options& options,
+                                            const std::vector<V>& vertices,
+                                            std::vector<u32>* indices,
+                                            IndexRange range);
+
+  // Average cache miss ratio, vertex shader invocations per triangle with a
+  // FIFO post-transform cache. 0.5 is the best case for regular grids, 3 the
+  // worst
+  static f32 Acmr(std::span<const u32> indices,
+                  size_t vertex_count,
+                  u32 cache_size = 16);
+
+  // remap[old] = new, new indices keep the first occurrence order. Returns the
+  // new vertex count
+  static size_t WeldRemap(const void* vertices,
+                          size_t vertex_count,
+                          size_t stride,
+                          std::vector<u32>* remap);
+  // Unreferenced vertices are mapped to ~0u and dropped
+  static size_t FetchRemap(std::span<const u32> indices,
+                           size_t vertex_count,
+                           std::vector<u32>* remap);
+  template<typename V>
+  static void Remap(std::vector<V>* vertices,
+                    std::span<u32> indices,
+                    const std::vector<u32>& remap,
+                    size_t new_count);
+
+  static void OptimizeVertexCache(std::span<u32> indices,
+                                  size_t vertex_count,
+                                  u32 cache_size = 16);
+  // Expects cache optimized indices, splits them where the ACMR allows it and
+  // draws outward facing clusters first. `positions` points to the first
+  // vertex position (3 floats), `stride` bytes apart
+  static void OptimizeOverdraw(std::span<u32> indices,
+                               const void* positions,
+                               size_t vertex_count,
+                               size_t stride,
+                               f32 threshold,
+                               u32 cache_size = 16);
+  // Quadric error edge collapses until `target_index_count` indices are left
+  // or the next collapse costs more than `target_error`. The cost is the root
+  // mean squared distance, weighted by area, from the collapsed vertex to the
+  // planes of the triangles merged into it: an estimate of how far the
+  // surface moves, not a bound. `out_error` is the largest cost paid.
+  // Vertices sharing their position with another one (UV and normal seams)
+  // and vertices of open edges never move, so seams and borders keep their
+  // shape
+  static std::vector<u32> Simplify(std::span<const u32> indices,
+                                   const void* positions,
+                                   size_t vertex_count,
+                                   size_t stride,
+                                   size_t target_index_count,
+                                   f32 target_error,
+                                   f32* out_error);
+  // Meshlets grow greedily over shared vertices from the first triangle left
+  // in the input order, picking the neighbors that add the fewest vertices
+  // and bend the normal cone the least. Each meshlet is then vertex cache
+  // optimized on its own, unless `cache_size` is 0. `First` is relative to
+  // `indices`
+  static std::vector<Meshlet> BuildMeshlets(std::span<u32> indices,
+                                            const void* positions,
+                                            size_t vertex_count,
+                                            size_t stride,
+                                            u32 max_vertices,
+                                            u32 max_triangles,
+                                            u32 cache_size);
+};
+
+template<typename V>
+void
+MeshOptimizer::Remap(std::vector<V>* vertices,
+                     std::span<u32> indices,
+                     const std::vector<u32>& remap,
+                     size_t new_count)
+{
+  std::vector<V> out(new_count);
+  for (size_t i = 0; i < vertices->size(); ++i) {
+    if (remap[i] != ~0u) {
+      out[remap[i]] = (*vertices)[i];
+    }
+  }
+  for (auto& idx : indices) {
+    idx = remap[idx];
+  }
+  *vertices = std::move(out);
+}
+
+template<typename V>
+std::vector<MeshOptimizer::Stats>
+MeshOptimizer::Optimize(const Options& options,
+                        std::vector<V>* vertices,
+                        std::vector<u32>* indices,
+                        std::span<const IndexRange> ranges)
+{
+  std::vector<Stats> ret{};
+  auto record = [&](const char* step) {
+    ret.push_back(
+      { step, Acmr(*indices, vertices->size(), options.CacheSize),
+        vertices->size() });
+  };
+  record("input");
+  if (vertices->empty() || indices->empty() || indices->size() % 3 != 0) {
+    return ret;
+  }
+  for (u32 idx : *indices) {
+    if (idx >= vertices->size()) {
+      return ret; // broken input, left as is
+    }
+  }
+  for (const auto& r : ranges) {
+    if (r.Count % 3 != 0 || u64(r.First) + r.Count > indices->size()) {
+      return ret; // not a triangle list
+    }
+  }
+
+  std::vector<u32> remap{};
+  if (options.Weld) {
+    size_t count =
+      WeldRemap(vertices->data(), vertices->size(), sizeof(V), &remap);
+    Remap(vertices, *indices, remap, count);
+    record("weld");
+  }
+  if (options.VertexCache) {
+    for (const auto& r : ranges) {
+      OptimizeVertexCache(std::span{ *indices }.subspan(r.First, r.Count),
+                          vertices->size(),
+                          options.CacheSize);
+    }
+    record("vertex cache");
+  }
+  if (options.Overdraw) {
+    for (const auto& r : ranges) {
+      OptimizeOverdraw(std::span{ *indices }.subspan(r.First, r.Count),
+                       &(*vertices)[0].pos,
+                       vertices->size(),
+                       sizeof(V),
+                       options.OverdrawThreshold,
+                       options.CacheSize);
+    }
+    record("overdraw");
+  }
+  if (options.VertexFetch) {
+    size_t count = FetchRemap(*indices, vertices->size(), &remap);
+    Remap(vertices, *indices, remap, count);
+    record("vertex fetch");
+  }
+  return ret;
+}
+
+template<typename V>
+std::vector<MeshOptimizer::Lod>
+MeshOptimizer::BuildLods(const Options& options,
+                         const std::vector<V>& vertices,
+                         std::vector<u32>* indices,
+                         IndexRange range)
+{
+  std::vector<Lod> ret{};
+  if (vertices.empty() || range.Count < 3 || range.Count % 3 != 0 ||
+      options.MaxLods == 0) {
+    return ret;
+  }
+  glm::vec3 bounds_min{ vertices[0].pos };
+  glm::vec3 bounds_max{ vertices[0].pos };
+  for (const auto& v : vertices) {
+    bounds_min = glm::min(bounds_min, v.pos);
+    bounds_max = glm::max(bounds_max, v.pos);
+  }
+  const f32 max_error = glm::length(bounds_max - bounds_min) *
+                        options.LodMaxError;
+
+  // Every level starts over from the full range, errors don't add up
+  const std::vector<u32> source{ indices->begin() + range.First,
+                                 indices->begin() + range.First + range.Count };
+  size_t previous = source.size();
+  for (u32 level = 1; level <= options.MaxLods; ++level) {
+    const size_t target = (source.size() >> level) / 3 * 3;
+    f32 error{ 0.f };
+    auto lod = Simplify(source,
+                        &vertices[0].pos,
+                        vertices.size(),
+                        sizeof(V),
+                        target,
+                        max_error,
+                        &error);
+    // Not worth a level if it barely removed anything
+    if (lod.empty() || lod.size() * 5 > previous * 4) {
+      break;
+    }
+    if (options.VertexCache) {
+      OptimizeVertexCache(lod, vertices.size(), options.CacheSize);
+    }
+    ret.push_back({ u32(indices->size()), u32(lod.size()), error });
+    indices->insert(indices->end(), lod.begin(), lod.end());
+    previous = lod.size();
+  }
+  return ret;
+}
+
+template<typename V>
+std::vector<MeshOptimizer::Meshlet>
+MeshOptimizer::BuildMeshlets(const Options& options,
+                             const std::vector<V>& vertices,
+                             std::vector<u32>* indices,
+                             IndexRange range)
+{
+  if (!options.Meshlets || vertices.empty() || range.Count % 3 != 0 ||
+      u64(range.First) + range.Count > indices->size()) {
+    return {};
+  }
+  auto ret =
+    BuildMeshlets(std::span{ *indices }.subspan(range.First, range.Count),
+                  &vertices[0].pos,
+                  vertices.size(),
+                  sizeof(V),
+                  options.MeshletVertices,
+                  options.MeshletTriangles,
+                  options.VertexCache ? options.CacheSize : 0);
+  for (auto& meshlet : ret) {
+    meshlet.First += range.First;
+  }
+  return ret;
+}
@@ -0,0 +1,287 @@
+#include "mesh_pool.h"
+
+#include "common/gpu_memory.h"
+#include "common/logger.h"
+#include "common/types.h"
+#include "common/util.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <pch.h>
+
+MeshPool::MeshPool(SDL_GPUDevice* device,
+                   u32 vertex_stride,
+                   SDL_GPUIndexElementSize index_size)
+  : device_{ device }
+  , vertex_stride_{ vertex_stride }
+  , index_size_{ index_size }
+{
+}
+
+u32
+MeshPool::IndexStride() const
+{
+  return index_size_ == SDL_GPU_INDEXELEMENTSIZE_16BIT ? sizeof(u16)
+                                                       : sizeof(u32);
+}
+
+MeshPool::~MeshPool()
+{
+  Release();
+}
+
+void
+MeshPool::Release()
+{
+  std::lock_guard lock{ mutex_ };
+  auto Device = device_;
+  for (auto& page : pages_) {
+    RELEASE_IF(page->VertexBuffer, GpuMemory::Release);
+    RELEASE_IF(page->IndexBuffer, GpuMemory::Release);
+  }
+  pages_.clear();
+}
+
+MeshPool::Page*
+MeshPool::CreatePage(u32 vert_count, u32 idx_count)
+{
+  // Meshes bigger than a page get a page of their own
+  const u32 vert_capacity =
+    std::max(VertexPageSize / vertex_stride_, vert_count);
+  const u32 idx_capacity =
+    std::max(IndexPageSize / IndexStride(), idx_count);
+
+  SDL_GPUBufferCreateInfo vertInfo{};
+  {
+    vertInfo.usage = SDL_GPU_BUFFERUSAGE_VERTEX;
+    vertInfo.size = vert_capacity * vertex_stride_;
+  }
+  SDL_GPUBufferCreateInfo idxInfo{};
+  {
+    idxInfo.usage = SDL_GPU_BUFFERUSAGE_INDEX;
+    idxInfo.size = idx_capacity * IndexStride();
+  }
+
+  auto page = MakeUnique<Page>();
+  page->VertexBuffer = GpuMemory::CreateBuffer(
+    device_, vertInfo, GpuMemoryCategory::Mesh, "Mesh pool");
+  if (!page->VertexBuffer) {
+    LOG_ERROR("MeshPool: couldn't create vertex buffer: {}", GETERR);
+    return nullptr;
+  }
+  page->IndexBuffer = GpuMemory::CreateBuffer(
+    device_, idxInfo, GpuMemoryCategory::Mesh, "Mesh pool");
+  if (!page->IndexBuffer) {
+    LOG_ERROR("MeshPool: couldn't create index buffer: {}", GETERR);
+    GpuMemory::Release(device_, page->VertexBuffer);
+    return nullptr;
+  }
+  page->Vertices.Reset(vert_capacity);
+  page->Indices.Reset(idx_capacity);
+
+  LOG_DEBUG("MeshPool: new page of {} vertices and {} indices",
+            vert_capacity,
+            idx_capacity);
+  pages_.push_back(std::move(page));
+  return pages_.back().get();
+}
+
+MeshPool::Page*
+MeshPool::FindPage(const SDL_GPUBuffer* vertex_buffer)
+{
+  for (auto& page : pages_) {
+    if (page->VertexBuffer == vertex_buffer) {
+      return page.get();
+    }
+  }
+  return nullptr;
+}
+
+bool
+MeshPool::AllocateRanges(u32 vert_count, u32 idx_count, MeshBuffers* out)
+{
+  auto try_page = [&](Page* page) {
+    auto vtx = page->Vertices.Allocate(vert_count);
+    if (!vtx) {
+      return false;
+    }
+    auto idx = page->Indices.Allocate(idx_count);
+    if (!idx) {
+      page->Vertices.Free(*vtx, vert_count);
+      return false;
+    }
+    out->VertexBuffer = page->VertexBuffer;
+    out->IndexBuffer = page->IndexBuffer;
+    out->VertexOffset = static_cast<i32>(*vtx);
+    out->VertexCount = vert_count;
+    out->FirstIndex = static_cast<u32>(*idx);
+    out->IndexCount = idx_count;
+    out->IndexSize = index_size_;
+    return true;
+  };
+
+  for (auto& page : pages_) {
+    if (try_page(page.get())) {
+      return true;
+    }
+  }
+  Page* page = CreatePage(vert_count, idx_count);
+  return page != nullptr && try_page(page);
+}
+
+bool
+MeshPool::Upload(UploadBatch& batch,
+                 MeshBuffers* out,
+                 const void* vertices,
+                 u32 vert_count,
+                 const void* indices,
+                 u32 idx_count)
+{
+  LOG_TRACE("MeshPool::Upload");
+  if (!Allocate(vert_count, idx_count, out)) {
+    return false;
+  }
+
+  const u32 vert_offset = static_cast<u32>(out->VertexOffset) * vertex_stride_;
+  const u32 idx_offset = out->FirstIndex * IndexStride();
+  if (!batch.UploadToBuffer(out->VertexBuffer,
+                            vertices,
+                            vert_count * vertex_stride_,
+                            vert_offset) ||
+      !batch.UploadToBuffer(out->IndexBuffer,
+                            indices,
+                            idx_count * IndexStride(),
+                            idx_offset)) {
+    LOG_ERROR("MeshPool: couldn't upload mesh data");
+    Free(*out);
+    *out = {};
+    return false;
+  }
+  return true;
+}
+
+bool
+MeshPool::Upload(UploadScheduler& scheduler,
+                 const UploadTicket& ticket,
+                 MeshBuffers* out,
+                 const void* vertices,
+                 u32 vert_count,
+                 const void* indices,
+                 u32 idx_count,
+                 SharedPtr<const void> owner)
+{
+  LOG_TRACE("MeshPool::Upload");
+  if (!Allocate(vert_count, idx_count, out)) {
+    return false;
+  }
+  if (!Enqueue(scheduler, ticket, *out, vertices, indices, std::move(owner))) {
+    Free(*out);
+    *out = {};
+    return false;
+  }
+  return true;
+}
+
+bool
+MeshPool::Enqueue(UploadScheduler& scheduler,
+                  const UploadTicket& ticket,
+                  const MeshBuffers& ranges,
+                  const void* vertices,
+                  const void* indices,
+                  SharedPtr<const void> owner)
+{
+  const u32 vert_offset =
+    static_cast<u32>(ranges.VertexOffset) * vertex_stride_;
+  const u32 idx_offset = ranges.FirstIndex * IndexStride();
+  auto enqueue =
+    [&](SDL_GPUBuffer* buffer, u32 offset, const void* data, u32 size) {
+      const u32 priority = UploadScheduler::PriorityGeometry;
+      if (owner) {
+        const std::span<const u8> bytes{ static_cast<const u8*>(data), size };
+        return scheduler.EnqueueBuffer(
+          ticket, priority, buffer, offset, owner, bytes);
+      }
+      return scheduler.EnqueueBuffer(
+        ticket, priority, buffer, offset, data, size);
+    };
+  if (!enqueue(ranges.VertexBuffer,
+               vert_offset,
+               vertices,
+               ranges.VertexCount * vertex_stride_) ||
+      !enqueue(ranges.IndexBuffer,
+               idx_offset,
+               indices,
+               ranges.IndexCount * IndexStride())) {
+    LOG_ERROR("MeshPool: couldn't queue mesh upload");
+    return false;
+  }
+  return true;
+}
+
+bool
+MeshPool::Allocate(u32 vert_count, u32 idx_count, MeshBuffers* out)
+{
+  if (vert_count == 0 || idx_count == 0) {
+    LOG_ERROR("MeshPool: empty mesh");
+    return false;
+  }
+  std::lock_guard lock{ mutex_ };
+  if (!AllocateRanges(vert_count, idx_count, out)) {
+    LOG_ERROR("MeshPool: couldn't allocate {} vertices and {} indices",
+              vert_count,
+              idx_count);
+    return false;
+  }
+  return true;
+}
+
+void
+MeshPool::Free(const MeshBuffers& buffers)
+{
+  std::lock_guard lock{ mutex_ };
+  FreeLocked(buffers);
+}
+
+void
+MeshPool::FreeLocked(const MeshBuffers& buffers)
+{
+  if (buffers.VertexBuffer == nullptr) {
+    return;
+  }
+  Page* page = FindPage(buffers.VertexBuffer);
+  if (!page) {
+    LOG_WARN("MeshPool: freeing buffers that don't belong to the pool");
+    return;
+  }
+  page->Vertices.Free(static_cast<u64>(buffers.VertexOffset),
+                      buffers.VertexCount);
+  page->Indices.Free(buffers.FirstIndex, buffers.IndexCount);
+}
+
+size_t
+MeshPool::PageCount() const
+{
+  std::lock_guard lock{ mutex_ };
+  return pages_.size();
+}
+
+u64
+MeshPool::UsedVertices() const
+{
+  std::lock_guard lock{ mutex_ };
+  u64 used = 0;
+  for (const auto& page : pages_) {
+    used += page->Vertices.Used();
+  }
+  return used;
+}
+
+u64
+MeshPool::UsedIndices() const
+{
+  std::lock_guard lock{ mutex_ };
+  u64 used = 0;
+  for (const auto& page : pages_) {
+    used += page->Indices.Used();
+  }
+  return used;
+}
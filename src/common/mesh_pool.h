@@ -0,0 +1,111 @@
+#pragma once
+
+#include "common/range_allocator.h"
+#include "common/rendersystem.h"
+#include "common/types.h"
+#include "common/upload_batch.h"
+#include "common/upload_scheduler.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <mutex>
+#include <vector>
+
+// Shared vertex/index storage for every mesh of a given vertex layout and
+// index size. Meshes get a {VertexOffset, FirstIndex} range inside a large
+// vertex buffer and a large index buffer, so consecutive draws usually share
+// the same bindings. A new page (buffer pair) is only created when the
+// current ones are full, existing buffers are never reallocated.
+class MeshPool
+{
+public:
+  static constexpr u32 VertexPageSize = 64 * 1024 * 1024;
+  static constexpr u32 IndexPageSize = 16 * 1024 * 1024;
+
+public:
+  DISABLE_COPY_AND_MOVE(MeshPool);
+  explicit MeshPool(
+    SDL_GPUDevice* device,
+    u32 vertex_stride,
+    SDL_GPUIndexElementSize index_size = SDL_GPU_INDEXELEMENTSIZE_32BIT);
+  ~MeshPool();
+
+  // Sub-allocates the mesh and records its upload into the batch.
+  // Indices are relative to the mesh, draws must use out->VertexOffset
+  bool Upload(UploadBatch& batch,
+              MeshBuffers* out,
+              const void* vertices,
+              u32 vert_count,
+              const void* indices,
+              u32 idx_count);
+  template<typename V>
+  bool Upload(UploadBatch& batch,
+              MeshBuffers* out,
+              const V* vertices,
+              u32 vert_count,
+              const void* indices,
+              u32 idx_count)
+  {
+    assert(sizeof(V) == vertex_stride_);
+    return Upload(batch,
+                  out,
+                  static_cast<const void*>(vertices),
+                  vert_count,
+                  indices,
+                  idx_count);
+  }
+
+  // Same, queued into the scheduler instead of recorded right away. With an
+  // `owner`, vertices and indices aren't copied: they're read when recorded
+  // and must stay valid while `owner` lives
+  bool Upload(UploadScheduler& scheduler,
+              const UploadTicket& ticket,
+              MeshBuffers* out,
+              const void* vertices,
+              u32 vert_count,
+              const void* indices,
+              u32 idx_count,
+              SharedPtr<const void> owner = nullptr);
+
+  // Only reserves the ranges, the caller uploads to them
+  bool Allocate(u32 vert_count, u32 idx_count, MeshBuffers* out);
+  // Queues the data of ranges from Allocate(), `owner` as in Upload()
+  bool Enqueue(UploadScheduler& scheduler,
+               const UploadTicket& ticket,
+               const MeshBuffers& ranges,
+               const void* vertices,
+               const void* indices,
+               SharedPtr<const void> owner = nullptr);
+
+  // The ranges are reused right away, callers must make sure the GPU is done
+  // drawing them
+  void Free(const MeshBuffers& buffers);
+  void Release();
+
+  u32 VertexStride() const { return vertex_stride_; }
+  SDL_GPUIndexElementSize IndexSize() const { return index_size_; }
+  u32 IndexStride() const;
+  size_t PageCount() const;
+  u64 UsedVertices() const;
+  u64 UsedIndices() const;
+
+private:
+  struct Page
+  {
+    SDL_GPUBuffer* VertexBuffer{ nullptr };
+    SDL_GPUBuffer* IndexBuffer{ nullptr };
+    RangeAllocator Vertices;
+    RangeAllocator Indices;
+  };
+
+  Page* CreatePage(u32 vert_count, u32 idx_count);
+  Page* FindPage(const SDL_GPUBuffer* vertex_buffer);
+  bool AllocateRanges(u32 vert_count, u32 idx_count, MeshBuffers* out);
+  void FreeLocked(const MeshBuffers& buffers);
+
+private:
+  SDL_GPUDevice* device_;
+  u32 vertex_stride_;
+  SDL_GPUIndexElementSize index_size_;
+  std::vector<UniquePtr<Page>> pages_;
+  mutable std::mutex mutex_;
+};
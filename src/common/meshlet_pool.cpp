@@ -0,0 +1,141 @@
+#include "meshlet_pool.h"
+
+#include "common/gpu_memory.h"
+#include "common/logger.h"
+#include "common/types.h"
+#include "common/util.h"
+#include "shaders/meshlet_cull.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <pch.h>
+
+MeshletPool::MeshletPool(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+MeshletPool::~MeshletPool()
+{
+  Release();
+}
+
+void
+MeshletPool::Release()
+{
+  std::lock_guard lock{ mutex_ };
+  auto Device = device_;
+  for (auto& page : pages_) {
+    RELEASE_IF(page->Buffer, GpuMemory::Release);
+  }
+  pages_.clear();
+}
+
+MeshletPool::Page*
+MeshletPool::CreatePage(u32 count)
+{
+  // Meshes with more meshlets than a page get a page of their own
+  const u32 capacity = std::max<u32>(PageSize / sizeof(MeshletBinding), count);
+
+  SDL_GPUBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_BUFFERUSAGE_COMPUTE_STORAGE_READ;
+    info.size = capacity * sizeof(MeshletBinding);
+  }
+  auto page = MakeUnique<Page>();
+  page->Buffer = GpuMemory::CreateBuffer(
+    device_, info, GpuMemoryCategory::Mesh, "Meshlet pool");
+  if (!page->Buffer) {
+    LOG_ERROR("MeshletPool: couldn't create buffer: {}", GETERR);
+    return nullptr;
+  }
+  page->Meshlets.Reset(capacity);
+
+  LOG_DEBUG("MeshletPool: new page of {} meshlets", capacity);
+  pages_.push_back(std::move(page));
+  return pages_.back().get();
+}
+
+bool
+MeshletPool::Upload(UploadScheduler& scheduler,
+                    const UploadTicket& ticket,
+                    std::span<const MeshletBinding> meshlets,
+                    MeshletRange* out)
+{
+  if (meshlets.empty()) {
+    *out = {};
+    return true;
+  }
+  const u32 count = static_cast<u32>(meshlets.size());
+  {
+    std::lock_guard lock{ mutex_ };
+    auto try_page = [&](Page* page) {
+      auto first = page->Meshlets.Allocate(count);
+      if (!first) {
+        return false;
+      }
+      out->Buffer = page->Buffer;
+      out->First = static_cast<u32>(*first);
+      out->Count = count;
+      return true;
+    };
+    bool allocated = std::any_of(
+      pages_.begin(), pages_.end(), [&](auto& page) {
+        return try_page(page.get());
+      });
+    if (!allocated) {
+      Page* page = CreatePage(count);
+      allocated = page != nullptr && try_page(page);
+    }
+    if (!allocated) {
+      LOG_ERROR("MeshletPool: couldn't allocate {} meshlets", count);
+      return false;
+    }
+  }
+
+  if (!scheduler.EnqueueBuffer(ticket,
+                               UploadScheduler::PriorityGeometry,
+                               out->Buffer,
+                               out->First * sizeof(MeshletBinding),
+                               meshlets.data(),
+                               count * sizeof(MeshletBinding))) {
+    LOG_ERROR("MeshletPool: couldn't queue meshlet upload");
+    Free(*out);
+    *out = {};
+    return false;
+  }
+  return true;
+}
+
+void
+MeshletPool::Free(const MeshletRange& range)
+{
+  if (range.Buffer == nullptr) {
+    return;
+  }
+  std::lock_guard lock{ mutex_ };
+  for (auto& page : pages_) {
+    if (page->Buffer == range.Buffer) {
+      page->Meshlets.Free(range.First, range.Count);
+      return;
+    }
+  }
+  LOG_WARN("MeshletPool: freeing meshlets that don't belong to the pool");
+}
+
+size_t
+MeshletPool::PageCount() const
+{
+  std::lock_guard lock{ mutex_ };
+  return pages_.size();
+}
+
+u64
+MeshletPool::UsedMeshlets() const
+{
+  std::lock_guard lock{ mutex_ };
+  u64 used = 0;
+  for (const auto& page : pages_) {
+    used += page->Meshlets.Used();
+  }
+  return used;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "common/range_allocator.h"
+#include "common/rendersystem.h"
+#include "common/types.h"
+#include "common/upload_scheduler.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <mutex>
+#include <span>
+#include <vector>
+
+struct MeshletBinding;
+
+// Shared meshlet storage for every mesh, the MeshPool of MeshletBindings.
+// Meshes get a range of a large buffer as soon as their own meshlets are
+// built, so they don't wait for the rest of their scene and consecutive cull
+// dispatches usually bind the same buffer
+class MeshletPool
+{
+public:
+  static constexpr u32 PageSize = 4 * 1024 * 1024;
+
+public:
+  DISABLE_COPY_AND_MOVE(MeshletPool);
+  explicit MeshletPool(SDL_GPUDevice* device);
+  ~MeshletPool();
+
+  // Sub-allocates the meshlets and queues a copy of them
+  bool Upload(UploadScheduler& scheduler,
+              const UploadTicket& ticket,
+              std::span<const MeshletBinding> meshlets,
+              MeshletRange* out);
+  // Same as MeshPool::Free(), the GPU must be done reading the range
+  void Free(const MeshletRange& range);
+  void Release();
+
+  size_t PageCount() const;
+  u64 UsedMeshlets() const;
+
+private:
+  struct Page
+  {
+    SDL_GPUBuffer* Buffer{ nullptr };
+    RangeAllocator Meshlets;
+  };
+
+  Page* CreatePage(u32 count);
+
+private:
+  SDL_GPUDevice* device_;
+  std::vector<UniquePtr<Page>> pages_;
+  mutable std::mutex mutex_;
+};
@@ -0,0 +1,136 @@
+#include "mip_chain.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+
+namespace {
+// 8 bit sRGB to linear, indexed by the encoded value
+const std::array<f32, 256>&
+srgb_to_linear_table()
+{
+  static const std::array<f32, 256> table = []() {
+    std::array<f32, 256> ret{};
+    for (u32 i = 0; i < 256; ++i) {
+      f32 c = static_cast<f32>(i) / 255.f;
+      ret[i] = c <= 0.04045f ? c / 12.92f
+                             : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return ret;
+  }();
+  return table;
+}
+
+// Linear to 8 bit sRGB, quantized to LinearSteps so no pow() runs per texel.
+// Fine enough that even the steep dark end stays within a fraction of a step
+constexpr u32 LinearSteps = 16384;
+
+const std::array<u8, LinearSteps>&
+linear_to_srgb_table()
+{
+  static const std::array<u8, LinearSteps> table = []() {
+    std::array<u8, LinearSteps> ret{};
+    for (u32 i = 0; i < LinearSteps; ++i) {
+      f32 c = static_cast<f32>(i) / (LinearSteps - 1);
+      c = c <= 0.0031308f ? c * 12.92f
+                          : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+      ret[i] = static_cast<u8>(std::clamp(c * 255.f + 0.5f, 0.f, 255.f));
+    }
+    return ret;
+  }();
+  return table;
+}
+
+// Source texels covered by destination texel i: two, or three for the last
+// one when the size is odd so the extra row/column isn't dropped
+u32
+taps(u32 i, u32 size, u32 dst_size)
+{
+  if (size == 1) {
+    return 1;
+  }
+  return (size & 1) && i == dst_size - 1 ? 3 : 2;
+}
+
+// RGBA texels are summed as 4 fixed lanes, one loop per color space so the
+// lane loops carry no per channel branch
+template<bool Srgb>
+void
+downsample(const u8* src, u32 width, u32 height, u8* dst)
+{
+  constexpr u32 channels = 4;
+  const u32 dst_w = MipChain::LevelSize(width, 1);
+  const u32 dst_h = MipChain::LevelSize(height, 1);
+  const auto& to_linear = srgb_to_linear_table();
+  const auto& to_srgb = linear_to_srgb_table();
+
+  for (u32 y = 0; y < dst_h; ++y) {
+    const u32 rows = taps(y, height, dst_h);
+    const u8* row = src + u64{ 2 * y } * width * channels;
+    u8* out = dst + u64{ y } * dst_w * channels;
+
+    for (u32 x = 0; x < dst_w; ++x) {
+      const u32 cols = taps(x, width, dst_w);
+      const f32 scale = 1.f / static_cast<f32>(rows * cols);
+      u32 sum[channels]{};
+      f32 linear[channels]{};
+      for (u32 r = 0; r < rows; ++r) {
+        const u8* texel = row + (u64{ r } * width + 2 * x) * channels;
+        for (u32 k = 0; k < cols; ++k, texel += channels) {
+          for (u32 c = 0; c < channels; ++c) {
+            sum[c] += texel[c];
+          }
+          if constexpr (Srgb) {
+            for (u32 c = 0; c < channels; ++c) {
+              linear[c] += to_linear[texel[c]];
+            }
+          }
+        }
+      }
+      u8* texel = out + x * channels;
+      for (u32 c = 0; c < channels; ++c) {
+        texel[c] = static_cast<u8>(static_cast<f32>(sum[c]) * scale + .5f);
+      }
+      if constexpr (Srgb) { // alpha never is
+        for (u32 c = 0; c < 3; ++c) {
+          const f32 i = linear[c] * scale * (LinearSteps - 1) + .5f;
+          texel[c] = to_srgb[std::min(static_cast<u32>(i), LinearSteps - 1)];
+        }
+      }
+    }
+  }
+}
+} // namespace
+
+u32
+MipChain::LevelCount(u32 width, u32 height)
+{
+  return std::bit_width(std::max({ width, height, 1u }));
+}
+
+u32
+MipChain::LevelSize(u32 base_size, u32 level)
+{
+  return std::max(base_size >> level, 1u);
+}
+
+std::vector<u8>
+MipChain::Downsample(const std::vector<u8>& src,
+                     u32 width,
+                     u32 height,
+                     bool srgb)
+{
+  constexpr u32 channels = 4;
+  const u32 dst_w = LevelSize(width, 1);
+  const u32 dst_h = LevelSize(height, 1);
+  assert(src.size() >= u64{ width } * height * channels);
+
+  std::vector<u8> dst(u64{ dst_w } * dst_h * channels);
+  if (srgb) {
+    downsample<true>(src.data(), width, height, dst.data());
+  } else {
+    downsample<false>(src.data(), width, height, dst.data());
+  }
+  return dst;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "common/types.h"
+#include <vector>
+
+// CPU mip generation for RGBA8 images, for mips baked ahead of time (cached or
+// offline builds). Runtime loads blit them on the GPU instead, see
+// SDL_GenerateMipmapsForGPUTexture
+class MipChain
+{
+public:
+  // Full chain down to 1x1
+  static u32 LevelCount(u32 width, u32 height);
+  static u32 LevelSize(u32 base_size, u32 level);
+
+  // Next level with a 2x2 box filter, widened to 3 taps on the last row/column
+  // of odd sizes so no texel is dropped. sRGB texels are averaged in linear
+  // space, alpha never is
+  static std::vector<u8> Downsample(const std::vector<u8>& src,
+                                    u32 width,
+                                    u32 height,
+                                    bool srgb);
+};
@@ -0,0 +1,108 @@
+#include "range_allocator.h"
+
+#include "common/logger.h"
+
+#include <pch.h>
+
+RangeAllocator::RangeAllocator(u64 capacity)
+{
+  Reset(capacity);
+}
+
+void
+RangeAllocator::Reset(u64 capacity)
+{
+  free_.clear();
+  capacity_ = capacity;
+  used_ = 0;
+  if (capacity > 0) {
+    free_.emplace(0, capacity);
+  }
+}
+
+std::optional<u64>
+RangeAllocator::Allocate(u64 count, u64 alignment)
+{
+  if (count == 0) {
+    return std::nullopt;
+  }
+  if (alignment == 0) {
+    alignment = 1;
+  }
+
+  for (auto it = free_.begin(); it != free_.end(); ++it) {
+    const u64 begin = it->first;
+    const u64 end = begin + it->second;
+    const u64 aligned = (begin + alignment - 1) / alignment * alignment;
+    if (aligned + count > end) {
+      continue;
+    }
+
+    free_.erase(it);
+    // Give back the padding in front and the tail
+    if (aligned > begin) {
+      free_.emplace(begin, aligned - begin);
+    }
+    if (aligned + count < end) {
+      free_.emplace(aligned + count, end - (aligned + count));
+    }
+    used_ += count;
+    return aligned;
+  }
+  return std::nullopt;
+}
+
+void
+RangeAllocator::Free(u64 offset, u64 count)
+{
+  if (count == 0) {
+    return;
+  }
+  if (offset + count > capacity_) {
+    LOG_ERROR("RangeAllocator: freeing out of range [{}, {})",
+              offset,
+              offset + count);
+    return;
+  }
+
+  auto next = free_.lower_bound(offset);
+  if (next != free_.end() && next->first < offset + count) {
+    LOG_ERROR("RangeAllocator: double free at {}", offset);
+    return;
+  }
+
+  u64 begin = offset;
+  u64 end = offset + count;
+
+  // Merge with the previous range
+  if (next != free_.begin()) {
+    auto prev = std::prev(next);
+    const u64 prev_end = prev->first + prev->second;
+    if (prev_end > begin) {
+      LOG_ERROR("RangeAllocator: double free at {}", offset);
+      return;
+    }
+    if (prev_end == begin) {
+      begin = prev->first;
+      free_.erase(prev);
+    }
+  }
+  // Merge with the next range
+  if (next != free_.end() && next->first == end) {
+    end += next->second;
+    free_.erase(next);
+  }
+
+  free_.emplace(begin, end - begin);
+  used_ -= count;
+}
+
+u64
+RangeAllocator::LargestFreeRange() const
+{
+  u64 largest = 0;
+  for (const auto& [offset, count] : free_) {
+    largest = std::max(largest, count);
+  }
+  return largest;
+}
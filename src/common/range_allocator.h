@@ -0,0 +1,30 @@
+#pragma once
+
+#include "common/types.h"
+#include <map>
+#include <optional>
+
+// First-fit free list over [0, capacity), in abstract units (bytes, vertices,
+// indices...). Neighbouring free ranges are merged back on Free().
+// Not thread safe, owners are expected to lock around it.
+class RangeAllocator
+{
+public:
+  RangeAllocator() = default;
+  explicit RangeAllocator(u64 capacity);
+
+  // Returns the offset of the range, or nullopt if no free range is big enough
+  std::optional<u64> Allocate(u64 count, u64 alignment = 1);
+  void Free(u64 offset, u64 count);
+  void Reset(u64 capacity);
+
+  u64 Capacity() const { return capacity_; }
+  u64 Used() const { return used_; }
+  u64 LargestFreeRange() const;
+  size_t FreeRangeCount() const { return free_.size(); }
+
+private:
+  std::map<u64, u64> free_; // offset -> count
+  u64 capacity_{ 0 };
+  u64 used_{ 0 };
+};
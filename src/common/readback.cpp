@@ -0,0 +1,276 @@
+#include "readback.h"
+
+#include "common/logger.h"
+#include "common/types.h"
+#include "common/util.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <pch.h>
+
+struct ReadbackHandle::State
+{
+  ReadbackPool* Pool{ nullptr };
+  SDL_GPUTransferBuffer* Buffer{ nullptr };
+  u32 Capacity{ 0 };
+  u32 Size{ 0 };
+  SDL_GPUFence* Fence{ nullptr };
+  bool Done{ false };
+  bool Failed{ false };
+  std::vector<u8> Data{};
+};
+
+ReadbackHandle::ReadbackHandle(SharedPtr<State> state)
+  : state_{ std::move(state) }
+{
+}
+
+bool
+ReadbackHandle::Ready() const
+{
+  if (!state_) {
+    return false;
+  }
+  if (state_->Pool) {
+    std::lock_guard lock{ state_->Pool->mutex_ };
+    state_->Pool->PollLocked(*state_);
+  }
+  return state_->Done && !state_->Failed;
+}
+
+bool
+ReadbackHandle::Failed() const
+{
+  return !state_ || state_->Failed;
+}
+
+void
+ReadbackHandle::Wait() const
+{
+  if (!state_ || !state_->Pool) {
+    return;
+  }
+  auto* pool = state_->Pool;
+  std::lock_guard lock{ pool->mutex_ };
+  if (state_->Fence) {
+    SDL_WaitForGPUFences(pool->device_, true, &state_->Fence, 1);
+  }
+  pool->PollLocked(*state_);
+}
+
+const std::vector<u8>&
+ReadbackHandle::Data() const
+{
+  static const std::vector<u8> empty{};
+  return state_ ? state_->Data : empty;
+}
+
+ReadbackPool::ReadbackPool(SDL_GPUDevice* device)
+  : device_{ device }
+{
+}
+
+ReadbackPool::~ReadbackPool()
+{
+  std::lock_guard lock{ mutex_ };
+  for (auto& state : pending_) {
+    if (state->Fence) {
+      SDL_WaitForGPUFences(device_, true, &state->Fence, 1);
+    }
+    PollLocked(*state);
+    state->Pool = nullptr;
+  }
+  pending_.clear();
+
+  for (auto& pooled : free_) {
+    SDL_ReleaseGPUTransferBuffer(device_, pooled.Buffer);
+  }
+  free_.clear();
+}
+
+ReadbackPool::PooledBuffer
+ReadbackPool::Acquire(u32 size)
+{
+  // Smallest pooled buffer that fits
+  auto best = free_.end();
+  for (auto it = free_.begin(); it != free_.end(); ++it) {
+    if (it->Capacity >= size &&
+        (best == free_.end() || it->Capacity < best->Capacity)) {
+      best = it;
+    }
+  }
+  if (best != free_.end()) {
+    PooledBuffer ret = *best;
+    free_.erase(best);
+    return ret;
+  }
+
+  SDL_GPUTransferBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_DOWNLOAD;
+    info.size = size;
+  }
+  auto* buffer = SDL_CreateGPUTransferBuffer(device_, &info);
+  if (!buffer) {
+    LOG_ERROR("Couldn't create download transfer buffer: {}", GETERR);
+    return { nullptr, 0 };
+  }
+  return { buffer, size };
+}
+
+ReadbackHandle
+ReadbackPool::Download(SDL_GPUBuffer* buffer, u32 offset, u32 size)
+{
+  if (buffer == nullptr || size == 0) {
+    LOG_ERROR("Couldn't download buffer: invalid buffer or size");
+    return {};
+  }
+
+  std::lock_guard lock{ mutex_ };
+  auto pooled = Acquire(size);
+  if (!pooled.Buffer) {
+    return {};
+  }
+  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
+  if (!cmdbuf) {
+    LOG_ERROR("Couldn't acquire readback command buffer: {}", GETERR);
+    free_.push_back(pooled);
+    return {};
+  }
+
+  SDL_GPUBufferRegion src{};
+  {
+    src.buffer = buffer;
+    src.offset = offset;
+    src.size = size;
+  }
+  SDL_GPUTransferBufferLocation dst{};
+  {
+    dst.transfer_buffer = pooled.Buffer;
+    dst.offset = 0;
+  }
+  auto* pass = SDL_BeginGPUCopyPass(cmdbuf);
+  SDL_DownloadFromGPUBuffer(pass, &src, &dst);
+  SDL_EndGPUCopyPass(pass);
+
+  return Submit(cmdbuf, pooled, size);
+}
+
+ReadbackHandle
+ReadbackPool::Download(const SDL_GPUTextureRegion& region,
+                       SDL_GPUTextureFormat format)
+{
+  if (region.texture == nullptr) {
+    LOG_ERROR("Couldn't download texture: invalid texture");
+    return {};
+  }
+  const u32 size =
+    SDL_CalculateGPUTextureFormatSize(format, region.w, region.h, region.d);
+  if (size == 0) {
+    LOG_ERROR("Couldn't download texture: unsupported format");
+    return {};
+  }
+
+  std::lock_guard lock{ mutex_ };
+  auto pooled = Acquire(size);
+  if (!pooled.Buffer) {
+    return {};
+  }
+  SDL_GPUCommandBuffer* cmdbuf = SDL_AcquireGPUCommandBuffer(device_);
+  if (!cmdbuf) {
+    LOG_ERROR("Couldn't acquire readback command buffer: {}", GETERR);
+    free_.push_back(pooled);
+    return {};
+  }
+
+  SDL_GPUTextureTransferInfo dst{};
+  {
+    dst.transfer_buffer = pooled.Buffer;
+    dst.offset = 0;
+    dst.pixels_per_row = region.w; // tightly packed
+    dst.rows_per_layer = region.h;
+  }
+  auto* pass = SDL_BeginGPUCopyPass(cmdbuf);
+  SDL_DownloadFromGPUTexture(pass, &region, &dst);
+  SDL_EndGPUCopyPass(pass);
+
+  return Submit(cmdbuf, pooled, size);
+}
+
+ReadbackHandle
+ReadbackPool::Submit(SDL_GPUCommandBuffer* cmdbuf,
+                     PooledBuffer pooled,
+                     u32 size)
+{
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdbuf);
+  if (!fence) {
+    LOG_ERROR("Couldn't submit readback: {}", GETERR);
+    free_.push_back(pooled);
+    return {};
+  }
+
+  auto state = MakeShared<ReadbackHandle::State>();
+  {
+    state->Pool = this;
+    state->Buffer = pooled.Buffer;
+    state->Capacity = pooled.Capacity;
+    state->Size = size;
+    state->Fence = fence;
+  }
+  pending_.push_back(state);
+  return ReadbackHandle{ state };
+}
+
+bool
+ReadbackPool::PollLocked(ReadbackHandle::State& state)
+{
+  if (state.Done) {
+    return true;
+  }
+  if (state.Fence && !SDL_QueryGPUFence(device_, state.Fence)) {
+    return false;
+  }
+
+  auto* mapped = static_cast<const u8*>(
+    SDL_MapGPUTransferBuffer(device_, state.Buffer, false));
+  if (mapped) {
+    state.Data.assign(mapped, mapped + state.Size);
+    SDL_UnmapGPUTransferBuffer(device_, state.Buffer);
+  } else {
+    LOG_ERROR("Couldn't map download transfer buffer: {}", GETERR);
+    state.Failed = true;
+  }
+
+  SDL_ReleaseGPUFence(device_, state.Fence);
+  state.Fence = nullptr;
+  free_.push_back({ state.Buffer, state.Capacity });
+  state.Buffer = nullptr;
+  state.Done = true;
+  return true;
+}
+
+void
+ReadbackPool::Update()
+{
+  std::lock_guard lock{ mutex_ };
+  std::erase_if(pending_, [this](const auto& state) {
+    if (!PollLocked(*state)) {
+      return false;
+    }
+    state->Pool = nullptr; // complete, handles no longer need the pool
+    return true;
+  });
+}
+
+size_t
+ReadbackPool::Pending() const
+{
+  std::lock_guard lock{ mutex_ };
+  return pending_.size();
+}
+
+size_t
+ReadbackPool::PooledBuffers() const
+{
+  std::lock_guard lock{ mutex_ };
+  return free_.size();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "common/types.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+class ReadbackPool;
+
+// Result of an asynchronous GPU -> CPU copy. Polling never blocks: the data
+// is copied out of the transfer buffer once the download's fence signaled,
+// usually a couple of frames after the request.
+class ReadbackHandle
+{
+public:
+  ReadbackHandle() = default;
+
+  bool Valid() const { return state_ != nullptr; }
+  bool Ready() const;
+  bool Failed() const;
+  // Blocks until the download is done, avoid in the render loop
+  void Wait() const;
+
+  // Empty until Ready()
+  const std::vector<u8>& Data() const;
+  template<typename T>
+  bool Read(T* out, u32 count = 1, u32 byte_offset = 0) const
+  {
+    if (!Ready()) {
+      return false;
+    }
+    const auto& data = Data();
+    if (byte_offset + sizeof(T) * count > data.size()) {
+      return false;
+    }
+    std::memcpy(out, data.data() + byte_offset, sizeof(T) * count);
+    return true;
+  }
+
+private:
+  friend class ReadbackPool;
+  struct State;
+  explicit ReadbackHandle(SharedPtr<State> state);
+
+private:
+  SharedPtr<State> state_{ nullptr };
+};
+
+// Records downloads into pooled download transfer buffers, each one in its
+// own submission. In-flight downloads are completed by Update() (once per
+// frame) or by polling their handle, then their buffer goes back to the pool.
+// Downloads are submitted on their own, so they must be requested after the
+// command buffer producing the data has been submitted.
+class ReadbackPool
+{
+public:
+  DISABLE_COPY_AND_MOVE(ReadbackPool);
+  explicit ReadbackPool(SDL_GPUDevice* device);
+  ~ReadbackPool(); // waits for pending downloads
+
+  ReadbackHandle Download(SDL_GPUBuffer* buffer, u32 offset, u32 size);
+  ReadbackHandle Download(const SDL_GPUTextureRegion& region,
+                          SDL_GPUTextureFormat format);
+
+  void Update();
+
+  size_t Pending() const;
+  size_t PooledBuffers() const;
+
+private:
+  friend class ReadbackHandle;
+
+  struct PooledBuffer
+  {
+    SDL_GPUTransferBuffer* Buffer;
+    u32 Capacity;
+  };
+
+  PooledBuffer Acquire(u32 size);
+  ReadbackHandle Submit(SDL_GPUCommandBuffer* cmdbuf,
+                        PooledBuffer pooled,
+                        u32 size);
+  // Returns true once the state is complete
+  bool PollLocked(ReadbackHandle::State& state);
+
+private:
+  SDL_GPUDevice* device_;
+  std::vector<PooledBuffer> free_;
+  std::vector<SharedPtr<ReadbackHandle::State>> pending_;
+  mutable std::mutex mutex_;
+};
@@ -1,4 +1,7 @@
 #include <pch.h>
+#include <algorithm>
+#include <cmath>
+#include <span>
 #include <vector>
 
 #include "rendersystem.h"
@@ -20,20 +23,103 @@ SceneNode::Draw(glm::mat4 matrix, RenderContext& context)
   }
 }
 
+f32
+LodSelection::PixelsPerUnitFor(f32 fov_y, f32 viewport_height)
+{
+  return viewport_height / (2.f * std::tan(fov_y * .5f));
+}
+
 void
 MeshNode::Draw(glm::mat4 matrix, RenderContext& context)
 {
+  if (!Mesh->Visible) {
+    SceneNode::Draw(matrix, context);
+    return;
+  }
   glm::mat4 mat = matrix * WorldMatrix;
+  static const InstanceTransform identity{ 1.f };
+  const std::span<const InstanceTransform> instances =
+    Instances.empty() ? std::span{ &identity, 1 } : std::span{ Instances };
+
+  // Largest object space error each instance can hide, from its distance to
+  // the camera and the bounding sphere of the mesh
+  auto& tolerances = context.LodTolerances;
+  tolerances.assign(instances.size(), 0.f);
+  const auto& lod = context.Lod;
+  if (lod.PixelsPerUnit > 0.f) {
+    const glm::vec4 local_center{ (Mesh->BoundsMin + Mesh->BoundsMax) * .5f,
+                                  1.f };
+    const f32 local_radius =
+      glm::length(Mesh->BoundsMax - Mesh->BoundsMin) * .5f;
+    for (size_t i = 0; i < instances.size(); ++i) {
+      const glm::mat4 model = mat * FromInstanceTransform(instances[i]);
+      const glm::vec3 center{ model * local_center };
+      const f32 scale = std::max({ glm::length(glm::vec3{ model[0] }),
+                                   glm::length(glm::vec3{ model[1] }),
+                                   glm::length(glm::vec3{ model[2] }) });
+      const glm::vec3 to_camera = center - lod.CameraPosition;
+      const f32 distance =
+        std::max(glm::length(to_camera) - local_radius * scale, 1e-3f);
+      tolerances[i] =
+        lod.MaxPixelError * distance / (lod.PixelsPerUnit * scale);
+    }
+  }
+
+  auto& levels = context.LodLevels;
+  levels.assign(instances.size(), 0);
   for (const auto& submesh : Mesh->Submeshes) {
     bool isOpaque = (submesh.material->Opacity == MaterialOpacity::Opaque);
     std::vector<RenderItem>& draws =
       isOpaque ? context.OpaqueItems : context.TransparentItems;
-    draws.emplace_back(RenderItem{ mat,
-                                   Mesh->VertexBuffer(),
-                                   Mesh->IndexBuffer(),
-                                   submesh.FirstIndex,
-                                   submesh.VertexCount,
-                                   submesh.material });
+
+    // Levels have increasing errors, keep the last one that's hidden
+    u32 max_level{ 0 };
+    for (size_t i = 0; i < instances.size(); ++i) {
+      u8 level{ 0 };
+      while (level < submesh.Lods.size() &&
+             submesh.Lods[level].Error <= tolerances[i]) {
+        ++level;
+      }
+      levels[i] = level;
+      max_level = std::max<u32>(max_level, level);
+    }
+
+    for (u32 level = 0; level <= max_level; ++level) {
+      const u32 first_instance = context.InstanceTransforms.size();
+      for (size_t i = 0; i < instances.size(); ++i) {
+        if (levels[i] == level) {
+          context.InstanceTransforms.push_back(instances[i]);
+        }
+      }
+      const u32 instance_count =
+        context.InstanceTransforms.size() - first_instance;
+      if (instance_count == 0) {
+        continue;
+      }
+      size_t first_index = submesh.FirstIndex;
+      size_t index_count = submesh.VertexCount;
+      u32 meshlet_count = submesh.MeshletCount;
+      if (level > 0) {
+        first_index = submesh.Lods[level - 1].FirstIndex;
+        index_count = submesh.Lods[level - 1].IndexCount;
+        meshlet_count = 0;
+      }
+      draws.emplace_back(RenderItem{ mat,
+                                     Mesh->VertexBuffer(),
+                                     Mesh->IndexBuffer(),
+                                     Mesh->Buffers.FirstIndex + first_index,
+                                     index_count,
+                                     submesh.material,
+                                     Mesh->Buffers.VertexOffset,
+                                     Mesh->Buffers.IndexSize,
+                                     Mesh->Quantization,
+                                     first_instance,
+                                     instance_count,
+                                     level,
+                                     Mesh->Meshlets.Buffer,
+                                     submesh.FirstMeshlet,
+                                     meshlet_count });
+    }
   }
   SceneNode::Draw(matrix, context); // recurse down on children
 }
@@ -1,12 +1,32 @@
 #pragma once
 
+#include <string>
 #include <vector>
 
 #include "common/camera.h"
 #include "common/material.h"
+#include "common/vertex_formats.h"
 
 #include <SDL3/SDL_gpu.h>
+#include <glm/ext/matrix_float3x4.hpp>
 #include <glm/ext/matrix_float4x4.hpp>
+#include <glm/matrix.hpp>
+
+// Node space transform of a mesh instance, the first three rows of its affine
+// matrix: 48 bytes, read by pbr.vert as a mat3x4
+using InstanceTransform = glm::mat3x4;
+
+inline InstanceTransform
+ToInstanceTransform(const glm::mat4& matrix)
+{
+  return InstanceTransform{ glm::transpose(matrix) };
+}
+
+inline glm::mat4
+FromInstanceTransform(const InstanceTransform& rows)
+{
+  return glm::transpose(glm::mat4{ rows });
+}
 
 struct RenderItem
 {
@@ -16,16 +36,47 @@ struct RenderItem
   const std::size_t FirstIndex;
   const std::size_t VertexCount;
   SharedPtr<MaterialInstance> Material{ nullptr };
+  const i32 VertexOffset{ 0 }; // added to every index, see MeshPool
+  SDL_GPUIndexElementSize IndexSize{ SDL_GPU_INDEXELEMENTSIZE_32BIT };
+  VertexQuantization Quantization{}; // decodes packed positions
+  // Into RenderContext::InstanceTransforms, every instance uses the same LOD
+  u32 FirstInstance{ 0 };
+  u32 InstanceCount{ 1 };
+  u32 Lod{ 0 };
+  // Meshlets splitting [FirstIndex, FirstIndex + VertexCount), in a
+  // MeshletPool page. Only the full level has them
+  SDL_GPUBuffer* Meshlets{ nullptr };
+  u32 FirstMeshlet{ 0 };
+  u32 MeshletCount{ 0 };
+};
+
+// How MeshNode::Draw picks LODs: the coarsest one whose error, projected on
+// screen, stays under MaxPixelError
+struct LodSelection
+{
+  glm::vec3 CameraPosition{ 0.f };
+  // Pixels covered by one unit at a distance of one, 0 disables LODs
+  f32 PixelsPerUnit{ 0.f };
+  f32 MaxPixelError{ 1.f };
+
+  static f32 PixelsPerUnitFor(f32 fov_y, f32 viewport_height);
 };
 
 struct RenderContext
 {
   std::vector<RenderItem> OpaqueItems{};
   std::vector<RenderItem> TransparentItems{};
+  LodSelection Lod{};
+  // Instance transforms of the frame's RenderItems, grouped by LOD
+  std::vector<InstanceTransform> InstanceTransforms{};
+  // Per instance scratch of the node being drawn, reused across nodes/frames
+  std::vector<f32> LodTolerances{};
+  std::vector<u8> LodLevels{};
   void Clear()
   {
     OpaqueItems.clear();
     TransparentItems.clear();
+    InstanceTransforms.clear();
   }
 };
 
@@ -35,26 +86,58 @@ struct IRenderable
   virtual void Draw(glm::mat4 matrix, RenderContext& context) = 0;
 };
 
+// Simplified index range of a Geometry, in the same buffers
+struct GeometryLod
+{
+  u32 FirstIndex;
+  u32 IndexCount;
+  f32 Error; // object space
+};
+
 struct Geometry
 {
   const std::size_t FirstIndex;
   const std::size_t VertexCount;
   std::shared_ptr<MaterialInstance> material{ nullptr };
+  u32 MaterialIndex{ 0 }; // the instance's source, in the owning scene
+  std::vector<GeometryLod> Lods{}; // coarser and coarser, LOD 0 excluded
+  u32 FirstMeshlet{ 0 }; // into MeshAsset::Meshlets' buffer
+  u32 MeshletCount{ 0 };
 };
 
-// Vertex + Index buffer combo
+// Vertex + Index buffer combo. Meshes living in a MeshPool only own the
+// [VertexOffset, FirstIndex) ranges of shared buffers
 struct MeshBuffers
 {
   SDL_GPUBuffer* VertexBuffer{};
   SDL_GPUBuffer* IndexBuffer{};
+  i32 VertexOffset{ 0 };
+  u32 VertexCount{ 0 };
+  u32 FirstIndex{ 0 };
+  u32 IndexCount{ 0 };
+  SDL_GPUIndexElementSize IndexSize{ SDL_GPU_INDEXELEMENTSIZE_32BIT };
+};
+
+// Meshlets of a mesh, a range of a MeshletPool page
+struct MeshletRange
+{
+  SDL_GPUBuffer* Buffer{ nullptr }; // MeshletBinding
+  u32 First{ 0 };
+  u32 Count{ 0 };
 };
 
 struct MeshAsset
 {
-  const char* Name;
+  std::string Name;
   std::vector<Geometry> Submeshes;
+  glm::vec3 BoundsMin{ 0.f }; // object space
+  glm::vec3 BoundsMax{ 0.f };
+  VertexFormat Format{ VertexFormat::Packed };
+  VertexQuantization Quantization{};
+  bool Visible{ true }; // streamed meshes are skipped until their data landed
 
   MeshBuffers Buffers{};
+  MeshletRange Meshlets{};
   SDL_GPUBuffer* VertexBuffer() const { return Buffers.VertexBuffer; }
   SDL_GPUBuffer* IndexBuffer() const { return Buffers.IndexBuffer; }
 };
@@ -73,6 +156,8 @@ struct SceneNode : public IRenderable
 struct MeshNode final : public SceneNode
 {
   MeshAsset* Mesh;
+  // EXT_mesh_gpu_instancing, the mesh is drawn once at the node when empty
+  std::vector<InstanceTransform> Instances{};
   void Draw(glm::mat4 matrix, RenderContext& context) override;
 };
 
@@ -0,0 +1,74 @@
+#include "scene_cache.h"
+
+#include "common/logger.h"
+
+#include <algorithm>
+
+#include <pch.h>
+
+SceneCache::SceneCache(u64 budget)
+  : budget_{ budget }
+{
+}
+
+UniquePtr<GLTFScene>
+SceneCache::Take(const std::filesystem::path& path)
+{
+  auto it = std::find_if(entries_.begin(), entries_.end(), [&](auto& entry) {
+    return entry.Scene->Path == path;
+  });
+  if (it == entries_.end()) {
+    return nullptr;
+  }
+  auto ret = std::move(it->Scene);
+  used_ -= it->Bytes;
+  entries_.erase(it);
+  return ret;
+}
+
+void
+SceneCache::Insert(UniquePtr<GLTFScene> scene, u64 bytes)
+{
+  if (!scene) {
+    return;
+  }
+  Take(scene->Path); // an older copy is released
+  used_ += bytes;
+  entries_.push_front({ std::move(scene), bytes });
+  Evict();
+}
+
+bool
+SceneCache::Contains(const std::filesystem::path& path) const
+{
+  return std::any_of(entries_.begin(), entries_.end(), [&](auto& entry) {
+    return entry.Scene->Path == path;
+  });
+}
+
+void
+SceneCache::Clear()
+{
+  entries_.clear();
+  used_ = 0;
+}
+
+void
+SceneCache::SetBudget(u64 bytes)
+{
+  budget_ = bytes;
+  Evict();
+}
+
+void
+SceneCache::Evict()
+{
+  while (used_ > budget_ && !entries_.empty()) {
+    auto& lru = entries_.back();
+    LOG_DEBUG("SceneCache: evicting `{}` ({} bytes)",
+              lru.Scene->Path.string(),
+              lru.Bytes);
+    used_ -= lru.Bytes;
+    entries_.pop_back();
+  }
+}
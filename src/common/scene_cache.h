@@ -0,0 +1,48 @@
+#pragma once
+
+#include "common/gltf_scene.h"
+#include "common/types.h"
+#include "common/util.h"
+#include <filesystem>
+#include <list>
+
+// Scenes switched away from, kept resident so picking them again is instant.
+// Least recently used ones are released once the cached scenes take more GPU
+// memory than the budget. Main thread only
+class SceneCache
+{
+public:
+  static constexpr u64 DefaultBudget = 1024ull * 1024 * 1024;
+
+public:
+  DISABLE_COPY_AND_MOVE(SceneCache);
+  explicit SceneCache(u64 budget = DefaultBudget);
+
+  // Takes the scene of `path` out of the cache, nullptr if it isn't cached
+  UniquePtr<GLTFScene> Take(const std::filesystem::path& path);
+  // Caches `scene` as the most recently used one, `bytes` being its GPU
+  // memory (see GLTFScene::GpuBytes). That size is never measured again, only
+  // cache scenes done streaming (GLTFScene::Resident). Evicts down to the
+  // budget, `scene` included when it doesn't fit on its own
+  void Insert(UniquePtr<GLTFScene> scene, u64 bytes);
+  bool Contains(const std::filesystem::path& path) const;
+  void Clear();
+
+  void SetBudget(u64 bytes); // evicts down to it
+  u64 Budget() const { return budget_; }
+  u64 Used() const { return used_; }
+  size_t Size() const { return entries_.size(); }
+
+private:
+  struct Entry
+  {
+    UniquePtr<GLTFScene> Scene;
+    u64 Bytes;
+  };
+  void Evict();
+
+private:
+  std::list<Entry> entries_; // most recently used first
+  u64 budget_;
+  u64 used_{ 0 };
+};
@@ -25,10 +25,9 @@ ScenePicker::Render(bool loading)
 
     ImGui::Text("current dir: %s", cwd_.c_str());
 
+    // Scenes load concurrently, picking another one stays possible
     if (loading == true) {
       ImGui::Text("Loading...");
-      ImGui::End();
-      return;
     }
 
     bool disable_back = cwd_ == base_dir_;
@@ -0,0 +1,56 @@
+#include "shared_textures.h"
+
+#include <pch.h>
+
+bool
+SharedTextures::Acquire(u64 key, Entry* out)
+{
+  std::lock_guard lock{ mutex_ };
+  auto it = by_key_.find(key);
+  if (it == by_key_.end()) {
+    return false;
+  }
+  auto& shared = textures_.at(it->second);
+  ++shared.References;
+  *out = shared.Value;
+  return true;
+}
+
+bool
+SharedTextures::Insert(u64 key, Entry* entry)
+{
+  assert(entry->Texture);
+  std::lock_guard lock{ mutex_ };
+  auto [it, inserted] = by_key_.emplace(key, entry->Texture);
+  if (!inserted) {
+    auto& shared = textures_.at(it->second);
+    ++shared.References;
+    *entry = shared.Value;
+    return false;
+  }
+  textures_.emplace(entry->Texture, Shared{ *entry, key, 1 });
+  return true;
+}
+
+bool
+SharedTextures::Release(SDL_GPUTexture* texture)
+{
+  std::lock_guard lock{ mutex_ };
+  auto it = textures_.find(texture);
+  if (it == textures_.end()) {
+    return true;
+  }
+  if (--it->second.References > 0) {
+    return false;
+  }
+  by_key_.erase(it->second.Key);
+  textures_.erase(it);
+  return true;
+}
+
+size_t
+SharedTextures::Size() const
+{
+  std::lock_guard lock{ mutex_ };
+  return textures_.size();
+}
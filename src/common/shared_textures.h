@@ -0,0 +1,51 @@
+#pragma once
+
+#include "common/types.h"
+#include "common/upload_scheduler.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <mutex>
+#include <unordered_map>
+
+// Material textures shared by content across scenes. A texture decoded from
+// the same image bytes, for the same role and mip chain, is created once and
+// reference counted: every scene showing it holds a reference, the last one
+// releases it. Callable from any thread
+class SharedTextures
+{
+public:
+  struct Entry
+  {
+    SDL_GPUTexture* Texture{ nullptr };
+    UploadTicket Upload{}; // of its levels, shared by every scene
+  };
+
+public:
+  DISABLE_COPY_AND_MOVE(SharedTextures);
+  SharedTextures() = default;
+
+  // References the texture stored under `key`, false if there is none
+  bool Acquire(u64 key, Entry* out);
+  // Stores `entry` with one reference. When another texture got stored under
+  // `key` meanwhile, it's referenced and returned in `entry` instead: the
+  // caller releases the one it passed
+  bool Insert(u64 key, Entry* entry);
+  // Drops a reference. True when the caller must release the texture: it
+  // was the last reference, or the texture isn't shared
+  bool Release(SDL_GPUTexture* texture);
+
+  size_t Size() const;
+
+private:
+  struct Shared
+  {
+    Entry Value;
+    u64 Key;
+    u32 References;
+  };
+
+private:
+  std::unordered_map<u64, SDL_GPUTexture*> by_key_;
+  std::unordered_map<SDL_GPUTexture*, Shared> textures_;
+  mutable std::mutex mutex_;
+};
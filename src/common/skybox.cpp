@@ -39,11 +39,11 @@ Skybox::Skybox(const std::filesystem::path path,
 Skybox::~Skybox()
 {
   LOG_TRACE("Destroying Skybox");
-  auto* Device = engine_->Device;
-  RELEASE_IF(Pipeline, SDL_ReleaseGPUGraphicsPipeline);
-  RELEASE_IF(CubemapSampler, SDL_ReleaseGPUSampler);
-  RELEASE_IF(Buffers.IndexBuffer, SDL_ReleaseGPUBuffer);
-  RELEASE_IF(Buffers.VertexBuffer, SDL_ReleaseGPUBuffer);
+  auto& deletions = engine_->Deletions();
+  deletions.Release(Pipeline);
+  deletions.Release(CubemapSampler);
+  deletions.Release(Buffers.IndexBuffer);
+  deletions.Release(Buffers.VertexBuffer);
 }
 
 bool
@@ -0,0 +1,371 @@
+#include "staging_ring.h"
+
+#include "common/logger.h"
+#include "common/types.h"
+#include "common/util.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <pch.h>
+
+namespace {
+u64
+align_up(u64 value, u64 alignment)
+{
+  return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+StagingRing::StagingRing(SDL_GPUDevice* device, u32 capacity)
+  : device_{ device }
+  , capacity_{ capacity }
+{
+}
+
+StagingRing::~StagingRing()
+{
+  WaitIdle();
+
+  std::lock_guard lock{ mutex_ };
+  for (const auto& [buffer, state] : mapped_) {
+    SDL_UnmapGPUTransferBuffer(device_, buffer);
+  }
+  mapped_.clear();
+
+  for (auto& block : blocks_) {
+    if (!block.Submitted) {
+      LOG_WARN("StagingRing: allocation {} was never submitted", block.Id);
+    }
+    if (block.Dedicated) {
+      SDL_ReleaseGPUTransferBuffer(device_, block.Buffer);
+    }
+  }
+  blocks_.clear();
+
+  for (auto& retired : retired_) {
+    SDL_ReleaseGPUTransferBuffer(device_, retired.Buffer);
+  }
+  retired_.clear();
+
+  if (buffer_) {
+    SDL_ReleaseGPUTransferBuffer(device_, buffer_);
+  }
+}
+
+bool
+StagingRing::CreateRingBuffer(u32 capacity)
+{
+  SDL_GPUTransferBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    info.size = capacity;
+  }
+  auto* buffer = SDL_CreateGPUTransferBuffer(device_, &info);
+  if (!buffer) {
+    LOG_ERROR("Couldn't create staging buffer: {}", GETERR);
+    return false;
+  }
+
+  if (buffer_) { // retire it once every block referencing it is reclaimed
+    if (blocks_.empty()) {
+      SDL_ReleaseGPUTransferBuffer(device_, buffer_);
+    } else {
+      retired_.push_back({ buffer_, blocks_.back().Id });
+    }
+  }
+
+  LOG_DEBUG("Staging ring capacity: {} bytes", capacity);
+  buffer_ = buffer;
+  capacity_ = capacity;
+  head_ = 0;
+  tail_ = 0;
+  return true;
+}
+
+StagingRing::Allocation
+StagingRing::Allocate(u32 size, u32 alignment)
+{
+  if (size == 0) {
+    LOG_ERROR("StagingRing: empty allocation requested");
+    return {};
+  }
+  assert(alignment > 0);
+
+  std::lock_guard lock{ mutex_ };
+  ReclaimLocked();
+
+  if (!buffer_ || size > capacity_) {
+    u32 new_capacity = buffer_ ? capacity_ : std::max(capacity_, 1u);
+    while (new_capacity < size) {
+      new_capacity *= 2;
+    }
+    if (!CreateRingBuffer(new_capacity)) {
+      return {};
+    }
+  }
+
+  u64 offset{ 0 };
+  u64 needed{ 0 };
+  while (true) {
+    const u64 cursor = head_ % capacity_;
+    offset = align_up(cursor, alignment);
+    if (offset + size > capacity_) { // skip to the start of the ring
+      offset = 0;
+    }
+    needed = (offset >= cursor ? offset - cursor : capacity_ - cursor) + size;
+    if ((head_ - tail_) + needed <= capacity_) {
+      break;
+    }
+    if (!WaitFrontLocked()) {
+      // Oldest region is still being recorded; don't stall on it
+      LOG_DEBUG("StagingRing full, using dedicated transfer buffer");
+      return AllocateDedicated(size);
+    }
+  }
+
+  Block block{};
+  {
+    block.Id = next_id_++;
+    block.Begin = head_;
+    block.End = head_ + needed;
+    block.Buffer = buffer_;
+  }
+  blocks_.push_back(block);
+  head_ += needed;
+
+  return { buffer_, static_cast<u32>(offset), size, block.Id };
+}
+
+StagingRing::Allocation
+StagingRing::AllocateDedicated(u32 size)
+{
+  SDL_GPUTransferBufferCreateInfo info{};
+  {
+    info.usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD;
+    info.size = size;
+  }
+  auto* buffer = SDL_CreateGPUTransferBuffer(device_, &info);
+  if (!buffer) {
+    LOG_ERROR("Couldn't create transfer buffer: {}", GETERR);
+    return {};
+  }
+
+  Block block{};
+  {
+    block.Id = next_id_++;
+    block.Buffer = buffer;
+    block.Dedicated = true;
+  }
+  blocks_.push_back(block);
+  return { buffer, 0, size, block.Id };
+}
+
+u8*
+StagingRing::Map(const Allocation& alloc)
+{
+  if (!alloc.Valid()) {
+    return nullptr;
+  }
+
+  std::lock_guard lock{ mutex_ };
+  auto& state = mapped_[alloc.Buffer];
+  if (state.Count == 0) {
+    state.Ptr = static_cast<u8*>(
+      SDL_MapGPUTransferBuffer(device_, alloc.Buffer, false));
+    if (!state.Ptr) {
+      LOG_ERROR("Couldn't map staging buffer: {}", GETERR);
+      mapped_.erase(alloc.Buffer);
+      return nullptr;
+    }
+  }
+  ++state.Count;
+  return state.Ptr + alloc.Offset;
+}
+
+void
+StagingRing::Unmap(const Allocation& alloc)
+{
+  std::lock_guard lock{ mutex_ };
+  auto it = mapped_.find(alloc.Buffer);
+  if (it == mapped_.end()) {
+    LOG_WARN("StagingRing: unmapping a buffer that isn't mapped");
+    return;
+  }
+  if (--it->second.Count == 0) {
+    SDL_UnmapGPUTransferBuffer(device_, alloc.Buffer);
+    mapped_.erase(it);
+  }
+}
+
+bool
+StagingRing::Write(const Allocation& alloc, const void* data, u32 size)
+{
+  if (size > alloc.Size) {
+    LOG_ERROR("StagingRing: write of {} bytes into {} byte allocation",
+              size,
+              alloc.Size);
+    return false;
+  }
+  u8* dst = Map(alloc);
+  if (!dst) {
+    return false;
+  }
+  SDL_memcpy(dst, data, size);
+  Unmap(alloc);
+  return true;
+}
+
+SharedPtr<SDL_GPUFence>
+StagingRing::Submit(SDL_GPUCommandBuffer* cmdbuf,
+                    std::initializer_list<Allocation> allocs)
+{
+  return SubmitImpl(cmdbuf, allocs.begin(), allocs.size());
+}
+
+SharedPtr<SDL_GPUFence>
+StagingRing::Submit(SDL_GPUCommandBuffer* cmdbuf,
+                    const std::vector<Allocation>& allocs)
+{
+  return SubmitImpl(cmdbuf, allocs.data(), allocs.size());
+}
+
+SharedPtr<SDL_GPUFence>
+StagingRing::SubmitImpl(SDL_GPUCommandBuffer* cmdbuf,
+                        const Allocation* allocs,
+                        size_t count)
+{
+  SDL_GPUFence* fence = SDL_SubmitGPUCommandBufferAndAcquireFence(cmdbuf);
+  if (!fence) {
+    LOG_ERROR("Couldn't submit upload command buffer: {}", GETERR);
+    MarkSubmitted(allocs, count, nullptr);
+    return nullptr;
+  }
+
+  auto* device = device_;
+  SharedPtr<SDL_GPUFence> shared{ fence, [device](SDL_GPUFence* f) {
+                                   SDL_ReleaseGPUFence(device, f);
+                                 } };
+  MarkSubmitted(allocs, count, shared);
+  return shared;
+}
+
+void
+StagingRing::Discard(const Allocation& alloc)
+{
+  if (alloc.Valid()) {
+    MarkSubmitted(&alloc, 1, nullptr);
+  }
+}
+
+void
+StagingRing::MarkSubmitted(const Allocation* allocs,
+                           size_t count,
+                           const SharedPtr<SDL_GPUFence>& fence)
+{
+  std::lock_guard lock{ mutex_ };
+  for (size_t i = 0; i < count; ++i) {
+    if (!allocs[i].Valid()) {
+      continue;
+    }
+    Block* block = FindBlock(allocs[i].Id);
+    if (!block) {
+      LOG_WARN("StagingRing: allocation {} submitted twice", allocs[i].Id);
+      continue;
+    }
+    block->Fence = fence;
+    block->Submitted = true;
+  }
+}
+
+StagingRing::Block*
+StagingRing::FindBlock(u64 id)
+{
+  if (blocks_.empty() || id < blocks_.front().Id) {
+    return nullptr;
+  }
+  const u64 idx = id - blocks_.front().Id;
+  if (idx >= blocks_.size()) {
+    return nullptr;
+  }
+  return &blocks_[idx];
+}
+
+void
+StagingRing::Reclaim()
+{
+  std::lock_guard lock{ mutex_ };
+  ReclaimLocked();
+}
+
+void
+StagingRing::ReclaimLocked()
+{
+  // Blocks are freed in allocation order, a slow submission holds back
+  // everything recorded after it
+  while (!blocks_.empty()) {
+    auto& front = blocks_.front();
+    if (!front.Submitted) {
+      break;
+    }
+    if (front.Fence && !SDL_QueryGPUFence(device_, front.Fence.get())) {
+      break;
+    }
+    if (front.Dedicated) {
+      SDL_ReleaseGPUTransferBuffer(device_, front.Buffer);
+    } else if (front.Buffer == buffer_) {
+      tail_ = front.End;
+    }
+    blocks_.pop_front();
+  }
+
+  std::erase_if(retired_, [this](const Retired& retired) {
+    if (blocks_.empty() || blocks_.front().Id > retired.LastBlockId) {
+      SDL_ReleaseGPUTransferBuffer(device_, retired.Buffer);
+      return true;
+    }
+    return false;
+  });
+
+  if (head_ == tail_) {
+    head_ = 0;
+    tail_ = 0;
+  }
+}
+
+bool
+StagingRing::WaitFrontLocked()
+{
+  if (blocks_.empty() || !blocks_.front().Submitted) {
+    return false;
+  }
+  SharedPtr<SDL_GPUFence> fence = blocks_.front().Fence;
+  if (fence) {
+    SDL_GPUFence* raw = fence.get();
+    SDL_WaitForGPUFences(device_, true, &raw, 1);
+  }
+  ReclaimLocked();
+  return true;
+}
+
+void
+StagingRing::WaitIdle()
+{
+  std::lock_guard lock{ mutex_ };
+  std::vector<SDL_GPUFence*> fences{};
+  for (const auto& block : blocks_) {
+    if (block.Fence) {
+      fences.push_back(block.Fence.get());
+    }
+  }
+  if (!fences.empty()) {
+    SDL_WaitForGPUFences(
+      device_, true, fences.data(), static_cast<u32>(fences.size()));
+  }
+  ReclaimLocked();
+}
+
+u64
+StagingRing::InFlightBytes() const
+{
+  std::lock_guard lock{ mutex_ };
+  return head_ - tail_;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "common/types.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <deque>
+#include <initializer_list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Persistent upload transfer buffer shared by every engine upload.
+// Regions are sub-allocated linearly (wrapping around) and become reusable
+// once the fence of the submission that consumed them has signaled.
+// The backing buffer only grows when a single request exceeds its capacity.
+class StagingRing
+{
+public:
+  static constexpr u32 DefaultCapacity = 32 * 1024 * 1024;
+  static constexpr u32 DefaultAlignment = 16;
+
+  struct Allocation
+  {
+    SDL_GPUTransferBuffer* Buffer{ nullptr };
+    u32 Offset{ 0 };
+    u32 Size{ 0 };
+    u64 Id{ 0 };
+
+    bool Valid() const { return Buffer != nullptr; }
+  };
+
+public:
+  DISABLE_COPY_AND_MOVE(StagingRing);
+  explicit StagingRing(SDL_GPUDevice* device, u32 capacity = DefaultCapacity);
+  ~StagingRing();
+
+  // Returns an invalid allocation on failure. Every valid allocation must be
+  // handed back through Submit() or Discard()
+  Allocation Allocate(u32 size, u32 alignment = DefaultAlignment);
+
+  // Mapping is refcounted per transfer buffer, so several threads can fill
+  // disjoint allocations at the same time
+  u8* Map(const Allocation& alloc);
+  void Unmap(const Allocation& alloc);
+  bool Write(const Allocation& alloc, const void* data, u32 size);
+
+  // Submits the command buffer and ties the allocations to its fence.
+  // Returns nullptr if the submission failed
+  SharedPtr<SDL_GPUFence> Submit(SDL_GPUCommandBuffer* cmdbuf,
+                                 std::initializer_list<Allocation> allocs);
+  SharedPtr<SDL_GPUFence> Submit(SDL_GPUCommandBuffer* cmdbuf,
+                                 const std::vector<Allocation>& allocs);
+  // Gives an allocation back without it being consumed by the GPU
+  void Discard(const Allocation& alloc);
+
+  // Releases every region whose submission has completed
+  void Reclaim();
+  // Blocks until every submitted region has been consumed
+  void WaitIdle();
+
+  u32 Capacity() const { return capacity_; }
+  u64 InFlightBytes() const;
+
+private:
+  struct Block
+  {
+    u64 Id;
+    u64 Begin; // ring positions, monotonic
+    u64 End;
+    SDL_GPUTransferBuffer* Buffer;
+    SharedPtr<SDL_GPUFence> Fence;
+    bool Submitted{ false };
+    bool Dedicated{ false };
+  };
+
+  struct Retired
+  {
+    SDL_GPUTransferBuffer* Buffer;
+    u64 LastBlockId;
+  };
+
+  struct MapState
+  {
+    u8* Ptr{ nullptr };
+    u32 Count{ 0 };
+  };
+
+  bool CreateRingBuffer(u32 capacity);
+  Allocation AllocateDedicated(u32 size);
+  Block* FindBlock(u64 id);
+  void MarkSubmitted(const Allocation* allocs,
+                     size_t count,
+                     const SharedPtr<SDL_GPUFence>& fence);
+  SharedPtr<SDL_GPUFence> SubmitImpl(SDL_GPUCommandBuffer* cmdbuf,
+                                     const Allocation* allocs,
+                                     size_t count);
+  void ReclaimLocked();
+  bool WaitFrontLocked();
+
+private:
+  SDL_GPUDevice* device_;
+  SDL_GPUTransferBuffer* buffer_{ nullptr };
+  u32 capacity_;
+  u64 head_{ 0 };
+  u64 tail_{ 0 };
+  u64 next_id_{ 0 };
+  std::deque<Block> blocks_;
+  std::vector<Retired> retired_;
+  std::unordered_map<SDL_GPUTransferBuffer*, MapState> mapped_;
+  mutable std::mutex mutex_;
+};
@@ -0,0 +1,409 @@
+#include "texture_encoder.h"
+
+#include "common/logger.h"
+#include "common/mip_chain.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+
+#ifndef STB_DXT_IMPLEMENTATION
+#define STB_DXT_IMPLEMENTATION
+#endif
+#include <stb/stb_dxt.h>
+#include <pch.h>
+
+namespace {
+using Block = std::array<std::array<u8, 4>, 16>; // 4x4 RGBA texels
+
+constexpr u32 BC7_WEIGHTS[16] = { 0,  4,  9,  13, 17, 21, 26, 30,
+                                  34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Mode 6 endpoints: 7 bits per channel plus one p-bit per endpoint
+struct Bc7Endpoints
+{
+  std::array<std::array<u8, 4>, 2> Color{};
+  std::array<u8, 2> P{};
+
+  i32 Expand(u32 endpoint, u32 channel) const
+  {
+    return (Color[endpoint][channel] << 1) | P[endpoint];
+  }
+};
+
+// Closest 7 bit color and p-bit to an 8 bit one
+void
+bc7_quantize(const f32 color[4], std::array<u8, 4>* out, u8* p)
+{
+  f32 best = std::numeric_limits<f32>::max();
+  for (u8 pbit = 0; pbit < 2; ++pbit) {
+    std::array<u8, 4> q{};
+    f32 err = 0;
+    for (u32 c = 0; c < 4; ++c) {
+      const f32 v = std::round((std::clamp(color[c], 0.f, 255.f) - pbit) / 2);
+      q[c] = static_cast<u8>(std::clamp(v, 0.f, 127.f));
+      const f32 d = static_cast<f32>((q[c] << 1) | pbit) - color[c];
+      err += d * d;
+    }
+    if (err < best) {
+      best = err;
+      *out = q;
+      *p = pbit;
+    }
+  }
+}
+
+// Picks the closest palette entry of every texel, returns the squared error
+u32
+bc7_fit(const Block& texels, const Bc7Endpoints& ep, u8 indices[16])
+{
+  i32 palette[16][4];
+  for (u32 i = 0; i < 16; ++i) {
+    for (u32 c = 0; c < 4; ++c) {
+      const i32 w = BC7_WEIGHTS[i];
+      palette[i][c] =
+        ((64 - w) * ep.Expand(0, c) + w * ep.Expand(1, c) + 32) >> 6;
+    }
+  }
+  u32 ret{ 0 };
+  for (u32 t = 0; t < 16; ++t) {
+    u32 best = std::numeric_limits<u32>::max();
+    for (u32 i = 0; i < 16; ++i) {
+      u32 err{ 0 };
+      for (u32 c = 0; c < 4; ++c) {
+        const i32 d = palette[i][c] - texels[t][c];
+        err += d * d;
+      }
+      if (err < best) {
+        best = err;
+        indices[t] = static_cast<u8>(i);
+      }
+    }
+    ret += best;
+  }
+  return ret;
+}
+
+// Endpoints along the principal axis of the block's colors
+Bc7Endpoints
+bc7_principal_endpoints(const Block& texels)
+{
+  f32 mean[4]{};
+  for (const auto& t : texels) {
+    for (u32 c = 0; c < 4; ++c) {
+      mean[c] += t[c] / 16.f;
+    }
+  }
+  f32 cov[4][4]{};
+  for (const auto& t : texels) {
+    for (u32 i = 0; i < 4; ++i) {
+      for (u32 j = 0; j < 4; ++j) {
+        cov[i][j] += (t[i] - mean[i]) * (t[j] - mean[j]);
+      }
+    }
+  }
+  // Power iteration from the channel ranges
+  f32 axis[4]{};
+  for (u32 c = 0; c < 4; ++c) {
+    u8 lo{ 255 }, hi{ 0 };
+    for (const auto& t : texels) {
+      lo = std::min(lo, t[c]);
+      hi = std::max(hi, t[c]);
+    }
+    axis[c] = static_cast<f32>(hi - lo);
+  }
+  for (u32 iteration = 0; iteration < 8; ++iteration) {
+    f32 next[4]{};
+    f32 length{ 0 };
+    for (u32 i = 0; i < 4; ++i) {
+      for (u32 j = 0; j < 4; ++j) {
+        next[i] += cov[i][j] * axis[j];
+      }
+      length = std::max(length, std::abs(next[i]));
+    }
+    if (length <= 0) {
+      break;
+    }
+    for (u32 i = 0; i < 4; ++i) {
+      axis[i] = next[i] / length;
+    }
+  }
+  f32 norm{ 0 };
+  for (u32 c = 0; c < 4; ++c) {
+    norm += axis[c] * axis[c];
+  }
+
+  f32 lo[4]{ mean[0], mean[1], mean[2], mean[3] };
+  f32 hi[4]{ mean[0], mean[1], mean[2], mean[3] };
+  if (norm > 0) {
+    f32 t_min = std::numeric_limits<f32>::max();
+    f32 t_max = std::numeric_limits<f32>::lowest();
+    for (const auto& t : texels) {
+      f32 proj{ 0 };
+      for (u32 c = 0; c < 4; ++c) {
+        proj += (t[c] - mean[c]) * axis[c];
+      }
+      t_min = std::min(t_min, proj / norm);
+      t_max = std::max(t_max, proj / norm);
+    }
+    for (u32 c = 0; c < 4; ++c) {
+      lo[c] = mean[c] + axis[c] * t_min;
+      hi[c] = mean[c] + axis[c] * t_max;
+    }
+  }
+  Bc7Endpoints ret{};
+  bc7_quantize(lo, &ret.Color[0], &ret.P[0]);
+  bc7_quantize(hi, &ret.Color[1], &ret.P[1]);
+  return ret;
+}
+
+// Least squares endpoints for the given indices, false when they're all equal
+bool
+bc7_refine(const Block& texels, const u8 indices[16], Bc7Endpoints* out)
+{
+  f32 aa{ 0 }, ab{ 0 }, bb{ 0 };
+  f32 ax[4]{}, bx[4]{};
+  for (u32 t = 0; t < 16; ++t) {
+    const f32 b = BC7_WEIGHTS[indices[t]] / 64.f;
+    const f32 a = 1 - b;
+    aa += a * a;
+    ab += a * b;
+    bb += b * b;
+    for (u32 c = 0; c < 4; ++c) {
+      ax[c] += a * texels[t][c];
+      bx[c] += b * texels[t][c];
+    }
+  }
+  const f32 det = aa * bb - ab * ab;
+  if (std::abs(det) < 1e-6f) {
+    return false;
+  }
+  f32 lo[4], hi[4];
+  for (u32 c = 0; c < 4; ++c) {
+    lo[c] = (bb * ax[c] - ab * bx[c]) / det;
+    hi[c] = (aa * bx[c] - ab * ax[c]) / det;
+  }
+  bc7_quantize(lo, &out->Color[0], &out->P[0]);
+  bc7_quantize(hi, &out->Color[1], &out->P[1]);
+  return true;
+}
+
+struct BitWriter
+{
+  u8* Out;
+  u32 Position{ 0 };
+
+  void Write(u32 value, u32 bits)
+  {
+    for (u32 i = 0; i < bits; ++i, ++Position) {
+      if ((value >> i) & 1) {
+        Out[Position / 8] |= static_cast<u8>(1 << (Position % 8));
+      }
+    }
+  }
+};
+
+void
+encode_bc7_block(u8* dst, const Block& texels)
+{
+  Bc7Endpoints best = bc7_principal_endpoints(texels);
+  u8 best_indices[16];
+  u32 best_err = bc7_fit(texels, best, best_indices);
+  for (u32 iteration = 0; iteration < 2 && best_err > 0; ++iteration) {
+    Bc7Endpoints refined{};
+    u8 indices[16];
+    if (!bc7_refine(texels, best_indices, &refined)) {
+      break;
+    }
+    const u32 err = bc7_fit(texels, refined, indices);
+    if (err >= best_err) {
+      break;
+    }
+    best = refined;
+    best_err = err;
+    std::copy(indices, indices + 16, best_indices);
+  }
+
+  // The first texel's index drops its top bit, swap endpoints to clear it
+  if (best_indices[0] & 0x8) {
+    std::swap(best.Color[0], best.Color[1]);
+    std::swap(best.P[0], best.P[1]);
+    for (auto& index : best_indices) {
+      index = static_cast<u8>(15 - index);
+    }
+  }
+
+  std::fill(dst, dst + 16, u8{ 0 });
+  BitWriter bits{ dst };
+  bits.Write(1 << 6, 7); // mode 6
+  for (u32 c = 0; c < 4; ++c) {
+    bits.Write(best.Color[0][c], 7);
+    bits.Write(best.Color[1][c], 7);
+  }
+  bits.Write(best.P[0], 1);
+  bits.Write(best.P[1], 1);
+  bits.Write(best_indices[0], 3);
+  for (u32 t = 1; t < 16; ++t) {
+    bits.Write(best_indices[t], 4);
+  }
+}
+
+void
+encode_block(SDL_GPUTextureFormat format, u8* dst, const Block& texels)
+{
+  switch (format) {
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+      stb_compress_dxt_block(dst, texels[0].data(), 0, STB_DXT_HIGHQUAL);
+      break;
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB:
+      stb_compress_dxt_block(dst, texels[0].data(), 1, STB_DXT_HIGHQUAL);
+      break;
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM: {
+      u8 rg[32];
+      for (u32 t = 0; t < 16; ++t) {
+        rg[t * 2 + 0] = texels[t][0];
+        rg[t * 2 + 1] = texels[t][1];
+      }
+      stb_compress_bc5_block(dst, rg);
+      break;
+    }
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB:
+      encode_bc7_block(dst, texels);
+      break;
+    default:
+      assert(false && "Unsupported block format");
+  }
+}
+}
+
+SDL_GPUTextureFormat
+TextureEncoder::FormatFor(TextureRole role,
+                          bool srgb,
+                          bool has_alpha,
+                          u32 width,
+                          u32 height,
+                          const TextureTranscoder::Support& support)
+{
+  if (!TextureTranscoder::FitsBlocks(width, height)) {
+    return SDL_GPU_TEXTUREFORMAT_INVALID;
+  }
+  switch (role) {
+    case TextureRole::Color:
+      if (support.BC7) {
+        return srgb ? SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB
+                    : SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
+      }
+      if (has_alpha && support.BC3) {
+        return srgb ? SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB
+                    : SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+      }
+      break;
+    case TextureRole::Normal:
+      if (!srgb && support.BC5) {
+        return SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM;
+      }
+      break;
+    case TextureRole::Data:
+      break;
+  }
+  // BC1 alpha is 1 bit, only opaque images use it
+  if (!has_alpha && role != TextureRole::Normal && support.BC1) {
+    return srgb ? SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB
+                : SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+  }
+  return SDL_GPU_TEXTUREFORMAT_INVALID;
+}
+
+bool
+TextureEncoder::HasAlpha(std::span<const u8> rgba)
+{
+  for (size_t i = 3; i < rgba.size(); i += 4) {
+    if (rgba[i] != 255) {
+      return true;
+    }
+  }
+  return false;
+}
+
+u32
+TextureEncoder::BlockSize(SDL_GPUTextureFormat format)
+{
+  switch (format) {
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+      return 8;
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB:
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB:
+      return 16;
+    default:
+      return 0;
+  }
+}
+
+std::vector<u8>
+TextureEncoder::Encode(SDL_GPUTextureFormat format,
+                       std::span<const u8> rgba,
+                       u32 width,
+                       u32 height)
+{
+  const u32 block_size = BlockSize(format);
+  assert(block_size > 0);
+  assert(rgba.size() >= u64{ width } * height * 4);
+  const u32 blocks_x = (width + 3) / 4;
+  const u32 blocks_y = (height + 3) / 4;
+
+  std::vector<u8> ret(u64{ blocks_x } * blocks_y * block_size);
+  u8* dst = ret.data();
+  Block texels{};
+  for (u32 by = 0; by < blocks_y; ++by) {
+    for (u32 bx = 0; bx < blocks_x; ++bx) {
+      for (u32 t = 0; t < 16; ++t) {
+        const u32 x = std::min(bx * 4 + t % 4, width - 1);
+        const u32 y = std::min(by * 4 + t / 4, height - 1);
+        const u8* src = rgba.data() + (u64{ y } * width + x) * 4;
+        std::copy(src, src + 4, texels[t].begin());
+      }
+      encode_block(format, dst, texels);
+      dst += block_size;
+    }
+  }
+  return ret;
+}
+
+bool
+TextureEncoder::EncodeChain(SDL_GPUTextureFormat format,
+                            std::vector<u8>&& rgba,
+                            u32 width,
+                            u32 height,
+                            u32 levels,
+                            bool srgb,
+                            TranscodedTexture* out)
+{
+  if (BlockSize(format) == 0 || levels == 0) {
+    LOG_WARN("TextureEncoder: can't encode format {}", (u32)format);
+    return false;
+  }
+  out->Format = format;
+  out->Width = width;
+  out->Height = height;
+  out->Levels.clear();
+  out->Levels.reserve(levels);
+  u32 w = width;
+  u32 h = height;
+  for (u32 level = 0; level < levels; ++level) {
+    out->Levels.push_back(Encode(format, rgba, w, h));
+    if (level + 1 < levels) {
+      rgba = MipChain::Downsample(rgba, w, h, srgb);
+      w = MipChain::LevelSize(w, 1);
+      h = MipChain::LevelSize(h, 1);
+    }
+  }
+  return true;
+}
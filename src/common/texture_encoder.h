@@ -0,0 +1,42 @@
+#pragma once
+
+#include "common/texture_transcoder.h"
+#include "common/types.h"
+#include <SDL3/SDL_gpu.h>
+#include <span>
+#include <vector>
+
+// CPU block compression of decoded RGBA8 images (PNG, JPEG). BC1, BC3 and BC5
+// go through stb_dxt, BC7 uses its single subset mode 6 with PCA endpoints
+// refined by least squares. Blocks are encoded in the image's own color
+// space, sRGB formats decode them back the same way
+class TextureEncoder
+{
+public:
+  // Block format an image of `role` is compressed to, INVALID keeps it RGBA8.
+  // Colors are BC7, or BC1/BC3 depending on alpha, normals BC5 and data BC1
+  static SDL_GPUTextureFormat FormatFor(
+    TextureRole role,
+    bool srgb,
+    bool has_alpha,
+    u32 width,
+    u32 height,
+    const TextureTranscoder::Support& support);
+  static bool HasAlpha(std::span<const u8> rgba);
+  // Bytes of a 4x4 block, 0 for formats the encoder doesn't produce
+  static u32 BlockSize(SDL_GPUTextureFormat format);
+
+  // One level, texels past the edges repeat the last row/column
+  static std::vector<u8> Encode(SDL_GPUTextureFormat format,
+                                std::span<const u8> rgba,
+                                u32 width,
+                                u32 height);
+  // `levels` levels, box filtered from `rgba` (see MipChain) then encoded
+  static bool EncodeChain(SDL_GPUTextureFormat format,
+                          std::vector<u8>&& rgba,
+                          u32 width,
+                          u32 height,
+                          u32 levels,
+                          bool srgb,
+                          TranscodedTexture* out);
+};
@@ -0,0 +1,198 @@
+#include "texture_transcoder.h"
+
+#include "common/logger.h"
+
+#include <cstring>
+
+#include <ktx.h>
+#include <pch.h>
+
+namespace {
+constexpr u8 KTX2_MAGIC[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+// KTX2 files that skip transcoding, by VkFormat
+SDL_GPUTextureFormat
+from_vk_format(u32 vk_format)
+{
+  switch (vk_format) {
+    case 37: // VK_FORMAT_R8G8B8A8_UNORM
+      return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+    case 43: // VK_FORMAT_R8G8B8A8_SRGB
+      return SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB;
+    case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+    case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+      return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+    case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+    case 134: // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+      return SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB;
+    case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+      return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM;
+    case 138: // VK_FORMAT_BC3_SRGB_BLOCK
+      return SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB;
+    case 141: // VK_FORMAT_BC5_UNORM_BLOCK
+      return SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM;
+    case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+      return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
+    case 146: // VK_FORMAT_BC7_SRGB_BLOCK
+      return SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB;
+    default:
+      return SDL_GPU_TEXTUREFORMAT_INVALID;
+  }
+}
+
+bool
+supported(SDL_GPUTextureFormat format, const TextureTranscoder::Support& s)
+{
+  switch (format) {
+    case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB:
+      return true;
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+      return s.BC1;
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB:
+      return s.BC3;
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM:
+      return s.BC5;
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB:
+      return s.BC7;
+    default:
+      return false;
+  }
+}
+
+ktx_transcode_fmt_e
+transcode_target(SDL_GPUTextureFormat format)
+{
+  switch (format) {
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB:
+      return KTX_TTF_BC7_RGBA;
+    case SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM:
+      return KTX_TTF_BC5_RG;
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM:
+    case SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB:
+      return KTX_TTF_BC1_RGB;
+    default:
+      return KTX_TTF_RGBA32;
+  }
+}
+}
+
+TextureTranscoder::Support
+TextureTranscoder::Support::Query(SDL_GPUDevice* device)
+{
+  auto supports = [device](SDL_GPUTextureFormat format) {
+    return SDL_GPUTextureSupportsFormat(
+      device, format, SDL_GPU_TEXTURETYPE_2D, SDL_GPU_TEXTUREUSAGE_SAMPLER);
+  };
+  Support ret{};
+  {
+    ret.BC1 = supports(SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM) &&
+              supports(SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB);
+    ret.BC3 = supports(SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM) &&
+              supports(SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB);
+    ret.BC5 = supports(SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM);
+    ret.BC7 = supports(SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM) &&
+              supports(SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB);
+  }
+  LOG_DEBUG("TextureTranscoder: BC1 {}, BC3 {}, BC5 {}, BC7 {}",
+            ret.BC1,
+            ret.BC3,
+            ret.BC5,
+            ret.BC7);
+  return ret;
+}
+
+bool
+TextureTranscoder::IsKtx2(std::span<const u8> bytes)
+{
+  return bytes.size() >= sizeof(KTX2_MAGIC) &&
+         std::memcmp(bytes.data(), KTX2_MAGIC, sizeof(KTX2_MAGIC)) == 0;
+}
+
+SDL_GPUTextureFormat
+TextureTranscoder::FormatFor(TextureRole role,
+                             bool srgb,
+                             const Support& support)
+{
+  if (role == TextureRole::Normal && !srgb && support.BC5) {
+    return SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM;
+  }
+  if (role == TextureRole::Data && support.BC1) {
+    return srgb ? SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB
+                : SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM;
+  }
+  if (role == TextureRole::Color && support.BC7) {
+    return srgb ? SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB
+                : SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM;
+  }
+  return srgb ? SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB
+              : SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM;
+}
+
+bool
+TextureTranscoder::Transcode(std::span<const u8> bytes,
+                             TextureRole role,
+                             bool srgb,
+                             const Support& support,
+                             TranscodedTexture* out)
+{
+  ktxTexture2* ktx{ nullptr };
+  auto result = ktxTexture2_CreateFromMemory(
+    bytes.data(), bytes.size(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktx);
+  if (result != KTX_SUCCESS) {
+    LOG_WARN("Couldn't read KTX2 texture: {}", ktxErrorString(result));
+    return false;
+  }
+  if (ktx->numDimensions != 2 || ktx->isCubemap || ktx->isArray ||
+      ktx->numFaces != 1) {
+    LOG_WARN("KTX2 material textures must be plain 2D textures");
+    ktxTexture2_Destroy(ktx);
+    return false;
+  }
+
+  auto format = FormatFor(role, srgb, support);
+  if (!FitsBlocks(ktx->baseWidth, ktx->baseHeight)) {
+    format = FormatFor(role, srgb, Support{});
+  }
+  if (ktxTexture2_NeedsTranscoding(ktx)) {
+    result = ktxTexture2_TranscodeBasis(ktx, transcode_target(format), 0);
+    if (result != KTX_SUCCESS) {
+      LOG_WARN("Couldn't transcode KTX2 texture: {}", ktxErrorString(result));
+      ktxTexture2_Destroy(ktx);
+      return false;
+    }
+  } else {
+    format = from_vk_format(ktx->vkFormat);
+    if (!supported(format, support)) {
+      LOG_WARN("KTX2 texture format {} isn't supported", ktx->vkFormat);
+      ktxTexture2_Destroy(ktx);
+      return false;
+    }
+  }
+
+  out->Format = format;
+  out->Width = ktx->baseWidth;
+  out->Height = ktx->baseHeight;
+  out->Levels.resize(ktx->numLevels);
+  for (u32 level = 0; level < ktx->numLevels; ++level) {
+    ktx_size_t offset{ 0 };
+    result = ktxTexture_GetImageOffset(ktxTexture(ktx), level, 0, 0, &offset);
+    if (result != KTX_SUCCESS) {
+      LOG_WARN("Couldn't read KTX2 level {}: {}",
+               level,
+               ktxErrorString(result));
+      ktxTexture2_Destroy(ktx);
+      return false;
+    }
+    const u8* data = ktxTexture_GetData(ktxTexture(ktx)) + offset;
+    out->Levels[level].assign(
+      data, data + ktxTexture_GetImageSize(ktxTexture(ktx), level));
+  }
+  ktxTexture2_Destroy(ktx);
+  return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "common/types.h"
+#include <SDL3/SDL_gpu.h>
+#include <span>
+#include <vector>
+
+// What a material texture holds, picks the block format it's transcoded to
+enum class TextureRole : u8
+{
+  Color, // base color, BC7 keeps its alpha
+  Normal, // tangent space XY in BC5, the shader rebuilds Z
+  Data, // metallic-roughness, occlusion and emissive, BC1
+};
+
+// Mip chain ready for upload, each level tightly packed
+struct TranscodedTexture
+{
+  SDL_GPUTextureFormat Format{ SDL_GPU_TEXTUREFORMAT_INVALID };
+  u32 Width{ 0 };
+  u32 Height{ 0 };
+  std::vector<std::vector<u8>> Levels{}; // largest first
+};
+
+// KTX2 material textures (KHR_texture_basisu). Basis Universal payloads are
+// transcoded to the BC format of their role, or to RGBA8 when the device can't
+// sample it. Textures stored in a GPU format already are used as is
+class TextureTranscoder
+{
+public:
+  // Block formats the device can sample
+  struct Support
+  {
+    bool BC1{ false };
+    bool BC3{ false };
+    bool BC5{ false };
+    bool BC7{ false };
+
+    static Support Query(SDL_GPUDevice* device);
+  };
+
+  static bool IsKtx2(std::span<const u8> bytes);
+  // Block formats need a base level made of whole 4x4 blocks, some backends
+  // reject partial ones. Other sizes stay uncompressed
+  static bool FitsBlocks(u32 width, u32 height)
+  {
+    return width % 4 == 0 && height % 4 == 0;
+  }
+  // Format a texture of `role` is uploaded as
+  static SDL_GPUTextureFormat FormatFor(TextureRole role,
+                                        bool srgb,
+                                        const Support& support);
+  static bool Transcode(std::span<const u8> bytes,
+                        TextureRole role,
+                        bool srgb,
+                        const Support& support,
+                        TranscodedTexture* out);
+};
@@ -0,0 +1,64 @@
+#include "thread_pool.h"
+
+#include "common/logger.h"
+#include "common/types.h"
+
+#include <pch.h>
+
+ThreadPool::ThreadPool(u32 thread_count)
+{
+  if (thread_count == 0) {
+    thread_count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+  }
+  workers_.reserve(thread_count);
+  for (u32 i = 0; i < thread_count; ++i) {
+    workers_.emplace_back([this]() { WorkerLoop(); });
+  }
+  LOG_DEBUG("ThreadPool: started {} workers", thread_count);
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard lock{ mutex_ };
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+void
+ThreadPool::WorkerLoop()
+{
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock{ mutex_ };
+      cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+      if (tasks_.empty()) { // stopping and drained
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+bool
+ThreadPool::RunOne()
+{
+  std::function<void()> task;
+  {
+    std::lock_guard lock{ mutex_ };
+    if (tasks_.empty()) {
+      return false;
+    }
+    task = std::move(tasks_.front());
+    tasks_.pop_front();
+  }
+  task();
+  return true;
+}
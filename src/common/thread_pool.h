@@ -0,0 +1,66 @@
+#pragma once
+
+#include "common/types.h"
+#include "common/util.h"
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads running CPU jobs (image decoding, mesh
+// processing, whole scene loads). Tasks waiting on other tasks of the same
+// pool must do it through Wait(), blocking on the future can deadlock it.
+class ThreadPool
+{
+public:
+  DISABLE_COPY_AND_MOVE(ThreadPool);
+  // 0 picks one thread per core minus the calling one
+  explicit ThreadPool(u32 thread_count = 0);
+  ~ThreadPool(); // runs the tasks left in the queue first
+
+  template<typename F>
+  auto Submit(F&& task) -> std::future<std::invoke_result_t<F>>
+  {
+    using R = std::invoke_result_t<F>;
+    auto packaged =
+      MakeShared<std::packaged_task<R()>>(std::forward<F>(task));
+    auto ret = packaged->get_future();
+    {
+      std::lock_guard lock{ mutex_ };
+      tasks_.emplace_back([packaged]() { (*packaged)(); });
+    }
+    cv_.notify_one();
+    return ret;
+  }
+
+  // Runs queued tasks on the calling thread until `future` is ready
+  template<typename T>
+  T Wait(std::future<T>& future)
+  {
+    using namespace std::chrono_literals;
+    while (future.wait_for(0s) != std::future_status::ready) {
+      if (!RunOne()) {
+        future.wait_for(1ms);
+      }
+    }
+    return future.get();
+  }
+
+  u32 Size() const { return static_cast<u32>(workers_.size()); }
+
+private:
+  void WorkerLoop();
+  bool RunOne(); // false when the queue is empty
+
+private:
+  std::vector<std::thread> workers_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_{ false };
+};
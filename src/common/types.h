@@ -136,7 +136,7 @@ public:
   TransferBufferWrapper(const TransferBufferWrapper&) = delete;
   TransferBufferWrapper& operator=(const TransferBufferWrapper&) = delete;
 
-  // TODO: handle download someday
+  // Upload only, downloads go through ReadbackPool
   explicit TransferBufferWrapper(SDL_GPUDevice* device, u32 size)
     : device_{ device }
   {
@@ -0,0 +1,289 @@
+#include "upload_batch.h"
+
+#include "common/loaded_image.h"
+#include "common/logger.h"
+#include "common/types.h"
+#include "common/util.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <pch.h>
+
+UploadFence::UploadFence(SDL_GPUDevice* device,
+                         SharedPtr<SDL_GPUFence> fence,
+                         bool ok)
+  : device_{ device }
+  , fence_{ std::move(fence) }
+  , ok_{ ok }
+{
+}
+
+bool
+UploadFence::Ready() const
+{
+  return !fence_ || SDL_QueryGPUFence(device_, fence_.get());
+}
+
+void
+UploadFence::Wait() const
+{
+  if (fence_) {
+    SDL_GPUFence* fence = fence_.get();
+    SDL_WaitForGPUFences(device_, true, &fence, 1);
+  }
+}
+
+UploadBatch::UploadBatch(SDL_GPUDevice* device, StagingRing* staging)
+  : device_{ device }
+  , staging_{ staging }
+{
+}
+
+UploadBatch::~UploadBatch()
+{
+  if (cmdbuf_) {
+    LOG_DEBUG("UploadBatch destroyed with pending uploads, submitting");
+    Flush();
+  }
+}
+
+bool
+UploadBatch::BeginCopyPass()
+{
+  if (!cmdbuf_) {
+    cmdbuf_ = SDL_AcquireGPUCommandBuffer(device_);
+    if (!cmdbuf_) {
+      LOG_ERROR("Couldn't acquire upload command buffer: {}", GETERR);
+      failed_ = true;
+      return false;
+    }
+  }
+  if (!copy_pass_) {
+    copy_pass_ = SDL_BeginGPUCopyPass(cmdbuf_);
+  }
+  return true;
+}
+
+bool
+UploadBatch::Flush()
+{
+  if (!cmdbuf_) {
+    return true;
+  }
+  if (copy_pass_) {
+    SDL_EndGPUCopyPass(copy_pass_);
+    copy_pass_ = nullptr;
+  }
+
+  auto fence = staging_->Submit(cmdbuf_, allocs_);
+  cmdbuf_ = nullptr;
+  allocs_.clear();
+  pending_bytes_ = 0;
+  ++submissions_;
+
+  if (!fence) {
+    failed_ = true;
+    return false;
+  }
+  fence_ = fence;
+  return true;
+}
+
+StagingRing::Allocation
+UploadBatch::Stage(const void* data, u32 size)
+{
+  // Don't let a single batch hold the whole ring, earlier flushes can be
+  // recycled while we keep recording
+  if (!allocs_.empty() && pending_bytes_ + size > staging_->Capacity()) {
+    LOG_DEBUG("UploadBatch: staging full, flushing {} bytes", pending_bytes_);
+    Flush();
+  }
+
+  auto staged = staging_->Allocate(size);
+  if (!staged.Valid()) {
+    LOG_ERROR("Couldn't allocate staging memory");
+    return {};
+  }
+  if (!staging_->Write(staged, data, size)) {
+    staging_->Discard(staged);
+    return {};
+  }
+  if (!BeginCopyPass()) {
+    staging_->Discard(staged);
+    return {};
+  }
+
+  allocs_.push_back(staged);
+  pending_bytes_ += size;
+  bytes_uploaded_ += size;
+  return staged;
+}
+
+bool
+UploadBatch::UploadToBuffer(SDL_GPUBuffer* buf,
+                            const void* data,
+                            u32 size,
+                            u32 dst_offset,
+                            bool cycle)
+{
+  if (buf == nullptr) {
+    LOG_ERROR("Couldn't upload to buffer: invalid buffer");
+    return false;
+  }
+
+  auto staged = Stage(data, size);
+  if (!staged.Valid()) {
+    return false;
+  }
+
+  SDL_GPUTransferBufferLocation trLoc{};
+  {
+    trLoc.transfer_buffer = staged.Buffer;
+    trLoc.offset = staged.Offset;
+  }
+  SDL_GPUBufferRegion reg{};
+  {
+    reg.buffer = buf;
+    reg.offset = dst_offset;
+    reg.size = size;
+  }
+  SDL_UploadToGPUBuffer(copy_pass_, &trLoc, &reg, cycle);
+  return true;
+}
+
+bool
+UploadBatch::UploadToTexture(const SDL_GPUTextureRegion& region,
+                             const void* data,
+                             u32 size)
+{
+  if (region.texture == nullptr) {
+    LOG_ERROR("Couldn't upload to texture: invalid texture");
+    return false;
+  }
+
+  auto staged = Stage(data, size);
+  if (!staged.Valid()) {
+    return false;
+  }
+  RecordTextureUpload(region, staged);
+  return true;
+}
+
+void
+UploadBatch::RecordTextureUpload(const SDL_GPUTextureRegion& region,
+                                 const StagingRing::Allocation& staged)
+{
+  SDL_GPUTextureTransferInfo tex_transfer_info{};
+  {
+    tex_transfer_info.transfer_buffer = staged.Buffer;
+    tex_transfer_info.offset = staged.Offset;
+  }
+  SDL_UploadToGPUTexture(copy_pass_, &tex_transfer_info, &region, false);
+}
+
+StagingRing::Allocation
+UploadBatch::Reserve(u32 size, u8** mapped)
+{
+  *mapped = nullptr;
+  if (!allocs_.empty() && pending_bytes_ + size > staging_->Capacity()) {
+    LOG_DEBUG("UploadBatch: staging full, flushing {} bytes", pending_bytes_);
+    Flush();
+  }
+
+  auto staged = staging_->Allocate(size);
+  if (!staged.Valid()) {
+    LOG_ERROR("Couldn't allocate staging memory");
+    return {};
+  }
+  *mapped = staging_->Map(staged);
+  if (*mapped == nullptr) {
+    staging_->Discard(staged);
+    return {};
+  }
+  return staged;
+}
+
+bool
+UploadBatch::UploadToTexture(const SDL_GPUTextureRegion& region,
+                             const StagingRing::Allocation& staged)
+{
+  staging_->Unmap(staged);
+  if (region.texture == nullptr) {
+    LOG_ERROR("Couldn't upload to texture: invalid texture");
+    staging_->Discard(staged);
+    return false;
+  }
+  if (!BeginCopyPass()) {
+    staging_->Discard(staged);
+    return false;
+  }
+
+  // Only tied to a submission now, an earlier flush must not retire it
+  allocs_.push_back(staged);
+  pending_bytes_ += staged.Size;
+  bytes_uploaded_ += staged.Size;
+  RecordTextureUpload(region, staged);
+  return true;
+}
+
+void
+UploadBatch::Discard(const StagingRing::Allocation& staged)
+{
+  if (!staged.Valid()) {
+    return;
+  }
+  staging_->Unmap(staged);
+  staging_->Discard(staged);
+}
+
+StagingRing::Allocation
+UploadBatch::StageImage(LoadedImage& img,
+                        const std::filesystem::path& path,
+                        ImageType img_type,
+                        ImagePixelFormat pixel_fmt)
+{
+  StagingRing::Allocation staged{};
+  auto dst = [&](const LoadedImage& info) -> void* {
+    u8* mapped{ nullptr };
+    staged = Reserve(static_cast<u32>(info.DataSize()), &mapped);
+    return mapped;
+  };
+  if (!ImageLoader::LoadInto(img, path, dst, img_type, pixel_fmt)) {
+    Discard(staged);
+    return {};
+  }
+  return staged;
+}
+
+bool
+UploadBatch::UploadTo2DTexture(SDL_GPUTexture* tex, const LoadedImage& img)
+{
+  SDL_GPUTextureRegion tex_reg{};
+  {
+    tex_reg.texture = tex;
+    tex_reg.w = (Uint32)img.w;
+    tex_reg.h = (Uint32)img.h;
+    tex_reg.d = 1;
+  }
+  return UploadToTexture(tex_reg, img.data, static_cast<u32>(img.DataSize()));
+}
+
+SDL_GPUCommandBuffer*
+UploadBatch::CommandBuffer()
+{
+  if (!BeginCopyPass()) {
+    return nullptr;
+  }
+  SDL_EndGPUCopyPass(copy_pass_);
+  copy_pass_ = nullptr;
+  return cmdbuf_;
+}
+
+UploadFence
+UploadBatch::Submit()
+{
+  Flush();
+  UploadFence ret{ device_, fence_, !failed_ };
+  fence_ = nullptr;
+  failed_ = false;
+  return ret;
+}
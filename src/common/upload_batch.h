@@ -0,0 +1,93 @@
+#pragma once
+
+#include "common/staging_ring.h"
+#include "common/types.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <filesystem>
+#include <vector>
+
+struct LoadedImage;
+enum class ImageType : u8;
+enum class ImagePixelFormat : u8;
+
+// Completion handle of an UploadBatch submission
+class UploadFence
+{
+public:
+  UploadFence() = default;
+  UploadFence(SDL_GPUDevice* device, SharedPtr<SDL_GPUFence> fence, bool ok);
+
+  // False if any submission of the batch failed
+  bool Ok() const { return ok_; }
+  bool Ready() const;
+  void Wait() const;
+
+private:
+  SDL_GPUDevice* device_{ nullptr };
+  SharedPtr<SDL_GPUFence> fence_{ nullptr };
+  bool ok_{ true };
+};
+
+// Records any number of buffer and texture uploads into a single copy pass,
+// and submits them all at once. Staging memory comes from the StagingRing;
+// the batch flushes early when its pending uploads would overflow the ring.
+class UploadBatch
+{
+public:
+  DISABLE_COPY_AND_MOVE(UploadBatch);
+  explicit UploadBatch(SDL_GPUDevice* device, StagingRing* staging);
+  ~UploadBatch(); // submits anything left pending
+
+  bool UploadToBuffer(SDL_GPUBuffer* buf,
+                      const void* data,
+                      u32 size,
+                      u32 dst_offset = 0,
+                      bool cycle = false);
+  bool UploadToTexture(const SDL_GPUTextureRegion& region,
+                       const void* data,
+                       u32 size);
+  bool UploadTo2DTexture(SDL_GPUTexture* tex, const LoadedImage& img);
+
+  // Staging memory the caller fills itself through *mapped. It must be handed
+  // back through UploadToTexture(region, staged) or Discard()
+  StagingRing::Allocation Reserve(u32 size, u8** mapped);
+  bool UploadToTexture(const SDL_GPUTextureRegion& region,
+                       const StagingRing::Allocation& staged);
+  void Discard(const StagingRing::Allocation& staged);
+
+  // Decodes an image file straight into reserved staging memory, `img` only
+  // receives its description so the texture can be created afterwards
+  StagingRing::Allocation StageImage(LoadedImage& img,
+                                     const std::filesystem::path& path,
+                                     ImageType img_type,
+                                     ImagePixelFormat pixel_fmt);
+
+  // Ends the current copy pass so callers can record passes that consume the
+  // uploads before Submit()
+  SDL_GPUCommandBuffer* CommandBuffer();
+
+  UploadFence Submit();
+
+  u32 Submissions() const { return submissions_; }
+  u64 BytesUploaded() const { return bytes_uploaded_; }
+
+private:
+  StagingRing::Allocation Stage(const void* data, u32 size);
+  void RecordTextureUpload(const SDL_GPUTextureRegion& region,
+                           const StagingRing::Allocation& staged);
+  bool BeginCopyPass();
+  bool Flush();
+
+private:
+  SDL_GPUDevice* device_;
+  StagingRing* staging_;
+  SDL_GPUCommandBuffer* cmdbuf_{ nullptr };
+  SDL_GPUCopyPass* copy_pass_{ nullptr };
+  std::vector<StagingRing::Allocation> allocs_{};
+  SharedPtr<SDL_GPUFence> fence_{ nullptr };
+  u64 pending_bytes_{ 0 };
+  u64 bytes_uploaded_{ 0 };
+  u32 submissions_{ 0 };
+  bool failed_{ false };
+};
@@ -0,0 +1,343 @@
+#include "upload_scheduler.h"
+
+#include "common/logger.h"
+#include "common/staging_ring.h"
+#include "common/types.h"
+
+#include <SDL3/SDL_gpu.h>
+#include <SDL3/SDL_timer.h>
+#include <pch.h>
+
+UploadTicket::UploadTicket(SharedPtr<State> state)
+  : state_{ std::move(state) }
+{
+}
+
+bool
+UploadTicket::Ready() const
+{
+  if (!state_ || !state_->Sealed || state_->Jobs > 0) {
+    return false;
+  }
+  std::lock_guard lock{ state_->Mutex };
+  return state_->Fence.Ready();
+}
+
+bool
+UploadTicket::Failed() const
+{
+  return !state_ || state_->Failed;
+}
+
+void
+UploadTicket::Cancel() const
+{
+  if (state_) {
+    state_->Cancelled = true;
+  }
+}
+
+u64
+UploadTicket::PendingBytes() const
+{
+  return state_ ? state_->Bytes.load() : 0;
+}
+
+UploadScheduler::UploadScheduler(SDL_GPUDevice* device, StagingRing* staging)
+  : device_{ device }
+  , staging_{ staging }
+{
+}
+
+UploadTicket
+UploadScheduler::CreateTicket()
+{
+  return UploadTicket{ MakeShared<UploadTicket::State>() };
+}
+
+void
+UploadScheduler::Seal(const UploadTicket& ticket)
+{
+  if (ticket.state_) {
+    ticket.state_->Sealed = true;
+  }
+}
+
+void
+UploadScheduler::SetBudget(u64 bytes, f32 milliseconds)
+{
+  std::lock_guard lock{ mutex_ };
+  budget_bytes_ = bytes;
+  budget_ms_ = milliseconds;
+}
+
+bool
+UploadScheduler::Enqueue(u32 priority, Job&& job)
+{
+  if (!job.Ticket || job.Ticket->Cancelled) {
+    LOG_ERROR("UploadScheduler: invalid or cancelled ticket");
+    return false;
+  }
+  if (job.Bytes().empty()) {
+    return true;
+  }
+  const u64 size = job.Bytes().size();
+  job.Ticket->Jobs++;
+  job.Ticket->Bytes += size;
+
+  std::lock_guard lock{ mutex_ };
+  queues_[priority].push_back(std::move(job));
+  pending_bytes_ += size;
+  ++pending_jobs_;
+  return true;
+}
+
+bool
+UploadScheduler::EnqueueBuffer(const UploadTicket& ticket,
+                               u32 priority,
+                               SDL_GPUBuffer* buffer,
+                               u32 dst_offset,
+                               const void* data,
+                               u32 size)
+{
+  if (buffer == nullptr) {
+    LOG_ERROR("UploadScheduler: invalid buffer");
+    return false;
+  }
+  Job job{};
+  {
+    job.Ticket = ticket.state_;
+    job.Buffer = buffer;
+    job.DstOffset = dst_offset;
+    job.Data.assign(static_cast<const u8*>(data),
+                    static_cast<const u8*>(data) + size);
+  }
+  return Enqueue(priority, std::move(job));
+}
+
+bool
+UploadScheduler::EnqueueBuffer(const UploadTicket& ticket,
+                               u32 priority,
+                               SDL_GPUBuffer* buffer,
+                               u32 dst_offset,
+                               SharedPtr<const void> owner,
+                               std::span<const u8> data)
+{
+  if (buffer == nullptr || owner == nullptr) {
+    LOG_ERROR("UploadScheduler: invalid buffer or data owner");
+    return false;
+  }
+  Job job{};
+  {
+    job.Ticket = ticket.state_;
+    job.Buffer = buffer;
+    job.DstOffset = dst_offset;
+    job.Owner = std::move(owner);
+    job.Source = data;
+  }
+  return Enqueue(priority, std::move(job));
+}
+
+bool
+UploadScheduler::EnqueueTexture(const UploadTicket& ticket,
+                                u32 priority,
+                                const SDL_GPUTextureRegion& region,
+                                const void* data,
+                                u32 size)
+{
+  if (region.texture == nullptr) {
+    LOG_ERROR("UploadScheduler: invalid texture");
+    return false;
+  }
+  return EnqueueTexture(
+    ticket,
+    priority,
+    region,
+    std::vector<u8>(static_cast<const u8*>(data),
+                    static_cast<const u8*>(data) + size));
+}
+
+bool
+UploadScheduler::EnqueueTexture(const UploadTicket& ticket,
+                                u32 priority,
+                                const SDL_GPUTextureRegion& region,
+                                std::vector<u8>&& data,
+                                bool generate_mips)
+{
+  if (region.texture == nullptr) {
+    LOG_ERROR("UploadScheduler: invalid texture");
+    return false;
+  }
+  Job job{};
+  {
+    job.Ticket = ticket.state_;
+    job.Region = region;
+    job.Data = std::move(data);
+    job.GenerateMips = generate_mips;
+  }
+  return Enqueue(priority, std::move(job));
+}
+
+bool
+UploadScheduler::Record(UploadBatch& batch,
+                        Job& job,
+                        u64 budget_left,
+                        u32* recorded)
+{
+  const auto bytes = job.Bytes();
+  const u32 remaining = static_cast<u32>(bytes.size()) - job.Consumed;
+  *recorded = 0;
+
+  if (job.Buffer == nullptr) { // textures go in one piece
+    if (!batch.UploadToTexture(job.Region, bytes.data(), remaining)) {
+      return false;
+    }
+    if (job.GenerateMips) {
+      SDL_GPUCommandBuffer* cmdbuf = batch.CommandBuffer(); // ends copy pass
+      if (!cmdbuf) {
+        return false;
+      }
+      SDL_GenerateMipmapsForGPUTexture(cmdbuf, job.Region.texture);
+    }
+    *recorded = remaining;
+    job.Consumed += remaining;
+    return true;
+  }
+
+  const u32 chunk = ChunkSize(remaining, budget_left);
+  if (!batch.UploadToBuffer(job.Buffer,
+                            bytes.data() + job.Consumed,
+                            chunk,
+                            job.DstOffset + job.Consumed)) {
+    return false;
+  }
+  *recorded = chunk;
+  job.Consumed += chunk;
+  return true;
+}
+
+u32
+UploadScheduler::ChunkSize(u32 remaining, u64 budget_left)
+{
+  if (remaining <= budget_left) {
+    return remaining;
+  }
+  return std::min(remaining,
+                  std::max(static_cast<u32>(budget_left) & ~3u, 4u));
+}
+
+UploadFence
+UploadScheduler::Drain(u64 byte_budget, f32 ms_budget)
+{
+  const u64 start = SDL_GetTicksNS();
+  UploadBatch batch{ device_, staging_ };
+  std::vector<SharedPtr<UploadTicket::State>> touched;
+  std::vector<SharedPtr<UploadTicket::State>> completed; // one per job
+  u64 total = 0;
+
+  while (true) {
+    const f32 elapsed_ms = (SDL_GetTicksNS() - start) / 1e6f;
+    if (total > 0 && (total >= byte_budget || elapsed_ms >= ms_budget)) {
+      break;
+    }
+
+    // Recording can wait on a staging fence, threads queuing uploads mustn't
+    // stall behind it: the job is taken out and recorded unlocked, then put
+    // back in front when only part of it fit
+    u32 priority{ 0 };
+    Job job{};
+    {
+      std::lock_guard lock{ mutex_ };
+      if (queues_.empty()) {
+        break;
+      }
+      auto queue = queues_.begin();
+      priority = queue->first;
+      job = std::move(queue->second.front());
+      queue->second.pop_front();
+      if (queue->second.empty()) {
+        queues_.erase(queue);
+      }
+    }
+    auto ticket = job.Ticket;
+    bool done = true;
+    u32 recorded = 0;
+
+    if (!ticket->Cancelled) {
+      // The first job of a tick always makes progress
+      const u64 budget_left = total < byte_budget ? byte_budget - total : 1;
+      if (Record(batch, job, budget_left, &recorded)) {
+        done = job.Consumed == job.Bytes().size();
+      } else {
+        LOG_ERROR("UploadScheduler: couldn't record upload");
+        ticket->Failed = true;
+      }
+      total += recorded;
+      ticket->Bytes -= recorded;
+      if (std::find(touched.begin(), touched.end(), ticket) == touched.end()) {
+        touched.push_back(ticket);
+      }
+    }
+
+    std::lock_guard lock{ mutex_ };
+    pending_bytes_ -= recorded;
+    if (done) {
+      const u64 left = job.Bytes().size() - job.Consumed;
+      pending_bytes_ -= left;
+      ticket->Bytes -= left;
+      --pending_jobs_;
+      completed.push_back(ticket);
+    } else {
+      queues_[priority].push_front(std::move(job));
+    }
+  }
+
+  auto fence = batch.Submit();
+  for (auto& ticket : touched) {
+    std::lock_guard ticket_lock{ ticket->Mutex };
+    ticket->Fence = fence;
+    if (!fence.Ok()) {
+      ticket->Failed = true;
+    }
+  }
+  // Only once the fence is set, so Ready() can't see a stale one
+  for (auto& ticket : completed) {
+    ticket->Jobs--;
+  }
+  last_tick_bytes_ = total;
+  return fence;
+}
+
+void
+UploadScheduler::Tick()
+{
+  if (PendingJobs() == 0) {
+    last_tick_bytes_ = 0;
+    return;
+  }
+  Drain(budget_bytes_, budget_ms_);
+}
+
+void
+UploadScheduler::Flush()
+{
+  UploadFence fence{};
+  while (PendingJobs() > 0) {
+    fence = Drain(UINT64_MAX, std::numeric_limits<f32>::max());
+  }
+  fence.Wait();
+}
+
+u64
+UploadScheduler::PendingBytes() const
+{
+  std::lock_guard lock{ mutex_ };
+  return pending_bytes_;
+}
+
+size_t
+UploadScheduler::PendingJobs() const
+{
+  std::lock_guard lock{ mutex_ };
+  return pending_jobs_;
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "common/types.h"
+#include "common/upload_batch.h"
+#include "common/util.h"
+#include <SDL3/SDL_gpu.h>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <span>
+#include <vector>
+
+class StagingRing;
+class UploadScheduler;
+
+// Tracks a group of scheduled uploads, typically every upload of one asset
+class UploadTicket
+{
+public:
+  UploadTicket() = default;
+
+  bool Valid() const { return state_ != nullptr; }
+  // Every job was recorded and the last submission touching it completed
+  bool Ready() const;
+  bool Failed() const;
+  // Queued jobs are dropped, use before releasing the destination resources
+  void Cancel() const;
+  u64 PendingBytes() const;
+
+private:
+  friend class UploadScheduler;
+  struct State
+  {
+    std::atomic<u32> Jobs{ 0 }; // queued, not recorded yet
+    std::atomic<u64> Bytes{ 0 };
+    std::atomic<bool> Sealed{ false };
+    std::atomic<bool> Failed{ false };
+    std::atomic<bool> Cancelled{ false };
+    UploadFence Fence{}; // last submission that recorded one of its jobs
+    mutable std::mutex Mutex;
+  };
+  explicit UploadTicket(SharedPtr<State> state);
+
+private:
+  SharedPtr<State> state_{ nullptr };
+};
+
+// Queues uploads and drains them a bit every frame, under a byte and time
+// budget, so a large asset doesn't have to be uploaded in a single spike.
+// Jobs run by ascending priority, then in submission order. Buffer jobs
+// bigger than the remaining budget are split across frames.
+// Jobs can be queued from any thread, Tick() runs on the main loop.
+class UploadScheduler
+{
+public:
+  // Lower runs first
+  static constexpr u32 PriorityGeometry = 0;
+  static constexpr u32 PriorityTexture = 16; // + mip level, small mips last
+
+  static constexpr u64 DefaultFrameBytes = 8 * 1024 * 1024;
+  static constexpr f32 DefaultFrameMs = 2.f;
+
+public:
+  DISABLE_COPY_AND_MOVE(UploadScheduler);
+  explicit UploadScheduler(SDL_GPUDevice* device, StagingRing* staging);
+
+  UploadTicket CreateTicket();
+  // No more jobs will be added, the ticket can become Ready()
+  void Seal(const UploadTicket& ticket);
+
+  bool EnqueueBuffer(const UploadTicket& ticket,
+                     u32 priority,
+                     SDL_GPUBuffer* buffer,
+                     u32 dst_offset,
+                     const void* data,
+                     u32 size);
+  // Reads `data` in place when the job is recorded instead of copying it,
+  // `owner` keeps it alive until then (mapped files, baked geometry)
+  bool EnqueueBuffer(const UploadTicket& ticket,
+                     u32 priority,
+                     SDL_GPUBuffer* buffer,
+                     u32 dst_offset,
+                     SharedPtr<const void> owner,
+                     std::span<const u8> data);
+  bool EnqueueTexture(const UploadTicket& ticket,
+                      u32 priority,
+                      const SDL_GPUTextureRegion& region,
+                      const void* data,
+                      u32 size);
+  // Takes the pixels over, e.g. decoded straight into the vector.
+  // `generate_mips` blits the rest of the chain from the uploaded level
+  bool EnqueueTexture(const UploadTicket& ticket,
+                      u32 priority,
+                      const SDL_GPUTextureRegion& region,
+                      std::vector<u8>&& data,
+                      bool generate_mips = false);
+
+  // Records jobs until the budget is spent (at least one per call)
+  void Tick();
+  // Records every queued job and waits for them, for loading screens
+  void Flush();
+
+  void SetBudget(u64 bytes, f32 milliseconds);
+  u64 BudgetBytes() const { return budget_bytes_; }
+  f32 BudgetMs() const { return budget_ms_; }
+  u64 PendingBytes() const;
+  size_t PendingJobs() const;
+  u64 LastTickBytes() const { return last_tick_bytes_; }
+
+  // Bytes of a buffer job recorded next: all of them when they fit, else the
+  // budget rounded down to 4 (copy alignment), never past the end of the job
+  static u32 ChunkSize(u32 remaining, u64 budget_left);
+
+private:
+  struct Job
+  {
+    SharedPtr<UploadTicket::State> Ticket;
+    SDL_GPUBuffer* Buffer{ nullptr }; // either buffer
+    u32 DstOffset{ 0 };
+    SDL_GPUTextureRegion Region{}; // or texture
+    std::vector<u8> Data;
+    SharedPtr<const void> Owner{}; // or bytes read in place
+    std::span<const u8> Source{};
+    u32 Consumed{ 0 }; // bytes already recorded, buffer jobs only
+    bool GenerateMips{ false };
+
+    std::span<const u8> Bytes() const { return Owner ? Source : Data; }
+  };
+
+  bool Enqueue(u32 priority, Job&& job);
+  bool Record(UploadBatch& batch, Job& job, u64 budget_left, u32* recorded);
+  // One drain at a time (main loop), it records without holding mutex_
+  UploadFence Drain(u64 byte_budget, f32 ms_budget);
+
+private:
+  SDL_GPUDevice* device_;
+  StagingRing* staging_;
+  std::map<u32, std::deque<Job>> queues_;
+  u64 pending_bytes_{ 0 };
+  size_t pending_jobs_{ 0 };
+  u64 budget_bytes_{ DefaultFrameBytes };
+  f32 budget_ms_{ DefaultFrameMs };
+  u64 last_tick_bytes_{ 0 };
+  mutable std::mutex mutex_;
+};
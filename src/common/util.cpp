@@ -1,4 +1,5 @@
 #include "common/logger.h"
+#include <thread>
 #include <pch.h>
 
 SDL_GPUShader*
@@ -132,3 +133,37 @@ vertex_attribute_size(SDL_GPUVertexElementFormat f)
       return 0;
   }
 }
+
+u64
+Fnv1a(const void* data, u64 size, u64 hash)
+{
+  constexpr u64 prime = 0x100000001b3ull;
+  const auto* bytes = static_cast<const u8*>(data);
+  for (u64 i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * prime;
+  }
+  return hash;
+}
+
+bool
+WriteFileAtomically(
+  const std::filesystem::path& path,
+  const std::function<bool(const std::filesystem::path& tmp)>& write)
+{
+  std::error_code ec;
+  std::filesystem::create_directories(path.parent_path(), ec);
+  auto tmp = path;
+  const auto thread = std::hash<std::thread::id>{}(std::this_thread::get_id());
+  tmp += "." + std::to_string(thread) + ".tmp";
+  if (!write(tmp)) {
+    std::filesystem::remove(tmp, ec);
+    return false;
+  }
+  std::filesystem::rename(tmp, path, ec);
+  if (ec) {
+    LOG_WARN("Couldn't write {}: {}", path.string(), ec.message());
+    std::filesystem::remove(tmp, ec);
+    return false;
+  }
+  return true;
+}
@@ -1,44 +1,28 @@
 #pragma once
 
 #include "common/types.h"
+#include "common/vertex_formats.h"
 
 #include <SDL3/SDL_gpu.h>
+#include <filesystem>
+#include <functional>
 #include <type_traits>
 
-static constexpr size_t PosNormalTangentColorUvAttributeCount = 5;
-static constexpr SDL_GPUVertexAttribute
-  PosNormalTangentColorUvAttributes[PosNormalTangentColorUvAttributeCount] = {
-    { .location = 0,
-      .buffer_slot = 0,
-      .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3,
-      .offset = 0 },
-    { .location = 1,
-      .buffer_slot = 0,
-      .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3,
-      .offset = FLOAT3 },
-    { .location = 2,
-      .buffer_slot = 0,
-      .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
-      .offset = 2 * FLOAT3 },
-    { .location = 3,
-      .buffer_slot = 0,
-      .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2,
-      .offset = 2 * FLOAT3 + FLOAT4 },
-    { .location = 4,
-      .buffer_slot = 0,
-      .format = SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
-      .offset = 2 * FLOAT3 + FLOAT4 + FLOAT2 },
-  };
-
-static constexpr std::array<SDL_GPUVertexElementFormat, 5>
-  PosNormalTangentColorUvAttrs = {
-    SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3, SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3,
-    SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4, SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2,
-    SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4,
-  };
+static constexpr auto PosNormalTangentColorUvLayout =
+  MakeVertexLayout<PosNormalTangentColorUvVertex>(
+    { VERTEX_ELEMENT(PosNormalTangentColorUvVertex, pos),
+      VERTEX_ELEMENT(PosNormalTangentColorUvVertex, normal),
+      VERTEX_ELEMENT(PosNormalTangentColorUvVertex, tangent),
+      VERTEX_ELEMENT(PosNormalTangentColorUvVertex, uv),
+      VERTEX_ELEMENT(PosNormalTangentColorUvVertex, color) });
+static_assert(PosNormalTangentColorUvLayout.Tight);
 
-static_assert((2 * FLOAT3 + FLOAT4 + FLOAT2 + FLOAT4) ==
-              sizeof(PosNormalTangentColorUvVertex));
+static constexpr size_t PosNormalTangentColorUvAttributeCount =
+  PosNormalTangentColorUvLayout.Attributes.size();
+static constexpr auto PosNormalTangentColorUvAttributes =
+  PosNormalTangentColorUvLayout.Attributes;
+static constexpr auto PosNormalTangentColorUvAttrs =
+  PosNormalTangentColorUvLayout.Formats;
 
 #define RELEASE_IF(ptr, release_func)                                          \
   if (ptr != nullptr) {                                                        \
@@ -89,3 +73,18 @@ enable_blending(SDL_GPUColorTargetDescription& d);
 
 u32
 vertex_attribute_size(SDL_GPUVertexElementFormat f);
+
+// 64 bit FNV-1a, pass the previous result as `hash` to chain several ranges.
+// Cache keys and content hashes, not meant to resist collisions on purpose
+static constexpr u64 Fnv1aOffset = 0xcbf29ce484222325ull;
+u64
+Fnv1a(const void* data, u64 size, u64 hash = Fnv1aOffset);
+
+// Writes `path` through `write`, which fills the temporary file it's given.
+// The file is written aside then renamed, readers never see a partial one,
+// and each thread writes its own temporary so concurrent writers of the same
+// file (workers baking the same asset) don't clobber each other
+bool
+WriteFileAtomically(
+  const std::filesystem::path& path,
+  const std::function<bool(const std::filesystem::path& tmp)>& write);
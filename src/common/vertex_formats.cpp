@@ -0,0 +1,162 @@
+#include "vertex_formats.h"
+
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include <pch.h>
+
+namespace {
+i16
+to_snorm16(f32 v)
+{
+  return static_cast<i16>(std::round(std::clamp(v, -1.f, 1.f) * 32767.f));
+}
+
+f32
+from_snorm16(i16 v)
+{
+  return std::max(static_cast<f32>(v) / 32767.f, -1.f);
+}
+
+u8
+to_unorm8(f32 v)
+{
+  return static_cast<u8>(std::round(std::clamp(v, 0.f, 1.f) * 255.f));
+}
+
+template<typename V>
+void
+pack_vertices(std::span<const PosNormalTangentColorUvVertex> vertices,
+              const VertexQuantization& quantization,
+              std::vector<u8>* out)
+{
+  const size_t begin = out->size();
+  out->resize(begin + vertices.size() * sizeof(V));
+  const glm::vec3 offset{ quantization.Offset };
+  const glm::vec3 scale{ quantization.Scale };
+  for (size_t i = 0; i < vertices.size(); ++i) {
+    const auto& src = vertices[i];
+    V dst{};
+    {
+      const glm::vec3 p = (src.pos - offset) / scale;
+      dst.pos = { to_snorm16(p.x),
+                  to_snorm16(p.y),
+                  to_snorm16(p.z),
+                  to_snorm16(src.tangent.w < 0.f ? -1.f : 1.f) };
+      dst.normal = VertexPacker::OctEncode(src.normal);
+      dst.tangent = VertexPacker::OctEncode(glm::vec3{ src.tangent });
+      if constexpr (std::is_same_v<decltype(dst.uv), Half2>) {
+        dst.uv = { VertexPacker::ToHalf(src.uv.x),
+                   VertexPacker::ToHalf(src.uv.y) };
+      } else {
+        dst.uv = src.uv;
+      }
+      dst.color = { to_unorm8(src.color.x),
+                    to_unorm8(src.color.y),
+                    to_unorm8(src.color.z),
+                    to_unorm8(src.color.w) };
+    }
+    std::memcpy(out->data() + begin + i * sizeof(V), &dst, sizeof(V));
+  }
+}
+}
+
+VertexQuantization
+VertexQuantization::FromBounds(glm::vec3 bounds_min, glm::vec3 bounds_max)
+{
+  glm::vec3 scale = (bounds_max - bounds_min) * .5f;
+  for (int i = 0; i < 3; ++i) {
+    if (!(scale[i] > 0.f)) {
+      scale[i] = 1.f; // flat axis, every vertex sits on the offset
+    }
+  }
+  VertexQuantization ret{};
+  {
+    ret.Offset = glm::vec4{ (bounds_min + bounds_max) * .5f, 0.f };
+    ret.Scale = glm::vec4{ scale, 1.f };
+  }
+  return ret;
+}
+
+VertexFormat
+VertexPacker::Choose(std::span<const PosNormalTangentColorUvVertex> vertices)
+{
+  for (const auto& v : vertices) {
+    if (std::abs(v.uv.x) > HalfUvRange || std::abs(v.uv.y) > HalfUvRange) {
+      return VertexFormat::PackedFloatUv;
+    }
+  }
+  return VertexFormat::Packed;
+}
+
+void
+VertexPacker::Pack(std::span<const PosNormalTangentColorUvVertex> vertices,
+                   VertexFormat format,
+                   const VertexQuantization& quantization,
+                   std::vector<u8>* out)
+{
+  if (format == VertexFormat::PackedFloatUv) {
+    pack_vertices<PackedVertexFloatUv>(vertices, quantization, out);
+  } else {
+    pack_vertices<PackedVertex>(vertices, quantization, out);
+  }
+}
+
+// Octahedral mapping, see "A Survey of Efficient Representations for
+// Independent Unit Vectors" (Cigolle et al. 2014)
+Snorm16x2
+VertexPacker::OctEncode(glm::vec3 n)
+{
+  const f32 l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  if (!(l1 > 0.f)) {
+    return { 0, 0 }; // missing attribute, decodes to +Z
+  }
+  f32 x = n.x / l1;
+  f32 y = n.y / l1;
+  if (n.z < 0.f) {
+    const f32 fx = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+    const f32 fy = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+    x = fx;
+    y = fy;
+  }
+  return { to_snorm16(x), to_snorm16(y) };
+}
+
+glm::vec3
+VertexPacker::OctDecode(Snorm16x2 e)
+{
+  glm::vec3 n{ from_snorm16(e.v[0]), from_snorm16(e.v[1]), 0.f };
+  n.z = 1.f - std::abs(n.x) - std::abs(n.y);
+  const f32 t = std::max(-n.z, 0.f);
+  n.x += n.x >= 0.f ? -t : t;
+  n.y += n.y >= 0.f ? -t : t;
+  return glm::normalize(n);
+}
+
+// Round to nearest even, overflows to infinity and flushes denormals to zero
+u16
+VertexPacker::ToHalf(f32 f)
+{
+  const u32 bits = std::bit_cast<u32>(f);
+  const u16 sign = static_cast<u16>((bits >> 16) & 0x8000);
+  const i32 exponent = static_cast<i32>((bits >> 23) & 0xFF) - 127 + 15;
+  const u32 mantissa = bits & 0x7FFFFF;
+
+  if (((bits >> 23) & 0xFF) == 0xFF) {
+    return sign | 0x7C00 | (mantissa ? 0x200 : 0); // inf/nan
+  }
+  if (exponent <= 0) {
+    return sign;
+  }
+  // 13 dropped bits, round to nearest even
+  u32 half = (static_cast<u32>(exponent) << 10) | (mantissa >> 13);
+  const u32 rest = mantissa & 0x1FFF;
+  if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+    ++half; // may carry into the exponent, which is still correct
+  }
+  if (half >= 0x7C00) {
+    return sign | 0x7C00;
+  }
+  return sign | static_cast<u16>(half);
+}
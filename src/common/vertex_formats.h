@@ -0,0 +1,200 @@
+#pragma once
+
+#include "common/types.h"
+#include <SDL3/SDL_gpu.h>
+#include <array>
+#include <cstddef>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// Packed vertex element types, decoded by the vertex shader
+struct Half2
+{
+  u16 v[2];
+};
+
+struct Snorm16x2
+{
+  i16 v[2];
+};
+
+struct Snorm16x4
+{
+  i16 v[4];
+};
+
+struct Unorm8x4
+{
+  u8 v[4];
+};
+
+// Vertex element format of a vertex struct member type
+template<typename T>
+constexpr SDL_GPUVertexElementFormat
+VertexElementFormat()
+{
+  if constexpr (std::is_same_v<T, glm::vec2>) {
+    return SDL_GPU_VERTEXELEMENTFORMAT_FLOAT2;
+  } else if constexpr (std::is_same_v<T, glm::vec3>) {
+    return SDL_GPU_VERTEXELEMENTFORMAT_FLOAT3;
+  } else if constexpr (std::is_same_v<T, glm::vec4>) {
+    return SDL_GPU_VERTEXELEMENTFORMAT_FLOAT4;
+  } else if constexpr (std::is_same_v<T, Half2>) {
+    return SDL_GPU_VERTEXELEMENTFORMAT_HALF2;
+  } else if constexpr (std::is_same_v<T, Snorm16x2>) {
+    return SDL_GPU_VERTEXELEMENTFORMAT_SHORT2_NORM;
+  } else if constexpr (std::is_same_v<T, Snorm16x4>) {
+    return SDL_GPU_VERTEXELEMENTFORMAT_SHORT4_NORM;
+  } else if constexpr (std::is_same_v<T, Unorm8x4>) {
+    return SDL_GPU_VERTEXELEMENTFORMAT_UBYTE4_NORM;
+  } else {
+    static_assert(sizeof(T) == 0, "No vertex element format for this type");
+  }
+}
+
+struct VertexElement
+{
+  SDL_GPUVertexElementFormat Format;
+  u32 Offset;
+  u32 Size;
+};
+
+// Describes a vertex struct member, shader locations follow the listing order
+#define VERTEX_ELEMENT(Vertex, member)                                         \
+  VertexElement                                                                \
+  {                                                                            \
+    VertexElementFormat<decltype(Vertex::member)>(),                           \
+      static_cast<u32>(offsetof(Vertex, member)),                              \
+      static_cast<u32>(sizeof(Vertex::member))                                 \
+  }
+
+// SDL vertex input of a struct, generated from its VERTEX_ELEMENTs
+template<size_t N>
+struct VertexLayout
+{
+  std::array<SDL_GPUVertexAttribute, N> Attributes{};
+  std::array<SDL_GPUVertexElementFormat, N> Formats{};
+  u32 Size{ 0 };
+  // Members are listed in declaration order without any padding between them,
+  // so PipelineBuilder::AddVertexAttributes(Formats) finds the same offsets
+  bool Tight{ true };
+};
+
+template<typename Vertex, size_t N>
+constexpr VertexLayout<N>
+MakeVertexLayout(const VertexElement (&elements)[N])
+{
+  VertexLayout<N> ret{};
+  for (size_t i = 0; i < N; ++i) {
+    ret.Attributes[i].location = static_cast<u32>(i);
+    ret.Attributes[i].buffer_slot = 0;
+    ret.Attributes[i].format = elements[i].Format;
+    ret.Attributes[i].offset = elements[i].Offset;
+    ret.Formats[i] = elements[i].Format;
+    ret.Tight = ret.Tight && elements[i].Offset == ret.Size;
+    ret.Size += elements[i].Size;
+  }
+  ret.Tight = ret.Tight && ret.Size == sizeof(Vertex);
+  return ret;
+}
+
+// 24 bytes. Positions are fixed point within the mesh bounds, see
+// VertexQuantization. Shader locations match PosNormalTangentColorUvVertex
+struct PackedVertex
+{
+  Snorm16x4 pos; // w holds the tangent sign
+  Snorm16x2 normal; // octahedral
+  Snorm16x2 tangent; // octahedral
+  Half2 uv;
+  Unorm8x4 color;
+};
+
+// 28 bytes, for UVs half floats can't hold precisely enough
+struct PackedVertexFloatUv
+{
+  Snorm16x4 pos;
+  Snorm16x2 normal;
+  Snorm16x2 tangent;
+  glm::vec2 uv;
+  Unorm8x4 color;
+};
+
+static constexpr auto PackedVertexLayout =
+  MakeVertexLayout<PackedVertex>({ VERTEX_ELEMENT(PackedVertex, pos),
+                                   VERTEX_ELEMENT(PackedVertex, normal),
+                                   VERTEX_ELEMENT(PackedVertex, tangent),
+                                   VERTEX_ELEMENT(PackedVertex, uv),
+                                   VERTEX_ELEMENT(PackedVertex, color) });
+static_assert(PackedVertexLayout.Tight && sizeof(PackedVertex) == 24);
+
+static constexpr auto PackedVertexFloatUvLayout = MakeVertexLayout<
+  PackedVertexFloatUv>({ VERTEX_ELEMENT(PackedVertexFloatUv, pos),
+                         VERTEX_ELEMENT(PackedVertexFloatUv, normal),
+                         VERTEX_ELEMENT(PackedVertexFloatUv, tangent),
+                         VERTEX_ELEMENT(PackedVertexFloatUv, uv),
+                         VERTEX_ELEMENT(PackedVertexFloatUv, color) });
+static_assert(PackedVertexFloatUvLayout.Tight &&
+              sizeof(PackedVertexFloatUv) == 28);
+
+// Formats meshes are uploaded with, smallest first
+enum class VertexFormat : u8
+{
+  Packed,
+  PackedFloatUv,
+  Count,
+};
+
+constexpr u32
+VertexFormatStride(VertexFormat format)
+{
+  switch (format) {
+    case VertexFormat::Packed:
+      return sizeof(PackedVertex);
+    case VertexFormat::PackedFloatUv:
+      return sizeof(PackedVertexFloatUv);
+    default:
+      return 0;
+  }
+}
+
+constexpr std::span<const SDL_GPUVertexElementFormat>
+VertexFormatElements(VertexFormat format)
+{
+  if (format == VertexFormat::PackedFloatUv) {
+    return PackedVertexFloatUvLayout.Formats;
+  }
+  return PackedVertexLayout.Formats;
+}
+
+// Maps packed positions back to object space: pos = Offset + snorm * Scale
+struct VertexQuantization
+{
+  glm::vec4 Offset{ 0.f };
+  glm::vec4 Scale{ 1.f };
+
+  static VertexQuantization FromBounds(glm::vec3 bounds_min,
+                                       glm::vec3 bounds_max);
+};
+
+class VertexPacker
+{
+public:
+  // Half floats keep UVs within 1/1024 in this range
+  static constexpr f32 HalfUvRange = 2.f;
+
+  static VertexFormat Choose(
+    std::span<const PosNormalTangentColorUvVertex> vertices);
+  // Appends the packed vertices to `out`
+  static void Pack(std::span<const PosNormalTangentColorUvVertex> vertices,
+                   VertexFormat format,
+                   const VertexQuantization& quantization,
+                   std::vector<u8>* out);
+
+  static Snorm16x2 OctEncode(glm::vec3 n);
+  static glm::vec3 OctDecode(Snorm16x2 e);
+  static u16 ToHalf(f32 f);
+};
+
+// 16 bit indices are enough for any mesh below this many vertices
+static constexpr u64 MaxVerticesForU16Indices = 65536;
@@ -97,6 +97,7 @@ main(int argc, char** argv)
           LOG_CRITICAL("App failed to draw");
           break;
         };
+        engine.NextFrame();
       }
     }
     delete app;
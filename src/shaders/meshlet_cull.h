@@ -0,0 +1,53 @@
+#ifndef MESHLET_CULL_H
+#define MESHLET_CULL_H
+
+#ifdef __cplusplus
+using vec4 = glm::vec4;
+using uint = std::uint32_t;
+#endif
+
+// clang-format off
+#define MESHLET_CULL_FRUSTUM  (0x01 << 0x00)
+#define MESHLET_CULL_CONE     (0x01 << 0x01)
+// clang-format on
+
+// Meshlets of jobs with more instances are kept without being tested, one
+// thread can't afford a loop over every instance
+#define MESHLET_CULL_MAX_INSTANCES 8
+
+// Meshlet of a GLTFScene, indices are absolute in its MeshPool page
+struct MeshletBinding
+{
+  vec4 sphere; // object space center, radius
+  vec4 cone;   // object space axis, cutoff (1 never culls)
+  uint first_index;
+  uint index_count;
+  int vertex_offset;
+  uint _pad;
+};
+
+// A RenderItem split into meshlets: each meshlet gets an indirect draw,
+// emptied when it's culled for every instance
+struct MeshletCullJob
+{
+  uint draw_index; // into the draw data
+  uint first_meshlet;
+  uint meshlet_count;
+  uint first_command; // into the indirect draws
+  uint instance_count;
+  uint _pad0;
+  uint _pad1;
+  uint _pad2;
+};
+
+struct MeshletCullSettings
+{
+  vec4 frustum[6]; // world space planes, inside when dot(xyz, p) + w >= 0
+  vec4 camera_world;
+  uint first_job;
+  uint job_count;
+  uint flags; // MESHLET_CULL_*
+  uint _pad;
+};
+
+#endif // !MESHLET_CULL_H
@@ -22,7 +22,7 @@ layout(set = 2, binding = 5) uniform sampler2D TexBRDF;
 layout(set = 2, binding = 6) uniform samplerCube TexIrradianceMap;
 layout(set = 2, binding = 7) uniform samplerCube TexSpecularMap;
 
-// Data global to whole scene (120 bytes data, 8 to pad)
+// Data global to whole scene (180 bytes data, 12 to pad)
 layout(std140, set = 3, binding = 0) uniform uSceneData {
     SceneData scene;
 };
@@ -3,9 +3,10 @@
 #extension GL_GOOGLE_include_directive : require
 #include "scene_data.glsl"
 
-layout(location = 0) in vec3 inPos;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec4 inTangent;
+// Packed vertex, see common/vertex_formats.h
+layout(location = 0) in vec4 inPos; // snorm in the mesh bounds, w: tangent sign
+layout(location = 1) in vec2 inNormal; // octahedral
+layout(location = 2) in vec2 inTangent; // octahedral
 layout(location = 3) in vec2 inUv;
 layout(location = 4) in vec4 inColor;
 
@@ -15,46 +16,65 @@ layout(location = 2) out vec4 outColor; // depends on vertex
 layout(location = 3) out vec2 outUv; // depends on vertex
 layout(location = 4) out mat3 outTBN;
 
-// Data global to whole scene (120 bytes data, 8 to pad)
+// Data global to whole scene (180 bytes data, 12 to pad)
 layout(std140, set = 1, binding = 0) uniform uSceneData {
     SceneData scene;
 };
 
-// Data specific to this draw call
-layout(std140, set = 1, binding = 1) uniform uDrawData {
+struct DrawData {
     mat4 mat_m;
+    vec4 pos_offset; // dequantizes inPos
+    vec4 pos_scale;
+    uvec4 instances; // x: first instance offset
 };
 
+// Data of every draw call of the frame
+layout(std430, set = 0, binding = 0) readonly buffer bDrawData {
+    DrawData draws[];
+};
+
+// Node space transform of each instance (EXT_mesh_gpu_instancing), the rows
+// of an affine matrix. The draw's instances are contiguous
+layout(std430, set = 0, binding = 1) readonly buffer bInstances {
+    mat3x4 instance_transforms[];
+};
+
+// Index of this draw call in bDrawData
+layout(std140, set = 1, binding = 1) uniform uDrawIndex {
+    uint draw_index;
+};
+
+vec3 oct_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 void main()
 {
+    DrawData draw = draws[draw_index];
+    mat3x4 instance = instance_transforms[draw.instances.x + gl_InstanceIndex];
+    mat4 mat_m = draw.mat_m * mat4(transpose(instance));
+
+    vec3 pos = draw.pos_offset.xyz + inPos.xyz * draw.pos_scale.xyz;
+    vec3 normal = oct_decode(inNormal);
+    vec4 tangent = vec4(oct_decode(inTangent), inPos.w < 0.0 ? -1.0 : 1.0);
+
     outUv = inUv;
     outColor = inColor;
-    outNormal = (mat_m * vec4(inNormal, 0.f)).xyz;
+    outNormal = (mat_m * vec4(normal, 0.f)).xyz;
 
-    vec4 relative_pos = mat_m * vec4(inPos, 1.0);
+    vec4 relative_pos = mat_m * vec4(pos, 1.0);
 
-    vec3 T = normalize(vec3(mat_m * inTangent));
-    vec3 N = normalize(vec3(mat_m * vec4(inNormal, 0.0)));
+    vec3 T = normalize(vec3(mat_m * vec4(tangent.xyz, 0.0)));
+    vec3 N = normalize(vec3(mat_m * vec4(normal, 0.0)));
     T = normalize(T - dot(T, N) * N); // re-orthogonalize
-    vec3 B = cross(N, T) * inTangent.w;
+    vec3 B = cross(N, T) * tangent.w;
     outTBN = mat3(T, B, N);
 
-    if (dimension == 1) {
-        outFragPos = relative_pos.xyz;
-        gl_Position = mat_viewproj * relative_pos;
-        return;
-    }
-
-    uint instance = gl_InstanceIndex;
-    uint square = dimension * dimension;
-
-    relative_pos.x += float(instance % dimension) * spread;
-    relative_pos.y += int(floor(float(instance / dimension))) % dimension * spread;
-    relative_pos.z += floor(float(instance / square)) * spread;
-
-    relative_pos.x -= dimension * 2;
-    relative_pos.y -= dimension * 2;
-    relative_pos.z -= dimension * 2;
     outFragPos = relative_pos.xyz;
     gl_Position = mat_viewproj * relative_pos;
 }
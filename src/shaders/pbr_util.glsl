@@ -42,8 +42,9 @@ vec4 Material_GetDiffuse(MaterialUniform mat, vec4 vertex_color, sampler2D tex,
 vec3 Material_GetNormal(MaterialUniform mat, vec3 vertex_normal, mat3 tbn, sampler2D tex, vec2 uv, uint flags) {
     vec3 normal = normalize(vertex_normal);
     if (MATERIAL_FLAG(HAS_NORMAL_TEX) && DEBUG_FLAG(USE_NORMAL_TEX)) {
-        normal = texture(tex, uv).rgb;
-        normal = normal * 2.0 - 1.0; // [0, 1] -> [-1, 1]
+        // Z is rebuilt from XY: BC5 normal maps only store two channels
+        normal.xy = texture(tex, uv).rg * 2.0 - 1.0; // [0, 1] -> [-1, 1]
+        normal.z = sqrt(max(1.0 - dot(normal.xy, normal.xy), 0.0));
         normal = normalize(tbn * normal); // tangent -> world
         if (!gl_FrontFacing) {
             normal *= -1.0f;
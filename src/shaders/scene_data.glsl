@@ -4,8 +4,6 @@ struct SceneData {
     vec4 camera_world;
     vec4 light_dir;
     vec4 light_color;
-    float spread;
-    uint dimension;
     uint debug_flags;
 };
 
@@ -14,6 +12,4 @@ struct SceneData {
 #define camera_world    scene.camera_world.xyz
 #define light_dir       scene.light_dir
 #define light_color     scene.light_color
-#define spread          scene.spread
-#define dimension       scene.dimension
 #define debug_flags     scene.debug_flags 
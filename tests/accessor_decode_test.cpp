@@ -0,0 +1,169 @@
+#include "common/accessor_decode.h"
+#include "common/util.h"
+#include <catch2/catch_test_macros.hpp>
+#include <fastgltf/glm_element_traits.hpp>
+#include <initializer_list>
+
+namespace {
+// Asset whose only buffer gets a view per add_view()
+fastgltf::Asset
+make_asset()
+{
+  fastgltf::Asset asset{};
+  fastgltf::Buffer buffer{};
+  buffer.data = fastgltf::sources::Vector{};
+  asset.buffers.push_back(std::move(buffer));
+  return asset;
+}
+
+template<typename T>
+size_t
+add_view(fastgltf::Asset* asset, std::initializer_list<T> values)
+{
+  auto& bytes =
+    std::get<fastgltf::sources::Vector>(asset->buffers[0].data).bytes;
+  fastgltf::BufferView view{};
+  {
+    view.bufferIndex = 0;
+    view.byteOffset = bytes.size();
+    view.byteLength = values.size() * sizeof(T);
+  }
+  for (const T& value : values) {
+    const auto* data = reinterpret_cast<const std::byte*>(&value);
+    bytes.insert(bytes.end(), data, data + sizeof(T));
+  }
+  asset->buffers[0].byteLength = bytes.size();
+  asset->bufferViews.push_back(view);
+  return asset->bufferViews.size() - 1;
+}
+
+fastgltf::Accessor
+make_accessor(fastgltf::AccessorType type,
+              fastgltf::ComponentType component_type,
+              size_t count,
+              bool normalized)
+{
+  fastgltf::Accessor accessor{};
+  {
+    accessor.type = type;
+    accessor.componentType = component_type;
+    accessor.count = count;
+    accessor.normalized = normalized;
+  }
+  return accessor;
+}
+}
+
+SCENARIO("Accessors are decoded straight from their buffers",
+         "[accessor_decode]")
+{
+  using Vertex = PosNormalTangentColorUvVertex;
+  auto asset = make_asset();
+
+  GIVEN("Normalized unsigned byte colors")
+  {
+    auto accessor = make_accessor(fastgltf::AccessorType::Vec4,
+                                  fastgltf::ComponentType::UnsignedByte,
+                                  1,
+                                  true);
+    accessor.bufferViewIndex = add_view<u8>(&asset, { 255, 0, 51, 255 });
+    THEN("They map to [0, 1]")
+    {
+      glm::vec4 color{ -1.f };
+      copy_accessor<glm::vec4>(asset, accessor, &color);
+      const glm::vec4 expected{ 1.f, 0.f, .2f, 1.f };
+      REQUIRE(color == expected);
+    }
+  }
+
+  GIVEN("Normalized short normals, interleaved into vertices")
+  {
+    auto accessor = make_accessor(fastgltf::AccessorType::Vec3,
+                                  fastgltf::ComponentType::Short,
+                                  2,
+                                  true);
+    accessor.bufferViewIndex =
+      add_view<i16>(&asset, { 32767, -32768, 0, 0, 0, -32767 });
+    THEN("They map to [-1, 1], the other fields are left alone")
+    {
+      std::vector<Vertex> vertices(2);
+      vertices[1].uv = glm::vec2{ 5.f };
+      copy_accessor<glm::vec3, sizeof(Vertex)>(
+        asset, accessor, &vertices[0].normal);
+      const glm::vec3 first{ 1.f, -1.f, 0.f };
+      const glm::vec3 second{ 0.f, 0.f, -1.f };
+      REQUIRE(vertices[0].normal == first);
+      REQUIRE(vertices[1].normal == second);
+      REQUIRE(vertices[1].uv == glm::vec2{ 5.f });
+    }
+  }
+
+  GIVEN("Quantized positions that aren't normalized")
+  {
+    auto accessor = make_accessor(fastgltf::AccessorType::Vec3,
+                                  fastgltf::ComponentType::UnsignedShort,
+                                  1,
+                                  false);
+    accessor.bufferViewIndex = add_view<u16>(&asset, { 1, 2, 300 });
+    THEN("They keep their value")
+    {
+      glm::vec3 position{ 0.f };
+      copy_accessor<glm::vec3>(asset, accessor, &position);
+      const glm::vec3 expected{ 1.f, 2.f, 300.f };
+      REQUIRE(position == expected);
+    }
+  }
+
+  GIVEN("A sparse accessor over a base view")
+  {
+    auto accessor = make_accessor(fastgltf::AccessorType::Scalar,
+                                  fastgltf::ComponentType::UnsignedInt,
+                                  4,
+                                  false);
+    accessor.bufferViewIndex = add_view<u32>(&asset, { 10, 11, 12, 13 });
+    fastgltf::SparseAccessor sparse{};
+    {
+      sparse.count = 2;
+      sparse.indicesBufferView = add_view<u8>(&asset, { 1, 3 });
+      sparse.indicesByteOffset = 0;
+      sparse.valuesBufferView = add_view<u32>(&asset, { 21, 23 });
+      sparse.valuesByteOffset = 0;
+      sparse.indexComponentType = fastgltf::ComponentType::UnsignedByte;
+    }
+    accessor.sparse = sparse;
+    THEN("Its values replace the elements of their index")
+    {
+      std::vector<u32> indices(4);
+      copy_accessor<u32>(asset, accessor, indices.data());
+      const std::vector<u32> expected{ 10, 21, 12, 23 };
+      REQUIRE(indices == expected);
+    }
+  }
+
+  GIVEN("A sparse accessor without a base view")
+  {
+    auto accessor = make_accessor(fastgltf::AccessorType::Vec3,
+                                  fastgltf::ComponentType::Float,
+                                  3,
+                                  false);
+    fastgltf::SparseAccessor sparse{};
+    {
+      sparse.count = 1;
+      sparse.indicesBufferView = add_view<u16>(&asset, { 2 });
+      sparse.indicesByteOffset = 0;
+      sparse.valuesBufferView = add_view<f32>(&asset, { 1.f, 2.f, 3.f });
+      sparse.valuesByteOffset = 0;
+      sparse.indexComponentType = fastgltf::ComponentType::UnsignedShort;
+    }
+    accessor.sparse = sparse;
+    THEN("The other elements are zeroes")
+    {
+      std::vector<glm::vec3> positions(3, glm::vec3{ 9.f });
+      copy_accessor<glm::vec3>(asset, accessor, positions.data());
+      REQUIRE(positions[0] == glm::vec3{ 0.f });
+      REQUIRE(positions[1] == glm::vec3{ 0.f });
+      const glm::vec3 expected{ 1.f, 2.f, 3.f };
+      REQUIRE(positions[2] == expected);
+    }
+  }
+}
@@ -0,0 +1,170 @@
+#include "common/mesh_cache.h"
+#include <catch2/catch_test_macros.hpp>
+#include <fstream>
+
+namespace {
+void
+write_source(const std::filesystem::path& path, const std::string& content)
+{
+  std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+  file << content;
+}
+}
+
+SCENARIO("MeshCache round trips baked meshes", "[mesh_cache]")
+{
+  const auto dir = std::filesystem::temp_directory_path() / "mesh_cache_test";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  const auto source = dir / "scene.gltf";
+  write_source(source, "{ \"asset\": {} }");
+  const std::vector<std::filesystem::path> buffers = { dir / "scene.bin" };
+  write_source(buffers[0], "0123");
+
+  GIVEN("A mesh with two submeshes under a parent node")
+  {
+    MeshCache::Data data{};
+    data.Vertices.resize(3 * sizeof(PackedVertex));
+    data.Vertices.back() = 42;
+    data.Indices = { 0, 0, 1, 0, 2, 0, 2, 0, 1, 0, 0, 0 }; // u16
+
+    data.Names = "cube";
+    data.Submeshes = { { 0, 3, 1, 0, 1, 0, 1 }, { 3, 3, -1, 1, 0, 1, 0 } };
+    data.Lods = { { 3, 3, .5f, 0 } };
+    data.Meshlets = { { glm::vec3{ 0.f }, 2.f, glm::vec3{ 0.f, 0.f, 1.f },
+                        .5f, 0, 3 } };
+    BakedMesh mesh{};
+    {
+      mesh.VertexCount = 3;
+      mesh.IndexCount = 6;
+      mesh.Format = static_cast<u32>(VertexFormat::Packed);
+      mesh.IndexSize = sizeof(u16);
+      mesh.SubmeshCount = 2;
+      mesh.NameLength = 4;
+      mesh.BoundsMin = glm::vec3{ -1.f };
+      mesh.BoundsMax = glm::vec3{ 2.f };
+    }
+    data.Meshes = { mesh };
+    data.Nodes = { { glm::mat4{ 1.f }, -1, 0, 1, 0, 0 },
+                   { glm::mat4{ 2.f }, 0, 1, 0, 0, 2 } };
+    data.Children = { 1 };
+    data.Instances = { glm::mat4{ 1.f }, glm::mat4{ 3.f } };
+
+    MeshCache cache{ dir / "cache" };
+    REQUIRE(cache.Write(source, data, 0, buffers));
+
+    WHEN("Opening it again")
+    {
+      REQUIRE(cache.Open(source, 0, buffers));
+      const auto& view = cache.Get();
+      THEN("Everything is read back")
+      {
+        REQUIRE(view.Meshes.size() == 1);
+        REQUIRE(view.Name(view.Meshes[0]) == "cube");
+        REQUIRE(view.Meshes[0].BoundsMax == glm::vec3{ 2.f });
+        REQUIRE(view.Submeshes[1].MaterialIndex == -1);
+        REQUIRE(view.Lods[view.Submeshes[0].FirstLod].Error == .5f);
+        REQUIRE(view.Meshlets[view.Submeshes[0].FirstMeshlet].Radius == 2.f);
+        REQUIRE(view.MeshVertices(view.Meshes[0])[71] == 42);
+        REQUIRE(view.MeshIndices(view.Meshes[0])[6] == 2);
+        REQUIRE(view.Nodes[1].MeshIndex == 0);
+        REQUIRE(view.Nodes[1].LocalMatrix == glm::mat4{ 2.f });
+        REQUIRE(view.Children[0] == 1);
+        REQUIRE(view.Nodes[1].InstanceCount == 2);
+        REQUIRE(view.Instances[1] == glm::mat4{ 3.f });
+      }
+    }
+
+    WHEN("The source changes")
+    {
+      write_source(source, "{ \"asset\": { \"version\": \"2.0\" } }");
+      THEN("The entry is stale")
+      {
+        REQUIRE_FALSE(cache.Open(source, 0, buffers));
+      }
+    }
+
+    WHEN("Opening it with other optimizer settings")
+    {
+      REQUIRE(cache.Write(source, data, 7, buffers));
+      THEN("Only the same bake key matches")
+      {
+        REQUIRE_FALSE(cache.Open(source, 8, buffers));
+        REQUIRE(cache.Open(source, 7, buffers));
+      }
+    }
+
+    WHEN("The entry was baked by another version")
+    {
+      const auto entry = cache.EntryPath(source);
+      std::fstream file{ entry, std::ios::binary | std::ios::in |
+                                  std::ios::out };
+      const u32 version = MeshCache::Version + 1;
+      file.seekp(sizeof(u32)); // after the magic
+      file.write(reinterpret_cast<const char*>(&version), sizeof(version));
+      file.close();
+      THEN("The entry is rejected")
+      {
+        REQUIRE_FALSE(cache.Open(source, 0, buffers));
+      }
+    }
+
+    WHEN("An external buffer changes but the source doesn't")
+    {
+      write_source(buffers[0], "4567");
+      THEN("The entry is stale")
+      {
+        REQUIRE_FALSE(cache.Open(source, 0, buffers));
+      }
+    }
+  }
+  std::filesystem::remove_all(dir);
+}
+
+SCENARIO("MeshCache data gathers meshes baked on their own", "[mesh_cache]")
+{
+  GIVEN("Two meshes baked separately")
+  {
+    auto bake = [](const std::string& name, u8 marker) {
+      MeshCache::Data data{};
+      data.Vertices = { marker, marker };
+      data.Indices = { marker, 0 };
+      data.Names = name;
+      data.Submeshes = { { 0, 3, 0, 0, 1, 0, 1 } };
+      data.Lods = { { 0, 3, static_cast<f32>(marker), 0 } };
+      data.Meshlets = { { glm::vec3{ 0.f }, static_cast<f32>(marker),
+                          glm::vec3{ 0.f }, 1.f, 0, 3 } };
+      BakedMesh mesh{};
+      {
+        mesh.VertexCount = 1;
+        mesh.IndexCount = 1;
+        mesh.SubmeshCount = 1;
+        mesh.NameLength = name.size();
+      }
+      data.Meshes = { mesh };
+      return data;
+    };
+    const auto first = bake("first", 1);
+    const auto second = bake("second", 2);
+
+    WHEN("Appending them in order")
+    {
+      MeshCache::Data scene{};
+      scene.Append(first);
+      scene.Append(second);
+      const auto view = scene.Get();
+      THEN("The second one's offsets follow the first one's data")
+      {
+        REQUIRE(view.Meshes.size() == 2);
+        const auto& mesh = view.Meshes[1];
+        REQUIRE(view.Name(mesh) == "second");
+        REQUIRE(view.MeshVertices(mesh)[0] == 2);
+        REQUIRE(view.MeshIndices(mesh)[0] == 2);
+        const auto& sub = view.Submeshes[mesh.FirstSubmesh];
+        REQUIRE(view.Lods[sub.FirstLod].Error == 2.f);
+        REQUIRE(view.Meshlets[sub.FirstMeshlet].Radius == 2.f);
+        REQUIRE(view.Name(view.Meshes[0]) == "first");
+      }
+    }
+  }
+}
@@ -0,0 +1,179 @@
+#include "common/gltf_loader.h"
+#include "common/mesh_optimizer.h"
+#include <algorithm>
+#include <array>
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+
+namespace {
+const auto SUZANNE_PATH = std::filesystem::path{ __FILE__ }.parent_path() /
+                          "../resources/models/Suzanne/Suzanne.gltf";
+}
+
+SCENARIO("MeshOptimizer improves vertex locality", "[mesh_optimizer]")
+{
+  GIVEN("The bundled Suzanne model, unwelded")
+  {
+    const auto& path = SUZANNE_PATH;
+    std::vector<PosNormalVertex_Aligned> welded{};
+    std::vector<u32> welded_indices{};
+    REQUIRE(GLTFLoader::LoadPositions(path, welded, welded_indices, 0));
+
+    std::vector<PosNormalVertex_Aligned> vertices{};
+    std::vector<u32> indices{};
+    for (u32 idx : welded_indices) {
+      indices.push_back(static_cast<u32>(vertices.size()));
+      vertices.push_back(welded[idx]);
+    }
+    const MeshOptimizer::IndexRange range{ 0, u32(indices.size()) };
+
+    WHEN("Running every step")
+    {
+      MeshOptimizer::Options options{};
+      options.Overdraw = true;
+      auto stats =
+        MeshOptimizer::Optimize(options, &vertices, &indices, { &range, 1 });
+
+      THEN("Each step is reported")
+      {
+        REQUIRE(stats.size() == 5);
+        REQUIRE(stats[0].Acmr == 3.f);
+      }
+      THEN("Vertices are welded back")
+      {
+        REQUIRE(vertices.size() < indices.size() / 3);
+        REQUIRE(indices.size() == welded_indices.size());
+      }
+      THEN("The ACMR drops, overdraw sorting costs little of it")
+      {
+        REQUIRE(stats[1].Acmr < stats[0].Acmr);
+        REQUIRE(stats[2].Acmr < stats[1].Acmr);
+        REQUIRE(stats[2].Acmr < 1.f);
+        REQUIRE(stats[3].Acmr < 1.f);
+      }
+      THEN("Vertices are in first use order")
+      {
+        u32 next{ 0 };
+        for (u32 idx : indices) {
+          REQUIRE(idx <= next);
+          next = std::max(next, idx + 1);
+        }
+        REQUIRE(next == vertices.size());
+      }
+    }
+  }
+}
+
+SCENARIO("MeshOptimizer builds LOD chains", "[mesh_optimizer]")
+{
+  GIVEN("The bundled Suzanne model")
+  {
+    std::vector<PosNormalVertex_Aligned> vertices{};
+    std::vector<u32> indices{};
+    REQUIRE(GLTFLoader::LoadPositions(SUZANNE_PATH, vertices, indices, 0));
+    const MeshOptimizer::IndexRange range{ 0, u32(indices.size()) };
+    MeshOptimizer::Options options{};
+    MeshOptimizer::Optimize(options, &vertices, &indices, { &range, 1 });
+
+    WHEN("Building its LODs")
+    {
+      auto lods = MeshOptimizer::BuildLods(options, vertices, &indices, range);
+
+      THEN("Each level is coarser than the previous one")
+      {
+        REQUIRE(lods.size() >= 2);
+        u32 count = range.Count;
+        f32 error = 0.f;
+        for (const auto& lod : lods) {
+          REQUIRE(lod.Count < count);
+          REQUIRE(lod.Count % 3 == 0);
+          REQUIRE(lod.Error >= error);
+          count = lod.Count;
+          error = lod.Error;
+        }
+      }
+      THEN("They're appended after the full mesh, with the same vertices")
+      {
+        REQUIRE(lods[0].First == range.Count);
+        REQUIRE(indices.size() == lods.back().First + lods.back().Count);
+        for (u32 idx : indices) {
+          REQUIRE(idx < vertices.size());
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("MeshOptimizer splits meshes into meshlets", "[mesh_optimizer]")
+{
+  GIVEN("The bundled Suzanne model")
+  {
+    std::vector<PosNormalVertex_Aligned> vertices{};
+    std::vector<u32> indices{};
+    REQUIRE(GLTFLoader::LoadPositions(SUZANNE_PATH, vertices, indices, 0));
+    const MeshOptimizer::IndexRange range{ 0, u32(indices.size()) };
+    MeshOptimizer::Options options{};
+    MeshOptimizer::Optimize(options, &vertices, &indices, { &range, 1 });
+    auto triangles = [](const std::vector<u32>& idx) {
+      // rotated so that the smallest index comes first, winding is kept
+      std::vector<std::array<u32, 3>> ret{};
+      for (size_t i = 0; i < idx.size(); i += 3) {
+        std::array<u32, 3> t{ idx[i], idx[i + 1], idx[i + 2] };
+        std::rotate(
+          t.begin(), std::min_element(t.begin(), t.end()), t.end());
+        ret.push_back(t);
+      }
+      std::sort(ret.begin(), ret.end());
+      return ret;
+    };
+    const auto before = triangles(indices);
+
+    WHEN("Building its meshlets")
+    {
+      auto meshlets =
+        MeshOptimizer::BuildMeshlets(options, vertices, &indices, range);
+
+      THEN("They cover the range in order, within the limits")
+      {
+        REQUIRE(meshlets.size() > 1);
+        u32 next = range.First;
+        for (const auto& m : meshlets) {
+          REQUIRE(m.First == next);
+          REQUIRE(m.Count % 3 == 0);
+          REQUIRE(m.Count / 3 <= options.MeshletTriangles);
+          std::vector<u32> unique{ indices.begin() + m.First,
+                                   indices.begin() + m.First + m.Count };
+          std::sort(unique.begin(), unique.end());
+          unique.erase(std::unique(unique.begin(), unique.end()),
+                       unique.end());
+          REQUIRE(unique.size() <= options.MeshletVertices);
+          next = m.First + m.Count;
+        }
+        REQUIRE(next == range.First + range.Count);
+      }
+      THEN("Only the triangle order changes")
+      {
+        REQUIRE(triangles(indices) == before);
+      }
+      THEN("Bounds hold every vertex and cones every triangle normal")
+      {
+        for (const auto& m : meshlets) {
+          const f32 min_dot = std::sqrt(1.f - m.ConeCutoff * m.ConeCutoff);
+          for (u32 i = m.First; i < m.First + m.Count; i += 3) {
+            const glm::vec3 a = vertices[indices[i]].pos;
+            const glm::vec3 b = vertices[indices[i + 1]].pos;
+            const glm::vec3 c = vertices[indices[i + 2]].pos;
+            for (const auto& p : { a, b, c }) {
+              REQUIRE(glm::length(p - m.Center) <= m.Radius + 1e-5f);
+            }
+            const glm::vec3 n = glm::cross(b - a, c - a);
+            if (m.ConeCutoff < 1.f && glm::length(n) > 0.f) {
+              REQUIRE(glm::dot(glm::normalize(n), m.ConeAxis) >=
+                      min_dot - 1e-4f);
+            }
+          }
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,68 @@
+#include "common/mip_chain.h"
+#include <catch2/catch_test_macros.hpp>
+
+SCENARIO("MipChain halves RGBA8 images", "[mip_chain]")
+{
+  GIVEN("Image sizes")
+  {
+    THEN("The chain goes down to 1x1")
+    {
+      REQUIRE(MipChain::LevelCount(1, 1) == 1);
+      REQUIRE(MipChain::LevelCount(256, 256) == 9);
+      REQUIRE(MipChain::LevelCount(300, 17) == 9);
+      REQUIRE(MipChain::LevelSize(300, 8) == 1);
+      REQUIRE(MipChain::LevelSize(300, 20) == 1);
+    }
+  }
+
+  GIVEN("A 2x2 linear image")
+  {
+    std::vector<u8> src = {
+      0,  0,  0,  0,   // top left
+      40, 40, 40, 40,  // top right
+      80, 80, 80, 80,  // bottom left
+      120, 120, 120, 255, // bottom right
+    };
+
+    WHEN("Downsampling it")
+    {
+      auto dst = MipChain::Downsample(src, 2, 2, false);
+      THEN("Texels are box filtered")
+      {
+        REQUIRE(dst.size() == 4);
+        REQUIRE(dst[0] == 60);
+        REQUIRE(dst[3] == 94);
+      }
+    }
+
+    WHEN("Downsampling it as sRGB")
+    {
+      auto dst = MipChain::Downsample(src, 2, 2, true);
+      THEN("Color is averaged in linear space but alpha isn't")
+      {
+        REQUIRE(dst[0] > 60);
+        REQUIRE(dst[3] == 94);
+      }
+    }
+  }
+
+  GIVEN("An odd sized image")
+  {
+    std::vector<u8> src = {
+      0,  0,  0,  0,  // left
+      30, 30, 30, 30, //
+      90, 90, 90, 90, // right
+    };
+
+    WHEN("Downsampling it")
+    {
+      auto dst = MipChain::Downsample(src, 3, 1, false);
+      THEN("The last column is averaged in, not dropped")
+      {
+        REQUIRE(dst.size() == 4);
+        REQUIRE(dst[0] == 40);
+        REQUIRE(dst[3] == 40);
+      }
+    }
+  }
+}
@@ -0,0 +1,97 @@
+#include "common/range_allocator.h"
+#include <catch2/catch_test_macros.hpp>
+
+SCENARIO("RangeAllocator hands out disjoint ranges", "[range_allocator]")
+{
+  GIVEN("An empty allocator")
+  {
+    auto alloc = RangeAllocator{ 100 };
+
+    THEN("The whole capacity is free")
+    {
+      REQUIRE(alloc.Used() == 0);
+      REQUIRE(alloc.LargestFreeRange() == 100);
+    }
+
+    WHEN("Allocating several ranges")
+    {
+      auto a = alloc.Allocate(10);
+      auto b = alloc.Allocate(20);
+      auto c = alloc.Allocate(70);
+      THEN("They are packed one after the other")
+      {
+        REQUIRE(a.value() == 0);
+        REQUIRE(b.value() == 10);
+        REQUIRE(c.value() == 30);
+        REQUIRE(alloc.Used() == 100);
+        REQUIRE_FALSE(alloc.Allocate(1).has_value());
+      }
+    }
+
+    WHEN("Allocating with an alignment")
+    {
+      auto a = alloc.Allocate(3);
+      auto b = alloc.Allocate(4, 16);
+      THEN("The offset is aligned and the padding stays free")
+      {
+        REQUIRE(a.value() == 0);
+        REQUIRE(b.value() == 16);
+        REQUIRE(alloc.Allocate(13).value() == 3);
+      }
+    }
+
+    WHEN("Requesting more than the capacity")
+    {
+      THEN("Allocation fails")
+      {
+        REQUIRE_FALSE(alloc.Allocate(101).has_value());
+        REQUIRE_FALSE(alloc.Allocate(0).has_value());
+      }
+    }
+  }
+}
+
+SCENARIO("RangeAllocator merges freed ranges", "[range_allocator]")
+{
+  GIVEN("A full allocator")
+  {
+    auto alloc = RangeAllocator{ 90 };
+    auto a = alloc.Allocate(30).value();
+    auto b = alloc.Allocate(30).value();
+    auto c = alloc.Allocate(30).value();
+
+    WHEN("The outer ranges are freed")
+    {
+      alloc.Free(a, 30);
+      alloc.Free(c, 30);
+      THEN("They stay separate")
+      {
+        REQUIRE(alloc.FreeRangeCount() == 2);
+        REQUIRE(alloc.LargestFreeRange() == 30);
+        REQUIRE_FALSE(alloc.Allocate(31).has_value());
+      }
+
+      AND_WHEN("The middle range is freed")
+      {
+        alloc.Free(b, 30);
+        THEN("Everything is coalesced back into one range")
+        {
+          REQUIRE(alloc.FreeRangeCount() == 1);
+          REQUIRE(alloc.LargestFreeRange() == 90);
+          REQUIRE(alloc.Used() == 0);
+        }
+      }
+    }
+
+    WHEN("A range is freed twice")
+    {
+      alloc.Free(b, 30);
+      alloc.Free(b, 30);
+      THEN("The second free is ignored")
+      {
+        REQUIRE(alloc.Used() == 60);
+        REQUIRE(alloc.FreeRangeCount() == 1);
+      }
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#include "common/scene_cache.h"
+#include <catch2/catch_test_macros.hpp>
+
+SCENARIO("SceneCache keeps recently used scenes", "[scene_cache]")
+{
+  GIVEN("A cache with room for two scenes")
+  {
+    SceneCache cache{ 200 };
+    auto scene = [](const char* path) {
+      return MakeUnique<GLTFScene>(path, nullptr);
+    };
+    cache.Insert(scene("a.glb"), 100);
+    cache.Insert(scene("b.glb"), 100);
+    REQUIRE(cache.Size() == 2);
+    REQUIRE(cache.Used() == 200);
+
+    WHEN("A third one is cached")
+    {
+      cache.Insert(scene("c.glb"), 100);
+      THEN("The least recently used one is evicted")
+      {
+        REQUIRE(cache.Size() == 2);
+        REQUIRE_FALSE(cache.Contains("a.glb"));
+        REQUIRE(cache.Contains("b.glb"));
+        REQUIRE(cache.Contains("c.glb"));
+      }
+    }
+
+    WHEN("A scene is taken out and cached back")
+    {
+      auto a = cache.Take("a.glb");
+      REQUIRE(a != nullptr);
+      REQUIRE(cache.Used() == 100);
+      cache.Insert(std::move(a), 100);
+      cache.Insert(scene("c.glb"), 100);
+      THEN("It's the most recently used one")
+      {
+        REQUIRE(cache.Contains("a.glb"));
+        REQUIRE_FALSE(cache.Contains("b.glb"));
+      }
+    }
+
+    WHEN("The budget shrinks")
+    {
+      cache.SetBudget(50);
+      THEN("Scenes that don't fit are released")
+      {
+        REQUIRE(cache.Size() == 0);
+        REQUIRE(cache.Used() == 0);
+        REQUIRE(cache.Take("b.glb") == nullptr);
+      }
+    }
+  }
+}
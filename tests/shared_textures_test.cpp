@@ -0,0 +1,71 @@
+#include "common/shared_textures.h"
+#include <catch2/catch_test_macros.hpp>
+
+namespace {
+// Only compared, never dereferenced
+SDL_GPUTexture*
+fake_texture(u64 id)
+{
+  return reinterpret_cast<SDL_GPUTexture*>(id * 16);
+}
+}
+
+SCENARIO("SharedTextures reference counts textures by content",
+         "[shared_textures]")
+{
+  GIVEN("A texture stored by a first scene")
+  {
+    SharedTextures textures{};
+    SharedTextures::Entry first{ .Texture = fake_texture(1) };
+    REQUIRE(textures.Insert(42, &first));
+    REQUIRE(first.Texture == fake_texture(1));
+    REQUIRE(textures.Size() == 1);
+
+    WHEN("Another scene acquires the same key")
+    {
+      SharedTextures::Entry second{};
+      REQUIRE(textures.Acquire(42, &second));
+      THEN("It gets the same texture, released with the last reference")
+      {
+        REQUIRE(second.Texture == fake_texture(1));
+        REQUIRE_FALSE(textures.Release(second.Texture));
+        REQUIRE(textures.Release(first.Texture));
+        REQUIRE(textures.Size() == 0);
+        REQUIRE_FALSE(textures.Acquire(42, &second));
+      }
+    }
+
+    WHEN("Another scene created the same texture meanwhile")
+    {
+      SharedTextures::Entry raced{ .Texture = fake_texture(2) };
+      const bool inserted = textures.Insert(42, &raced);
+      THEN("The stored one is referenced and handed back instead")
+      {
+        REQUIRE_FALSE(inserted);
+        REQUIRE(raced.Texture == fake_texture(1));
+        REQUIRE(textures.Size() == 1);
+        REQUIRE_FALSE(textures.Release(raced.Texture));
+        REQUIRE(textures.Release(first.Texture));
+      }
+    }
+
+    WHEN("A key isn't stored")
+    {
+      SharedTextures::Entry other{};
+      THEN("Nothing is acquired")
+      {
+        REQUIRE_FALSE(textures.Acquire(7, &other));
+        REQUIRE(other.Texture == nullptr);
+      }
+    }
+
+    WHEN("A texture that isn't shared is released")
+    {
+      THEN("The caller releases it")
+      {
+        REQUIRE(textures.Release(fake_texture(3)));
+        REQUIRE(textures.Size() == 1);
+      }
+    }
+  }
+}
@@ -0,0 +1,136 @@
+#include "common/texture_encoder.h"
+#include <catch2/catch_test_macros.hpp>
+
+#include <cstdlib>
+
+namespace {
+// Reference mode 6 decoder, returns the 16 RGBA texels of `block`
+std::vector<u8>
+decode_bc7_mode6(const u8* block)
+{
+  u32 position{ 0 };
+  auto read = [&](u32 bits) {
+    u32 ret{ 0 };
+    for (u32 i = 0; i < bits; ++i, ++position) {
+      ret |= ((block[position / 8] >> (position % 8)) & 1) << i;
+    }
+    return ret;
+  };
+  REQUIRE(read(7) == (1 << 6));
+  u32 endpoints[2][4];
+  for (u32 c = 0; c < 4; ++c) {
+    endpoints[0][c] = read(7);
+    endpoints[1][c] = read(7);
+  }
+  const u32 p[2] = { read(1), read(1) };
+  constexpr u32 weights[16] = { 0,  4,  9,  13, 17, 21, 26, 30,
+                                34, 38, 43, 47, 51, 55, 60, 64 };
+  std::vector<u8> ret(64);
+  for (u32 t = 0; t < 16; ++t) {
+    const u32 w = weights[read(t == 0 ? 3 : 4)];
+    for (u32 c = 0; c < 4; ++c) {
+      const u32 e0 = (endpoints[0][c] << 1) | p[0];
+      const u32 e1 = (endpoints[1][c] << 1) | p[1];
+      ret[t * 4 + c] = static_cast<u8>(((64 - w) * e0 + w * e1 + 32) >> 6);
+    }
+  }
+  return ret;
+}
+}
+
+SCENARIO("TextureEncoder compresses RGBA8 images", "[texture_encoder]")
+{
+  const TextureTranscoder::Support all{ true, true, true, true };
+
+  GIVEN("Texture roles")
+  {
+    THEN("Each gets its block format")
+    {
+      REQUIRE(TextureEncoder::FormatFor(
+                TextureRole::Color, true, true, 64, 64, all) ==
+              SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB);
+      REQUIRE(TextureEncoder::FormatFor(
+                TextureRole::Normal, false, false, 64, 64, all) ==
+              SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM);
+      REQUIRE(TextureEncoder::FormatFor(
+                TextureRole::Data, false, false, 64, 64, all) ==
+              SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM);
+    }
+    THEN("Colors without BC7 depend on alpha")
+    {
+      TextureTranscoder::Support no_bc7{ true, true, true, false };
+      REQUIRE(TextureEncoder::FormatFor(
+                TextureRole::Color, true, true, 64, 64, no_bc7) ==
+              SDL_GPU_TEXTUREFORMAT_BC3_RGBA_UNORM_SRGB);
+      REQUIRE(TextureEncoder::FormatFor(
+                TextureRole::Color, true, false, 64, 64, no_bc7) ==
+              SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM_SRGB);
+    }
+    THEN("Partial blocks and missing support keep RGBA8")
+    {
+      REQUIRE(TextureEncoder::FormatFor(
+                TextureRole::Color, true, false, 62, 64, all) ==
+              SDL_GPU_TEXTUREFORMAT_INVALID);
+      REQUIRE(TextureEncoder::FormatFor(
+                TextureRole::Normal, false, false, 64, 64, {}) ==
+              SDL_GPU_TEXTUREFORMAT_INVALID);
+    }
+  }
+
+  GIVEN("An 8x8 gradient")
+  {
+    std::vector<u8> rgba(8 * 8 * 4);
+    for (u32 y = 0; y < 8; ++y) {
+      for (u32 x = 0; x < 8; ++x) {
+        u8* texel = &rgba[(y * 8 + x) * 4];
+        texel[0] = static_cast<u8>(x * 32);
+        texel[1] = static_cast<u8>(128 + x * 8);
+        texel[2] = static_cast<u8>(255 - x * 16);
+        texel[3] = 255;
+      }
+    }
+
+    WHEN("Encoding it to BC7")
+    {
+      auto blocks = TextureEncoder::Encode(
+        SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM, rgba, 8, 8);
+      THEN("Every texel decodes close to its source")
+      {
+        REQUIRE(blocks.size() == 4 * 16);
+        i32 max_error{ 0 };
+        for (u32 b = 0; b < 4; ++b) {
+          auto texels = decode_bc7_mode6(&blocks[b * 16]);
+          for (u32 t = 0; t < 16; ++t) {
+            const u32 x = (b % 2) * 4 + t % 4;
+            const u32 y = (b / 2) * 4 + t / 4;
+            for (u32 c = 0; c < 4; ++c) {
+              const i32 d = texels[t * 4 + c] - rgba[(y * 8 + x) * 4 + c];
+              max_error = std::max(max_error, std::abs(d));
+            }
+          }
+        }
+        REQUIRE(max_error <= 4);
+      }
+    }
+
+    WHEN("Encoding a chain with partial blocks")
+    {
+      TranscodedTexture out{};
+      std::vector<u8> pixels(rgba.begin(), rgba.begin() + 6 * 5 * 4);
+      REQUIRE(TextureEncoder::EncodeChain(SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM,
+                                          std::move(pixels),
+                                          6,
+                                          5,
+                                          3,
+                                          false,
+                                          &out));
+      THEN("Each level rounds up to whole blocks")
+      {
+        REQUIRE(out.Levels.size() == 3);
+        REQUIRE(out.Levels[0].size() == 2 * 2 * 8);
+        REQUIRE(out.Levels[1].size() == 1 * 1 * 8);
+        REQUIRE(out.Levels[2].size() == 1 * 1 * 8);
+      }
+    }
+  }
+}
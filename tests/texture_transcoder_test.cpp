@@ -0,0 +1,55 @@
+#include "common/texture_transcoder.h"
+#include <catch2/catch_test_macros.hpp>
+
+SCENARIO("TextureTranscoder picks a format per texture role",
+         "[texture_transcoder]")
+{
+  GIVEN("A device sampling every BC format")
+  {
+    TextureTranscoder::Support support{ true, true, true, true };
+    THEN("Colors are BC7, normals BC5 and data BC1")
+    {
+      REQUIRE(TextureTranscoder::FormatFor(
+                TextureRole::Color, true, support) ==
+              SDL_GPU_TEXTUREFORMAT_BC7_RGBA_UNORM_SRGB);
+      REQUIRE(TextureTranscoder::FormatFor(
+                TextureRole::Normal, false, support) ==
+              SDL_GPU_TEXTUREFORMAT_BC5_RG_UNORM);
+      REQUIRE(TextureTranscoder::FormatFor(
+                TextureRole::Data, false, support) ==
+              SDL_GPU_TEXTUREFORMAT_BC1_RGBA_UNORM);
+    }
+  }
+
+  GIVEN("A device without BC support")
+  {
+    TextureTranscoder::Support support{};
+    THEN("Every role falls back to RGBA8")
+    {
+      REQUIRE(TextureTranscoder::FormatFor(
+                TextureRole::Color, true, support) ==
+              SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM_SRGB);
+      REQUIRE(TextureTranscoder::FormatFor(
+                TextureRole::Normal, false, support) ==
+              SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM);
+      REQUIRE(TextureTranscoder::FormatFor(
+                TextureRole::Data, false, support) ==
+              SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM);
+    }
+  }
+
+  GIVEN("Image headers")
+  {
+    const std::vector<u8> ktx2 = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                   0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+    const std::vector<u8> png = { 0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A,
+                                  0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D };
+    THEN("Only KTX2 is recognized")
+    {
+      REQUIRE(TextureTranscoder::IsKtx2(ktx2));
+      REQUIRE_FALSE(TextureTranscoder::IsKtx2(png));
+      REQUIRE_FALSE(TextureTranscoder::IsKtx2(
+        std::span<const u8>{ ktx2.data(), ktx2.size() - 1 }));
+    }
+  }
+}
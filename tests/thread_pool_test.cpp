@@ -0,0 +1,64 @@
+#include "common/thread_pool.h"
+#include <atomic>
+#include <catch2/catch_test_macros.hpp>
+
+SCENARIO("ThreadPool runs every submitted task", "[thread_pool]")
+{
+  GIVEN("A pool with several workers")
+  {
+    auto pool = ThreadPool{ 4 };
+    REQUIRE(pool.Size() == 4);
+
+    WHEN("Submitting tasks returning values")
+    {
+      std::vector<std::future<u32>> results;
+      for (u32 i = 0; i < 64; ++i) {
+        results.push_back(pool.Submit([i]() { return i * i; }));
+      }
+      THEN("Each future holds its task's result")
+      {
+        for (u32 i = 0; i < 64; ++i) {
+          REQUIRE(results[i].get() == i * i);
+        }
+      }
+    }
+  }
+
+  GIVEN("A single worker whose task waits on tasks it submits")
+  {
+    auto pool = ThreadPool{ 1 };
+    WHEN("The outer task waits through the pool")
+    {
+      auto outer = pool.Submit([&pool]() {
+        std::vector<std::future<u32>> inner;
+        for (u32 i = 0; i < 8; ++i) {
+          inner.push_back(pool.Submit([i]() { return i; }));
+        }
+        u32 sum{ 0 };
+        for (auto& result : inner) {
+          sum += pool.Wait(result);
+        }
+        return sum;
+      });
+      THEN("The inner tasks run instead of deadlocking")
+      {
+        REQUIRE(pool.Wait(outer) == 28);
+      }
+    }
+  }
+
+  GIVEN("Tasks still queued when the pool is destroyed")
+  {
+    std::atomic<u32> done{ 0 };
+    {
+      auto pool = ThreadPool{ 1 };
+      for (u32 i = 0; i < 16; ++i) {
+        pool.Submit([&done]() { ++done; });
+      }
+    }
+    THEN("They all ran")
+    {
+      REQUIRE(done == 16);
+    }
+  }
+}
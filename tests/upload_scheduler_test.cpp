@@ -0,0 +1,40 @@
+#include "common/upload_scheduler.h"
+#include <catch2/catch_test_macros.hpp>
+
+SCENARIO("UploadScheduler splits buffer jobs within the job",
+         "[upload_scheduler]")
+{
+  GIVEN("A 6 byte job, e.g. three u16 indices")
+  {
+    const u32 size = 6;
+
+    WHEN("It fits the budget")
+    {
+      THEN("It is recorded in one piece")
+      {
+        REQUIRE(UploadScheduler::ChunkSize(size, 64) == size);
+        REQUIRE(UploadScheduler::ChunkSize(size, size) == size);
+      }
+    }
+
+    WHEN("It is drained with a tiny budget every frame")
+    {
+      u32 consumed = 0;
+      u32 chunks = 0;
+      while (consumed < size) {
+        const u32 chunk = UploadScheduler::ChunkSize(size - consumed, 1);
+        REQUIRE(chunk > 0);
+        REQUIRE(chunk <= size - consumed);
+        consumed += chunk;
+        ++chunks;
+      }
+      THEN("Chunks stay 4 byte aligned and the tail isn't overrun")
+      {
+        REQUIRE(consumed == size);
+        REQUIRE(chunks == 2);
+        REQUIRE(UploadScheduler::ChunkSize(2, 1) == 2);
+        REQUIRE(UploadScheduler::ChunkSize(size, 5) == 4);
+      }
+    }
+  }
+}
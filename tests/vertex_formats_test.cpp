@@ -0,0 +1,73 @@
+#include "common/vertex_formats.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+
+SCENARIO("Vertices are packed losslessly enough", "[vertex_formats]")
+{
+  GIVEN("Unit vectors all around the sphere")
+  {
+    const glm::vec3 dirs[] = {
+      { 0.f, 0.f, 1.f },   { 0.f, 0.f, -1.f },   { 1.f, 0.f, 0.f },
+      { 0.f, -1.f, 0.f },  { .6f, .0f, -.8f },   { -.48f, .6f, .64f },
+      { .36f, -.48f, -.8f },
+    };
+    THEN("Octahedral encoding round trips them")
+    {
+      for (const auto& d : dirs) {
+        glm::vec3 n = VertexPacker::OctDecode(VertexPacker::OctEncode(d));
+        REQUIRE(glm::dot(n, d) > 0.9999f);
+      }
+    }
+  }
+
+  GIVEN("Floats in the half range")
+  {
+    THEN("They are converted to half floats")
+    {
+      REQUIRE(VertexPacker::ToHalf(0.f) == 0x0000);
+      REQUIRE(VertexPacker::ToHalf(1.f) == 0x3C00);
+      REQUIRE(VertexPacker::ToHalf(-2.f) == 0xC000);
+      REQUIRE(VertexPacker::ToHalf(.5f) == 0x3800);
+      REQUIRE(VertexPacker::ToHalf(65504.f) == 0x7BFF);
+      REQUIRE(VertexPacker::ToHalf(1e6f) == 0x7C00);
+    }
+  }
+
+  GIVEN("A vertex within its mesh bounds")
+  {
+    PosNormalTangentColorUvVertex v{};
+    {
+      v.pos = { 1.f, 2.f, 3.f };
+      v.normal = { 0.f, 1.f, 0.f };
+      v.tangent = { 1.f, 0.f, 0.f, -1.f };
+      v.uv = { .5f, .25f };
+    }
+    auto q = VertexQuantization::FromBounds({ -1.f, 0.f, 3.f },
+                                            { 3.f, 4.f, 3.f });
+    std::vector<u8> out;
+    VertexPacker::Pack({ &v, 1 }, VertexFormat::Packed, q, &out);
+    PackedVertex packed{};
+    std::memcpy(&packed, out.data(), sizeof(packed));
+
+    THEN("Its position is dequantized back")
+    {
+      REQUIRE(out.size() == sizeof(PackedVertex));
+      for (int i = 0; i < 3; ++i) {
+        f32 p = q.Offset[i] + packed.pos.v[i] / 32767.f * q.Scale[i];
+        REQUIRE(std::abs(p - v.pos[i]) < 1e-3f);
+      }
+      REQUIRE(packed.pos.v[3] == -32767); // tangent sign
+      REQUIRE(packed.uv.v[0] == 0x3800);
+    }
+  }
+
+  GIVEN("UVs outside the half range")
+  {
+    PosNormalTangentColorUvVertex v{};
+    v.uv = { 12.f, 0.f };
+    THEN("Float UVs are picked")
+    {
+      REQUIRE(VertexPacker::Choose({ &v, 1 }) == VertexFormat::PackedFloatUv);
+    }
+  }
+}